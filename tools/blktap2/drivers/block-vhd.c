@@ -664,6 +664,8 @@ __vhd_open(td_driver_t *driver, const char *name, vhd_flag_t flags)
 		s->writes++;
 	}
 
+	td_register_file(s->vhd.fd);
+
         return 0;
 
  fail:
@@ -760,6 +762,7 @@ _vhd_close(td_driver_t *driver)
 	vhd_log_close(s);
 	vhd_free_bat(s);
 	vhd_free_bitmap_cache(s);
+	td_unregister_file(s->vhd.fd);
 	vhd_close(&s->vhd);
 	vhd_free(s);
 
@@ -34,6 +34,10 @@
 #include "scheduler.h"
 #include "tapdisk-log.h"
 
+#ifdef SCHEDULER_EPOLL
+#include <sys/epoll.h>
+#endif
+
 #define DBG(_f, _a...)               tlog_write(TLOG_DBG, _f, ##_a)
 
 #define SCHEDULER_MAX_TIMEOUT        600
@@ -47,6 +51,20 @@
 #define scheduler_for_each_event(s, event, tmp)	\
 	list_for_each_entry_safe(event, tmp, &(s)->events, next)
 
+#ifdef SCHEDULER_EPOLL
+/* Descriptors returned per epoll_wait(); the rest are left for the next. */
+#define SCHEDULER_EPOLL_EVENTS       64
+
+/* All events registered on one fd, which epoll knows only once. */
+typedef struct scheduler_fd {
+	int                          fd;
+	uint32_t                     mask;
+
+	struct list_head             events;
+	struct list_head             next;
+} scheduler_fd_t;
+#endif
+
 typedef struct event {
 	char                         mode;
 	event_id_t                   id;
@@ -59,8 +77,300 @@ typedef struct event {
 	void                        *private;
 
 	struct list_head             next;
+
+#ifdef SCHEDULER_EPOLL
+	scheduler_fd_t              *sfd;
+	struct list_head             fd_next;
+	struct list_head             timeout_next;
+
+	/* Modes reported ready, and queued on the ready list. */
+	char                         pending;
+	struct list_head             ready_next;
+
+	/* Last round the callback was run in. */
+	unsigned int                 round;
+#endif
 } event_t;
 
+static void
+scheduler_event_callback(event_t *event, char mode)
+{
+	if (event->mode & SCHEDULER_POLL_TIMEOUT) {
+		struct timeval now;
+		gettimeofday(&now, NULL);
+		event->deadline = now.tv_sec + event->timeout;
+	}
+
+	event->cb(event->id, mode, event->private);
+}
+
+#ifdef SCHEDULER_EPOLL
+
+static uint32_t
+scheduler_fd_mask(scheduler_fd_t *sfd)
+{
+	event_t *event;
+	uint32_t mask = 0;
+	int edge = 1;
+
+	list_for_each_entry(event, &sfd->events, fd_next) {
+		if (event->mode & SCHEDULER_POLL_READ_FD)
+			mask |= EPOLLIN;
+		if (event->mode & SCHEDULER_POLL_WRITE_FD)
+			mask |= EPOLLOUT;
+		if (event->mode & SCHEDULER_POLL_EXCEPT_FD)
+			mask |= EPOLLPRI;
+		if (!(event->mode & SCHEDULER_POLL_EDGE))
+			edge = 0;
+	}
+
+	if (mask && edge)
+		mask |= EPOLLET;
+
+	return mask;
+}
+
+static int
+scheduler_fd_update(scheduler_t *s, scheduler_fd_t *sfd)
+{
+	struct epoll_event ev;
+	int err;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events   = scheduler_fd_mask(sfd);
+	ev.data.ptr = sfd;
+
+	if (!ev.events) {
+		/* Fails harmlessly if the fd has been closed already. */
+		epoll_ctl(s->epoll_fd, EPOLL_CTL_DEL, sfd->fd, NULL);
+		sfd->mask = 0;
+		return 0;
+	}
+
+	err = epoll_ctl(s->epoll_fd, sfd->mask ? EPOLL_CTL_MOD : EPOLL_CTL_ADD,
+			sfd->fd, &ev);
+	/*
+	 * Closing an fd drops it from the epoll set, and the number may have
+	 * been reused since.
+	 */
+	if (err && errno == ENOENT)
+		err = epoll_ctl(s->epoll_fd, EPOLL_CTL_ADD, sfd->fd, &ev);
+	if (err)
+		return -errno;
+
+	sfd->mask = ev.events;
+	return 0;
+}
+
+static void
+scheduler_detach_event(scheduler_t *s, event_t *event)
+{
+	scheduler_fd_t *sfd = event->sfd;
+
+	if (event->mode & SCHEDULER_POLL_TIMEOUT)
+		list_del(&event->timeout_next);
+
+	list_del_init(&event->ready_next);
+
+	if (!sfd)
+		return;
+
+	list_del(&event->fd_next);
+	event->sfd = NULL;
+
+	scheduler_fd_update(s, sfd);
+
+	if (list_empty(&sfd->events)) {
+		list_del(&sfd->next);
+		free(sfd);
+	}
+}
+
+static int
+scheduler_attach_event(scheduler_t *s, event_t *event)
+{
+	scheduler_fd_t *sfd;
+	int err;
+
+	INIT_LIST_HEAD(&event->ready_next);
+
+	if (event->mode & SCHEDULER_POLL_TIMEOUT)
+		list_add_tail(&event->timeout_next, &s->timeouts);
+
+	if (!(event->mode & SCHEDULER_POLL_FD))
+		return 0;
+
+	list_for_each_entry(sfd, &s->fds, next)
+		if (sfd->fd == event->fd)
+			goto found;
+
+	sfd = calloc(1, sizeof(*sfd));
+	if (!sfd) {
+		err = -ENOMEM;
+		goto fail;
+	}
+
+	sfd->fd = event->fd;
+	INIT_LIST_HEAD(&sfd->events);
+	list_add_tail(&sfd->next, &s->fds);
+
+found:
+	list_add_tail(&event->fd_next, &sfd->events);
+	event->sfd = sfd;
+
+	err = scheduler_fd_update(s, sfd);
+	if (err)
+		goto fail;
+
+	return 0;
+
+fail:
+	scheduler_detach_event(s, event);
+	return err;
+}
+
+static void
+scheduler_prepare_events(scheduler_t *s)
+{
+	int diff;
+	struct timeval now;
+	event_t *event;
+
+	s->timeout = SCHEDULER_MAX_TIMEOUT;
+
+	gettimeofday(&now, NULL);
+
+	list_for_each_entry(event, &s->timeouts, timeout_next) {
+		diff = event->deadline - now.tv_sec;
+		if (diff > 0)
+			s->timeout = MIN(s->timeout, diff);
+		else
+			s->timeout = 0;
+	}
+
+	s->timeout = MIN(s->timeout, s->max_timeout);
+}
+
+/*
+ * Queue the events on the ready fds before running any callbacks, which
+ * may unregister events and free the scheduler_fds the results point to.
+ */
+static void
+scheduler_queue_events(scheduler_t *s, struct epoll_event *evs, int n)
+{
+	scheduler_fd_t *sfd;
+	event_t *event;
+	char ready;
+	int i;
+
+	for (i = 0; i < n; i++) {
+		sfd   = evs[i].data.ptr;
+		ready = 0;
+
+		if (evs[i].events & EPOLLIN)
+			ready |= SCHEDULER_POLL_READ_FD;
+		if (evs[i].events & EPOLLOUT)
+			ready |= SCHEDULER_POLL_WRITE_FD;
+		if (evs[i].events & EPOLLPRI)
+			ready |= SCHEDULER_POLL_EXCEPT_FD;
+		/*
+		 * Errors and hangups can't be masked, and would be returned
+		 * forever unless some callback deals with them.
+		 */
+		if (evs[i].events & (EPOLLHUP | EPOLLERR))
+			ready |= SCHEDULER_POLL_FD;
+
+		list_for_each_entry(event, &sfd->events, fd_next) {
+			event->pending = event->mode & ready;
+			if (event->pending)
+				list_add_tail(&event->ready_next, &s->ready);
+		}
+	}
+}
+
+static void
+scheduler_run_events(scheduler_t *s)
+{
+	struct timeval now;
+	event_t *event, *tmp;
+	char mode;
+
+	gettimeofday(&now, NULL);
+
+	s->round++;
+
+	while (!list_empty(&s->ready)) {
+		event = list_entry(s->ready.next, event_t, ready_next);
+		list_del_init(&event->ready_next);
+
+		if (event->pending & SCHEDULER_POLL_READ_FD)
+			mode = SCHEDULER_POLL_READ_FD;
+		else if (event->pending & SCHEDULER_POLL_WRITE_FD)
+			mode = SCHEDULER_POLL_WRITE_FD;
+		else
+			mode = SCHEDULER_POLL_EXCEPT_FD;
+
+		event->pending = 0;
+		event->round   = s->round;
+		scheduler_event_callback(event, mode);
+	}
+
+ again:
+	s->restart = 0;
+
+	list_for_each_entry_safe(event, tmp, &s->timeouts, timeout_next) {
+		if (event->round != s->round &&
+		    event->deadline <= now.tv_sec) {
+			event->round = s->round;
+			scheduler_event_callback(event, SCHEDULER_POLL_TIMEOUT);
+		}
+
+		if (s->restart)
+			goto again;
+	}
+}
+
+static int
+scheduler_wait(scheduler_t *s)
+{
+	struct epoll_event evs[SCHEDULER_EPOLL_EVENTS];
+	int ret;
+
+	ret = epoll_wait(s->epoll_fd, evs, SCHEDULER_EPOLL_EVENTS,
+			 s->timeout * 1000);
+	if (ret > 0)
+		scheduler_queue_events(s, evs, ret);
+
+	return ret;
+}
+
+static int
+scheduler_init_backend(scheduler_t *s)
+{
+	INIT_LIST_HEAD(&s->fds);
+	INIT_LIST_HEAD(&s->timeouts);
+	INIT_LIST_HEAD(&s->ready);
+
+	s->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (s->epoll_fd < 0)
+		return -errno;
+
+	return 0;
+}
+
+#else /* !SCHEDULER_EPOLL */
+
+static int
+scheduler_attach_event(scheduler_t *s, event_t *event)
+{
+	return 0;
+}
+
+static void
+scheduler_detach_event(scheduler_t *s, event_t *event)
+{
+}
+
 static void
 scheduler_prepare_events(scheduler_t *s)
 {
@@ -105,18 +415,6 @@ scheduler_prepare_events(scheduler_t *s)
 	s->timeout = MIN(s->timeout, s->max_timeout);
 }
 
-static void
-scheduler_event_callback(event_t *event, char mode)
-{
-	if (event->mode & SCHEDULER_POLL_TIMEOUT) {
-		struct timeval now;
-		gettimeofday(&now, NULL);
-		event->deadline = now.tv_sec + event->timeout;
-	}
-
-	event->cb(event->id, mode, event->private);
-}
-
 static void
 scheduler_run_events(scheduler_t *s)
 {
@@ -160,12 +458,37 @@ scheduler_run_events(scheduler_t *s)
 	}
 }
 
+static int
+scheduler_wait(scheduler_t *s)
+{
+	struct timeval tv;
+
+	tv.tv_sec  = s->timeout;
+	tv.tv_usec = 0;
+
+	return select(s->max_fd + 1, &s->read_fds,
+		      &s->write_fds, &s->except_fds, &tv);
+}
+
+static int
+scheduler_init_backend(scheduler_t *s)
+{
+	FD_ZERO(&s->read_fds);
+	FD_ZERO(&s->write_fds);
+	FD_ZERO(&s->except_fds);
+
+	return 0;
+}
+
+#endif /* SCHEDULER_EPOLL */
+
 int
 scheduler_register_event(scheduler_t *s, char mode, int fd,
 			 int timeout, event_cb_t cb, void *private)
 {
 	event_t *event;
 	struct timeval now;
+	int err;
 
 	if (!cb)
 		return -EINVAL;
@@ -187,6 +510,13 @@ scheduler_register_event(scheduler_t *s, char mode, int fd,
 	event->deadline = now.tv_sec + timeout;
 	event->cb       = cb;
 	event->private  = private;
+
+	err = scheduler_attach_event(s, event);
+	if (err) {
+		free(event);
+		return err;
+	}
+
 	event->id       = s->uuid++;
 
 	if (!s->uuid)
@@ -207,6 +537,7 @@ scheduler_unregister_event(scheduler_t *s, event_id_t id)
 
 	scheduler_for_each_event(s, event, tmp)
 		if (event->id == id) {
+			scheduler_detach_event(s, event);
 			list_del(&event->next);
 			free(event);
 			s->restart = 1;
@@ -225,18 +556,13 @@ int
 scheduler_wait_for_events(scheduler_t *s)
 {
 	int ret;
-	struct timeval tv;
 
 	scheduler_prepare_events(s);
 
-	tv.tv_sec  = s->timeout;
-	tv.tv_usec = 0;
-
 	DBG("timeout: %d, max_timeout: %d\n",
 	    s->timeout, s->max_timeout);
 
-	ret = select(s->max_fd + 1, &s->read_fds,
-		     &s->write_fds, &s->except_fds, &tv);
+	ret = scheduler_wait(s);
 
 	s->restart     = 0;
 	s->timeout     = SCHEDULER_MAX_TIMEOUT;
@@ -250,16 +576,14 @@ scheduler_wait_for_events(scheduler_t *s)
 	return ret;
 }
 
-void
+int
 scheduler_initialize(scheduler_t *s)
 {
 	memset(s, 0, sizeof(scheduler_t));
 
 	s->uuid = 1;
 
-	FD_ZERO(&s->read_fds);
-	FD_ZERO(&s->write_fds);
-	FD_ZERO(&s->except_fds);
-
 	INIT_LIST_HEAD(&s->events);
+
+	return scheduler_init_backend(s);
 }
@@ -32,29 +32,53 @@
 
 #include "list.h"
 
+/*
+ * On Linux, events are waited for with epoll, which costs in proportion to
+ * the number of ready rather than registered descriptors, and has no
+ * FD_SETSIZE limit.  Define SCHEDULER_SELECT to use select() regardless.
+ */
+#if defined(__linux__) && !defined(SCHEDULER_SELECT)
+#define SCHEDULER_EPOLL
+#endif
+
 #define SCHEDULER_POLL_READ_FD       0x1
 #define SCHEDULER_POLL_WRITE_FD      0x2
 #define SCHEDULER_POLL_EXCEPT_FD     0x4
 #define SCHEDULER_POLL_TIMEOUT       0x8
+/*
+ * The callback always drains the fd, so it need only be reported when
+ * it becomes ready again (edge triggered).  Only a hint: without epoll,
+ * or when other events on the same fd don't set it, the fd is polled
+ * level triggered.
+ */
+#define SCHEDULER_POLL_EDGE          0x10
 
 typedef int                          event_id_t;
 typedef void (*event_cb_t)          (event_id_t id, char mode, void *private);
 
 typedef struct scheduler {
+#ifdef SCHEDULER_EPOLL
+	int                          epoll_fd;
+	struct list_head             fds;
+	struct list_head             timeouts;
+	struct list_head             ready;
+	unsigned int                 round;
+#else
 	fd_set                       read_fds;
 	fd_set                       write_fds;
 	fd_set                       except_fds;
+	int                          max_fd;
+#endif
 
 	struct list_head             events;
 
 	int                          uuid;
-	int                          max_fd;
 	int                          timeout;
 	int                          restart;
 	int                          max_timeout;
 } scheduler_t;
 
-void scheduler_initialize(scheduler_t *);
+int scheduler_initialize(scheduler_t *);
 event_id_t scheduler_register_event(scheduler_t *, char mode,
 				    int fd, int timeout,
 				    event_cb_t cb, void *private);
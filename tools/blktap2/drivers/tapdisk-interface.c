@@ -245,6 +245,18 @@ td_prep_write(struct tiocb *tiocb, int fd, char *buf, size_t bytes,
 	tapdisk_prep_tiocb(tiocb, fd, 1, buf, bytes, offset, cb, arg);
 }
 
+void
+td_register_file(int fd)
+{
+	tapdisk_server_register_file(fd);
+}
+
+void
+td_unregister_file(int fd)
+{
+	tapdisk_server_unregister_file(fd);
+}
+
 void
 td_debug(td_image_t *image)
 {
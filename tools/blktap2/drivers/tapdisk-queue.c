@@ -28,6 +28,7 @@
 
 #include <errno.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <libaio.h>
 #ifdef __linux__
@@ -44,6 +45,13 @@
 #include "libaio-compat.h"
 #include "atomicio.h"
 
+#if defined(HAVE_LINUX_IO_URING_H) && defined(__NR_io_uring_setup)
+#define TIO_URING
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+#endif
+
 #define WARN(_f, _a...) tlog_write(TLOG_WARN, _f, ##_a)
 #define DBG(_f, _a...) tlog_write(TLOG_DBG, _f, ##_a)
 #define ERR(_err, _f, _a...) tlog_error(_err, _f, ##_a)
@@ -475,6 +483,7 @@ tapdisk_lio_setup(struct tqueue *queue, int qlen)
 {
 	struct lio *lio = queue->tio_data;
 	size_t sz;
+	char mode;
 	int err;
 
 	lio->event_id = -1;
@@ -483,8 +492,16 @@ tapdisk_lio_setup(struct tqueue *queue, int qlen)
 	if (err)
 		goto fail;
 
+	/*
+	 * tapdisk_lio_event() resets the eventfd and reaps all completions,
+	 * so it only needs to run when the counter goes up again.
+	 */
+	mode = SCHEDULER_POLL_READ_FD;
+	if (lio->flags & LIO_FLAG_EVENTFD)
+		mode |= SCHEDULER_POLL_EDGE;
+
 	lio->event_id =
-		tapdisk_server_register_event(SCHEDULER_POLL_READ_FD,
+		tapdisk_server_register_event(mode,
 					      lio->event_fd, 0,
 					      tapdisk_lio_event,
 					      queue);
@@ -547,6 +564,700 @@ static const struct tio td_tio_lio = {
 	.tio_submit  = tapdisk_lio_submit,
 };
 
+/*
+ * io_uring
+ */
+
+#ifdef TIO_URING
+
+/*
+ * Image files and data buffers are looked up in small tables of
+ * registered resources. A tapdisk serves few images and rings, so a
+ * linear scan is cheaper than the fget and page pinning it saves.
+ */
+#define URING_MAX_FILES         64
+#define URING_MAX_BUFFERS       16
+
+struct uring {
+	int                      ring_fd;
+	unsigned int             setup_flags;
+
+	unsigned int             sq_entries;
+	unsigned int            *sq_head;
+	unsigned int            *sq_tail;
+	unsigned int            *sq_mask;
+	unsigned int            *sq_array;
+	struct io_uring_sqe     *sqes;
+
+	unsigned int            *cq_head;
+	unsigned int            *cq_tail;
+	unsigned int            *cq_mask;
+	struct io_uring_cqe     *cqes;
+
+	void                    *sq_ring;
+	size_t                   sq_ring_size;
+	void                    *cq_ring;
+	size_t                   cq_ring_size;
+	size_t                   sqes_size;
+
+	struct io_event         *aio_events;
+
+	int                      event_fd;
+	event_id_t               event_id;
+
+	int                      files[URING_MAX_FILES];
+	int                      nr_files;
+
+	struct iovec             buffers[URING_MAX_BUFFERS];
+	int                      nr_buffers;
+
+	int                      flags;
+};
+
+#define URING_FLAG_FILES        (1<<0)
+
+static inline int
+__io_uring_setup(unsigned int entries, struct io_uring_params *p)
+{
+	return syscall(__NR_io_uring_setup, entries, p);
+}
+
+static inline int
+__io_uring_enter(int fd, unsigned int to_submit,
+		 unsigned int min_complete, unsigned int flags)
+{
+	return syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+		       flags, NULL, 0);
+}
+
+static inline int
+__io_uring_register(int fd, unsigned int opcode, void *arg,
+		    unsigned int nr_args)
+{
+	return syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static void
+tapdisk_uring_unmap_rings(struct uring *uring)
+{
+	if (uring->sqes) {
+		munmap(uring->sqes, uring->sqes_size);
+		uring->sqes = NULL;
+	}
+
+	if (uring->cq_ring && uring->cq_ring != uring->sq_ring)
+		munmap(uring->cq_ring, uring->cq_ring_size);
+	uring->cq_ring = NULL;
+
+	if (uring->sq_ring) {
+		munmap(uring->sq_ring, uring->sq_ring_size);
+		uring->sq_ring = NULL;
+	}
+}
+
+static int
+tapdisk_uring_map_rings(struct uring *uring, struct io_uring_params *p)
+{
+	int fd = uring->ring_fd;
+	char *sq, *cq;
+
+	uring->sq_ring_size = p->sq_off.array +
+		p->sq_entries * sizeof(unsigned int);
+	uring->cq_ring_size = p->cq_off.cqes +
+		p->cq_entries * sizeof(struct io_uring_cqe);
+	uring->sqes_size    = p->sq_entries * sizeof(struct io_uring_sqe);
+
+	if (p->features & IORING_FEAT_SINGLE_MMAP) {
+		if (uring->cq_ring_size > uring->sq_ring_size)
+			uring->sq_ring_size = uring->cq_ring_size;
+		uring->cq_ring_size = uring->sq_ring_size;
+	}
+
+	sq = mmap(NULL, uring->sq_ring_size, PROT_READ | PROT_WRITE,
+		  MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	if (sq == MAP_FAILED)
+		return -errno;
+	uring->sq_ring = sq;
+
+	if (p->features & IORING_FEAT_SINGLE_MMAP)
+		cq = sq;
+	else {
+		cq = mmap(NULL, uring->cq_ring_size, PROT_READ | PROT_WRITE,
+			  MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+		if (cq == MAP_FAILED)
+			return -errno;
+	}
+	uring->cq_ring = cq;
+
+	uring->sqes = mmap(NULL, uring->sqes_size, PROT_READ | PROT_WRITE,
+			   MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+	if (uring->sqes == MAP_FAILED) {
+		uring->sqes = NULL;
+		return -errno;
+	}
+
+	uring->sq_entries = p->sq_entries;
+	uring->sq_head    = (unsigned int *)(sq + p->sq_off.head);
+	uring->sq_tail    = (unsigned int *)(sq + p->sq_off.tail);
+	uring->sq_mask    = (unsigned int *)(sq + p->sq_off.ring_mask);
+	uring->sq_array   = (unsigned int *)(sq + p->sq_off.array);
+
+	uring->cq_head    = (unsigned int *)(cq + p->cq_off.head);
+	uring->cq_tail    = (unsigned int *)(cq + p->cq_off.tail);
+	uring->cq_mask    = (unsigned int *)(cq + p->cq_off.ring_mask);
+	uring->cqes       = (struct io_uring_cqe *)(cq + p->cq_off.cqes);
+
+	return 0;
+}
+
+/*
+ * IORING_OP_READ and IORING_OP_WRITE came later than the ring itself,
+ * so check for them rather than failing every request on older kernels.
+ */
+static int
+tapdisk_uring_probe(struct uring *uring)
+{
+	struct io_uring_probe *probe;
+	size_t sz;
+	int err;
+
+	sz    = sizeof(*probe) + 256 * sizeof(struct io_uring_probe_op);
+	probe = calloc(1, sz);
+	if (!probe)
+		return -ENOMEM;
+
+	err = __io_uring_register(uring->ring_fd, IORING_REGISTER_PROBE,
+				  probe, 256);
+	if (err) {
+		err = -errno;
+		goto out;
+	}
+
+	if (probe->last_op < IORING_OP_WRITE ||
+	    !(probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED) ||
+	    !(probe->ops[IORING_OP_WRITE].flags & IO_URING_OP_SUPPORTED))
+		err = -EOPNOTSUPP;
+
+out:
+	free(probe);
+	return err;
+}
+
+static void
+tapdisk_uring_setup_files(struct uring *uring)
+{
+	int i, err;
+
+	for (i = 0; i < URING_MAX_FILES; i++)
+		uring->files[i] = -1;
+
+	/* a sparse table, filled in by tapdisk_uring_register_file */
+	err = __io_uring_register(uring->ring_fd, IORING_REGISTER_FILES,
+				  uring->files, URING_MAX_FILES);
+	if (err) {
+		DPRINTF("io_uring: file registration unavailable: %d\n",
+			-errno);
+		return;
+	}
+
+	uring->flags |= URING_FLAG_FILES;
+}
+
+static void
+tapdisk_uring_destroy(struct tqueue *queue)
+{
+	struct uring *uring = queue->tio_data;
+
+	if (!uring)
+		return;
+
+	if (uring->event_id >= 0) {
+		tapdisk_server_unregister_event(uring->event_id);
+		uring->event_id = -1;
+	}
+
+	tapdisk_uring_unmap_rings(uring);
+
+	if (uring->ring_fd >= 0) {
+		close(uring->ring_fd);
+		uring->ring_fd = -1;
+	}
+
+	if (uring->event_fd >= 0) {
+		close(uring->event_fd);
+		uring->event_fd = -1;
+	}
+
+	free(uring->aio_events);
+	uring->aio_events = NULL;
+}
+
+/*
+ * Move completions from the CQ ring into aio_events, so the rest of
+ * the completion path is shared with lio.
+ */
+static void
+tapdisk_uring_reap(struct tqueue *queue)
+{
+	struct uring *uring = queue->tio_data;
+	unsigned int head, tail;
+	struct io_uring_cqe *cqe;
+	int i, n, split;
+	struct iocb *iocb;
+	struct tiocb *tiocb;
+	struct io_event *ep;
+
+	head = *uring->cq_head;
+	tail = __atomic_load_n(uring->cq_tail, __ATOMIC_ACQUIRE);
+
+	for (n = 0; head != tail && n < queue->size; n++, head++) {
+		cqe     = &uring->cqes[head & *uring->cq_mask];
+		ep      = uring->aio_events + n;
+		ep->obj = (struct iocb *)(unsigned long)cqe->user_data;
+		ep->res = (long)cqe->res;
+	}
+
+	__atomic_store_n(uring->cq_head, head, __ATOMIC_RELEASE);
+
+	split = io_split(&queue->opioctx, uring->aio_events, n);
+	tapdisk_filter_events(queue->filter, uring->aio_events, split);
+
+	DBG("events: %d, tiocbs: %d\n", n, split);
+
+	queue->iocbs_pending  -= n;
+	queue->tiocbs_pending -= split;
+
+	for (i = split, ep = uring->aio_events; i-- > 0; ep++) {
+		iocb  = ep->obj;
+		tiocb = iocb->data;
+		complete_tiocb(queue, tiocb, ep->res);
+	}
+
+	queue_deferred_tiocbs(queue);
+}
+
+static void
+tapdisk_uring_event(event_id_t id, char mode, void *private)
+{
+	struct tqueue *queue = private;
+	struct uring *uring = queue->tio_data;
+	uint64_t val;
+
+	read_exact(uring->event_fd, &val, sizeof(val));
+
+	tapdisk_uring_reap(queue);
+}
+
+/*
+ * Polled rings never signal the eventfd: completions are only found
+ * by asking the driver. Spin on a zero timeout while I/O is in flight,
+ * and drop back to sleeping in the scheduler once the ring is idle.
+ */
+static void
+tapdisk_uring_poll_event(event_id_t id, char mode, void *private)
+{
+	struct tqueue *queue = private;
+	struct uring *uring = queue->tio_data;
+	int err;
+
+	err = __io_uring_enter(uring->ring_fd, 0, 0, IORING_ENTER_GETEVENTS);
+	if (err < 0 && errno != EINTR && errno != EAGAIN)
+		ERR(-errno, "io_uring_enter");
+
+	tapdisk_uring_reap(queue);
+
+	if (!queue->iocbs_pending && uring->event_id >= 0) {
+		tapdisk_server_unregister_event(uring->event_id);
+		uring->event_id = -1;
+	}
+}
+
+static int
+tapdisk_uring_arm_poll(struct tqueue *queue)
+{
+	struct uring *uring = queue->tio_data;
+
+	if (uring->event_id >= 0)
+		return 0;
+
+	uring->event_id =
+		tapdisk_server_register_event(SCHEDULER_POLL_TIMEOUT,
+					      -1, 0,
+					      tapdisk_uring_poll_event,
+					      queue);
+	if (uring->event_id < 0) {
+		int err = uring->event_id;
+		uring->event_id = -1;
+		return err;
+	}
+
+	return 0;
+}
+
+static int
+__tapdisk_uring_setup(struct tqueue *queue, int qlen, unsigned int flags)
+{
+	struct uring *uring = queue->tio_data;
+	struct io_uring_params p;
+	int err;
+
+	uring->ring_fd     = -1;
+	uring->event_fd    = -1;
+	uring->event_id    = -1;
+	uring->setup_flags = flags;
+
+	/*
+	 * The CQ ring defaults to twice the SQ ring, and no more than
+	 * qlen iocbs are ever in flight, so it cannot overflow.
+	 */
+	memset(&p, 0, sizeof(p));
+	p.flags = flags;
+
+	uring->ring_fd = __io_uring_setup(qlen, &p);
+	if (uring->ring_fd < 0) {
+		err = -errno;
+		uring->ring_fd = -1;
+		goto fail;
+	}
+
+	err = tapdisk_uring_map_rings(uring, &p);
+	if (err)
+		goto fail;
+
+	err = tapdisk_uring_probe(uring);
+	if (err)
+		goto fail;
+
+	tapdisk_uring_setup_files(uring);
+
+	if (!(flags & IORING_SETUP_IOPOLL)) {
+		uring->event_fd = tapdisk_sys_eventfd(0);
+		if (uring->event_fd < 0) {
+			err = -errno;
+			goto fail;
+		}
+
+		err = __io_uring_register(uring->ring_fd,
+					  IORING_REGISTER_EVENTFD,
+					  &uring->event_fd, 1);
+		if (err) {
+			err = -errno;
+			goto fail;
+		}
+
+		/* as for lio, the eventfd is reset before every reap */
+		uring->event_id =
+			tapdisk_server_register_event(SCHEDULER_POLL_READ_FD |
+						      SCHEDULER_POLL_EDGE,
+						      uring->event_fd, 0,
+						      tapdisk_uring_event,
+						      queue);
+		err = uring->event_id;
+		if (err < 0)
+			goto fail;
+	}
+
+	uring->aio_events = calloc(qlen, sizeof(struct io_event));
+	if (!uring->aio_events) {
+		err = -errno;
+		goto fail;
+	}
+
+	return 0;
+
+fail:
+	DPRINTF("io_uring setup failed: %d\n", err);
+	tapdisk_uring_destroy(queue);
+	return err;
+}
+
+static int
+tapdisk_uring_setup(struct tqueue *queue, int qlen)
+{
+	return __tapdisk_uring_setup(queue, qlen, 0);
+}
+
+static int
+tapdisk_uring_poll_setup(struct tqueue *queue, int qlen)
+{
+	return __tapdisk_uring_setup(queue, qlen, IORING_SETUP_IOPOLL);
+}
+
+static inline int
+tapdisk_uring_file_index(struct uring *uring, int fd)
+{
+	int i;
+
+	for (i = 0; i < uring->nr_files; i++)
+		if (uring->files[i] == fd)
+			return i;
+
+	return -1;
+}
+
+static inline int
+tapdisk_uring_buffer_index(struct uring *uring, void *buf, size_t size)
+{
+	struct iovec *iov;
+	int i;
+
+	for (i = 0; i < uring->nr_buffers; i++) {
+		iov = &uring->buffers[i];
+		if ((char *)buf >= (char *)iov->iov_base &&
+		    (char *)buf + size <= (char *)iov->iov_base + iov->iov_len)
+			return i;
+	}
+
+	return -1;
+}
+
+static void
+tapdisk_uring_prep_sqe(struct uring *uring,
+		       struct io_uring_sqe *sqe, struct iocb *iocb)
+{
+	int write = (iocb->aio_lio_opcode == IO_CMD_PWRITE);
+	int idx;
+
+	memset(sqe, 0, sizeof(*sqe));
+
+	sqe->opcode    = write ? IORING_OP_WRITE : IORING_OP_READ;
+	sqe->fd        = iocb->aio_fildes;
+	sqe->off       = iocb->u.c.offset;
+	sqe->addr      = (unsigned long)iocb->u.c.buf;
+	sqe->len       = iocb->u.c.nbytes;
+	sqe->user_data = (unsigned long)iocb;
+
+	idx = tapdisk_uring_file_index(uring, iocb->aio_fildes);
+	if (idx >= 0) {
+		sqe->fd     = idx;
+		sqe->flags |= IOSQE_FIXED_FILE;
+	}
+
+	idx = tapdisk_uring_buffer_index(uring, iocb->u.c.buf,
+					 iocb->u.c.nbytes);
+	if (idx >= 0) {
+		sqe->opcode    = write ? IORING_OP_WRITE_FIXED :
+			IORING_OP_READ_FIXED;
+		sqe->buf_index = idx;
+	}
+}
+
+/*
+ * Every merged iocb goes into the SQ ring, and the whole batch is
+ * submitted with a single io_uring_enter. Like io_submit, the kernel
+ * may stop early; the rest is failed, as tapdisk_lio_submit does.
+ */
+static int
+tapdisk_uring_submit(struct tqueue *queue)
+{
+	struct uring *uring = queue->tio_data;
+	int i, merged, submitted, err = 0;
+	unsigned int tail, idx;
+
+	if (!queue->queued)
+		return 0;
+
+	tapdisk_filter_iocbs(queue->filter, queue->iocbs, queue->queued);
+	merged = io_merge(&queue->opioctx, queue->iocbs, queue->queued);
+
+	tail = *uring->sq_tail;
+	for (i = 0; i < merged; i++, tail++) {
+		idx = tail & *uring->sq_mask;
+		tapdisk_uring_prep_sqe(uring, &uring->sqes[idx],
+				       queue->iocbs[i]);
+		uring->sq_array[idx] = idx;
+	}
+	__atomic_store_n(uring->sq_tail, tail, __ATOMIC_RELEASE);
+
+	submitted = __io_uring_enter(uring->ring_fd, merged, 0, 0);
+
+	DBG("queued: %d, merged: %d, submitted: %d\n",
+	    queue->queued, merged, submitted);
+
+	if (submitted < 0) {
+		err = -errno;
+		submitted = 0;
+	} else if (submitted < merged)
+		err = -EIO;
+
+	/* whatever the kernel did not consume is failed below */
+	if (err)
+		__atomic_store_n(uring->sq_tail, *uring->sq_head,
+				 __ATOMIC_RELEASE);
+
+	queue->iocbs_pending  += submitted;
+	queue->tiocbs_pending += queue->queued;
+	queue->queued          = 0;
+
+	if (err)
+		queue->tiocbs_pending -=
+			fail_tiocbs(queue, submitted, merged, err);
+
+	if (queue->iocbs_pending &&
+	    (uring->setup_flags & IORING_SETUP_IOPOLL)) {
+		err = tapdisk_uring_arm_poll(queue);
+		if (err)
+			ERR(err, "failed to poll for io_uring completions");
+	}
+
+	return submitted;
+}
+
+static int
+tapdisk_uring_register_file(struct tqueue *queue, int fd)
+{
+	struct uring *uring = queue->tio_data;
+	struct io_uring_files_update up;
+	int i, err;
+
+	if (!(uring->flags & URING_FLAG_FILES))
+		return -EOPNOTSUPP;
+
+	if (tapdisk_uring_file_index(uring, fd) >= 0)
+		return 0;
+
+	for (i = 0; i < URING_MAX_FILES; i++)
+		if (uring->files[i] == -1)
+			break;
+	if (i == URING_MAX_FILES)
+		return -ENOSPC;
+
+	memset(&up, 0, sizeof(up));
+	up.offset = i;
+	up.fds    = (unsigned long)&fd;
+
+	err = __io_uring_register(uring->ring_fd,
+				  IORING_REGISTER_FILES_UPDATE, &up, 1);
+	if (err < 0)
+		return -errno;
+
+	uring->files[i] = fd;
+	if (uring->nr_files <= i)
+		uring->nr_files = i + 1;
+
+	return 0;
+}
+
+static void
+tapdisk_uring_unregister_file(struct tqueue *queue, int fd)
+{
+	struct uring *uring = queue->tio_data;
+	struct io_uring_files_update up;
+	int i, none = -1;
+
+	i = tapdisk_uring_file_index(uring, fd);
+	if (i < 0)
+		return;
+
+	memset(&up, 0, sizeof(up));
+	up.offset = i;
+	up.fds    = (unsigned long)&none;
+
+	if (__io_uring_register(uring->ring_fd,
+				IORING_REGISTER_FILES_UPDATE, &up, 1) < 0)
+		ERR(-errno, "failed to unregister fd %d", fd);
+
+	uring->files[i] = -1;
+	while (uring->nr_files && uring->files[uring->nr_files - 1] == -1)
+		uring->nr_files--;
+}
+
+/*
+ * The kernel only takes the buffer table as a whole, so it is rebuilt
+ * on every change. Buffers change when rings are mapped, which is rare.
+ */
+static int
+tapdisk_uring_update_buffers(struct uring *uring, int nr_buffers)
+{
+	int err;
+
+	if (uring->nr_buffers)
+		__io_uring_register(uring->ring_fd,
+				    IORING_UNREGISTER_BUFFERS, NULL, 0);
+	uring->nr_buffers = 0;
+
+	if (!nr_buffers)
+		return 0;
+
+	err = __io_uring_register(uring->ring_fd, IORING_REGISTER_BUFFERS,
+				  uring->buffers, nr_buffers);
+	if (err < 0)
+		return -errno;
+
+	uring->nr_buffers = nr_buffers;
+
+	return 0;
+}
+
+static int
+tapdisk_uring_register_buffer(struct tqueue *queue, void *buf, size_t size)
+{
+	struct uring *uring = queue->tio_data;
+	int n, err;
+
+	n = uring->nr_buffers;
+	if (n == URING_MAX_BUFFERS)
+		return -ENOSPC;
+
+	uring->buffers[n].iov_base = buf;
+	uring->buffers[n].iov_len  = size;
+
+	err = tapdisk_uring_update_buffers(uring, n + 1);
+	if (err) {
+		/* fall back to unregistered buffers for the others, too */
+		DPRINTF("io_uring: failed to register %zu bytes at %p: %d\n",
+			size, buf, err);
+		tapdisk_uring_update_buffers(uring, n);
+	}
+
+	return err;
+}
+
+static void
+tapdisk_uring_unregister_buffer(struct tqueue *queue, void *buf)
+{
+	struct uring *uring = queue->tio_data;
+	int i, n;
+
+	n = uring->nr_buffers;
+	for (i = 0; i < n; i++)
+		if (uring->buffers[i].iov_base == buf)
+			break;
+	if (i == n)
+		return;
+
+	uring->buffers[i] = uring->buffers[n - 1];
+
+	if (tapdisk_uring_update_buffers(uring, n - 1))
+		DPRINTF("io_uring: buffers no longer registered\n");
+}
+
+static const struct tio td_tio_uring = {
+	.name                  = "uring",
+	.data_size             = sizeof(struct uring),
+	.tio_setup             = tapdisk_uring_setup,
+	.tio_destroy           = tapdisk_uring_destroy,
+	.tio_submit            = tapdisk_uring_submit,
+	.tio_register_file     = tapdisk_uring_register_file,
+	.tio_unregister_file   = tapdisk_uring_unregister_file,
+	.tio_register_buffer   = tapdisk_uring_register_buffer,
+	.tio_unregister_buffer = tapdisk_uring_unregister_buffer,
+};
+
+static const struct tio td_tio_uring_poll = {
+	.name                  = "uring-poll",
+	.data_size             = sizeof(struct uring),
+	.tio_setup             = tapdisk_uring_poll_setup,
+	.tio_destroy           = tapdisk_uring_destroy,
+	.tio_submit            = tapdisk_uring_submit,
+	.tio_register_file     = tapdisk_uring_register_file,
+	.tio_unregister_file   = tapdisk_uring_unregister_file,
+	.tio_register_buffer   = tapdisk_uring_register_buffer,
+	.tio_unregister_buffer = tapdisk_uring_unregister_buffer,
+};
+
+#endif /* TIO_URING */
+
 static void
 tapdisk_queue_free_io(struct tqueue *queue)
 {
@@ -575,6 +1286,14 @@ tapdisk_queue_init_io(struct tqueue *queue, int drv)
 	case TIO_DRV_RWIO:
 		tio = &td_tio_rwio;
 		break;
+#ifdef TIO_URING
+	case TIO_DRV_URING:
+		tio = &td_tio_uring;
+		break;
+	case TIO_DRV_URING_POLL:
+		tio = &td_tio_uring_poll;
+		break;
+#endif
 	default:
 		err = -EINVAL;
 		goto fail;
@@ -604,6 +1323,21 @@ fail:
 	return err;
 }
 
+int
+tapdisk_queue_driver(const char *name)
+{
+	if (!strcmp(name, "lio"))
+		return TIO_DRV_LIO;
+	if (!strcmp(name, "rwio"))
+		return TIO_DRV_RWIO;
+	if (!strcmp(name, "uring"))
+		return TIO_DRV_URING;
+	if (!strcmp(name, "uring-poll"))
+		return TIO_DRV_URING_POLL;
+
+	return -EINVAL;
+}
+
 int
 tapdisk_init_queue(struct tqueue *queue, int size,
 		   int drv, struct tfilter *filter)
@@ -690,6 +1424,38 @@ tapdisk_prep_tiocb(struct tiocb *tiocb, int fd, int rw, char *buf, size_t size,
 	tiocb->next = NULL;
 }
 
+int
+tapdisk_queue_register_file(struct tqueue *queue, int fd)
+{
+	if (!queue->tio || !queue->tio->tio_register_file)
+		return 0;
+
+	return queue->tio->tio_register_file(queue, fd);
+}
+
+void
+tapdisk_queue_unregister_file(struct tqueue *queue, int fd)
+{
+	if (queue->tio && queue->tio->tio_unregister_file)
+		queue->tio->tio_unregister_file(queue, fd);
+}
+
+int
+tapdisk_queue_register_buffer(struct tqueue *queue, void *buf, size_t size)
+{
+	if (!queue->tio || !queue->tio->tio_register_buffer)
+		return 0;
+
+	return queue->tio->tio_register_buffer(queue, buf, size);
+}
+
+void
+tapdisk_queue_unregister_buffer(struct tqueue *queue, void *buf)
+{
+	if (queue->tio && queue->tio->tio_unregister_buffer)
+		queue->tio->tio_unregister_buffer(queue, buf);
+}
+
 void
 tapdisk_queue_tiocb(struct tqueue *queue, struct tiocb *tiocb)
 {
@@ -91,11 +91,20 @@ struct tio {
 	int  (*tio_setup)    (struct tqueue *queue, int qlen);
 	void (*tio_destroy)  (struct tqueue *queue);
 	int  (*tio_submit)   (struct tqueue *queue);
+
+	/* optional: let the kernel pin image files and data buffers */
+	int  (*tio_register_file)     (struct tqueue *queue, int fd);
+	void (*tio_unregister_file)   (struct tqueue *queue, int fd);
+	int  (*tio_register_buffer)   (struct tqueue *queue,
+				       void *buf, size_t size);
+	void (*tio_unregister_buffer) (struct tqueue *queue, void *buf);
 };
 
 enum {
-	TIO_DRV_LIO     = 1,
-	TIO_DRV_RWIO    = 2,
+	TIO_DRV_LIO        = 1,
+	TIO_DRV_RWIO       = 2,
+	TIO_DRV_URING      = 3,
+	TIO_DRV_URING_POLL = 4,
 };
 
 /*
@@ -112,6 +121,7 @@ enum {
 #define tapdisk_queue_full(q)  \
 	(((q)->tiocbs_pending + (q)->queued) >= (q)->size)
 int tapdisk_init_queue(struct tqueue *, int size, int drv, struct tfilter *);
+int tapdisk_queue_driver(const char *name);
 void tapdisk_free_queue(struct tqueue *);
 void tapdisk_debug_queue(struct tqueue *);
 void tapdisk_queue_tiocb(struct tqueue *, struct tiocb *);
@@ -122,4 +132,13 @@ int tapdisk_cancel_all_tiocbs(struct tqueue *);
 void tapdisk_prep_tiocb(struct tiocb *, int, int, char *, size_t,
 			long long, td_queue_callback_t, void *);
 
+/*
+ * Registration is a hint for backends which can avoid per-request
+ * file lookups and page pinning. It is a no-op for lio and rwio.
+ */
+int tapdisk_queue_register_file(struct tqueue *, int fd);
+void tapdisk_queue_unregister_file(struct tqueue *, int fd);
+int tapdisk_queue_register_buffer(struct tqueue *, void *, size_t);
+void tapdisk_queue_unregister_buffer(struct tqueue *, void *);
+
 #endif
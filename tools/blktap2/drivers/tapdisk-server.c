@@ -101,6 +101,42 @@ tapdisk_server_queue_tiocb(struct tiocb *tiocb)
 	tapdisk_queue_tiocb(&server.aio_queue, tiocb);
 }
 
+void
+tapdisk_server_set_io_driver(int drv)
+{
+	server.io_driver = drv;
+}
+
+int
+tapdisk_server_register_file(int fd)
+{
+	int err;
+
+	err = tapdisk_queue_register_file(&server.aio_queue, fd);
+	if (err)
+		DPRINTF("fd %d not registered for I/O: %d\n", fd, err);
+
+	return err;
+}
+
+void
+tapdisk_server_unregister_file(int fd)
+{
+	tapdisk_queue_unregister_file(&server.aio_queue, fd);
+}
+
+int
+tapdisk_server_register_buffer(void *buf, size_t size)
+{
+	return tapdisk_queue_register_buffer(&server.aio_queue, buf, size);
+}
+
+void
+tapdisk_server_unregister_buffer(void *buf)
+{
+	tapdisk_queue_unregister_buffer(&server.aio_queue, buf);
+}
+
 void
 tapdisk_server_debug(void)
 {
@@ -208,8 +244,20 @@ tapdisk_server_stop_vbds(void)
 static int
 tapdisk_server_init_aio(void)
 {
-	return tapdisk_init_queue(&server.aio_queue, TAPDISK_TIOCBS,
-				  TIO_DRV_LIO, NULL);
+	int err, drv;
+
+	drv = server.io_driver ? : TIO_DRV_LIO;
+
+	err = tapdisk_init_queue(&server.aio_queue, TAPDISK_TIOCBS,
+				 drv, NULL);
+	if (err && drv != TIO_DRV_LIO) {
+		EPRINTF("I/O queue driver %d unavailable (%d), "
+			"falling back to lio\n", drv, err);
+		err = tapdisk_init_queue(&server.aio_queue, TAPDISK_TIOCBS,
+					 TIO_DRV_LIO, NULL);
+	}
+
+	return err;
 }
 
 static void
@@ -283,9 +331,7 @@ tapdisk_server_init(void)
 	memset(&server, 0, sizeof(server));
 	INIT_LIST_HEAD(&server.vbds);
 
-	scheduler_initialize(&server.scheduler);
-
-	return 0;
+	return scheduler_initialize(&server.scheduler);
 }
 
 int
@@ -311,7 +357,9 @@ tapdisk_server_initialize(void)
 {
 	int err;
 
-	tapdisk_server_init();
+	err = tapdisk_server_init();
+	if (err)
+		return err;
 
 	err = tapdisk_server_complete();
 	if (err)
@@ -42,6 +42,11 @@ void tapdisk_server_add_vbd(td_vbd_t *);
 void tapdisk_server_remove_vbd(td_vbd_t *);
 
 void tapdisk_server_queue_tiocb(struct tiocb *);
+void tapdisk_server_set_io_driver(int);
+int tapdisk_server_register_file(int);
+void tapdisk_server_unregister_file(int);
+int tapdisk_server_register_buffer(void *, size_t);
+void tapdisk_server_unregister_buffer(void *);
 
 void tapdisk_server_check_state(void);
 
@@ -62,6 +67,7 @@ typedef struct tapdisk_server {
 	struct list_head             vbds;
 	scheduler_t                  scheduler;
 	struct tqueue                aio_queue;
+	int                          io_driver;
 } tapdisk_server_t;
 
 #endif
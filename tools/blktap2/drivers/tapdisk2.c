@@ -49,7 +49,7 @@ usage(const char *app, int err)
 int
 main(int argc, char *argv[])
 {
-	char *control;
+	char *control, *io;
 	int c, err, nodaemon;
 
 	control  = NULL;
@@ -93,6 +93,15 @@ main(int argc, char *argv[])
 		goto out;
 	}
 
+	io = getenv("TAPDISK2_IO");
+	if (io) {
+		int drv = tapdisk_queue_driver(io);
+		if (drv < 0)
+			DPRINTF("ignoring unknown I/O driver %s\n", io);
+		else
+			tapdisk_server_set_io_driver(drv);
+	}
+
 	if (!nodaemon) {
 		err = daemon(0, 1);
 		if (err) {
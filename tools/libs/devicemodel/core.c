@@ -228,9 +228,9 @@ int xendevicemodel_get_ioreq_server_info(
     return 0;
 }
 
-int xendevicemodel_map_io_range_to_ioreq_server(
+static int map_io_range_to_ioreq_server(
     xendevicemodel_handle *dmod, domid_t domid, ioservid_t id, int is_mmio,
-    uint64_t start, uint64_t end)
+    uint64_t start, uint64_t end, uint16_t flags)
 {
     struct xen_dm_op op;
     struct xen_dm_op_ioreq_server_range *data;
@@ -242,12 +242,29 @@ int xendevicemodel_map_io_range_to_ioreq_server(
 
     data->id = id;
     data->type = is_mmio ? XEN_DMOP_IO_RANGE_MEMORY : XEN_DMOP_IO_RANGE_PORT;
+    data->flags = flags;
     data->start = start;
     data->end = end;
 
     return xendevicemodel_op(dmod, domid, 1, &op, sizeof(op));
 }
 
+int xendevicemodel_map_io_range_to_ioreq_server(
+    xendevicemodel_handle *dmod, domid_t domid, ioservid_t id, int is_mmio,
+    uint64_t start, uint64_t end)
+{
+    return map_io_range_to_ioreq_server(dmod, domid, id, is_mmio, start, end,
+                                        0);
+}
+
+int xendevicemodel_map_posted_io_range_to_ioreq_server(
+    xendevicemodel_handle *dmod, domid_t domid, ioservid_t id, int is_mmio,
+    uint64_t start, uint64_t end)
+{
+    return map_io_range_to_ioreq_server(dmod, domid, id, is_mmio, start, end,
+                                        XEN_DMOP_io_range_posted);
+}
+
 int xendevicemodel_unmap_io_range_from_ioreq_server(
     xendevicemodel_handle *dmod, domid_t domid, ioservid_t id, int is_mmio,
     uint64_t start, uint64_t end)
@@ -88,6 +88,28 @@ int xendevicemodel_map_io_range_to_ioreq_server(
     xendevicemodel_handle *dmod, domid_t domid, ioservid_t id, int is_mmio,
     uint64_t start, uint64_t end);
 
+/**
+ * This function registers a range of memory or I/O ports for emulation,
+ * with writes to it posted: the vCPU does not wait for them to be
+ * handled.  Posted writes are read from the ring exposed as
+ * XENMEM_resource_ioreq_server_frame_posted() (see posted_iopage_t for
+ * its protocol).  The ring is only allocated by the first successful call
+ * to this function, and until then acquiring its frames fails with
+ * ENOENT.  The IOREQ Server must have been created with buffered ioreq
+ * handling.
+ *
+ * @parm dmod a handle to an open devicemodel interface.
+ * @parm domid the domain id to be serviced
+ * @parm id the IOREQ Server id.
+ * @parm is_mmio is this a range of ports or memory
+ * @parm start start of range
+ * @parm end end of range (inclusive).
+ * @return 0 on success, -1 on failure.
+ */
+int xendevicemodel_map_posted_io_range_to_ioreq_server(
+    xendevicemodel_handle *dmod, domid_t domid, ioservid_t id, int is_mmio,
+    uint64_t start, uint64_t end);
+
 /**
  * This function deregisters a range of memory or I/O ports for emulation.
  *
@@ -19,6 +19,7 @@
  * Split out from xc_gnttab.c
  */
 
+#include <errno.h>
 #include <stdlib.h>
 
 #include "private.h"
@@ -160,6 +161,385 @@ int xengnttab_dmabuf_imp_release(xengnttab_handle *xgt, uint32_t fd)
 {
     return osdep_gnttab_dmabuf_imp_release(xgt, fd);
 }
+
+/*
+ * Persistent grant cache.
+ *
+ * Each cached grant is an entry hashed by (domid, ref).  Entries which are
+ * not in use by any caller are kept on an LRU list, most recently used
+ * first, and are the only ones which may be evicted.
+ *
+ * The misses of one xengnttab_pgcache_get() call are mapped with a single
+ * call to the driver, and so share one mapping (a chunk).  The driver can
+ * only unmap a whole mapping, so a chunk stays mapped until all of its
+ * entries have been evicted or invalidated.  The size bound applies to
+ * the pages mapped through the cache, which includes those, so eviction
+ * only helps for chunks none of whose entries are in use.
+ */
+struct pgcache_chunk {
+    void *addr;
+    uint32_t count;
+    uint32_t live;              /* Entries of this chunk still cached. */
+    uint32_t idle;              /* Entries of this chunk on the LRU list. */
+    bool seen;                  /* Scratch for pgcache_reclaimable(). */
+};
+
+struct pgcache_entry {
+    uint32_t domid;
+    uint32_t ref;
+    void *addr;
+    struct pgcache_chunk *chunk; /* NULL until mapped. */
+    unsigned int users;
+    bool stale;                 /* Invalidated while in use. */
+    struct pgcache_entry *hash_next;
+    struct pgcache_entry *lru_prev, *lru_next;
+};
+
+struct xengnttab_pgcache {
+    xengnttab_handle *xgt;
+    int prot;
+    uint32_t max_pages;
+    uint32_t nr_mapped;
+    uint32_t hash_mask;
+    struct pgcache_entry **hash;
+    struct pgcache_entry lru;   /* List head: lru.lru_next is the MRU. */
+};
+
+static struct pgcache_entry **pgcache_bucket(xengnttab_pgcache *pgc,
+                                             uint32_t domid, uint32_t ref)
+{
+    uint32_t h = (ref ^ (domid << 16) ^ (domid >> 16)) * 0x9e3779b1U;
+
+    return &pgc->hash[(h >> 8) & pgc->hash_mask];
+}
+
+static struct pgcache_entry *pgcache_find(xengnttab_pgcache *pgc,
+                                          uint32_t domid, uint32_t ref)
+{
+    struct pgcache_entry *e = *pgcache_bucket(pgc, domid, ref);
+
+    while ( e && (e->domid != domid || e->ref != ref) )
+        e = e->hash_next;
+
+    return e;
+}
+
+static void pgcache_lru_del(struct pgcache_entry *e)
+{
+    e->chunk->idle--;
+    e->lru_prev->lru_next = e->lru_next;
+    e->lru_next->lru_prev = e->lru_prev;
+    e->lru_prev = e->lru_next = NULL;
+}
+
+static void pgcache_lru_add(xengnttab_pgcache *pgc, struct pgcache_entry *e)
+{
+    e->chunk->idle++;
+    e->lru_prev = &pgc->lru;
+    e->lru_next = pgc->lru.lru_next;
+    pgc->lru.lru_next->lru_prev = e;
+    pgc->lru.lru_next = e;
+}
+
+/* Drop an unused entry from the cache, unmapping its chunk if it was last. */
+static void pgcache_remove(xengnttab_pgcache *pgc, struct pgcache_entry *e)
+{
+    struct pgcache_entry **pp = pgcache_bucket(pgc, e->domid, e->ref);
+    struct pgcache_chunk *chunk = e->chunk;
+
+    while ( *pp != e )
+        pp = &(*pp)->hash_next;
+    *pp = e->hash_next;
+
+    if ( e->lru_next )
+        pgcache_lru_del(e);
+
+    if ( chunk && --chunk->live == 0 )
+    {
+        osdep_gnttab_unmap(pgc->xgt, chunk->addr, chunk->count);
+        pgc->nr_mapped -= chunk->count;
+        free(chunk);
+    }
+
+    free(e);
+}
+
+static bool pgcache_chunk_idle(const struct pgcache_chunk *chunk)
+{
+    return chunk->idle == chunk->live;
+}
+
+/* Number of pages which evicting every unused entry would unmap. */
+static uint32_t pgcache_reclaimable(xengnttab_pgcache *pgc)
+{
+    struct pgcache_entry *e;
+    uint32_t nr = 0;
+
+    for ( e = pgc->lru.lru_next; e != &pgc->lru; e = e->lru_next )
+        if ( pgcache_chunk_idle(e->chunk) && !e->chunk->seen )
+        {
+            e->chunk->seen = true;
+            nr += e->chunk->count;
+        }
+
+    for ( e = pgc->lru.lru_next; e != &pgc->lru; e = e->lru_next )
+        e->chunk->seen = false;
+
+    return nr;
+}
+
+/*
+ * Evict unused entries, least recently used first, until @nr more pages
+ * fit.  Entries of chunks which are partly in use are left alone, as
+ * evicting them wouldn't unmap anything.
+ */
+static int pgcache_make_room(xengnttab_pgcache *pgc, uint32_t nr)
+{
+    struct pgcache_entry *e, *prev;
+
+    if ( pgc->nr_mapped + nr <= pgc->max_pages )
+        return 0;
+
+    if ( nr > pgc->max_pages ||
+         pgc->nr_mapped - pgcache_reclaimable(pgc) > pgc->max_pages - nr )
+    {
+        errno = ENOSPC;
+        return -1;
+    }
+
+    for ( e = pgc->lru.lru_prev;
+          e != &pgc->lru && pgc->nr_mapped + nr > pgc->max_pages; e = prev )
+    {
+        prev = e->lru_prev;
+        if ( pgcache_chunk_idle(e->chunk) )
+            pgcache_remove(pgc, e);
+    }
+
+    return 0;
+}
+
+static void pgcache_release(xengnttab_pgcache *pgc, struct pgcache_entry *e)
+{
+    if ( --e->users )
+        return;
+
+    if ( !e->chunk || e->stale )
+        pgcache_remove(pgc, e);
+    else
+        pgcache_lru_add(pgc, e);
+}
+
+xengnttab_pgcache *xengnttab_pgcache_create(xengnttab_handle *xgt,
+                                            uint32_t max_pages, int prot)
+{
+    xengnttab_pgcache *pgc;
+    uint32_t nr_buckets = 16;
+
+    if ( !max_pages )
+    {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    while ( nr_buckets < max_pages && nr_buckets < (1U << 20) )
+        nr_buckets <<= 1;
+
+    pgc = calloc(1, sizeof(*pgc));
+    if ( !pgc )
+        return NULL;
+
+    pgc->hash = calloc(nr_buckets, sizeof(*pgc->hash));
+    if ( !pgc->hash )
+    {
+        free(pgc);
+        return NULL;
+    }
+
+    pgc->xgt = xgt;
+    pgc->prot = prot;
+    pgc->max_pages = max_pages;
+    pgc->hash_mask = nr_buckets - 1;
+    pgc->lru.lru_prev = pgc->lru.lru_next = &pgc->lru;
+
+    return pgc;
+}
+
+void xengnttab_pgcache_destroy(xengnttab_pgcache *pgc)
+{
+    uint32_t i;
+
+    if ( !pgc )
+        return;
+
+    for ( i = 0; i <= pgc->hash_mask; i++ )
+        while ( pgc->hash[i] )
+            pgcache_remove(pgc, pgc->hash[i]);
+
+    free(pgc->hash);
+    free(pgc);
+}
+
+int xengnttab_pgcache_get(xengnttab_pgcache *pgc, uint32_t count,
+                          const uint32_t *domids, const uint32_t *refs,
+                          void **addrs)
+{
+    struct pgcache_entry **ents, **miss;
+    uint32_t *miss_domids = NULL, *miss_refs = NULL;
+    struct pgcache_chunk *chunk = NULL;
+    uint32_t i, done = 0, nr_miss = 0;
+    int saved_errno;
+    void *addr;
+
+    if ( !count )
+        return 0;
+
+    ents = calloc(count, sizeof(*ents));
+    miss = calloc(count, sizeof(*miss));
+    if ( !ents || !miss )
+        goto err;
+
+    for ( done = 0; done < count; done++ )
+    {
+        struct pgcache_entry *e = pgcache_find(pgc, domids[done], refs[done]);
+
+        if ( e && e->stale )
+        {
+            errno = EBUSY;
+            goto err;
+        }
+
+        if ( !e )
+        {
+            struct pgcache_entry **bucket;
+
+            /* Placeholder, so that repeats within this call find it. */
+            e = calloc(1, sizeof(*e));
+            if ( !e )
+                goto err;
+
+            e->domid = domids[done];
+            e->ref = refs[done];
+            bucket = pgcache_bucket(pgc, e->domid, e->ref);
+            e->hash_next = *bucket;
+            *bucket = e;
+            miss[nr_miss++] = e;
+        }
+        else if ( !e->users && e->lru_next )
+            pgcache_lru_del(e);
+
+        e->users++;
+        ents[done] = e;
+    }
+
+    if ( nr_miss )
+    {
+        if ( pgcache_make_room(pgc, nr_miss) )
+            goto err;
+
+        chunk = calloc(1, sizeof(*chunk));
+        miss_domids = malloc(nr_miss * sizeof(*miss_domids));
+        miss_refs = malloc(nr_miss * sizeof(*miss_refs));
+        if ( !chunk || !miss_domids || !miss_refs )
+            goto err;
+
+        for ( i = 0; i < nr_miss; i++ )
+        {
+            miss_domids[i] = miss[i]->domid;
+            miss_refs[i] = miss[i]->ref;
+        }
+
+        addr = osdep_gnttab_grant_map(pgc->xgt, nr_miss, 0, pgc->prot,
+                                      miss_domids, miss_refs, -1, -1);
+        if ( !addr )
+            goto err;
+
+        chunk->addr = addr;
+        chunk->count = chunk->live = nr_miss;
+        pgc->nr_mapped += nr_miss;
+
+        for ( i = 0; i < nr_miss; i++ )
+        {
+            miss[i]->addr = (char *)addr + ((size_t)i << XEN_PAGE_SHIFT);
+            miss[i]->chunk = chunk;
+        }
+    }
+
+    for ( i = 0; i < count; i++ )
+        addrs[i] = ents[i]->addr;
+
+    free(miss_refs);
+    free(miss_domids);
+    free(miss);
+    free(ents);
+
+    return 0;
+
+ err:
+    saved_errno = errno;
+
+    /* Placeholders are removed when their last user goes. */
+    for ( i = 0; i < done; i++ )
+        pgcache_release(pgc, ents[i]);
+
+    free(chunk);
+    free(miss_refs);
+    free(miss_domids);
+    free(miss);
+    free(ents);
+
+    errno = saved_errno;
+
+    return -1;
+}
+
+void xengnttab_pgcache_put(xengnttab_pgcache *pgc, uint32_t count,
+                           const uint32_t *domids, const uint32_t *refs)
+{
+    uint32_t i;
+
+    for ( i = 0; i < count; i++ )
+    {
+        struct pgcache_entry *e = pgcache_find(pgc, domids[i], refs[i]);
+
+        if ( e && e->users )
+            pgcache_release(pgc, e);
+    }
+}
+
+void xengnttab_pgcache_invalidate(xengnttab_pgcache *pgc, uint32_t domid,
+                                  uint32_t count, const uint32_t *refs)
+{
+    struct pgcache_entry *e, *next;
+    uint32_t i;
+
+    if ( refs )
+    {
+        for ( i = 0; i < count; i++ )
+        {
+            e = pgcache_find(pgc, domid, refs[i]);
+            if ( !e )
+                continue;
+            if ( e->users )
+                e->stale = true;
+            else
+                pgcache_remove(pgc, e);
+        }
+
+        return;
+    }
+
+    for ( i = 0; i <= pgc->hash_mask; i++ )
+        for ( e = pgc->hash[i]; e; e = next )
+        {
+            next = e->hash_next;
+            if ( e->domid != domid )
+                continue;
+            if ( e->users )
+                e->stale = true;
+            else
+                pgcache_remove(pgc, e);
+        }
+}
 /*
  * Local variables:
  * mode: C
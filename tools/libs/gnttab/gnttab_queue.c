@@ -0,0 +1,330 @@
+/*
+ * Asynchronous grant copy queues.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include "private.h"
+
+/*
+ * Requests live in a ring of @depth slots, indexed by free running
+ * counters.  Slots [reaped, done) hold completions not yet reaped,
+ * [done, taken) requests being copied by the worker, and [taken, submitted)
+ * requests waiting for it.  There is a single worker per queue, so
+ * requests complete in the order they were submitted.
+ *
+ * The worker takes all waiting requests at once and, if there is more
+ * than one, gathers their segments so that they are copied with a single
+ * call to the driver.
+ */
+
+/* Maximum number of segments gathered into one call to the driver. */
+#define COPYQ_MAX_SEGS 1024
+
+struct copyq_req {
+    uint32_t count;
+    xengnttab_grant_copy_segment_t *segs;
+    void *cookie;
+    int rc;
+};
+
+struct xengnttab_copy_queue {
+    xengnttab_handle *xgt;
+    int efd;
+    pthread_t worker;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    bool stop;
+
+    uint32_t depth;
+    uint32_t ring_mask;         /* Ring size, a power of 2 >= depth, - 1. */
+    uint32_t submitted, taken, done, reaped;
+    struct copyq_req *ring;
+
+    /* Worker only. */
+    xengnttab_grant_copy_segment_t *scratch;
+};
+
+static struct copyq_req *copyq_slot(xengnttab_copy_queue *q, uint32_t idx)
+{
+    return &q->ring[idx & q->ring_mask];
+}
+
+static void copyq_run(xengnttab_copy_queue *q, uint32_t first, uint32_t end)
+{
+    struct copyq_req *req = copyq_slot(q, first);
+    uint32_t i, nr_segs = 0;
+    int rc;
+
+    if ( end - first == 1 )
+    {
+        rc = osdep_gnttab_grant_copy(q->xgt, req->count, req->segs);
+        req->rc = rc ? -errno : 0;
+        return;
+    }
+
+    for ( i = first; i != end; i++ )
+    {
+        req = copyq_slot(q, i);
+        memcpy(&q->scratch[nr_segs], req->segs,
+               req->count * sizeof(*req->segs));
+        nr_segs += req->count;
+    }
+
+    rc = osdep_gnttab_grant_copy(q->xgt, nr_segs, q->scratch);
+    rc = rc ? -errno : 0;
+
+    nr_segs = 0;
+    for ( i = first; i != end; i++ )
+    {
+        uint32_t j;
+
+        req = copyq_slot(q, i);
+        for ( j = 0; j < req->count; j++ )
+            req->segs[j].status = q->scratch[nr_segs + j].status;
+        nr_segs += req->count;
+        req->rc = rc;
+    }
+}
+
+static void *copyq_worker(void *arg)
+{
+    xengnttab_copy_queue *q = arg;
+    uint64_t val;
+
+    pthread_mutex_lock(&q->lock);
+
+    for ( ;; )
+    {
+        uint32_t first, end, nr_segs;
+
+        while ( q->taken == q->submitted && !q->stop )
+            pthread_cond_wait(&q->cond, &q->lock);
+
+        if ( q->taken == q->submitted )
+            break;
+
+        /* Take as many requests as fit in one call. */
+        first = q->taken;
+        nr_segs = copyq_slot(q, first)->count;
+        for ( end = first + 1; end != q->submitted; end++ )
+        {
+            uint32_t count = copyq_slot(q, end)->count;
+
+            if ( nr_segs + count > COPYQ_MAX_SEGS )
+                break;
+            nr_segs += count;
+        }
+        q->taken = end;
+
+        pthread_mutex_unlock(&q->lock);
+
+        copyq_run(q, first, end);
+
+        pthread_mutex_lock(&q->lock);
+        q->done = end;
+        pthread_mutex_unlock(&q->lock);
+
+        val = end - first;
+        if ( write(q->efd, &val, sizeof(val)) != sizeof(val) )
+            GTERROR(q->xgt->logger, "copy queue: failed to signal eventfd");
+
+        pthread_mutex_lock(&q->lock);
+    }
+
+    pthread_mutex_unlock(&q->lock);
+
+    return NULL;
+}
+
+xengnttab_copy_queue *xengnttab_copy_queue_create(xengnttab_handle *xgt,
+                                                  uint32_t depth)
+{
+    xengnttab_copy_queue *q;
+    uint32_t ring_size = 1;
+    int rc;
+
+    if ( !depth || depth > (1U << 16) )
+    {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    q = calloc(1, sizeof(*q));
+    if ( !q )
+        return NULL;
+
+    q->xgt = xgt;
+    q->depth = depth;
+    q->efd = -1;
+
+    while ( ring_size < depth )
+        ring_size <<= 1;
+    q->ring_mask = ring_size - 1;
+
+    q->ring = calloc(ring_size, sizeof(*q->ring));
+    q->scratch = malloc(COPYQ_MAX_SEGS * sizeof(*q->scratch));
+    if ( !q->ring || !q->scratch )
+        goto err;
+
+    q->efd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if ( q->efd < 0 )
+    {
+        GTERROR(xgt->logger, "copy queue: failed to create eventfd");
+        goto err;
+    }
+
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->cond, NULL);
+
+    rc = pthread_create(&q->worker, NULL, copyq_worker, q);
+    if ( rc )
+    {
+        errno = rc;
+        GTERROR(xgt->logger, "copy queue: failed to create worker");
+        pthread_cond_destroy(&q->cond);
+        pthread_mutex_destroy(&q->lock);
+        goto err;
+    }
+
+    return q;
+
+ err:
+    rc = errno;
+    if ( q->efd >= 0 )
+        close(q->efd);
+    free(q->scratch);
+    free(q->ring);
+    free(q);
+    errno = rc;
+
+    return NULL;
+}
+
+void xengnttab_copy_queue_destroy(xengnttab_copy_queue *q)
+{
+    if ( !q )
+        return;
+
+    pthread_mutex_lock(&q->lock);
+    q->stop = true;
+    pthread_cond_signal(&q->cond);
+    pthread_mutex_unlock(&q->lock);
+
+    pthread_join(q->worker, NULL);
+
+    pthread_cond_destroy(&q->cond);
+    pthread_mutex_destroy(&q->lock);
+    close(q->efd);
+    free(q->scratch);
+    free(q->ring);
+    free(q);
+}
+
+int xengnttab_copy_queue_fd(xengnttab_copy_queue *q)
+{
+    return q->efd;
+}
+
+int xengnttab_copy_submit(xengnttab_copy_queue *q, uint32_t count,
+                          xengnttab_grant_copy_segment_t *segs, void *cookie)
+{
+    struct copyq_req *req;
+
+    if ( !count || count > COPYQ_MAX_SEGS )
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    pthread_mutex_lock(&q->lock);
+
+    if ( q->submitted - q->reaped == q->depth )
+    {
+        pthread_mutex_unlock(&q->lock);
+        errno = EAGAIN;
+        return -1;
+    }
+
+    req = copyq_slot(q, q->submitted);
+    req->count = count;
+    req->segs = segs;
+    req->cookie = cookie;
+    req->rc = 0;
+
+    /* Only wake the worker if it has nothing to do. */
+    if ( q->submitted++ == q->taken )
+        pthread_cond_signal(&q->cond);
+
+    pthread_mutex_unlock(&q->lock);
+
+    return 0;
+}
+
+int xengnttab_copy_reap(xengnttab_copy_queue *q, uint32_t max,
+                        void **cookies, int *rcs)
+{
+    uint64_t val;
+    uint32_t i, nr;
+
+    /*
+     * Clear the eventfd first: a request completing after this will make
+     * it readable again.
+     */
+    if ( read(q->efd, &val, sizeof(val)) < 0 && errno != EAGAIN )
+        return -1;
+
+    pthread_mutex_lock(&q->lock);
+
+    nr = q->done - q->reaped;
+    if ( nr > max )
+    {
+        /* Leave the eventfd readable for the completions left behind. */
+        val = 1;
+        if ( write(q->efd, &val, sizeof(val)) != sizeof(val) )
+            GTERROR(q->xgt->logger, "copy queue: failed to signal eventfd");
+        nr = max;
+    }
+
+    for ( i = 0; i < nr; i++ )
+    {
+        struct copyq_req *req = copyq_slot(q, q->reaped + i);
+
+        cookies[i] = req->cookie;
+        if ( rcs )
+            rcs[i] = req->rc;
+    }
+    q->reaped += nr;
+
+    pthread_mutex_unlock(&q->lock);
+
+    return nr;
+}
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
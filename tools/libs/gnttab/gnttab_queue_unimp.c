@@ -0,0 +1,59 @@
+/*
+ * Asynchronous grant copy queues are not implemented on this platform.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+
+#include "private.h"
+
+xengnttab_copy_queue *xengnttab_copy_queue_create(xengnttab_handle *xgt,
+                                                  uint32_t depth)
+{
+    errno = ENOSYS;
+    return NULL;
+}
+
+void xengnttab_copy_queue_destroy(xengnttab_copy_queue *q)
+{
+}
+
+int xengnttab_copy_queue_fd(xengnttab_copy_queue *q)
+{
+    abort();
+}
+
+int xengnttab_copy_submit(xengnttab_copy_queue *q, uint32_t count,
+                          xengnttab_grant_copy_segment_t *segs, void *cookie)
+{
+    abort();
+}
+
+int xengnttab_copy_reap(xengnttab_copy_queue *q, uint32_t max,
+                        void **cookies, int *rcs)
+{
+    abort();
+}
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -110,6 +110,36 @@ int xengnttab_dmabuf_imp_release(xengnttab_handle *xgt, uint32_t fd)
     abort();
 }
 
+xengnttab_pgcache *xengnttab_pgcache_create(xengnttab_handle *xgt,
+                                            uint32_t max_pages, int prot)
+{
+    abort();
+}
+
+void xengnttab_pgcache_destroy(xengnttab_pgcache *pgc)
+{
+    abort();
+}
+
+int xengnttab_pgcache_get(xengnttab_pgcache *pgc, uint32_t count,
+                          const uint32_t *domids, const uint32_t *refs,
+                          void **addrs)
+{
+    abort();
+}
+
+void xengnttab_pgcache_put(xengnttab_pgcache *pgc, uint32_t count,
+                           const uint32_t *domids, const uint32_t *refs)
+{
+    abort();
+}
+
+void xengnttab_pgcache_invalidate(xengnttab_pgcache *pgc, uint32_t domid,
+                                  uint32_t count, const uint32_t *refs)
+{
+    abort();
+}
+
 /*
  * Local variables:
  * mode: C
@@ -296,6 +296,63 @@ int xengnttab_grant_copy(xengnttab_handle *xgt,
                          uint32_t count,
                          xengnttab_grant_copy_segment_t *segs);
 
+/*
+ * Asynchronous grant copy.
+ *
+ * A copy queue has a worker thread which performs the copies submitted to
+ * it in order, gathering the requests waiting for it into one call to the
+ * driver.  A backend with several queues (e.g. one per ring) should create
+ * one copy queue per backend thread.  Each copy queue must only be used by
+ * one thread at a time.
+ *
+ * Completion is signalled through an eventfd, which becomes readable when
+ * requests complete and can be polled along with the backend's event
+ * channels.
+ *
+ * Copy queues are only implemented on Linux; elsewhere
+ * xengnttab_copy_queue_create() fails with ENOSYS.
+ */
+
+typedef struct xengnttab_copy_queue xengnttab_copy_queue;
+
+/*
+ * Creates a copy queue for at most @depth (up to 65536) requests submitted
+ * and not yet reaped.  The queue must be destroyed before @xgt is closed.
+ * Returns NULL and sets errno on failure.  Logs errors.
+ */
+xengnttab_copy_queue *xengnttab_copy_queue_create(xengnttab_handle *xgt,
+                                                  uint32_t depth);
+
+/*
+ * Waits for the requests already submitted to complete, and destroys the
+ * queue.
+ */
+void xengnttab_copy_queue_destroy(xengnttab_copy_queue *q);
+
+/* Returns the eventfd which signals completions on @q. */
+int xengnttab_copy_queue_fd(xengnttab_copy_queue *q);
+
+/*
+ * Submits a request to copy the @count (at most 1024) segments @segs, as
+ * xengnttab_grant_copy() would.  @segs must remain valid until the request
+ * is reaped, and the status of each segment is set when it completes.
+ * @cookie is returned by xengnttab_copy_reap() to identify the request.
+ *
+ * Returns 0 on success, or -1 and sets errno: EAGAIN if the queue is full.
+ */
+int xengnttab_copy_submit(xengnttab_copy_queue *q, uint32_t count,
+                          xengnttab_grant_copy_segment_t *segs, void *cookie);
+
+/*
+ * Reaps up to @max completed requests, in the order they were submitted,
+ * without blocking.  The cookie of each is stored in @cookies and, if
+ * @rcs is not NULL, 0 or a negative errno value for the request as a
+ * whole in @rcs.  Returns the number of requests reaped, or -1 and sets
+ * errno.
+ */
+int xengnttab_copy_reap(xengnttab_copy_queue *q, uint32_t max,
+                        void **cookies, int *rcs);
+
 /*
  * Flags to be used while requesting memory mapping's backing storage
  * to be allocated with DMA API.
@@ -356,6 +413,69 @@ int xengnttab_dmabuf_imp_to_refs(xengnttab_handle *xgt, uint32_t domid,
  */
 int xengnttab_dmabuf_imp_release(xengnttab_handle *xgt, uint32_t fd);
 
+/*
+ * Persistent grant cache.
+ *
+ * Keeps grants mapped after use, so that a backend whose frontend reuses
+ * the same grant references (e.g. blkif persistent grants) does not have
+ * to map and unmap them for every request.
+ *
+ * A cache maps grants through the handle it was created with, and must be
+ * destroyed before that handle is closed.  The handle's maximum number of
+ * grants (see xengnttab_set_max_grants()) should be at least @max_pages.
+ * A cache is not thread safe; callers must serialise access to it.
+ */
+
+typedef struct xengnttab_pgcache xengnttab_pgcache;
+
+/*
+ * Creates a cache of at most @max_pages mapped pages, mapped with @prot
+ * (same flag as in mmap()).  Returns NULL and sets errno on failure.
+ */
+xengnttab_pgcache *xengnttab_pgcache_create(xengnttab_handle *xgt,
+                                            uint32_t max_pages, int prot);
+
+/*
+ * Unmaps every grant in the cache and frees it.  Any address returned by
+ * xengnttab_pgcache_get() becomes invalid.
+ */
+void xengnttab_pgcache_destroy(xengnttab_pgcache *pgc);
+
+/*
+ * Looks up @count grants, given by @domids and @refs, and returns the
+ * address at which each is mapped in @addrs.  Grants which are not cached
+ * are mapped with a single call to the driver, evicting the least recently
+ * used grants not in use if the cache is full.
+ *
+ * Each grant returned is in use until released by xengnttab_pgcache_put()
+ * and will not be evicted until then.  A grant may appear more than once,
+ * in which case it must be released as many times.
+ *
+ * Returns 0 on success, which includes a @count of 0.  On failure, returns
+ * -1, sets errno and no grant is left in use.  errno is ENOSPC if the cache
+ * is too full of grants in use, or mapped by the same call as grants in use,
+ * and EBUSY if one of the grants was invalidated while in use and has not
+ * been released yet.  A failure with ENOSPC evicts nothing.
+ */
+int xengnttab_pgcache_get(xengnttab_pgcache *pgc, uint32_t count,
+                          const uint32_t *domids, const uint32_t *refs,
+                          void **addrs);
+
+/*
+ * Releases @count grants obtained from xengnttab_pgcache_get().  They stay
+ * mapped until evicted or invalidated.
+ */
+void xengnttab_pgcache_put(xengnttab_pgcache *pgc, uint32_t count,
+                           const uint32_t *domids, const uint32_t *refs);
+
+/*
+ * Unmaps the @count grants @refs from @domid, or all grants from @domid if
+ * @refs is NULL.  To be called when the frontend revokes grants, or
+ * disconnects.  A grant which is in use is unmapped when last released.
+ */
+void xengnttab_pgcache_invalidate(xengnttab_pgcache *pgc, uint32_t domid,
+                                  uint32_t count, const uint32_t *refs);
+
 /*
  * Grant Sharing Interface (allocating and granting pages to others)
  */
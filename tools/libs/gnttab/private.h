@@ -1,6 +1,8 @@
 #ifndef XENGNTTAB_PRIVATE_H
 #define XENGNTTAB_PRIVATE_H
 
+#include <stdbool.h>
+
 #include <xentoollog.h>
 #include <xentoolcore_internal.h>
 #include <xengnttab.h>
@@ -8,6 +10,10 @@
 /* Set of macros/defines used by both Linux and FreeBSD */
 #define ROUNDUP(_x,_w) (((unsigned long)(_x)+(1UL<<(_w))-1) & ~((1UL<<(_w))-1))
 
+#ifndef XEN_PAGE_SHIFT
+#define XEN_PAGE_SHIFT 12
+#endif
+
 #define GTERROR(_l, _f...) xtl_log(_l, XTL_ERROR, errno, "gnttab", _f)
 #define GSERROR(_l, _f...) xtl_log(_l, XTL_ERROR, errno, "gntshr", _f)
 
@@ -955,6 +955,24 @@ int xc_shadow_control(xc_interface *xch,
                       uint32_t mode,
                       xc_shadow_op_stats_t *stats);
 
+/*
+ * Retrieve the dirty pfns below 'pages' as ranges, for
+ * XEN_DOMCTL_SHADOW_OP_{CLEAN,PEEK}_RANGES.  Scanning starts at *cursor and
+ * at most *nr_ranges ranges are written to 'ranges'.  On return *cursor is
+ * where to resume, and *nr_ranges is the number of ranges written; callers
+ * repeat the call until *cursor reaches 'pages'.
+ */
+typedef struct xen_domctl_dirty_range xc_dirty_range_t;
+int xc_shadow_dirty_ranges(xc_interface *xch,
+                           uint32_t domid,
+                           unsigned int sop,
+                           xc_hypercall_buffer_t *ranges,
+                           unsigned int *nr_ranges,
+                           uint64_t *cursor,
+                           unsigned long pages,
+                           uint32_t mode,
+                           xc_shadow_op_stats_t *stats);
+
 int xc_sched_credit_domain_set(xc_interface *xch,
                                uint32_t domid,
                                struct xen_domctl_sched_credit *sdom);
@@ -981,6 +999,15 @@ int xc_sched_credit2_domain_set(xc_interface *xch,
 int xc_sched_credit2_domain_get(xc_interface *xch,
                                 uint32_t domid,
                                 struct xen_domctl_sched_credit2 *sdom);
+/* Per-vCPU caps.  Only enforced while the domain has a cap too. */
+int xc_sched_credit2_vcpu_set(xc_interface *xch,
+                              uint32_t domid,
+                              struct xen_domctl_schedparam_vcpu *vcpus,
+                              uint32_t num_vcpus);
+int xc_sched_credit2_vcpu_get(xc_interface *xch,
+                              uint32_t domid,
+                              struct xen_domctl_schedparam_vcpu *vcpus,
+                              uint32_t num_vcpus);
 
 int xc_sched_rtds_domain_set(xc_interface *xch,
                              uint32_t domid,
@@ -29,6 +29,24 @@
 #define XCFLAGS_HVM       (1 << 2)
 #define XCFLAGS_STDVGA    (1 << 3)
 #define XCFLAGS_CHECKPOINT_COMPRESS    (1 << 4)
+/* Send PAGE_DATA_ENCODED records.  The receiver must understand them. */
+#define XCFLAGS_PAGE_ENCODING          (1 << 5)
+/*
+ * Permit post-copy migration of HVM guests: the guest is resumed on the
+ * receiver before all of its memory has been sent.  Requires a back channel
+ * (recv_fd) for the receiver to request pages.
+ *
+ * Only for direct users of libxc.  libxl never sets it, as a libxl stream
+ * carries the device model state after the libxc stream, where a post-copy
+ * receiver would need it before resuming the guest.
+ */
+#define XCFLAGS_POSTCOPY               (1 << 6)
+/*
+ * Use the auto-converge precopy policy, when the caller provides none:
+ * throttle the vCPUs dirtying memory fastest until the final round is
+ * expected to fit in the downtime target.  Requires the credit2 scheduler.
+ */
+#define XCFLAGS_AUTO_CONVERGE          (1 << 7)
 
 #define X86_64_B_SIZE   64 
 #define X86_32_B_SIZE   32
@@ -72,6 +90,10 @@ struct save_callbacks {
 #define XGS_POLICY_CONTINUE_PRECOPY 0  /* Remain in the precopy phase. */
 #define XGS_POLICY_STOP_AND_COPY    1  /* Immediately suspend and transmit the
                                         * remaining dirty pages. */
+#define XGS_POLICY_POSTCOPY         2  /* Immediately suspend, and send the
+                                        * remaining dirty pages after the
+                                        * guest has resumed on the receiver.
+                                        * Requires XCFLAGS_POSTCOPY. */
     precopy_policy_t precopy_policy;
 
     /*
@@ -129,12 +151,20 @@ typedef enum {
  * @parm dom the id of the domain
  * @param stream_type XC_MIG_STREAM_NONE if the far end of the stream
  *        doesn't use checkpointing
+ * @parm nr_workers number of threads mapping and normalising guest memory
+ *       ahead of the stream writer, or 0 to do everything on the calling
+ *       thread.  Capped at XC_SAVE_MAX_WORKERS.
+ * @parm max_downtime_ms downtime target for XCFLAGS_AUTO_CONVERGE, or 0 for
+ *       XC_SAVE_DEFAULT_DOWNTIME_MS
  * @return 0 on success, -1 on failure
  */
+#define XC_SAVE_MAX_WORKERS 64
+#define XC_SAVE_DEFAULT_DOWNTIME_MS 300
 int xc_domain_save(xc_interface *xch, int io_fd, uint32_t dom,
                    uint32_t flags /* XCFLAGS_xxx */,
                    struct save_callbacks* callbacks, int hvm,
-                   xc_migration_stream_t stream_type, int recv_fd);
+                   xc_migration_stream_t stream_type, int recv_fd,
+                   unsigned int nr_workers, unsigned int max_downtime_ms);
 
 /* callbacks provided by xc_domain_restore */
 struct restore_callbacks {
@@ -145,6 +175,10 @@ struct restore_callbacks {
     /* Called after the secondary vm is ready to resume.
      * Callback function resumes the guest & the device model,
      * returns to xc_domain_restore.
+     *
+     * Also used for post-copy migration, when the guest is resumed while
+     * the rest of its memory is still arriving.  Both this and
+     * restore_results must be provided to accept a post-copy stream.
      */
     int (*postcopy)(void* data);
 
@@ -191,15 +225,20 @@ struct restore_callbacks {
  * @parm stream_type non-zero if the far end of the stream is using checkpointing
  * @parm callbacks non-NULL to receive a callback to restore toolstack
  *       specific data
+ * @parm nr_workers number of threads copying page data into the guest
+ *       behind the stream reader, or 0 to do everything on the calling
+ *       thread.  At most XC_RESTORE_MAX_WORKERS.
  * @return 0 on success, -1 on failure
  */
+#define XC_RESTORE_MAX_WORKERS 64
 int xc_domain_restore(xc_interface *xch, int io_fd, uint32_t dom,
                       unsigned int store_evtchn, unsigned long *store_mfn,
                       uint32_t store_domid, unsigned int console_evtchn,
                       unsigned long *console_mfn, uint32_t console_domid,
                       unsigned int hvm, unsigned int pae,
                       xc_migration_stream_t stream_type,
-                      struct restore_callbacks *callbacks, int send_back_fd);
+                      struct restore_callbacks *callbacks, int send_back_fd,
+                      unsigned int nr_workers);
 
 /**
  * This function will create a domain for a paravirtualized Linux
@@ -687,6 +687,46 @@ int xc_shadow_control(xc_interface *xch,
     return (rc == 0) ? domctl.u.shadow_op.pages : rc;
 }
 
+int xc_shadow_dirty_ranges(xc_interface *xch,
+                           uint32_t domid,
+                           unsigned int sop,
+                           xc_hypercall_buffer_t *ranges,
+                           unsigned int *nr_ranges,
+                           uint64_t *cursor,
+                           unsigned long pages,
+                           uint32_t mode,
+                           xc_shadow_op_stats_t *stats)
+{
+    int rc;
+    DECLARE_DOMCTL;
+    DECLARE_HYPERCALL_BUFFER_ARGUMENT(ranges);
+
+    memset(&domctl, 0, sizeof(domctl));
+
+    domctl.cmd = XEN_DOMCTL_shadow_op;
+    domctl.domain = domid;
+    domctl.u.shadow_op.op        = sop;
+    domctl.u.shadow_op.pages     = pages;
+    domctl.u.shadow_op.mode      = mode;
+    domctl.u.shadow_op.cursor    = *cursor;
+    domctl.u.shadow_op.nr_ranges = *nr_ranges;
+    if ( ranges != NULL )
+        set_xen_guest_handle(domctl.u.shadow_op.dirty_ranges, ranges);
+
+    rc = do_domctl(xch, &domctl);
+    if ( rc )
+        return rc;
+
+    if ( stats )
+        memcpy(stats, &domctl.u.shadow_op.stats,
+               sizeof(xc_shadow_op_stats_t));
+
+    *cursor = domctl.u.shadow_op.cursor;
+    *nr_ranges = domctl.u.shadow_op.nr_ranges;
+
+    return 0;
+}
+
 int xc_domain_setmaxmem(xc_interface *xch,
                         uint32_t domid,
                         uint64_t max_memkb)
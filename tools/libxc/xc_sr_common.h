@@ -2,6 +2,7 @@
 #define __COMMON__H
 
 #include <stdbool.h>
+#include <pthread.h>
 
 #include "xg_private.h"
 #include "xg_save_restore.h"
@@ -10,6 +11,9 @@
 
 #include "xc_sr_stream_format.h"
 
+#include <xenevtchn.h>
+#include <xen/vm_event.h>
+
 /* String representation of Domain Header types. */
 const char *dhdr_type_to_str(uint32_t type);
 
@@ -165,6 +169,201 @@ struct xc_sr_restore_ops
     int (*cleanup)(struct xc_sr_context *ctx);
 };
 
+/*
+ * A batch of pfns on its way into the stream as a PAGE_DATA record.  All
+ * arrays are sized for MAX_BATCH_SIZE entries and allocated once, at setup.
+ */
+struct xc_sr_save_batch
+{
+    xen_pfn_t *pfns;
+    unsigned int nr_pfns;
+
+    /* State filled in by the map/normalise stage. */
+    xen_pfn_t *mfns, *types;
+    int *errors;
+    void **guest_data;   /* Page data to send: guest mappings or local_pages. */
+    void **local_pages;  /* Pages allocated by normalise_page(). */
+    void *guest_mapping;
+    unsigned int nr_pages, nr_pages_mapped;
+
+    /*
+     * Bitmap of indices into pfns[] which need resending once the domain is
+     * paused.  Merged into ctx->save.deferred_pages when the batch is
+     * written, so the map/normalise stage doesn't touch shared state.
+     */
+    unsigned long *deferred;
+    unsigned int nr_deferred;
+
+    /* Scratch space for the PAGE_DATA record. */
+    uint64_t *rec_pfns;
+    struct iovec *iov;
+
+    /*
+     * Per-pfn encodings and payloads for a PAGE_DATA_ENCODED record.  Only
+     * allocated when page encoding is in use.  enc_buf holds a page worth of
+     * space for each pfn, and enc_work is scratch space for encode_page_data().
+     */
+    struct xc_sr_rec_page_encoding *encodings;
+    const void **enc_data;
+    void *enc_buf, *enc_work;
+
+    /* Result of the map/normalise stage. */
+    bool done;
+    int rc, err;
+};
+
+/*
+ * Pool of threads mapping and normalising batches ahead of the thread
+ * writing the stream.  Batches live in a ring and are written out strictly
+ * in submission order, so the stream is identical to a single threaded save.
+ *
+ * Counters are free running; the ring index is the counter modulo
+ * nr_batches.  retired <= dispatched <= submitted, with the batch at
+ * 'submitted' being the one currently filled by the main thread.
+ */
+struct xc_sr_save_pipeline
+{
+    unsigned int nr_workers;
+    pthread_t *workers;
+    unsigned int nr_workers_started;
+
+    struct xc_sr_save_batch *batches;
+    unsigned int nr_batches;
+    unsigned int submitted, dispatched, retired;
+
+    pthread_mutex_t lock;
+    pthread_cond_t work_cond;   /* Signalled on submission or exit. */
+    pthread_cond_t done_cond;   /* Signalled when a batch is done. */
+    bool exit;
+};
+
+/*
+ * A PAGE_DATA or PAGE_DATA_ENCODED record on its way into the guest.  The
+ * pfns have already been populated by the thread reading the stream; what
+ * remains is mapping the pages and copying the data in.
+ */
+struct xc_sr_restore_batch
+{
+    void *rec_data;      /* Record body, owned by the batch. */
+    unsigned int count;
+    xen_pfn_t *pfns;
+    uint32_t *types;
+
+    /* Page data, and optionally its encodings, within rec_data. */
+    void *page_data;
+    const struct xc_sr_rec_page_encoding *encodings;
+
+    /* Gfns of the pages with data, to be mapped. */
+    xen_pfn_t *mfns;
+    unsigned int nr_pages;
+
+    /*
+     * Localising pagetables may populate further pfns, so batches containing
+     * them are copied in by the thread reading the stream.
+     */
+    bool pagetables;
+
+    /* Result of the copy stage. */
+    bool done;
+    int rc, err;
+    uint64_t copy_ns;
+};
+
+/*
+ * Pool of threads copying page data into the guest, while the main thread
+ * carries on reading and populating.  Batches are retired in submission
+ * order, as for the save pipeline.
+ *
+ * A pfn must never be in flight in two batches at once, as the later data
+ * has to win.  The saver sends pfns in ascending order within each
+ * iteration, so a batch whose lowest pfn isn't above max_pfn (the highest
+ * pfn in flight) waits for the pipeline to drain first.
+ */
+struct xc_sr_restore_pipeline
+{
+    unsigned int nr_workers;
+    pthread_t *workers;
+    unsigned int nr_workers_started;
+
+    struct xc_sr_restore_batch *batches;
+    unsigned int nr_batches;
+    unsigned int submitted, dispatched, retired;
+    xen_pfn_t max_pfn;
+
+    pthread_mutex_t lock;
+    pthread_cond_t work_cond;   /* Signalled on submission or exit. */
+    pthread_cond_t done_cond;   /* Signalled when a batch is done. */
+    bool exit;
+};
+
+/*
+ * The auto-converge precopy policy.  Each round, the projected downtime of
+ * stopping and copying is compared against a target; while it misses, the
+ * vCPUs dirtying memory fastest have their credit2 caps lowered.
+ */
+struct xc_sr_converge
+{
+    /* Start of the round being measured. */
+    uint64_t round_start_ns;
+    unsigned int round_written;
+
+    /* Per-vCPU log-dirty counters at the start of the round, and caps. */
+    unsigned int nr_vcpus;
+    uint64_t *dirty_pages;
+    uint16_t *caps;
+
+    /* The domain's own cap, to restore, once vCPUs have been throttled. */
+    bool throttled;
+    bool cant_throttle;
+    uint16_t dom_cap;
+};
+
+/* Time spent in, and work done by, each stage of a restore. */
+struct xc_sr_restore_stats
+{
+    uint64_t read_ns, read_octets;
+    uint64_t populate_ns, populate_pfns;
+    uint64_t copy_ns, copy_pages;
+};
+
+/*
+ * The tail end of a post-copy migration.  Pfns listed in POSTCOPY_PFNS
+ * records are paged out using Xen's mem_paging interface at the transition,
+ * and paged back in as their data arrives.  Guest accesses to them in the
+ * meantime arrive as requests on the paging ring, and are forwarded to the
+ * sender.
+ */
+struct xc_sr_restore_postcopy
+{
+    /* Between POSTCOPY_BEGIN and POSTCOPY_TRANSITION. */
+    bool active;
+
+    /* Pfns from POSTCOPY_PFNS records, until the transition. */
+    xen_pfn_t *pfns;
+    unsigned long nr_pfns, max_pfns;
+
+    /* Pfns still to be paged in, from the transition onwards. */
+    unsigned long *outstanding;
+    xen_pfn_t max_pfn;
+    unsigned long nr_outstanding;
+
+    /* Paging ring. */
+    void *ring_page;
+    vm_event_back_ring_t back_ring;
+    xenevtchn_handle *xce;
+    uint32_t remote_port;
+    evtchn_port_t local_port;
+
+    /* Requests waiting on data from the sender. */
+    vm_event_request_t *waiting;
+    unsigned int nr_waiting, max_waiting;
+
+    /* Page aligned bounce buffer for xc_mem_paging_load(). */
+    void *buffer;
+
+    uint64_t nr_faults;
+};
+
 /* x86 PV per-vcpu storage structure for blobs heading Xen-wards. */
 struct xc_sr_x86_pv_restore_vcpu
 {
@@ -198,15 +397,57 @@ struct xc_sr_context
             /* Further debugging information in the stream. */
             bool debug;
 
+            /*
+             * Post-copy is permitted, and has been chosen by the precopy
+             * policy.  Once entered, dirty_bitmap holds the pfns still to
+             * be sent.
+             */
+            bool postcopy;
+            bool enter_postcopy;
+            unsigned long nr_postcopy_pfns;
+
+            /*
+             * Downtime target for the auto-converge policy, which throttles
+             * vCPUs so that precopy converges.  0 if not in use, in which
+             * case converge is NULL.
+             */
+            unsigned int max_downtime_ms;
+            struct xc_sr_converge *converge;
+
+            /* Send PAGE_DATA_ENCODED rather than PAGE_DATA records. */
+            bool encode_pages;
+            /* Sending the pages for the receiver to verify. */
+            bool verifying;
+            /* Previously sent pages, for DELTA encodings.  May be NULL. */
+            struct xc_sr_delta_cache *delta_cache;
+            /* Pages and octets sent with each encoding. */
+            uint64_t enc_pages[PAGE_ENCODING_MAX + 1];
+            uint64_t enc_octets[PAGE_ENCODING_MAX + 1];
+
             unsigned long p2m_size;
 
             struct precopy_stats stats;
 
-            xen_pfn_t *batch_pfns;
-            unsigned nr_batch_pfns;
+            /*
+             * Batch currently being filled.  With no worker threads, this is
+             * the only batch, and is mapped and written inline when full.
+             */
+            struct xc_sr_save_batch *batch;
+            struct xc_sr_save_pipeline pipeline;
+
             unsigned long *deferred_pages;
             unsigned long nr_deferred_pages;
             xc_hypercall_buffer_t dirty_bitmap_hbuf;
+
+            /*
+             * Where Xen can report the dirty log as ranges of pfns, each
+             * round is harvested into dirty_ranges a batch at a time via
+             * dirty_ranges_hbuf, rather than CLEANing the whole bitmap.
+             */
+            bool use_dirty_ranges;
+            xc_dirty_range_t *dirty_ranges;
+            unsigned long nr_dirty_ranges, max_dirty_ranges;
+            xc_hypercall_buffer_t dirty_ranges_hbuf;
         } save;
 
         struct /* Restore data. */
@@ -258,6 +499,11 @@ struct xc_sr_context
 
             /* Sender has invoked verify mode on the stream. */
             bool verify;
+
+            struct xc_sr_restore_pipeline pipeline;
+            struct xc_sr_restore_stats stats;
+
+            struct xc_sr_restore_postcopy postcopy;
         } restore;
     };
 
@@ -397,6 +643,86 @@ int read_record(struct xc_sr_context *ctx, int fd, struct xc_sr_record *rec);
 int populate_pfns(struct xc_sr_context *ctx, unsigned count,
                   const xen_pfn_t *original_pfns, const uint32_t *types);
 
+/*
+ * Page encodings for PAGE_DATA_ENCODED records.  See xc_sr_page_encoding.c.
+ */
+struct xc_sr_delta_cache;
+
+/* Number of pages remembered for DELTA encodings. */
+#define DELTA_CACHE_PAGES 8192
+
+/* Size of the 'work' scratch space needed by encode_page_data(). */
+#define PAGE_ENCODE_WORK_SIZE (4096 * sizeof(uint16_t))
+
+/*
+ * Encodes the page of data for 'pfn', choosing the smallest encoding
+ * available.  'buf' must have space for a page; *data is set to the payload
+ * to send, which is either in 'buf', or 'page' itself.  If 'cache' is
+ * non-NULL, it is consulted for a DELTA encoding and updated to match.
+ *
+ * May be called concurrently for different pfns.  Never fails.
+ */
+void encode_page_data(struct xc_sr_delta_cache *cache, xen_pfn_t pfn,
+                      xen_pfn_t type, const void *page, void *buf,
+                      void *work, struct xc_sr_rec_page_encoding *enc,
+                      const void **data);
+
+/*
+ * Decodes an encoded page into 'page'.  For DELTA encodings, 'page' must
+ * already contain the receivers existing copy.  Returns 0 on success, or -1
+ * if the payload is malformed.
+ */
+int decode_page_data(const struct xc_sr_rec_page_encoding *enc,
+                     const void *data, void *page);
+
+/* Checks an encoding descriptor from the stream for sanity. */
+bool page_encoding_valid(const struct xc_sr_rec_page_encoding *enc);
+
+/* String representation of PAGE_ENCODING_* values. */
+const char *page_encoding_to_str(unsigned int encoding);
+
+struct xc_sr_delta_cache *alloc_delta_cache(unsigned int nr_slots);
+void free_delta_cache(struct xc_sr_delta_cache *cache);
+void invalidate_delta_cache(struct xc_sr_delta_cache *cache, xen_pfn_t pfn);
+
+/*
+ * The pages still to send after a post-copy transition, and the order to
+ * send them in.  See xc_sr_postcopy.c.
+ */
+struct xc_sr_postcopy_queue
+{
+    /* Pfns neither sent nor queued as faults yet.  Not owned. */
+    unsigned long *outstanding;
+    xen_pfn_t p2m_size;
+    /* Pfns not yet returned by postcopy_queue_next(). */
+    unsigned long nr_outstanding;
+
+    /* Where the background push has got to. */
+    xen_pfn_t next;
+
+    /* Faulting pfns waiting to be sent, oldest first. */
+    xen_pfn_t *faults;
+    unsigned int first_fault, nr_faults, max_faults;
+};
+
+void postcopy_queue_init(struct xc_sr_postcopy_queue *q,
+                         unsigned long *outstanding, xen_pfn_t p2m_size,
+                         unsigned long nr_outstanding);
+void postcopy_queue_destroy(struct xc_sr_postcopy_queue *q);
+
+/*
+ * Queues a pfn the receiver has faulted on, unless it has been sent or
+ * queued already.  Returns 0, or -1 with errno set.
+ */
+int postcopy_queue_fault(struct xc_sr_postcopy_queue *q, xen_pfn_t pfn);
+
+/*
+ * Picks up to 'max' pfns to send next into 'pfns', returning how many.
+ * Queued faults are returned, on their own, before any other pfn.
+ */
+unsigned int postcopy_queue_next(struct xc_sr_postcopy_queue *q,
+                                 xen_pfn_t *pfns, unsigned int max);
+
 #endif
 /*
  * Local variables:
@@ -0,0 +1,535 @@
+/*
+ * Per-page encodings used by PAGE_DATA_ENCODED records.
+ *
+ * Each page of data in the record is sent either verbatim, or as one of:
+ * - ZERO:    no payload.
+ * - PATTERN: a single 64bit word, repeated across the page.
+ * - LZ4:     an LZ4 block, decompressing to exactly one page.
+ * - DELTA:   runs of 64bit words to XOR onto the receivers current copy of
+ *            the page, for pages which have been sent before.
+ *
+ * The LZ4 blocks are decoded with the decompressor from xen/common/lz4,
+ * already built into libxenguest for LZ4 compressed kernels.  Where it
+ * isn't, XC_SR_PAGE_ENCODING is left undefined, and PAGE_DATA_ENCODED
+ * records are neither sent nor accepted.
+ */
+
+#include "xc_sr_common.h"
+#include "../../xen/include/xen/lz4.h"
+
+#define PAGE_WORDS (PAGE_SIZE / sizeof(uint64_t))
+
+/* Only bother with LZ4 if it saves at least an eighth of the page. */
+#define LZ4_MAX_LENGTH   (PAGE_SIZE - PAGE_SIZE / 8)
+/* Beyond half a page, a delta loses out to compressing the page afresh. */
+#define DELTA_MAX_LENGTH (PAGE_SIZE / 2)
+
+/* LZ4 block format parameters. */
+#define LZ4_MINMATCH     4
+#define LZ4_MFLIMIT      12
+#define LZ4_LASTLITERALS 5
+#define LZ4_ML_BITS      4
+#define LZ4_ML_MASK      ((1U << LZ4_ML_BITS) - 1)
+#define LZ4_RUN_MASK     ((1U << (8 - LZ4_ML_BITS)) - 1)
+#define LZ4_HASH_LOG     12
+/*
+ * The bounds checks in lz4_decompress_unknownoutputsize() reject matches
+ * shorter than its 8 octet copy step, so don't emit any.
+ */
+#define LZ4_DEC_MINMATCH 8
+
+/*
+ * Cache of the most recently sent contents of NOTAB pages, used to generate
+ * DELTA encodings.  Direct mapped by pfn.  An entry only ever holds exactly
+ * what the receiver has for its pfn, and is updated whenever that pfn is
+ * sent again.
+ */
+#define DELTA_CACHE_LOCKS 64
+
+struct xc_sr_delta_cache
+{
+    unsigned int nr_slots;
+    xen_pfn_t *tags;
+    void *pages;
+    pthread_mutex_t locks[DELTA_CACHE_LOCKS];
+};
+
+static inline uint32_t read32(const uint8_t *p)
+{
+    uint32_t val;
+
+    memcpy(&val, p, sizeof(val));
+
+    return val;
+}
+
+static inline unsigned int lz4_hash(uint32_t seq)
+{
+    return (seq * 2654435761U) >> (32 - LZ4_HASH_LOG);
+}
+
+static uint8_t *lz4_put_length(uint8_t *op, size_t len)
+{
+    for ( ; len >= 255; len -= 255 )
+        *op++ = 255;
+    *op++ = len;
+
+    return op;
+}
+
+/*
+ * Greedy single-pass LZ4 block compression of one page, honouring the end
+ * of block restrictions (no match within the final LZ4_MFLIMIT octets, and at
+ * least LZ4_LASTLITERALS literals) which the decompressor relies upon.
+ *
+ * Returns the compressed length, or 0 if it would exceed dst_len.
+ */
+static size_t lz4_compress_page(const uint8_t *src, uint8_t *dst,
+                                size_t dst_len, uint16_t *table)
+{
+    const uint8_t *ip = src + 1, *anchor = src, *ref;
+    const uint8_t *const iend = src + PAGE_SIZE;
+    const uint8_t *const mflimit = iend - LZ4_MFLIMIT;
+    const uint8_t *const matchlimit = iend - LZ4_LASTLITERALS;
+    uint8_t *op = dst, *token;
+    uint8_t *const oend = dst + dst_len;
+    size_t lit, len;
+    unsigned int h, offset;
+    uint32_t seq;
+
+    BUILD_BUG_ON(PAGE_ENCODE_WORK_SIZE < (sizeof(*table) << LZ4_HASH_LOG));
+
+    /* Stale entries are harmless; every candidate is checked before use. */
+    memset(table, 0, sizeof(*table) << LZ4_HASH_LOG);
+
+    while ( ip < mflimit )
+    {
+        seq = read32(ip);
+        h = lz4_hash(seq);
+        ref = src + table[h];
+        table[h] = ip - src;
+
+        if ( read32(ref) != seq )
+        {
+            ++ip;
+            continue;
+        }
+
+        for ( len = LZ4_MINMATCH;
+              ip + len < matchlimit && ip[len] == ref[len]; ++len )
+            ;
+
+        if ( len < LZ4_DEC_MINMATCH )
+        {
+            ++ip;
+            continue;
+        }
+
+        while ( ip > anchor && ref > src && ip[-1] == ref[-1] )
+        {
+            --ip;
+            --ref;
+            ++len;
+        }
+
+        lit = ip - anchor;
+        if ( op + 1 + lit / 255 + 1 + lit + 2 + len / 255 + 1 > oend )
+            return 0;
+
+        token = op++;
+        if ( lit >= LZ4_RUN_MASK )
+        {
+            *token = LZ4_RUN_MASK << LZ4_ML_BITS;
+            op = lz4_put_length(op, lit - LZ4_RUN_MASK);
+        }
+        else
+            *token = lit << LZ4_ML_BITS;
+
+        memcpy(op, anchor, lit);
+        op += lit;
+
+        offset = ip - ref;
+        *op++ = offset & 0xff;
+        *op++ = offset >> 8;
+
+        if ( len - LZ4_MINMATCH >= LZ4_ML_MASK )
+        {
+            *token |= LZ4_ML_MASK;
+            op = lz4_put_length(op, len - LZ4_MINMATCH - LZ4_ML_MASK);
+        }
+        else
+            *token |= len - LZ4_MINMATCH;
+
+        ip += len;
+        anchor = ip;
+    }
+
+    lit = iend - anchor;
+    if ( op + 1 + lit / 255 + 1 + lit > oend )
+        return 0;
+
+    token = op++;
+    if ( lit >= LZ4_RUN_MASK )
+    {
+        *token = LZ4_RUN_MASK << LZ4_ML_BITS;
+        op = lz4_put_length(op, lit - LZ4_RUN_MASK);
+    }
+    else
+        *token = lit << LZ4_ML_BITS;
+
+    memcpy(op, anchor, lit);
+    op += lit;
+
+    return op - dst;
+}
+
+/*
+ * XOR delta of 'page' against 'old', as runs of changed words.  'page' may
+ * be changing under our feet, so each of its words is read exactly once when
+ * generating the payload.  DELTA payloads may not be empty, so an unchanged
+ * page is sent as a single empty run.
+ *
+ * Returns the encoded length, or -1 if it would exceed max_len.
+ */
+static long delta_encode_page(const uint64_t *page, const uint64_t *old,
+                              uint8_t *dst, size_t max_len)
+{
+    struct xc_sr_page_delta_run run;
+    unsigned int i = 0, start, last = 0;
+    size_t len = 0;
+    uint64_t word;
+
+    while ( i < PAGE_WORDS )
+    {
+        if ( page[i] == old[i] )
+        {
+            ++i;
+            continue;
+        }
+
+        for ( start = i; i < PAGE_WORDS && page[i] != old[i]; ++i )
+            ;
+
+        if ( len + sizeof(run) + (i - start) * sizeof(word) > max_len )
+            return -1;
+
+        run.skip = start - last;
+        run.count = i - start;
+        memcpy(dst + len, &run, sizeof(run));
+        len += sizeof(run);
+
+        for ( ; start < i; ++start )
+        {
+            word = page[start] ^ old[start];
+            memcpy(dst + len, &word, sizeof(word));
+            len += sizeof(word);
+        }
+
+        last = i;
+    }
+
+    if ( !len )
+    {
+        run.skip = run.count = 0;
+        memcpy(dst, &run, sizeof(run));
+        len = sizeof(run);
+    }
+
+    return len;
+}
+
+static int delta_decode_page(const uint8_t *src, size_t len, uint64_t *page)
+{
+    struct xc_sr_page_delta_run run;
+    unsigned int pos = 0;
+    size_t off = 0;
+    uint64_t word;
+
+    while ( off < len )
+    {
+        if ( len - off < sizeof(run) )
+            return -1;
+
+        memcpy(&run, src + off, sizeof(run));
+        off += sizeof(run);
+
+        if ( run.skip > PAGE_WORDS - pos ||
+             run.count > PAGE_WORDS - pos - run.skip ||
+             (len - off) / sizeof(word) < run.count )
+            return -1;
+
+        for ( pos += run.skip; run.count; --run.count )
+        {
+            memcpy(&word, src + off, sizeof(word));
+            off += sizeof(word);
+            page[pos++] ^= word;
+        }
+    }
+
+    return 0;
+}
+
+static bool page_is_pattern(const uint64_t *page, uint64_t *pattern)
+{
+    uint64_t word = page[0];
+    unsigned int i;
+
+    for ( i = 1; i < PAGE_WORDS; ++i )
+        if ( page[i] != word )
+            return false;
+
+    *pattern = word;
+
+    return true;
+}
+
+/*
+ * Picks the cheapest of the stateless encodings for a page.  *data is left
+ * pointing at 'page' for a RAW encoding.
+ */
+static void encode_page_contents(const void *page, uint8_t *buf,
+                                 uint16_t *table,
+                                 struct xc_sr_rec_page_encoding *enc,
+                                 const void **data)
+{
+    uint64_t pattern;
+    size_t len;
+
+    if ( page_is_pattern(page, &pattern) )
+    {
+        if ( pattern )
+        {
+            memcpy(buf, &pattern, sizeof(pattern));
+            enc->encoding = PAGE_ENCODING_PATTERN;
+            enc->length = sizeof(pattern);
+        }
+        else
+        {
+            enc->encoding = PAGE_ENCODING_ZERO;
+            enc->length = 0;
+        }
+        *data = buf;
+    }
+    else if ( (len = lz4_compress_page(page, buf, LZ4_MAX_LENGTH, table)) )
+    {
+        enc->encoding = PAGE_ENCODING_LZ4;
+        enc->length = len;
+        *data = buf;
+    }
+    else
+    {
+        enc->encoding = PAGE_ENCODING_RAW;
+        enc->length = PAGE_SIZE;
+        *data = page;
+    }
+}
+
+void encode_page_data(struct xc_sr_delta_cache *cache, xen_pfn_t pfn,
+                      xen_pfn_t type, const void *page, void *buf,
+                      void *work, struct xc_sr_rec_page_encoding *enc,
+                      const void **data)
+{
+    pthread_mutex_t *lock = NULL;
+    unsigned int slot;
+    void *cached = NULL;
+    long len;
+
+    memset(enc, 0, sizeof(*enc));
+
+    if ( cache )
+    {
+        slot = pfn % cache->nr_slots;
+        lock = &cache->locks[slot % DELTA_CACHE_LOCKS];
+
+        pthread_mutex_lock(lock);
+
+        if ( type != XEN_DOMCTL_PFINFO_NOTAB )
+        {
+            if ( cache->tags[slot] == pfn )
+                cache->tags[slot] = INVALID_MFN;
+        }
+        else
+        {
+            cached = cache->pages + (size_t)slot * PAGE_SIZE;
+
+            if ( cache->tags[slot] == pfn &&
+                 (len = delta_encode_page(page, cached, buf,
+                                          DELTA_MAX_LENGTH)) >= 0 )
+            {
+                /*
+                 * Apply the delta rather than copying the page, so the cache
+                 * matches what the receiver will end up with even if the
+                 * guest has written to the page since.
+                 */
+                delta_decode_page(buf, len, cached);
+                pthread_mutex_unlock(lock);
+
+                enc->encoding = PAGE_ENCODING_DELTA;
+                enc->length = len;
+                *data = buf;
+                return;
+            }
+
+            /* Snapshot the page, and encode from the stable copy. */
+            memcpy(cached, page, PAGE_SIZE);
+            cache->tags[slot] = pfn;
+            page = cached;
+        }
+    }
+
+    encode_page_contents(page, buf, work, enc, data);
+
+    if ( cached && *data == cached )
+    {
+        memcpy(buf, cached, PAGE_SIZE);
+        *data = buf;
+    }
+
+    if ( lock )
+        pthread_mutex_unlock(lock);
+}
+
+void invalidate_delta_cache(struct xc_sr_delta_cache *cache, xen_pfn_t pfn)
+{
+    unsigned int slot = pfn % cache->nr_slots;
+    pthread_mutex_t *lock = &cache->locks[slot % DELTA_CACHE_LOCKS];
+
+    pthread_mutex_lock(lock);
+    if ( cache->tags[slot] == pfn )
+        cache->tags[slot] = INVALID_MFN;
+    pthread_mutex_unlock(lock);
+}
+
+bool page_encoding_valid(const struct xc_sr_rec_page_encoding *enc)
+{
+    switch ( enc->encoding )
+    {
+    case PAGE_ENCODING_RAW:
+        return enc->length == PAGE_SIZE;
+
+    case PAGE_ENCODING_ZERO:
+        return enc->length == 0;
+
+    case PAGE_ENCODING_PATTERN:
+        return enc->length == sizeof(uint64_t);
+
+    case PAGE_ENCODING_LZ4:
+    case PAGE_ENCODING_DELTA:
+        return enc->length > 0 && enc->length <= PAGE_SIZE;
+
+    default:
+        return false;
+    }
+}
+
+int decode_page_data(const struct xc_sr_rec_page_encoding *enc,
+                     const void *data, void *page)
+{
+    uint64_t pattern, *words = page;
+#ifdef XC_SR_PAGE_ENCODING
+    size_t len = PAGE_SIZE;
+#endif
+    unsigned int i;
+
+    switch ( enc->encoding )
+    {
+    case PAGE_ENCODING_RAW:
+        memcpy(page, data, PAGE_SIZE);
+        return 0;
+
+    case PAGE_ENCODING_ZERO:
+        memset(page, 0, PAGE_SIZE);
+        return 0;
+
+    case PAGE_ENCODING_PATTERN:
+        memcpy(&pattern, data, sizeof(pattern));
+        for ( i = 0; i < PAGE_WORDS; ++i )
+            words[i] = pattern;
+        return 0;
+
+#ifdef XC_SR_PAGE_ENCODING
+    case PAGE_ENCODING_LZ4:
+        if ( lz4_decompress_unknownoutputsize(data, enc->length, page, &len) ||
+             len != PAGE_SIZE )
+            return -1;
+        return 0;
+#endif
+
+    case PAGE_ENCODING_DELTA:
+        return delta_decode_page(data, enc->length, page);
+
+    default:
+        return -1;
+    }
+}
+
+const char *page_encoding_to_str(unsigned int encoding)
+{
+    static const char *const names[] =
+    {
+        [PAGE_ENCODING_RAW]     = "raw",
+        [PAGE_ENCODING_ZERO]    = "zero",
+        [PAGE_ENCODING_PATTERN] = "pattern",
+        [PAGE_ENCODING_LZ4]     = "lz4",
+        [PAGE_ENCODING_DELTA]   = "delta",
+    };
+
+    if ( encoding < ARRAY_SIZE(names) && names[encoding] )
+        return names[encoding];
+
+    return "unknown";
+}
+
+struct xc_sr_delta_cache *alloc_delta_cache(unsigned int nr_slots)
+{
+    struct xc_sr_delta_cache *cache = calloc(1, sizeof(*cache));
+    unsigned int i;
+
+    if ( !cache )
+        return NULL;
+
+    cache->nr_slots = nr_slots;
+    cache->tags = malloc(nr_slots * sizeof(*cache->tags));
+    cache->pages = malloc((size_t)nr_slots * PAGE_SIZE);
+
+    if ( !cache->tags || !cache->pages )
+    {
+        free(cache->pages);
+        free(cache->tags);
+        free(cache);
+        return NULL;
+    }
+
+    for ( i = 0; i < nr_slots; ++i )
+        cache->tags[i] = INVALID_MFN;
+
+    for ( i = 0; i < DELTA_CACHE_LOCKS; ++i )
+        pthread_mutex_init(&cache->locks[i], NULL);
+
+    return cache;
+}
+
+void free_delta_cache(struct xc_sr_delta_cache *cache)
+{
+    unsigned int i;
+
+    if ( !cache )
+        return;
+
+    for ( i = 0; i < DELTA_CACHE_LOCKS; ++i )
+        pthread_mutex_destroy(&cache->locks[i]);
+
+    free(cache->pages);
+    free(cache->tags);
+    free(cache);
+}
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,114 @@
+/*
+ * The order in which a post-copy sender sends the outstanding pages.
+ *
+ * Once the guest runs on the receiver, a page it touches before the page has
+ * arrived stalls a vcpu until it does.  Faulting pfns are therefore always
+ * sent ahead of the background push of everything else, which walks the
+ * outstanding bitmap in pfn order.  Nothing here talks to Xen or the stream,
+ * so that it can be tested on its own.
+ */
+
+#include <errno.h>
+
+#include "xc_sr_common.h"
+
+void postcopy_queue_init(struct xc_sr_postcopy_queue *q,
+                         unsigned long *outstanding, xen_pfn_t p2m_size,
+                         unsigned long nr_outstanding)
+{
+    *q = (struct xc_sr_postcopy_queue){
+        .outstanding = outstanding,
+        .p2m_size = p2m_size,
+        .nr_outstanding = nr_outstanding,
+    };
+}
+
+void postcopy_queue_destroy(struct xc_sr_postcopy_queue *q)
+{
+    free(q->faults);
+    q->faults = NULL;
+    q->nr_faults = q->max_faults = 0;
+}
+
+int postcopy_queue_fault(struct xc_sr_postcopy_queue *q, xen_pfn_t pfn)
+{
+    xen_pfn_t *faults;
+    unsigned int new_max;
+
+    if ( pfn >= q->p2m_size )
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    /* Already sent or queued?  The fault crossed with the data. */
+    if ( !test_and_clear_bit(pfn, q->outstanding) )
+        return 0;
+
+    if ( q->first_fault + q->nr_faults == q->max_faults )
+    {
+        if ( q->first_fault )
+        {
+            memmove(q->faults, &q->faults[q->first_fault],
+                    q->nr_faults * sizeof(*q->faults));
+            q->first_fault = 0;
+        }
+        else
+        {
+            new_max = q->max_faults ? q->max_faults * 2 : 64;
+            faults = realloc(q->faults, new_max * sizeof(*faults));
+            if ( !faults )
+            {
+                set_bit(pfn, q->outstanding);
+                errno = ENOMEM;
+                return -1;
+            }
+
+            q->faults = faults;
+            q->max_faults = new_max;
+        }
+    }
+
+    q->faults[q->first_fault + q->nr_faults++] = pfn;
+
+    return 0;
+}
+
+unsigned int postcopy_queue_next(struct xc_sr_postcopy_queue *q,
+                                 xen_pfn_t *pfns, unsigned int max)
+{
+    unsigned int n = 0;
+
+    /*
+     * Faulting pfns alone, even if that leaves the batch short, so that the
+     * guest waits on no more than it has to.
+     */
+    if ( q->nr_faults )
+    {
+        for ( ; n < max && q->nr_faults; ++n, --q->nr_faults )
+            pfns[n] = q->faults[q->first_fault++];
+
+        if ( !q->nr_faults )
+            q->first_fault = 0;
+    }
+    else
+    {
+        for ( ; n < max && q->next < q->p2m_size; ++q->next )
+            if ( test_and_clear_bit(q->next, q->outstanding) )
+                pfns[n++] = q->next;
+    }
+
+    q->nr_outstanding -= n;
+
+    return n;
+}
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -1,9 +1,23 @@
 #include <arpa/inet.h>
 
 #include <assert.h>
+#include <poll.h>
+#include <time.h>
 
 #include "xc_sr_common.h"
 
+#define SUPERPAGE_SHIFT    9
+#define SUPERPAGE_NR_PFNS  (1U << SUPERPAGE_SHIFT)
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
 /*
  * Read and validate the Image and Domain headers.
  */
@@ -126,18 +140,40 @@ static int pfn_set_populated(struct xc_sr_context *ctx, xen_pfn_t pfn)
     return 0;
 }
 
+/*
+ * Is pfns[0 .. SUPERPAGE_NR_PFNS) a complete, suitably aligned superpage?
+ */
+static bool pfns_are_superpage(const xen_pfn_t *pfns)
+{
+    unsigned int i;
+
+    if ( pfns[0] & (SUPERPAGE_NR_PFNS - 1) )
+        return false;
+
+    for ( i = 1; i < SUPERPAGE_NR_PFNS; ++i )
+        if ( pfns[i] != pfns[0] + i )
+            return false;
+
+    return true;
+}
+
 /*
  * Given a set of pfns, obtain memory from Xen to fill the physmap for the
  * unpopulated subset.  If types is NULL, no page type checking is performed
  * and all unpopulated pfns are populated.
+ *
+ * Aligned runs of SUPERPAGE_NR_PFNS unpopulated pfns are populated as
+ * superpages where Xen can provide them, falling back to single pages
+ * otherwise.
  */
 int populate_pfns(struct xc_sr_context *ctx, unsigned count,
                   const xen_pfn_t *original_pfns, const uint32_t *types)
 {
     xc_interface *xch = ctx->xch;
     xen_pfn_t *mfns = malloc(count * sizeof(*mfns)),
-        *pfns = malloc(count * sizeof(*pfns));
-    unsigned i, nr_pfns = 0;
+        *pfns = malloc(count * sizeof(*pfns)),
+        *sp_mfns = NULL;
+    unsigned i, j, nr_pfns = 0, nr_sp = 0, nr_sp_done = 0, nr_single = 0;
     int rc = -1;
 
     if ( !mfns || !pfns )
@@ -162,253 +198,1235 @@ int populate_pfns(struct xc_sr_context *ctx, unsigned count,
         }
     }
 
-    if ( nr_pfns )
+    /*
+     * Move the superpages to the front of pfns[], keeping the remaining
+     * single pages in order behind them.  mfns[] is used as scratch space.
+     */
+    if ( nr_pfns >= SUPERPAGE_NR_PFNS )
     {
-        rc = xc_domain_populate_physmap_exact(
-            xch, ctx->domid, nr_pfns, 0, 0, mfns);
-        if ( rc )
+        for ( i = 0; i < nr_pfns; )
         {
-            PERROR("Failed to populate physmap");
+            if ( i + SUPERPAGE_NR_PFNS <= nr_pfns &&
+                 pfns_are_superpage(&pfns[i]) )
+            {
+                memmove(&pfns[nr_sp * SUPERPAGE_NR_PFNS], &pfns[i],
+                        SUPERPAGE_NR_PFNS * sizeof(*pfns));
+                ++nr_sp;
+                i += SUPERPAGE_NR_PFNS;
+            }
+            else
+                mfns[nr_single++] = pfns[i++];
+        }
+
+        memcpy(&pfns[nr_sp * SUPERPAGE_NR_PFNS], mfns,
+               nr_single * sizeof(*pfns));
+        memcpy(mfns, pfns, nr_pfns * sizeof(*mfns));
+    }
+
+    if ( nr_sp )
+    {
+        sp_mfns = malloc(nr_sp * sizeof(*sp_mfns));
+        if ( !sp_mfns )
+        {
+            ERROR("Failed to allocate %zu bytes for populating superpages",
+                  nr_sp * sizeof(*sp_mfns));
             goto err;
         }
 
-        for ( i = 0; i < nr_pfns; ++i )
+        for ( i = 0; i < nr_sp; ++i )
+            sp_mfns[i] = pfns[i * SUPERPAGE_NR_PFNS];
+
+        /* Partial success is fine; the rest are populated as single pages. */
+        rc = xc_domain_populate_physmap(xch, ctx->domid, nr_sp,
+                                        SUPERPAGE_SHIFT, 0, sp_mfns);
+        nr_sp_done = rc > 0 ? rc : 0;
+
+        for ( i = 0; i < nr_sp_done; ++i )
         {
-            if ( mfns[i] == INVALID_MFN )
+            if ( sp_mfns[i] == INVALID_MFN )
             {
-                ERROR("Populate physmap failed for pfn %u", i);
+                ERROR("Populate physmap failed for superpage %u", i);
                 rc = -1;
                 goto err;
             }
 
-            ctx->restore.ops.set_gfn(ctx, pfns[i], mfns[i]);
+            for ( j = 0; j < SUPERPAGE_NR_PFNS; ++j )
+                mfns[i * SUPERPAGE_NR_PFNS + j] = sp_mfns[i] + j;
         }
+
+        if ( nr_sp_done < nr_sp )
+            DPRINTF("Populated %u of %u superpages", nr_sp_done, nr_sp);
+    }
+
+    i = nr_sp_done * SUPERPAGE_NR_PFNS;
+    if ( i < nr_pfns )
+    {
+        rc = xc_domain_populate_physmap_exact(
+            xch, ctx->domid, nr_pfns - i, 0, 0, &mfns[i]);
+        if ( rc )
+        {
+            PERROR("Failed to populate physmap");
+            goto err;
+        }
+    }
+
+    for ( i = 0; i < nr_pfns; ++i )
+    {
+        if ( mfns[i] == INVALID_MFN )
+        {
+            ERROR("Populate physmap failed for pfn %u", i);
+            rc = -1;
+            goto err;
+        }
+
+        ctx->restore.ops.set_gfn(ctx, pfns[i], mfns[i]);
     }
 
     rc = 0;
 
  err:
+    free(sp_mfns);
     free(pfns);
     free(mfns);
 
-    return rc;
+    return rc;
+}
+
+/*
+ * First stage of processing page data, run by the thread reading the stream:
+ * populate the pfns, record their types and pick out the subset to map.
+ */
+static int populate_page_data(struct xc_sr_context *ctx,
+                              struct xc_sr_restore_batch *batch)
+{
+    xc_interface *xch = ctx->xch;
+    unsigned i, count = batch->count;
+    int rc;
+
+    batch->mfns = malloc(count * sizeof(*batch->mfns));
+    if ( !batch->mfns )
+    {
+        ERROR("Failed to allocate %zu bytes to process page data",
+              count * sizeof(*batch->mfns));
+        return -1;
+    }
+
+    rc = populate_pfns(ctx, count, batch->pfns, batch->types);
+    if ( rc )
+    {
+        ERROR("Failed to populate pfns for batch of %u pages", count);
+        return rc;
+    }
+
+    for ( i = 0; i < count; ++i )
+    {
+        ctx->restore.ops.set_page_type(ctx, batch->pfns[i], batch->types[i]);
+
+        switch ( batch->types[i] )
+        {
+        case XEN_DOMCTL_PFINFO_L1TAB:
+        case XEN_DOMCTL_PFINFO_L1TAB | XEN_DOMCTL_PFINFO_LPINTAB:
+
+        case XEN_DOMCTL_PFINFO_L2TAB:
+        case XEN_DOMCTL_PFINFO_L2TAB | XEN_DOMCTL_PFINFO_LPINTAB:
+
+        case XEN_DOMCTL_PFINFO_L3TAB:
+        case XEN_DOMCTL_PFINFO_L3TAB | XEN_DOMCTL_PFINFO_LPINTAB:
+
+        case XEN_DOMCTL_PFINFO_L4TAB:
+        case XEN_DOMCTL_PFINFO_L4TAB | XEN_DOMCTL_PFINFO_LPINTAB:
+
+            batch->pagetables = true;
+            /* Fallthrough */
+        case XEN_DOMCTL_PFINFO_NOTAB:
+            batch->mfns[batch->nr_pages++] =
+                ctx->restore.ops.pfn_to_gfn(ctx, batch->pfns[i]);
+            break;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Second stage of processing page data: map the populated subset and copy
+ * the data into the guest, decoding it first if the record carried
+ * encodings.  Safe to run on a pipeline worker unless the batch contains
+ * pagetables.
+ */
+static int copy_page_data(struct xc_sr_context *ctx,
+                          struct xc_sr_restore_batch *batch)
+{
+    xc_interface *xch = ctx->xch;
+    const struct xc_sr_rec_page_encoding *encodings = batch->encodings;
+    const xen_pfn_t *pfns = batch->pfns;
+    const uint32_t *types = batch->types;
+    unsigned count = batch->count, nr_pages = batch->nr_pages;
+    uint64_t start = now_ns();
+    int *map_errs = NULL;
+    void *decoded = NULL;
+    int rc;
+    void *mapping = NULL, *guest_page = NULL, *data;
+    void *page_data = batch->page_data;
+    unsigned i,    /* i indexes the pfns from the record. */
+        j;         /* j indexes the subset of pfns we decide to map. */
+
+    /* Nothing to do? */
+    if ( nr_pages == 0 )
+        return 0;
+
+    map_errs = malloc(nr_pages * sizeof(*map_errs));
+    decoded = encodings ? malloc(PAGE_SIZE) : NULL;
+    if ( !map_errs || (encodings && !decoded) )
+    {
+        rc = -1;
+        ERROR("Failed to allocate %zu bytes to process page data",
+              nr_pages * sizeof(*map_errs) + (encodings ? PAGE_SIZE : 0));
+        goto err;
+    }
+
+    mapping = guest_page = xenforeignmemory_map(xch->fmem,
+        ctx->domid, PROT_READ | PROT_WRITE,
+        nr_pages, batch->mfns, map_errs);
+    if ( !mapping )
+    {
+        rc = -1;
+        PERROR("Unable to map %u mfns for %u pages of data",
+               nr_pages, count);
+        goto err;
+    }
+
+    for ( i = 0, j = 0; i < count; ++i )
+    {
+        switch ( types[i] )
+        {
+        case XEN_DOMCTL_PFINFO_XTAB:
+        case XEN_DOMCTL_PFINFO_BROKEN:
+        case XEN_DOMCTL_PFINFO_XALLOC:
+            /* No page data to deal with. */
+            continue;
+        }
+
+        if ( map_errs[j] )
+        {
+            rc = -1;
+            ERROR("Mapping pfn %#"PRIpfn" (mfn %#"PRIpfn", type %#"PRIx32") failed with %d",
+                  pfns[i], batch->mfns[j], types[i], map_errs[j]);
+            goto err;
+        }
+
+        data = page_data;
+
+        if ( encodings && encodings[j].encoding != PAGE_ENCODING_RAW )
+        {
+            if ( encodings[j].encoding == PAGE_ENCODING_DELTA )
+            {
+                /* Deltas only make sense against data we already have. */
+                if ( types[i] != XEN_DOMCTL_PFINFO_NOTAB )
+                {
+                    rc = -1;
+                    ERROR("Delta encoding for pfn %#"PRIpfn" (type %#"PRIx32")",
+                          pfns[i], types[i] >> XEN_DOMCTL_PFINFO_LTAB_SHIFT);
+                    goto err;
+                }
+
+                memcpy(decoded, guest_page, PAGE_SIZE);
+            }
+
+            rc = decode_page_data(&encodings[j], page_data, decoded);
+            if ( rc )
+            {
+                ERROR("Failed to decode pfn %#"PRIpfn" (%s encoding, length %u)",
+                      pfns[i], page_encoding_to_str(encodings[j].encoding),
+                      encodings[j].length);
+                goto err;
+            }
+
+            data = decoded;
+        }
+
+        /* Undo page normalisation done by the saver. */
+        rc = ctx->restore.ops.localise_page(ctx, types[i], data);
+        if ( rc )
+        {
+            ERROR("Failed to localise pfn %#"PRIpfn" (type %#"PRIx32")",
+                  pfns[i], types[i] >> XEN_DOMCTL_PFINFO_LTAB_SHIFT);
+            goto err;
+        }
+
+        if ( ctx->restore.verify )
+        {
+            /* Verify mode - compare incoming data to what we already have. */
+            if ( memcmp(guest_page, data, PAGE_SIZE) )
+                ERROR("verify pfn %#"PRIpfn" failed (type %#"PRIx32")",
+                      pfns[i], types[i] >> XEN_DOMCTL_PFINFO_LTAB_SHIFT);
+        }
+        else
+        {
+            /* Regular mode - copy incoming data into place. */
+            memcpy(guest_page, data, PAGE_SIZE);
+        }
+
+        page_data += encodings ? encodings[j].length : PAGE_SIZE;
+        ++j;
+        guest_page += PAGE_SIZE;
+    }
+
+    rc = 0;
+
+ err:
+    if ( mapping )
+        xenforeignmemory_unmap(xch->fmem, mapping, nr_pages);
+
+    free(decoded);
+    free(map_errs);
+
+    batch->copy_ns = now_ns() - start;
+
+    return rc;
+}
+
+/*
+ * Frees everything owned by a batch, and resets it for reuse.
+ */
+static void release_page_data(struct xc_sr_restore_batch *batch)
+{
+    free(batch->mfns);
+    free(batch->types);
+    free(batch->pfns);
+    free(batch->rec_data);
+
+    memset(batch, 0, sizeof(*batch));
+}
+
+/*
+ * Pipeline worker.  Takes submitted batches in order and copies them into
+ * the guest.
+ */
+static void *restore_worker(void *arg)
+{
+    struct xc_sr_context *ctx = arg;
+    struct xc_sr_restore_pipeline *pl = &ctx->restore.pipeline;
+    struct xc_sr_restore_batch *batch;
+    int rc, err;
+
+    pthread_mutex_lock(&pl->lock);
+
+    for ( ; ; )
+    {
+        while ( pl->dispatched == pl->submitted && !pl->exit )
+            pthread_cond_wait(&pl->work_cond, &pl->lock);
+
+        if ( pl->exit )
+            break;
+
+        batch = &pl->batches[pl->dispatched++ % pl->nr_batches];
+        pthread_mutex_unlock(&pl->lock);
+
+        rc = copy_page_data(ctx, batch);
+        err = errno;
+
+        pthread_mutex_lock(&pl->lock);
+        batch->rc = rc;
+        batch->err = err;
+        batch->done = true;
+        pthread_cond_broadcast(&pl->done_cond);
+    }
+
+    pthread_mutex_unlock(&pl->lock);
+
+    return NULL;
+}
+
+/*
+ * Accounts for a batch which has been copied in, and releases it.
+ */
+static int finish_page_data(struct xc_sr_context *ctx,
+                            struct xc_sr_restore_batch *batch, int rc)
+{
+    if ( !rc )
+    {
+        ctx->restore.stats.copy_ns += batch->copy_ns;
+        ctx->restore.stats.copy_pages += batch->nr_pages;
+    }
+
+    release_page_data(batch);
+
+    return rc;
+}
+
+/*
+ * Waits for the oldest outstanding batch to be copied in, and releases it.
+ */
+static int retire_page_data(struct xc_sr_context *ctx)
+{
+    struct xc_sr_restore_pipeline *pl = &ctx->restore.pipeline;
+    struct xc_sr_restore_batch *batch;
+    int rc;
+
+    assert(pl->retired != pl->submitted);
+    batch = &pl->batches[pl->retired % pl->nr_batches];
+
+    pthread_mutex_lock(&pl->lock);
+    while ( !batch->done )
+        pthread_cond_wait(&pl->done_cond, &pl->lock);
+    pthread_mutex_unlock(&pl->lock);
+
+    ++pl->retired;
+
+    rc = batch->rc;
+    if ( rc )
+        errno = batch->err;
+
+    return finish_page_data(ctx, batch, rc);
+}
+
+/*
+ * Waits for all outstanding batches to be copied in.  Anything in the
+ * restore which depends on guest memory must call this first.
+ */
+static int drain_page_data(struct xc_sr_context *ctx)
+{
+    struct xc_sr_restore_pipeline *pl = &ctx->restore.pipeline;
+    int rc = 0;
+
+    while ( !rc && pl->retired != pl->submitted )
+        rc = retire_page_data(ctx);
+
+    return rc;
+}
+
+/*
+ * Hands a populated batch over to be copied into the guest.  Without
+ * workers, or for batches containing pagetables, the copy happens
+ * synchronously once everything before it has landed.  Otherwise the batch
+ * is queued for the workers, retiring the oldest batch if the ring is full.
+ */
+static int submit_page_data(struct xc_sr_context *ctx,
+                            struct xc_sr_restore_batch *batch)
+{
+    struct xc_sr_restore_pipeline *pl = &ctx->restore.pipeline;
+    xen_pfn_t min_pfn = ~(xen_pfn_t)0, max_pfn = 0;
+    unsigned i;
+    int rc;
+
+    if ( !pl->nr_workers || batch->pagetables )
+    {
+        rc = drain_page_data(ctx);
+        if ( !rc )
+            rc = copy_page_data(ctx, batch);
+
+        return finish_page_data(ctx, batch, rc);
+    }
+
+    for ( i = 0; i < batch->count; ++i )
+    {
+        min_pfn = min(min_pfn, batch->pfns[i]);
+        max_pfn = max(max_pfn, batch->pfns[i]);
+    }
+
+    if ( pl->retired != pl->submitted && min_pfn <= pl->max_pfn )
+    {
+        rc = drain_page_data(ctx);
+        if ( rc )
+            return finish_page_data(ctx, batch, rc);
+    }
+
+    if ( pl->retired == pl->submitted || max_pfn > pl->max_pfn )
+        pl->max_pfn = max_pfn;
+
+    pthread_mutex_lock(&pl->lock);
+    batch->done = false;
+    ++pl->submitted;
+    pthread_cond_signal(&pl->work_cond);
+    pthread_mutex_unlock(&pl->lock);
+
+    if ( pl->submitted - pl->retired == pl->nr_batches )
+        return retire_page_data(ctx);
+
+    return 0;
+}
+
+/*
+ * Post-copy: answer a request from the paging ring, resuming the vcpu if it
+ * was paused.  The caller notifies Xen.
+ */
+static void postcopy_respond(struct xc_sr_context *ctx,
+                             const vm_event_request_t *req)
+{
+    struct xc_sr_restore_postcopy *pc = &ctx->restore.postcopy;
+    vm_event_response_t rsp =
+    {
+        .version = VM_EVENT_INTERFACE_VERSION,
+        .vcpu_id = req->vcpu_id,
+        .flags = req->flags,
+        .reason = req->reason,
+        .u.mem_paging = req->u.mem_paging,
+    };
+    RING_IDX rsp_prod = pc->back_ring.rsp_prod_pvt;
+
+    memcpy(RING_GET_RESPONSE(&pc->back_ring, rsp_prod), &rsp, sizeof(rsp));
+    pc->back_ring.rsp_prod_pvt = rsp_prod + 1;
+    RING_PUSH_RESPONSES(&pc->back_ring);
+}
+
+static int postcopy_check_faults(struct xc_sr_context *ctx);
+
+/*
+ * Post-copy: page the outstanding pfns of a PAGE_DATA or PAGE_DATA_ENCODED
+ * record back into the guest, and resume anything waiting on them.  New
+ * faults are forwarded to the sender between pages, rather than after the
+ * whole record.
+ */
+static int postcopy_page_in(struct xc_sr_context *ctx,
+                            struct xc_sr_restore_batch *batch)
+{
+    xc_interface *xch = ctx->xch;
+    struct xc_sr_restore_postcopy *pc = &ctx->restore.postcopy;
+    const struct xc_sr_rec_page_encoding *encodings = batch->encodings;
+    void *page_data = batch->page_data;
+    unsigned i, j, w;
+    bool resumed = false;
+    xen_pfn_t pfn;
+    int rc;
+
+    for ( i = 0, j = 0; i < batch->count; ++i )
+    {
+        switch ( batch->types[i] )
+        {
+        case XEN_DOMCTL_PFINFO_XTAB:
+        case XEN_DOMCTL_PFINFO_BROKEN:
+        case XEN_DOMCTL_PFINFO_XALLOC:
+            /* No page data to deal with. */
+            continue;
+
+        case XEN_DOMCTL_PFINFO_NOTAB:
+            break;
+
+        default:
+            ERROR("Unexpected type %#"PRIx32" for post-copy pfn %#"PRIpfn,
+                  batch->types[i], batch->pfns[i]);
+            return -1;
+        }
+
+        pfn = batch->pfns[i];
+
+        /* Anything else has been dropped by the guest in the meantime. */
+        if ( pfn <= pc->max_pfn && test_bit(pfn, pc->outstanding) )
+        {
+            if ( encodings && encodings[j].encoding != PAGE_ENCODING_RAW )
+            {
+                /* The base of a delta was discarded at the transition. */
+                if ( encodings[j].encoding == PAGE_ENCODING_DELTA )
+                {
+                    ERROR("Delta encoding for post-copy pfn %#"PRIpfn, pfn);
+                    return -1;
+                }
+
+                rc = decode_page_data(&encodings[j], page_data, pc->buffer);
+                if ( rc )
+                {
+                    ERROR("Failed to decode pfn %#"PRIpfn" (%s encoding, length %u)",
+                          pfn, page_encoding_to_str(encodings[j].encoding),
+                          encodings[j].length);
+                    return -1;
+                }
+            }
+            else
+                memcpy(pc->buffer, page_data, PAGE_SIZE);
+
+            rc = postcopy_check_faults(ctx);
+            if ( rc )
+                return rc;
+
+            rc = xc_mem_paging_load(xch, ctx->domid, pfn, pc->buffer);
+            if ( rc )
+            {
+                PERROR("Failed to page in pfn %#"PRIpfn, pfn);
+                return -1;
+            }
+
+            clear_bit(pfn, pc->outstanding);
+            --pc->nr_outstanding;
+
+            for ( w = 0; w < pc->nr_waiting; )
+            {
+                if ( pc->waiting[w].u.mem_paging.gfn != pfn )
+                {
+                    ++w;
+                    continue;
+                }
+
+                postcopy_respond(ctx, &pc->waiting[w]);
+                pc->waiting[w] = pc->waiting[--pc->nr_waiting];
+                resumed = true;
+            }
+        }
+
+        page_data += encodings ? encodings[j].length : PAGE_SIZE;
+        ++j;
+    }
+
+    if ( resumed && xenevtchn_notify(pc->xce, pc->local_port) )
+    {
+        PERROR("Failed to notify paging ring");
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Validate a PAGE_DATA or PAGE_DATA_ENCODED record from the stream, populate
+ * its pfns, and pass it on to be copied into the guest.  The batch takes
+ * ownership of the record data.
+ */
+static int handle_page_data(struct xc_sr_context *ctx, struct xc_sr_record *rec)
+{
+    xc_interface *xch = ctx->xch;
+    struct xc_sr_restore_pipeline *pl = &ctx->restore.pipeline;
+    struct xc_sr_restore_batch *batch =
+        &pl->batches[pl->submitted % pl->nr_batches];
+    struct xc_sr_rec_page_data_header *pages = rec->data;
+    bool encoded = rec->type == REC_TYPE_PAGE_DATA_ENCODED;
+    const char *name = encoded ? "PAGE_DATA_ENCODED" : "PAGE_DATA";
+    struct xc_sr_rec_page_encoding *encodings = NULL;
+    void *page_data;
+    size_t data_length;
+    unsigned i, pages_of_data = 0;
+    uint64_t start;
+    int rc = -1;
+
+    xen_pfn_t *pfns = NULL, pfn;
+    uint32_t *types = NULL, type;
+
+#ifndef XC_SR_PAGE_ENCODING
+    if ( encoded )
+    {
+        ERROR("PAGE_DATA_ENCODED records not supported by this build");
+        goto err;
+    }
+#endif
+
+    if ( rec->length < sizeof(*pages) )
+    {
+        ERROR("%s record truncated: length %u, min %zu",
+              name, rec->length, sizeof(*pages));
+        goto err;
+    }
+    else if ( pages->count < 1 )
+    {
+        ERROR("Expected at least 1 pfn in %s record", name);
+        goto err;
+    }
+    else if ( rec->length < sizeof(*pages) + (pages->count * sizeof(uint64_t)) )
+    {
+        ERROR("%s record (length %u) too short to contain %u"
+              " pfns worth of information", name, rec->length, pages->count);
+        goto err;
+    }
+
+    pfns = malloc(pages->count * sizeof(*pfns));
+    types = malloc(pages->count * sizeof(*types));
+    if ( !pfns || !types )
+    {
+        ERROR("Unable to allocate enough memory for %u pfns",
+              pages->count);
+        goto err;
+    }
+
+    for ( i = 0; i < pages->count; ++i )
+    {
+        pfn = pages->pfn[i] & PAGE_DATA_PFN_MASK;
+        if ( !ctx->restore.ops.pfn_is_valid(ctx, pfn) )
+        {
+            ERROR("pfn %#"PRIpfn" (index %u) outside domain maximum", pfn, i);
+            goto err;
+        }
+
+        type = (pages->pfn[i] & PAGE_DATA_TYPE_MASK) >> 32;
+        if ( ((type >> XEN_DOMCTL_PFINFO_LTAB_SHIFT) >= 5) &&
+             ((type >> XEN_DOMCTL_PFINFO_LTAB_SHIFT) <= 8) )
+        {
+            ERROR("Invalid type %#"PRIx32" for pfn %#"PRIpfn" (index %u)",
+                  type, pfn, i);
+            goto err;
+        }
+        else if ( type < XEN_DOMCTL_PFINFO_BROKEN )
+            /* NOTAB and all L1 through L4 tables (including pinned) should
+             * have a page worth of data in the record. */
+            pages_of_data++;
+
+        pfns[i] = pfn;
+        types[i] = type;
+    }
+
+    page_data = &pages->pfn[pages->count];
+    data_length = PAGE_SIZE * pages_of_data;
+
+    if ( encoded )
+    {
+        encodings = page_data;
+
+        if ( rec->length < (sizeof(*pages) +
+                            (sizeof(uint64_t) * pages->count) +
+                            (sizeof(*encodings) * pages_of_data)) )
+        {
+            ERROR("%s record (length %u) too short to contain %u"
+                  " encodings", name, rec->length, pages_of_data);
+            goto err;
+        }
+
+        for ( i = 0, data_length = 0; i < pages_of_data; ++i )
+        {
+            if ( !page_encoding_valid(&encodings[i]) )
+            {
+                ERROR("Invalid encoding %u, length %u (index %u)",
+                      encodings[i].encoding, encodings[i].length, i);
+                goto err;
+            }
+
+            data_length += encodings[i].length;
+        }
+
+        page_data = &encodings[pages_of_data];
+    }
+
+    if ( rec->length != (page_data - rec->data) + data_length )
+    {
+        ERROR("%s record wrong size: length %u, expected %zu + %zu",
+              name, rec->length, (size_t)(page_data - rec->data), data_length);
+        goto err;
+    }
+
+    batch->rec_data = rec->data;
+    rec->data = NULL;
+    batch->count = pages->count;
+    batch->pfns = pfns;
+    batch->types = types;
+    batch->page_data = page_data;
+    batch->encodings = encodings;
+
+    if ( ctx->restore.postcopy.outstanding )
+    {
+        rc = postcopy_page_in(ctx, batch);
+        release_page_data(batch);
+        return rc;
+    }
+
+    start = now_ns();
+    rc = populate_page_data(ctx, batch);
+    ctx->restore.stats.populate_ns += now_ns() - start;
+    ctx->restore.stats.populate_pfns += batch->count;
+
+    if ( rc )
+    {
+        release_page_data(batch);
+        return rc;
+    }
+
+    return submit_page_data(ctx, batch);
+
+ err:
+    free(types);
+    free(pfns);
+
+    return rc;
+}
+
+/*
+ * Post-copy migration.
+ *
+ * After a POSTCOPY_BEGIN record, the sender lists in POSTCOPY_PFNS records
+ * the pfns whose contents will only be sent once the guest is running here.
+ * The rest of the checkpoint follows as usual, up to a POSTCOPY_TRANSITION
+ * record, at which point the listed pfns are paged out using Xen's
+ * mem_paging interface and the guest is resumed.
+ *
+ * Guest accesses to the outstanding pfns arrive as requests on the paging
+ * ring, and are forwarded to the sender in POSTCOPY_FAULT records on the
+ * back channel.  Page data arriving in the remainder of the stream is paged
+ * back in, resuming any vcpus waiting on it, until the END record.
+ */
+static int handle_postcopy_begin(struct xc_sr_context *ctx)
+{
+    xc_interface *xch = ctx->xch;
+    struct restore_callbacks *cb = ctx->restore.callbacks;
+
+    if ( ctx->restore.postcopy.active || ctx->restore.postcopy.outstanding )
+    {
+        ERROR("Unexpected POSTCOPY_BEGIN record");
+        return -1;
+    }
+
+    if ( ctx->restore.checkpointed != XC_MIG_STREAM_NONE ||
+         !ctx->dominfo.hvm )
+    {
+        ERROR("Post-copy is only supported for uncheckpointed HVM streams");
+        return -1;
+    }
+
+    if ( ctx->restore.send_back_fd < 0 ||
+         !cb || !cb->postcopy || !cb->restore_results )
+    {
+        ERROR("Post-copy stream, but no back channel or resume callbacks");
+        return -1;
+    }
+
+    ctx->restore.postcopy.active = true;
+
+    return 0;
+}
+
+static int handle_postcopy_pfns(struct xc_sr_context *ctx,
+                                struct xc_sr_record *rec)
+{
+    xc_interface *xch = ctx->xch;
+    struct xc_sr_restore_postcopy *pc = &ctx->restore.postcopy;
+    const uint64_t *pfns = rec->data;
+    unsigned long i, count = rec->length / sizeof(*pfns), new_max;
+    xen_pfn_t *p;
+
+    if ( !pc->active )
+    {
+        ERROR("POSTCOPY_PFNS record outside of post-copy setup");
+        return -1;
+    }
+
+    if ( rec->length % sizeof(*pfns) )
+    {
+        ERROR("Invalid POSTCOPY_PFNS record length %u", rec->length);
+        return -1;
+    }
+
+    if ( pc->nr_pfns + count > pc->max_pfns )
+    {
+        new_max = max(pc->max_pfns * 2, pc->nr_pfns + count);
+        p = realloc(pc->pfns, new_max * sizeof(*p));
+        if ( !p )
+        {
+            ERROR("Unable to allocate memory for %lu post-copy pfns", new_max);
+            return -1;
+        }
+
+        pc->pfns = p;
+        pc->max_pfns = new_max;
+    }
+
+    for ( i = 0; i < count; ++i )
+    {
+        if ( !ctx->restore.ops.pfn_is_valid(ctx, pfns[i]) )
+        {
+            ERROR("Post-copy pfn %#"PRIx64" outside domain maximum", pfns[i]);
+            return -1;
+        }
+
+        pc->pfns[pc->nr_pfns++] = pfns[i];
+        pc->max_pfn = max(pc->max_pfn, (xen_pfn_t)pfns[i]);
+    }
+
+    return 0;
+}
+
+/*
+ * Enable paging for the domain, and connect to the paging ring.
+ */
+static int postcopy_setup_paging(struct xc_sr_context *ctx)
+{
+    xc_interface *xch = ctx->xch;
+    struct xc_sr_restore_postcopy *pc = &ctx->restore.postcopy;
+    int rc;
+
+    pc->ring_page = xc_vm_event_enable(xch, ctx->domid,
+                                       HVM_PARAM_PAGING_RING_PFN,
+                                       &pc->remote_port);
+    if ( !pc->ring_page )
+    {
+        PERROR("Failed to enable paging");
+        return -1;
+    }
+
+    pc->xce = xenevtchn_open(NULL, 0);
+    if ( !pc->xce )
+    {
+        PERROR("Failed to open event channel handle");
+        return -1;
+    }
+
+    rc = xenevtchn_bind_interdomain(pc->xce, ctx->domid, pc->remote_port);
+    if ( rc < 0 )
+    {
+        PERROR("Failed to bind paging event channel");
+        return -1;
+    }
+    pc->local_port = rc;
+
+    SHARED_RING_INIT((vm_event_sring_t *)pc->ring_page);
+    BACK_RING_INIT(&pc->back_ring, (vm_event_sring_t *)pc->ring_page,
+                   PAGE_SIZE);
+
+    rc = posix_memalign(&pc->buffer, PAGE_SIZE, PAGE_SIZE);
+    if ( rc )
+    {
+        pc->buffer = NULL;
+        errno = rc;
+        PERROR("Failed to allocate post-copy page buffer");
+        return -1;
+    }
+
+    return 0;
+}
+
+static void postcopy_cleanup(struct xc_sr_context *ctx)
+{
+    xc_interface *xch = ctx->xch;
+    struct xc_sr_restore_postcopy *pc = &ctx->restore.postcopy;
+
+    /* Xen uses the ring and event channel until paging is disabled. */
+    if ( pc->ring_page )
+    {
+        if ( xc_mem_paging_disable(xch, ctx->domid) )
+            PERROR("Failed to disable paging");
+        xenforeignmemory_unmap(xch->fmem, pc->ring_page, 1);
+    }
+
+    if ( pc->xce )
+    {
+        if ( pc->local_port )
+            xenevtchn_unbind(pc->xce, pc->local_port);
+        xenevtchn_close(pc->xce);
+    }
+
+    free(pc->buffer);
+    free(pc->waiting);
+    free(pc->outstanding);
+    free(pc->pfns);
+}
+
+/*
+ * The sender has sent everything but the outstanding memory.  Page out the
+ * outstanding pfns, finish the restore and resume the guest.
+ */
+static int handle_postcopy_transition(struct xc_sr_context *ctx)
+{
+    xc_interface *xch = ctx->xch;
+    struct xc_sr_restore_postcopy *pc = &ctx->restore.postcopy;
+    struct restore_callbacks *cb = ctx->restore.callbacks;
+    unsigned long i;
+    uint64_t ring_pfn;
+    xen_pfn_t pfn;
+    int rc;
+
+    if ( !pc->active )
+    {
+        ERROR("Unexpected POSTCOPY_TRANSITION record");
+        return -1;
+    }
+    pc->active = false;
+
+    rc = postcopy_setup_paging(ctx);
+    if ( rc )
+        return rc;
+
+    rc = xc_hvm_param_get(xch, ctx->domid, HVM_PARAM_PAGING_RING_PFN,
+                          &ring_pfn);
+    if ( rc )
+    {
+        PERROR("Failed to get paging ring pfn");
+        return rc;
+    }
+
+    /*
+     * The rings set up from HVM_PARAMS must already hold their final
+     * contents: the sender sends them before the transition.
+     */
+    for ( i = 0; i < pc->nr_pfns; ++i )
+    {
+        pfn = pc->pfns[i];
+        if ( pfn == ring_pfn ||
+             (pfn && (pfn == ctx->restore.xenstore_gfn ||
+                      pfn == ctx->restore.console_gfn)) )
+        {
+            ERROR("Special pfn %#"PRIpfn" listed for post-copy", pfn);
+            return -1;
+        }
+    }
+
+    pc->outstanding = bitmap_alloc(pc->max_pfn + 1);
+    if ( !pc->outstanding )
+    {
+        ERROR("Unable to allocate memory for post-copy bitmap");
+        return -1;
+    }
+
+    /* Only populated pfns can be paged out. */
+    rc = populate_pfns(ctx, pc->nr_pfns, pc->pfns, NULL);
+    if ( rc )
+        return rc;
+
+    for ( i = 0; i < pc->nr_pfns; ++i )
+    {
+        pfn = pc->pfns[i];
+        if ( test_and_set_bit(pfn, pc->outstanding) )
+            continue;
+
+        if ( xc_mem_paging_nominate(xch, ctx->domid, pfn) ||
+             xc_mem_paging_evict(xch, ctx->domid, pfn) )
+        {
+            PERROR("Failed to page out pfn %#"PRIpfn" for post-copy", pfn);
+            return -1;
+        }
+
+        ++pc->nr_outstanding;
+    }
+
+    free(pc->pfns);
+    pc->pfns = NULL;
+
+    rc = ctx->restore.ops.stream_complete(ctx);
+    if ( rc )
+        return rc;
+
+    cb->restore_results(ctx->restore.xenstore_gfn, ctx->restore.console_gfn,
+                        cb->data);
+
+    IPRINTF("Resuming guest with %lu pages outstanding", pc->nr_outstanding);
+
+    if ( cb->postcopy(cb->data) != 1 )
+    {
+        ERROR("Failed to resume guest for post-copy");
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Asks the sender for the contents of some faulting pfns.
+ */
+static int postcopy_request_pfns(struct xc_sr_context *ctx,
+                                 uint64_t *pfns, unsigned int count)
+{
+    xc_interface *xch = ctx->xch;
+    struct xc_sr_record rec =
+    {
+        .type = REC_TYPE_POSTCOPY_FAULT,
+        .length = count * sizeof(*pfns),
+    };
+    struct iovec iov[] =
+    {
+        { .iov_base = &rec.type,   .iov_len = sizeof(rec.type) },
+        { .iov_base = &rec.length, .iov_len = sizeof(rec.length) },
+        { .iov_base = pfns,        .iov_len = count * sizeof(*pfns) },
+    };
+
+    if ( writev_exact(ctx->restore.send_back_fd, iov, ARRAY_SIZE(iov)) )
+    {
+        PERROR("Failed to write post-copy faults to back channel");
+        return -1;
+    }
+
+    return 0;
 }
 
 /*
- * Given a list of pfns, their types, and a block of page data from the
- * stream, populate and record their types, map the relevant subset and copy
- * the data into the guest.
+ * Consume requests from the paging ring.  Requests for pfns which are still
+ * outstanding wait for their data, and the sender is asked for each such pfn
+ * once.  Anything else is answered straight away.
  */
-static int process_page_data(struct xc_sr_context *ctx, unsigned count,
-                             xen_pfn_t *pfns, uint32_t *types, void *page_data)
+static int postcopy_handle_faults(struct xc_sr_context *ctx)
 {
     xc_interface *xch = ctx->xch;
-    xen_pfn_t *mfns = malloc(count * sizeof(*mfns));
-    int *map_errs = malloc(count * sizeof(*map_errs));
-    int rc;
-    void *mapping = NULL, *guest_page = NULL;
-    unsigned i,    /* i indexes the pfns from the record. */
-        j,         /* j indexes the subset of pfns we decide to map. */
-        nr_pages = 0;
-
-    if ( !mfns || !map_errs )
+    struct xc_sr_restore_postcopy *pc = &ctx->restore.postcopy;
+    vm_event_request_t req, *w;
+    uint64_t pfns[64];
+    unsigned int i, nr_pfns = 0, new_max;
+    bool resumed = false, requested;
+    RING_IDX cons;
+    xen_pfn_t gfn;
+    int port, rc;
+
+    port = xenevtchn_pending(pc->xce);
+    if ( port < 0 || xenevtchn_unmask(pc->xce, port) )
     {
-        rc = -1;
-        ERROR("Failed to allocate %zu bytes to process page data",
-              count * (sizeof(*mfns) + sizeof(*map_errs)));
-        goto err;
+        PERROR("Failed to handle paging event channel");
+        return -1;
     }
 
-    rc = populate_pfns(ctx, count, pfns, types);
-    if ( rc )
+    while ( RING_HAS_UNCONSUMED_REQUESTS(&pc->back_ring) )
     {
-        ERROR("Failed to populate pfns for batch of %u pages", count);
-        goto err;
-    }
+        cons = pc->back_ring.req_cons;
+        memcpy(&req, RING_GET_REQUEST(&pc->back_ring, cons), sizeof(req));
+        pc->back_ring.req_cons = ++cons;
+        pc->back_ring.sring->req_event = cons + 1;
 
-    for ( i = 0; i < count; ++i )
-    {
-        ctx->restore.ops.set_page_type(ctx, pfns[i], types[i]);
+        gfn = req.u.mem_paging.gfn;
 
-        switch ( types[i] )
+        if ( gfn > pc->max_pfn || !test_bit(gfn, pc->outstanding) )
         {
-        case XEN_DOMCTL_PFINFO_NOTAB:
-
-        case XEN_DOMCTL_PFINFO_L1TAB:
-        case XEN_DOMCTL_PFINFO_L1TAB | XEN_DOMCTL_PFINFO_LPINTAB:
-
-        case XEN_DOMCTL_PFINFO_L2TAB:
-        case XEN_DOMCTL_PFINFO_L2TAB | XEN_DOMCTL_PFINFO_LPINTAB:
-
-        case XEN_DOMCTL_PFINFO_L3TAB:
-        case XEN_DOMCTL_PFINFO_L3TAB | XEN_DOMCTL_PFINFO_LPINTAB:
-
-        case XEN_DOMCTL_PFINFO_L4TAB:
-        case XEN_DOMCTL_PFINFO_L4TAB | XEN_DOMCTL_PFINFO_LPINTAB:
-
-            mfns[nr_pages++] = ctx->restore.ops.pfn_to_gfn(ctx, pfns[i]);
-            break;
+            /* Paged in since the request was made. */
+            postcopy_respond(ctx, &req);
+            resumed = true;
+            continue;
         }
-    }
-
-    /* Nothing to do? */
-    if ( nr_pages == 0 )
-        goto done;
-
-    mapping = guest_page = xenforeignmemory_map(xch->fmem,
-        ctx->domid, PROT_READ | PROT_WRITE,
-        nr_pages, mfns, map_errs);
-    if ( !mapping )
-    {
-        rc = -1;
-        PERROR("Unable to map %u mfns for %u pages of data",
-               nr_pages, count);
-        goto err;
-    }
 
-    for ( i = 0, j = 0; i < count; ++i )
-    {
-        switch ( types[i] )
+        if ( req.u.mem_paging.flags & MEM_PAGING_DROP_PAGE )
         {
-        case XEN_DOMCTL_PFINFO_XTAB:
-        case XEN_DOMCTL_PFINFO_BROKEN:
-        case XEN_DOMCTL_PFINFO_XALLOC:
-            /* No page data to deal with. */
+            /* Freed by the guest; any data arriving for it is stale. */
+            clear_bit(gfn, pc->outstanding);
+            --pc->nr_outstanding;
+            postcopy_respond(ctx, &req);
+            resumed = true;
             continue;
         }
 
-        if ( map_errs[j] )
-        {
-            rc = -1;
-            ERROR("Mapping pfn %#"PRIpfn" (mfn %#"PRIpfn", type %#"PRIx32") failed with %d",
-                  pfns[i], mfns[j], types[i], map_errs[j]);
-            goto err;
-        }
+        for ( i = 0, requested = false; i < pc->nr_waiting; ++i )
+            if ( pc->waiting[i].u.mem_paging.gfn == gfn )
+                requested = true;
 
-        /* Undo page normalisation done by the saver. */
-        rc = ctx->restore.ops.localise_page(ctx, types[i], page_data);
-        if ( rc )
+        if ( pc->nr_waiting == pc->max_waiting )
         {
-            ERROR("Failed to localise pfn %#"PRIpfn" (type %#"PRIx32")",
-                  pfns[i], types[i] >> XEN_DOMCTL_PFINFO_LTAB_SHIFT);
-            goto err;
-        }
+            new_max = pc->max_waiting ? pc->max_waiting * 2 : 64;
+            w = realloc(pc->waiting, new_max * sizeof(*w));
+            if ( !w )
+            {
+                ERROR("Unable to allocate memory for post-copy faults");
+                return -1;
+            }
 
-        if ( ctx->restore.verify )
-        {
-            /* Verify mode - compare incoming data to what we already have. */
-            if ( memcmp(guest_page, page_data, PAGE_SIZE) )
-                ERROR("verify pfn %#"PRIpfn" failed (type %#"PRIx32")",
-                      pfns[i], types[i] >> XEN_DOMCTL_PFINFO_LTAB_SHIFT);
+            pc->waiting = w;
+            pc->max_waiting = new_max;
         }
-        else
+        pc->waiting[pc->nr_waiting++] = req;
+
+        if ( requested )
+            continue;
+
+        ++pc->nr_faults;
+        pfns[nr_pfns++] = gfn;
+        if ( nr_pfns == ARRAY_SIZE(pfns) )
         {
-            /* Regular mode - copy incoming data into place. */
-            memcpy(guest_page, page_data, PAGE_SIZE);
+            rc = postcopy_request_pfns(ctx, pfns, nr_pfns);
+            if ( rc )
+                return rc;
+            nr_pfns = 0;
         }
-
-        ++j;
-        guest_page += PAGE_SIZE;
-        page_data += PAGE_SIZE;
     }
 
- done:
-    rc = 0;
-
- err:
-    if ( mapping )
-        xenforeignmemory_unmap(xch->fmem, mapping, nr_pages);
+    if ( nr_pfns )
+    {
+        rc = postcopy_request_pfns(ctx, pfns, nr_pfns);
+        if ( rc )
+            return rc;
+    }
 
-    free(map_errs);
-    free(mfns);
+    if ( resumed && xenevtchn_notify(pc->xce, pc->local_port) )
+    {
+        PERROR("Failed to notify paging ring");
+        return -1;
+    }
 
-    return rc;
+    return 0;
 }
 
 /*
- * Validate a PAGE_DATA record from the stream, and pass the results to
- * process_page_data() to actually perform the legwork.
+ * Forward any faults pending on the paging ring, without waiting for one.
  */
-static int handle_page_data(struct xc_sr_context *ctx, struct xc_sr_record *rec)
+static int postcopy_check_faults(struct xc_sr_context *ctx)
 {
     xc_interface *xch = ctx->xch;
-    struct xc_sr_rec_page_data_header *pages = rec->data;
-    unsigned i, pages_of_data = 0;
-    int rc = -1;
-
-    xen_pfn_t *pfns = NULL, pfn;
-    uint32_t *types = NULL, type;
-
-    if ( rec->length < sizeof(*pages) )
-    {
-        ERROR("PAGE_DATA record truncated: length %u, min %zu",
-              rec->length, sizeof(*pages));
-        goto err;
-    }
-    else if ( pages->count < 1 )
+    struct pollfd pfd =
     {
-        ERROR("Expected at least 1 pfn in PAGE_DATA record");
-        goto err;
-    }
-    else if ( rec->length < sizeof(*pages) + (pages->count * sizeof(uint64_t)) )
+        .fd = xenevtchn_fd(ctx->restore.postcopy.xce),
+        .events = POLLIN,
+    };
+    int rc;
+
+    rc = poll(&pfd, 1, 0);
+    if ( rc < 0 )
     {
-        ERROR("PAGE_DATA record (length %u) too short to contain %u"
-              " pfns worth of information", rec->length, pages->count);
-        goto err;
+        if ( errno == EINTR )
+            return 0;
+
+        PERROR("Failed to poll for post-copy faults");
+        return -1;
     }
 
-    pfns = malloc(pages->count * sizeof(*pfns));
-    types = malloc(pages->count * sizeof(*types));
-    if ( !pfns || !types )
+    return rc ? postcopy_handle_faults(ctx) : 0;
+}
+
+static int process_record(struct xc_sr_context *ctx, struct xc_sr_record *rec);
+
+/*
+ * Receive the outstanding memory while the guest runs, servicing its faults,
+ * up to the END record.
+ */
+static int receive_memory_postcopy(struct xc_sr_context *ctx)
+{
+    xc_interface *xch = ctx->xch;
+    struct xc_sr_restore_postcopy *pc = &ctx->restore.postcopy;
+    struct xc_sr_record rec;
+    struct pollfd pfds[] =
     {
-        ERROR("Unable to allocate enough memory for %u pfns",
-              pages->count);
-        goto err;
-    }
+        { .fd = ctx->fd,                .events = POLLIN },
+        { .fd = xenevtchn_fd(pc->xce),  .events = POLLIN },
+    };
+    int rc;
 
-    for ( i = 0; i < pages->count; ++i )
+    for ( ; ; )
     {
-        pfn = pages->pfn[i] & PAGE_DATA_PFN_MASK;
-        if ( !ctx->restore.ops.pfn_is_valid(ctx, pfn) )
+        rc = poll(pfds, ARRAY_SIZE(pfds), -1);
+        if ( rc < 0 )
         {
-            ERROR("pfn %#"PRIpfn" (index %u) outside domain maximum", pfn, i);
-            goto err;
+            if ( errno == EINTR )
+                continue;
+
+            PERROR("Failed to poll during post-copy");
+            return -1;
         }
 
-        type = (pages->pfn[i] & PAGE_DATA_TYPE_MASK) >> 32;
-        if ( ((type >> XEN_DOMCTL_PFINFO_LTAB_SHIFT) >= 5) &&
-             ((type >> XEN_DOMCTL_PFINFO_LTAB_SHIFT) <= 8) )
+        if ( pfds[1].revents )
         {
-            ERROR("Invalid type %#"PRIx32" for pfn %#"PRIpfn" (index %u)",
-                  type, pfn, i);
-            goto err;
+            rc = postcopy_handle_faults(ctx);
+            if ( rc )
+                return rc;
         }
-        else if ( type < XEN_DOMCTL_PFINFO_BROKEN )
-            /* NOTAB and all L1 through L4 tables (including pinned) should
-             * have a page worth of data in the record. */
-            pages_of_data++;
 
-        pfns[i] = pfn;
-        types[i] = type;
-    }
+        if ( !pfds[0].revents )
+            continue;
 
-    if ( rec->length != (sizeof(*pages) +
-                         (sizeof(uint64_t) * pages->count) +
-                         (PAGE_SIZE * pages_of_data)) )
-    {
-        ERROR("PAGE_DATA record wrong size: length %u, expected "
-              "%zu + %zu + %lu", rec->length, sizeof(*pages),
-              (sizeof(uint64_t) * pages->count), (PAGE_SIZE * pages_of_data));
-        goto err;
-    }
+        rc = read_record(ctx, ctx->fd, &rec);
+        if ( rc )
+            return rc;
 
-    rc = process_page_data(ctx, pages->count, pfns, types,
-                           &pages->pfn[pages->count]);
- err:
-    free(types);
-    free(pfns);
+        switch ( rec.type )
+        {
+        case REC_TYPE_PAGE_DATA:
+        case REC_TYPE_PAGE_DATA_ENCODED:
+            rc = process_record(ctx, &rec);
+            if ( rc )
+                return rc;
+            break;
 
-    return rc;
+        case REC_TYPE_END:
+            if ( pc->nr_outstanding )
+            {
+                ERROR("Stream ended with %lu post-copy pages outstanding",
+                      pc->nr_outstanding);
+                return -1;
+            }
+
+            IPRINTF("Post-copy complete: %"PRIu64" pages requested by faults",
+                    pc->nr_faults);
+            return 0;
+
+        default:
+            ERROR("Unexpected %s record (%#x) during post-copy",
+                  rec_type_to_str(rec.type), rec.type);
+            free(rec.data);
+            return -1;
+        }
+    }
 }
 
 /*
@@ -499,7 +1517,6 @@ static int send_checkpoint_dirty_pfn_list(struct xc_sr_context *ctx)
     return rc;
 }
 
-static int process_record(struct xc_sr_context *ctx, struct xc_sr_record *rec);
 static int handle_checkpoint(struct xc_sr_context *ctx)
 {
     xc_interface *xch = ctx->xch;
@@ -543,6 +1560,10 @@ static int handle_checkpoint(struct xc_sr_context *ctx)
                 goto err;
         }
         ctx->restore.buffered_rec_num = 0;
+
+        rc = drain_page_data(ctx);
+        if ( rc )
+            goto err;
         IPRINTF("All records processed");
     }
     else
@@ -631,12 +1652,22 @@ static int process_record(struct xc_sr_context *ctx, struct xc_sr_record *rec)
     xc_interface *xch = ctx->xch;
     int rc = 0;
 
+    /* Everything other than page data may depend on guest memory. */
+    if ( rec->type != REC_TYPE_PAGE_DATA &&
+         rec->type != REC_TYPE_PAGE_DATA_ENCODED )
+    {
+        rc = drain_page_data(ctx);
+        if ( rc )
+            goto out;
+    }
+
     switch ( rec->type )
     {
     case REC_TYPE_END:
         break;
 
     case REC_TYPE_PAGE_DATA:
+    case REC_TYPE_PAGE_DATA_ENCODED:
         rc = handle_page_data(ctx, rec);
         break;
 
@@ -649,17 +1680,139 @@ static int process_record(struct xc_sr_context *ctx, struct xc_sr_record *rec)
         rc = handle_checkpoint(ctx);
         break;
 
+    case REC_TYPE_POSTCOPY_BEGIN:
+        rc = handle_postcopy_begin(ctx);
+        break;
+
+    case REC_TYPE_POSTCOPY_PFNS:
+        rc = handle_postcopy_pfns(ctx, rec);
+        break;
+
+    case REC_TYPE_POSTCOPY_TRANSITION:
+        rc = handle_postcopy_transition(ctx);
+        break;
+
     default:
         rc = ctx->restore.ops.process_record(ctx, rec);
         break;
     }
 
+ out:
     free(rec->data);
     rec->data = NULL;
 
     return rc;
 }
 
+/*
+ * Allocates the batches, and starts the pipeline workers if requested.
+ */
+static int setup_pipeline(struct xc_sr_context *ctx)
+{
+    xc_interface *xch = ctx->xch;
+    struct xc_sr_restore_pipeline *pl = &ctx->restore.pipeline;
+    unsigned int i;
+    int rc;
+
+    /* Two batches per worker keeps every worker busy while one is read. */
+    pl->nr_batches = pl->nr_workers ? 2 * pl->nr_workers : 1;
+    pl->batches = calloc(pl->nr_batches, sizeof(*pl->batches));
+    if ( !pl->batches )
+    {
+        ERROR("Unable to allocate memory for %u page batches", pl->nr_batches);
+        errno = ENOMEM;
+        return -1;
+    }
+
+    if ( !pl->nr_workers )
+        return 0;
+
+    pl->workers = calloc(pl->nr_workers, sizeof(*pl->workers));
+    if ( !pl->workers )
+    {
+        ERROR("Unable to allocate memory for %u restore workers",
+              pl->nr_workers);
+        errno = ENOMEM;
+        return -1;
+    }
+
+    pthread_mutex_init(&pl->lock, NULL);
+    pthread_cond_init(&pl->work_cond, NULL);
+    pthread_cond_init(&pl->done_cond, NULL);
+
+    for ( i = 0; i < pl->nr_workers; ++i )
+    {
+        rc = pthread_create(&pl->workers[i], NULL, restore_worker, ctx);
+        if ( rc )
+        {
+            errno = rc;
+            PERROR("Unable to start restore worker %u", i);
+            return -1;
+        }
+        ++pl->nr_workers_started;
+    }
+
+    DPRINTF("Using %u restore workers", pl->nr_workers);
+
+    return 0;
+}
+
+/*
+ * Stops the pipeline workers and releases all batches.  Batches still in
+ * flight (after an error) are dropped without being copied in.
+ */
+static void cleanup_pipeline(struct xc_sr_context *ctx)
+{
+    struct xc_sr_restore_pipeline *pl = &ctx->restore.pipeline;
+    unsigned int i;
+
+    if ( pl->workers )
+    {
+        pthread_mutex_lock(&pl->lock);
+        pl->exit = true;
+        pthread_cond_broadcast(&pl->work_cond);
+        pthread_mutex_unlock(&pl->lock);
+
+        for ( i = 0; i < pl->nr_workers_started; ++i )
+            pthread_join(pl->workers[i], NULL);
+
+        pthread_cond_destroy(&pl->done_cond);
+        pthread_cond_destroy(&pl->work_cond);
+        pthread_mutex_destroy(&pl->lock);
+        free(pl->workers);
+    }
+
+    for ( i = 0; pl->batches && i < pl->nr_batches; ++i )
+        release_page_data(&pl->batches[i]);
+    free(pl->batches);
+}
+
+/*
+ * Log the throughput of each stage of the restore.
+ */
+static void log_restore_stats(struct xc_sr_context *ctx, uint64_t total_ns)
+{
+    xc_interface *xch = ctx->xch;
+    const struct xc_sr_restore_stats *st = &ctx->restore.stats;
+
+#define MIBPS(octets, ns) \
+    ((ns) ? (double)(octets) * 1000000000. / (ns) / (1 << 20) : 0.)
+
+    IPRINTF("Restore took %"PRIu64" ms", total_ns / 1000000);
+    IPRINTF("  Read:     %"PRIu64" MiB in %"PRIu64" ms, %.1f MiB/s",
+            st->read_octets >> 20, st->read_ns / 1000000,
+            MIBPS(st->read_octets, st->read_ns));
+    IPRINTF("  Populate: %"PRIu64" pfns in %"PRIu64" ms, %.1f MiB/s",
+            st->populate_pfns, st->populate_ns / 1000000,
+            MIBPS(st->populate_pfns * PAGE_SIZE, st->populate_ns));
+    IPRINTF("  Copy:     %"PRIu64" pages in %"PRIu64" ms (%u workers), %.1f MiB/s",
+            st->copy_pages, st->copy_ns / 1000000,
+            ctx->restore.pipeline.nr_workers,
+            MIBPS(st->copy_pages * PAGE_SIZE, st->copy_ns));
+
+#undef MIBPS
+}
+
 static int setup(struct xc_sr_context *ctx)
 {
     xc_interface *xch = ctx->xch;
@@ -704,6 +1857,8 @@ static int setup(struct xc_sr_context *ctx)
     }
     ctx->restore.allocated_rec_num = DEFAULT_BUF_RECORDS;
 
+    rc = setup_pipeline(ctx);
+
  err:
     return rc;
 }
@@ -715,6 +1870,9 @@ static void cleanup(struct xc_sr_context *ctx)
     DECLARE_HYPERCALL_BUFFER_SHADOW(unsigned long, dirty_bitmap,
                                     &ctx->restore.dirty_bitmap_hbuf);
 
+    cleanup_pipeline(ctx);
+    postcopy_cleanup(ctx);
+
     for ( i = 0; i < ctx->restore.buffered_rec_num; i++ )
         free(ctx->restore.buffered_records[i].data);
 
@@ -735,6 +1893,7 @@ static int restore(struct xc_sr_context *ctx)
     xc_interface *xch = ctx->xch;
     struct xc_sr_record rec;
     int rc, saved_rc = 0, saved_errno = 0;
+    uint64_t start = now_ns(), t;
 
     IPRINTF("Restoring domain");
 
@@ -744,6 +1903,7 @@ static int restore(struct xc_sr_context *ctx)
 
     do
     {
+        t = now_ns();
         rc = read_record(ctx, ctx->fd, &rec);
         if ( rc )
         {
@@ -752,6 +1912,9 @@ static int restore(struct xc_sr_context *ctx)
             else
                 goto err;
         }
+        ctx->restore.stats.read_ns += now_ns() - t;
+        ctx->restore.stats.read_octets += sizeof(struct xc_sr_rhdr) +
+            ROUNDUP(rec.length, REC_ALIGN_ORDER);
 
         if ( ctx->restore.buffer_all_records &&
              rec.type != REC_TYPE_END &&
@@ -783,10 +1946,27 @@ static int restore(struct xc_sr_context *ctx)
                 goto err;
         }
 
-    } while ( rec.type != REC_TYPE_END );
+    } while ( rec.type != REC_TYPE_END &&
+              rec.type != REC_TYPE_POSTCOPY_TRANSITION );
+
+    if ( rec.type == REC_TYPE_POSTCOPY_TRANSITION )
+    {
+        /* The guest is already running, and its memory still arriving. */
+        rc = receive_memory_postcopy(ctx);
+        if ( rc )
+            goto err;
+
+        IPRINTF("Restore successful");
+        log_restore_stats(ctx, now_ns() - start);
+        goto done;
+    }
 
  remus_failover:
 
+    rc = drain_page_data(ctx);
+    if ( rc )
+        goto err;
+
     if ( ctx->restore.checkpointed == XC_MIG_STREAM_COLO )
     {
         /* With COLO, we have already called stream_complete */
@@ -804,6 +1984,7 @@ static int restore(struct xc_sr_context *ctx)
         goto err;
 
     IPRINTF("Restore successful");
+    log_restore_stats(ctx, now_ns() - start);
     goto done;
 
  err:
@@ -829,7 +2010,8 @@ int xc_domain_restore(xc_interface *xch, int io_fd, uint32_t dom,
                       unsigned long *console_gfn, uint32_t console_domid,
                       unsigned int hvm, unsigned int pae,
                       xc_migration_stream_t stream_type,
-                      struct restore_callbacks *callbacks, int send_back_fd)
+                      struct restore_callbacks *callbacks, int send_back_fd,
+                      unsigned int nr_workers)
 {
     xen_pfn_t nr_pfns;
     struct xc_sr_context ctx =
@@ -846,6 +2028,15 @@ int xc_domain_restore(xc_interface *xch, int io_fd, uint32_t dom,
     ctx.restore.checkpointed = stream_type;
     ctx.restore.callbacks = callbacks;
     ctx.restore.send_back_fd = send_back_fd;
+    ctx.restore.pipeline.nr_workers = nr_workers;
+
+    if ( nr_workers > XC_RESTORE_MAX_WORKERS )
+    {
+        ERROR("Invalid number of restore workers %u, at most %u supported",
+              nr_workers, XC_RESTORE_MAX_WORKERS);
+        errno = EINVAL;
+        return -1;
+    }
 
     /* Sanity checks for callbacks. */
     if ( stream_type )
@@ -860,8 +2051,8 @@ int xc_domain_restore(xc_interface *xch, int io_fd, uint32_t dom,
                callbacks->restore_results);
     }
 
-    DPRINTF("fd %d, dom %u, hvm %u, pae %u, stream_type %d",
-            io_fd, dom, hvm, pae, stream_type);
+    DPRINTF("fd %d, dom %u, hvm %u, pae %u, stream_type %d, workers %u",
+            io_fd, dom, hvm, pae, stream_type, nr_workers);
 
     if ( xc_domain_getinfo(xch, dom, 1, &ctx.dominfo) != 1 )
     {
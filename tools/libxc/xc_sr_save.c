@@ -1,5 +1,7 @@
 #include <assert.h>
 #include <arpa/inet.h>
+#include <poll.h>
+#include <time.h>
 
 #include "xc_sr_common.h"
 
@@ -67,66 +69,43 @@ static int write_checkpoint_record(struct xc_sr_context *ctx)
 }
 
 /*
- * Writes a batch of memory as a PAGE_DATA record into the stream.  The batch
- * is constructed in ctx->save.batch_pfns.
+ * Maps and normalises a batch of memory, ready to be written into the stream
+ * by write_batch().
  *
  * This function:
  * - gets the types for each pfn in the batch.
  * - for each pfn with real data:
- *   - maps and attempts to localise the pages.
- * - construct and writes a PAGE_DATA record into the stream.
+ *   - maps and attempts to normalise the pages.
+ *   - encodes the pages, if PAGE_DATA_ENCODED records are in use.
+ *
+ * It may run on a pipeline worker thread, concurrently with other batches, so
+ * must only read shared state in ctx, other than the delta cache which has
+ * its own locking.  Pages which need deferring are recorded in the batch.
  */
-static int write_batch(struct xc_sr_context *ctx)
+static int prepare_batch(struct xc_sr_context *ctx,
+                         struct xc_sr_save_batch *batch)
 {
     xc_interface *xch = ctx->xch;
-    xen_pfn_t *mfns = NULL, *types = NULL;
-    void *guest_mapping = NULL;
-    void **guest_data = NULL;
-    void **local_pages = NULL;
-    int *errors = NULL, rc = -1;
-    unsigned i, p, nr_pages = 0, nr_pages_mapped = 0;
-    unsigned nr_pfns = ctx->save.nr_batch_pfns;
+    xen_pfn_t *mfns = batch->mfns, *types = batch->types;
+    int *errors = batch->errors;
+    struct xc_sr_delta_cache *cache =
+        ctx->save.verifying ? NULL : ctx->save.delta_cache;
+    unsigned i, p, nr_pages = 0;
+    unsigned nr_pfns = batch->nr_pfns;
     void *page, *orig_page;
-    uint64_t *rec_pfns = NULL;
-    struct iovec *iov = NULL; int iovcnt = 0;
-    struct xc_sr_rec_page_data_header hdr = { 0 };
-    struct xc_sr_record rec =
-    {
-        .type = REC_TYPE_PAGE_DATA,
-    };
+    int rc;
 
     assert(nr_pfns != 0);
 
-    /* Mfns of the batch pfns. */
-    mfns = malloc(nr_pfns * sizeof(*mfns));
-    /* Types of the batch pfns. */
-    types = malloc(nr_pfns * sizeof(*types));
-    /* Errors from attempting to map the gfns. */
-    errors = malloc(nr_pfns * sizeof(*errors));
-    /* Pointers to page data to send.  Mapped gfns or local allocations. */
-    guest_data = calloc(nr_pfns, sizeof(*guest_data));
-    /* Pointers to locally allocated pages.  Need freeing. */
-    local_pages = calloc(nr_pfns, sizeof(*local_pages));
-    /* iovec[] for writev(). */
-    iov = malloc((nr_pfns + 4) * sizeof(*iov));
-
-    if ( !mfns || !types || !errors || !guest_data || !local_pages || !iov )
-    {
-        ERROR("Unable to allocate arrays for a batch of %u pages",
-              nr_pfns);
-        goto err;
-    }
-
     for ( i = 0; i < nr_pfns; ++i )
     {
-        types[i] = mfns[i] = ctx->save.ops.pfn_to_gfn(ctx,
-                                                      ctx->save.batch_pfns[i]);
+        types[i] = mfns[i] = ctx->save.ops.pfn_to_gfn(ctx, batch->pfns[i]);
 
         /* Likely a ballooned page. */
         if ( mfns[i] == INVALID_MFN )
         {
-            set_bit(ctx->save.batch_pfns[i], ctx->save.deferred_pages);
-            ++ctx->save.nr_deferred_pages;
+            set_bit(i, batch->deferred);
+            ++batch->nr_deferred;
         }
     }
 
@@ -134,9 +113,8 @@ static int write_batch(struct xc_sr_context *ctx)
     if ( rc )
     {
         PERROR("Failed to get types for pfn batch");
-        goto err;
+        return -1;
     }
-    rc = -1;
 
     for ( i = 0; i < nr_pfns; ++i )
     {
@@ -145,6 +123,8 @@ static int write_batch(struct xc_sr_context *ctx)
         case XEN_DOMCTL_PFINFO_BROKEN:
         case XEN_DOMCTL_PFINFO_XALLOC:
         case XEN_DOMCTL_PFINFO_XTAB:
+            if ( cache )
+                invalidate_delta_cache(cache, batch->pfns[i]);
             continue;
         }
 
@@ -153,14 +133,14 @@ static int write_batch(struct xc_sr_context *ctx)
 
     if ( nr_pages > 0 )
     {
-        guest_mapping = xenforeignmemory_map(xch->fmem,
+        batch->guest_mapping = xenforeignmemory_map(xch->fmem,
             ctx->domid, PROT_READ, nr_pages, mfns, errors);
-        if ( !guest_mapping )
+        if ( !batch->guest_mapping )
         {
             PERROR("Failed to map guest pages");
-            goto err;
+            return -1;
         }
-        nr_pages_mapped = nr_pages;
+        batch->nr_pages_mapped = nr_pages;
 
         for ( i = 0, p = 0; i < nr_pfns; ++i )
         {
@@ -175,52 +155,76 @@ static int write_batch(struct xc_sr_context *ctx)
             if ( errors[p] )
             {
                 ERROR("Mapping of pfn %#"PRIpfn" (mfn %#"PRIpfn") failed %d",
-                      ctx->save.batch_pfns[i], mfns[p], errors[p]);
-                goto err;
+                      batch->pfns[i], mfns[p], errors[p]);
+                return -1;
             }
 
-            orig_page = page = guest_mapping + (p * PAGE_SIZE);
+            orig_page = page = batch->guest_mapping + (p * PAGE_SIZE);
             rc = ctx->save.ops.normalise_page(ctx, types[i], &page);
 
             if ( orig_page != page )
-                local_pages[i] = page;
+                batch->local_pages[i] = page;
 
             if ( rc )
             {
                 if ( rc == -1 && errno == EAGAIN )
                 {
-                    set_bit(ctx->save.batch_pfns[i], ctx->save.deferred_pages);
-                    ++ctx->save.nr_deferred_pages;
+                    set_bit(i, batch->deferred);
+                    ++batch->nr_deferred;
                     types[i] = XEN_DOMCTL_PFINFO_XTAB;
                     --nr_pages;
                 }
                 else
-                    goto err;
+                    return -1;
             }
             else
-                guest_data[i] = page;
+            {
+                batch->guest_data[i] = page;
+
+                if ( ctx->save.encode_pages )
+                    encode_page_data(cache, batch->pfns[i], types[i], page,
+                                     batch->enc_buf + i * PAGE_SIZE,
+                                     batch->enc_work, &batch->encodings[i],
+                                     &batch->enc_data[i]);
+            }
 
-            rc = -1;
             ++p;
         }
     }
 
-    rec_pfns = malloc(nr_pfns * sizeof(*rec_pfns));
-    if ( !rec_pfns )
+    batch->nr_pages = nr_pages;
+
+    return 0;
+}
+
+/*
+ * Writes a prepared batch of memory as a PAGE_DATA or PAGE_DATA_ENCODED
+ * record into the stream, and merges its deferred pages into
+ * ctx->save.deferred_pages.
+ */
+static int write_batch(struct xc_sr_context *ctx,
+                       struct xc_sr_save_batch *batch)
+{
+    static const char zeroes[(1u << REC_ALIGN_ORDER) - 1] = { 0 };
+    xc_interface *xch = ctx->xch;
+    unsigned i, n, nr_pages = batch->nr_pages;
+    unsigned nr_pfns = batch->nr_pfns;
+    uint64_t *rec_pfns = batch->rec_pfns;
+    struct iovec *iov = batch->iov; int iovcnt = 0;
+    struct xc_sr_rec_page_encoding *enc;
+    struct xc_sr_rec_page_data_header hdr = { 0 };
+    struct xc_sr_record rec =
     {
-        ERROR("Unable to allocate %zu bytes of memory for page data pfn list",
-              nr_pfns * sizeof(*rec_pfns));
-        goto err;
-    }
+        .type = REC_TYPE_PAGE_DATA,
+    };
 
     hdr.count = nr_pfns;
 
     rec.length = sizeof(hdr);
     rec.length += nr_pfns * sizeof(*rec_pfns);
-    rec.length += nr_pages * PAGE_SIZE;
 
     for ( i = 0; i < nr_pfns; ++i )
-        rec_pfns[i] = ((uint64_t)(types[i]) << 32) | ctx->save.batch_pfns[i];
+        rec_pfns[i] = ((uint64_t)(batch->types[i]) << 32) | batch->pfns[i];
 
     iov[0].iov_base = &rec.type;
     iov[0].iov_len = sizeof(rec.type);
@@ -236,13 +240,55 @@ static int write_batch(struct xc_sr_context *ctx)
 
     iovcnt = 4;
 
-    if ( nr_pages )
+    if ( ctx->save.encode_pages )
     {
+        rec.type = REC_TYPE_PAGE_DATA_ENCODED;
+
+        /* iov[4] carries the descriptors, which are packed below. */
+        iovcnt = 5;
+
+        for ( i = 0, n = 0; i < nr_pfns; ++i )
+        {
+            if ( !batch->guest_data[i] )
+                continue;
+
+            enc = &batch->encodings[i];
+            if ( enc->length )
+            {
+                iov[iovcnt].iov_base = (void *)batch->enc_data[i];
+                iov[iovcnt].iov_len = enc->length;
+                iovcnt++;
+            }
+
+            rec.length += sizeof(*enc) + enc->length;
+            ctx->save.enc_pages[enc->encoding]++;
+            ctx->save.enc_octets[enc->encoding] += enc->length;
+
+            /* Descriptors are only sent for pages with data.  n <= i. */
+            batch->encodings[n++] = *enc;
+            --nr_pages;
+        }
+
+        iov[4].iov_base = batch->encodings;
+        iov[4].iov_len = n * sizeof(*batch->encodings);
+
+        if ( rec.length & ((1u << REC_ALIGN_ORDER) - 1) )
+        {
+            iov[iovcnt].iov_base = (void *)zeroes;
+            iov[iovcnt].iov_len =
+                ROUNDUP(rec.length, REC_ALIGN_ORDER) - rec.length;
+            iovcnt++;
+        }
+    }
+    else if ( nr_pages )
+    {
+        rec.length += nr_pages * PAGE_SIZE;
+
         for ( i = 0; i < nr_pfns; ++i )
         {
-            if ( guest_data[i] )
+            if ( batch->guest_data[i] )
             {
-                iov[iovcnt].iov_base = guest_data[i];
+                iov[iovcnt].iov_base = batch->guest_data[i];
                 iov[iovcnt].iov_len = PAGE_SIZE;
                 iovcnt++;
                 --nr_pages;
@@ -253,67 +299,336 @@ static int write_batch(struct xc_sr_context *ctx)
     if ( writev_exact(ctx->fd, iov, iovcnt) )
     {
         PERROR("Failed to write page data to stream");
-        goto err;
+        return -1;
     }
 
     /* Sanity check we have sent all the pages we expected to. */
     assert(nr_pages == 0);
-    rc = ctx->save.nr_batch_pfns = 0;
 
- err:
-    free(rec_pfns);
-    if ( guest_mapping )
-        xenforeignmemory_unmap(xch->fmem, guest_mapping, nr_pages_mapped);
-    for ( i = 0; local_pages && i < nr_pfns; ++i )
-        free(local_pages[i]);
-    free(iov);
-    free(local_pages);
-    free(guest_data);
-    free(errors);
-    free(types);
-    free(mfns);
+    if ( batch->nr_deferred )
+    {
+        for ( i = 0; i < nr_pfns; ++i )
+            if ( test_bit(i, batch->deferred) )
+                set_bit(batch->pfns[i], ctx->save.deferred_pages);
+
+        ctx->save.nr_deferred_pages += batch->nr_deferred;
+    }
+
+    return 0;
+}
+
+/*
+ * Drops the guest mappings and local pages of a batch, and empties it ready
+ * for reuse.  Safe to call on a batch which was never prepared.
+ */
+static void release_batch(struct xc_sr_context *ctx,
+                          struct xc_sr_save_batch *batch)
+{
+    xc_interface *xch = ctx->xch;
+    unsigned i;
+
+    if ( batch->guest_mapping )
+        xenforeignmemory_unmap(xch->fmem, batch->guest_mapping,
+                               batch->nr_pages_mapped);
+
+    for ( i = 0; i < batch->nr_pfns; ++i )
+    {
+        free(batch->local_pages[i]);
+        batch->local_pages[i] = NULL;
+        batch->guest_data[i] = NULL;
+    }
+
+    if ( batch->nr_deferred )
+        bitmap_clear(batch->deferred, MAX_BATCH_SIZE);
+
+    batch->guest_mapping = NULL;
+    batch->nr_pfns = batch->nr_pages = batch->nr_pages_mapped = 0;
+    batch->nr_deferred = 0;
+
+    VALGRIND_MAKE_MEM_UNDEFINED(batch->pfns,
+                                MAX_BATCH_SIZE * sizeof(*batch->pfns));
+}
+
+static int alloc_batch(struct xc_sr_context *ctx,
+                       struct xc_sr_save_batch *batch)
+{
+    batch->pfns = malloc(MAX_BATCH_SIZE * sizeof(*batch->pfns));
+    batch->mfns = malloc(MAX_BATCH_SIZE * sizeof(*batch->mfns));
+    batch->types = malloc(MAX_BATCH_SIZE * sizeof(*batch->types));
+    batch->errors = malloc(MAX_BATCH_SIZE * sizeof(*batch->errors));
+    batch->guest_data = calloc(MAX_BATCH_SIZE, sizeof(*batch->guest_data));
+    batch->local_pages = calloc(MAX_BATCH_SIZE, sizeof(*batch->local_pages));
+    batch->deferred = bitmap_alloc(MAX_BATCH_SIZE);
+    batch->rec_pfns = malloc(MAX_BATCH_SIZE * sizeof(*batch->rec_pfns));
+    /* Header, pfns and pages, plus descriptors and padding if encoding. */
+    batch->iov = malloc((MAX_BATCH_SIZE + 6) * sizeof(*batch->iov));
+
+    if ( !batch->pfns || !batch->mfns || !batch->types || !batch->errors ||
+         !batch->guest_data || !batch->local_pages || !batch->deferred ||
+         !batch->rec_pfns || !batch->iov )
+        return -1;
+
+    if ( !ctx->save.encode_pages )
+        return 0;
+
+    batch->encodings = malloc(MAX_BATCH_SIZE * sizeof(*batch->encodings));
+    batch->enc_data = malloc(MAX_BATCH_SIZE * sizeof(*batch->enc_data));
+    batch->enc_buf = malloc(MAX_BATCH_SIZE * PAGE_SIZE);
+    batch->enc_work = malloc(PAGE_ENCODE_WORK_SIZE);
+
+    if ( !batch->encodings || !batch->enc_data || !batch->enc_buf ||
+         !batch->enc_work )
+        return -1;
+
+    return 0;
+}
+
+static void free_batch(struct xc_sr_save_batch *batch)
+{
+    free(batch->enc_work);
+    free(batch->enc_buf);
+    free(batch->enc_data);
+    free(batch->encodings);
+    free(batch->iov);
+    free(batch->rec_pfns);
+    free(batch->deferred);
+    free(batch->local_pages);
+    free(batch->guest_data);
+    free(batch->errors);
+    free(batch->types);
+    free(batch->mfns);
+    free(batch->pfns);
+}
+
+/*
+ * Pipeline worker.  Takes submitted batches in order and maps and normalises
+ * them.  Writing them into the stream is left to the main thread, which
+ * retires batches strictly in submission order.
+ */
+static void *save_worker(void *arg)
+{
+    struct xc_sr_context *ctx = arg;
+    struct xc_sr_save_pipeline *pl = &ctx->save.pipeline;
+    struct xc_sr_save_batch *batch;
+    int rc, err;
+
+    pthread_mutex_lock(&pl->lock);
+
+    for ( ; ; )
+    {
+        while ( pl->dispatched == pl->submitted && !pl->exit )
+            pthread_cond_wait(&pl->work_cond, &pl->lock);
+
+        if ( pl->exit )
+            break;
+
+        batch = &pl->batches[pl->dispatched++ % pl->nr_batches];
+        pthread_mutex_unlock(&pl->lock);
+
+        rc = prepare_batch(ctx, batch);
+        err = errno;
+
+        pthread_mutex_lock(&pl->lock);
+        batch->rc = rc;
+        batch->err = err;
+        batch->done = true;
+        pthread_cond_broadcast(&pl->done_cond);
+    }
+
+    pthread_mutex_unlock(&pl->lock);
+
+    return NULL;
+}
+
+/*
+ * Waits for the oldest outstanding batch to be prepared, then writes it into
+ * the stream and releases it.
+ */
+static int retire_batch(struct xc_sr_context *ctx)
+{
+    struct xc_sr_save_pipeline *pl = &ctx->save.pipeline;
+    struct xc_sr_save_batch *batch;
+    int rc;
+
+    assert(pl->retired != pl->submitted);
+    batch = &pl->batches[pl->retired % pl->nr_batches];
+
+    pthread_mutex_lock(&pl->lock);
+    while ( !batch->done )
+        pthread_cond_wait(&pl->done_cond, &pl->lock);
+    pthread_mutex_unlock(&pl->lock);
+
+    ++pl->retired;
+
+    rc = batch->rc;
+    if ( rc )
+        errno = batch->err;
+    else
+        rc = write_batch(ctx, batch);
+
+    release_batch(ctx, batch);
 
     return rc;
 }
 
 /*
- * Flush a batch of pfns into the stream.
+ * Hands the current batch over for sending.  Without workers, the batch is
+ * sent synchronously.  Otherwise it is queued for the workers, and the main
+ * thread moves onto the next free batch in the ring, retiring the oldest if
+ * the ring is full.
  */
-static int flush_batch(struct xc_sr_context *ctx)
+static int submit_batch(struct xc_sr_context *ctx)
 {
+    struct xc_sr_save_pipeline *pl = &ctx->save.pipeline;
+    struct xc_sr_save_batch *batch = ctx->save.batch;
     int rc = 0;
 
-    if ( ctx->save.nr_batch_pfns == 0 )
+    if ( !pl->nr_workers )
+    {
+        rc = prepare_batch(ctx, batch);
+        if ( !rc )
+            rc = write_batch(ctx, batch);
+        release_batch(ctx, batch);
+
         return rc;
+    }
 
-    rc = write_batch(ctx);
+    pthread_mutex_lock(&pl->lock);
+    batch->done = false;
+    ++pl->submitted;
+    pthread_cond_signal(&pl->work_cond);
+    pthread_mutex_unlock(&pl->lock);
 
-    if ( !rc )
-    {
-        VALGRIND_MAKE_MEM_UNDEFINED(ctx->save.batch_pfns,
-                                    MAX_BATCH_SIZE *
-                                    sizeof(*ctx->save.batch_pfns));
-    }
+    if ( pl->submitted - pl->retired == pl->nr_batches )
+        rc = retire_batch(ctx);
+
+    ctx->save.batch = &pl->batches[pl->submitted % pl->nr_batches];
+
+    return rc;
+}
+
+/*
+ * Flush a batch of pfns into the stream, waiting for all outstanding batches
+ * to be written.
+ */
+static int flush_batch(struct xc_sr_context *ctx)
+{
+    struct xc_sr_save_pipeline *pl = &ctx->save.pipeline;
+    int rc = 0;
+
+    if ( ctx->save.batch->nr_pfns )
+        rc = submit_batch(ctx);
+
+    while ( !rc && pl->retired != pl->submitted )
+        rc = retire_batch(ctx);
 
     return rc;
 }
 
 /*
- * Add a single pfn to the batch, flushing the batch if full.
+ * Add a single pfn to the batch, submitting the batch if full.
  */
 static int add_to_batch(struct xc_sr_context *ctx, xen_pfn_t pfn)
 {
     int rc = 0;
 
-    if ( ctx->save.nr_batch_pfns == MAX_BATCH_SIZE )
-        rc = flush_batch(ctx);
+    if ( ctx->save.batch->nr_pfns == MAX_BATCH_SIZE )
+        rc = submit_batch(ctx);
 
     if ( rc == 0 )
-        ctx->save.batch_pfns[ctx->save.nr_batch_pfns++] = pfn;
+        ctx->save.batch->pfns[ctx->save.batch->nr_pfns++] = pfn;
 
     return rc;
 }
 
+/*
+ * Allocates the batches, and starts the pipeline workers if requested.
+ */
+static int setup_pipeline(struct xc_sr_context *ctx)
+{
+    xc_interface *xch = ctx->xch;
+    struct xc_sr_save_pipeline *pl = &ctx->save.pipeline;
+    unsigned int i;
+    int rc;
+
+    /* Two batches per worker keeps every worker busy while one is written. */
+    pl->nr_batches = pl->nr_workers ? 2 * pl->nr_workers : 1;
+    pl->batches = calloc(pl->nr_batches, sizeof(*pl->batches));
+    if ( !pl->batches )
+        goto enomem;
+
+    for ( i = 0; i < pl->nr_batches; ++i )
+        if ( alloc_batch(ctx, &pl->batches[i]) )
+            goto enomem;
+
+    ctx->save.batch = &pl->batches[0];
+
+    if ( !pl->nr_workers )
+        return 0;
+
+    pl->workers = calloc(pl->nr_workers, sizeof(*pl->workers));
+    if ( !pl->workers )
+        goto enomem;
+
+    pthread_mutex_init(&pl->lock, NULL);
+    pthread_cond_init(&pl->work_cond, NULL);
+    pthread_cond_init(&pl->done_cond, NULL);
+
+    for ( i = 0; i < pl->nr_workers; ++i )
+    {
+        rc = pthread_create(&pl->workers[i], NULL, save_worker, ctx);
+        if ( rc )
+        {
+            errno = rc;
+            PERROR("Unable to start save worker %u", i);
+            return -1;
+        }
+        ++pl->nr_workers_started;
+    }
+
+    DPRINTF("Using %u save workers", pl->nr_workers);
+
+    return 0;
+
+ enomem:
+    ERROR("Unable to allocate memory for %u page batches", pl->nr_batches);
+    errno = ENOMEM;
+    return -1;
+}
+
+/*
+ * Stops the pipeline workers and releases all batches.  Batches still in
+ * flight (after an error) are dropped without being written.
+ */
+static void cleanup_pipeline(struct xc_sr_context *ctx)
+{
+    struct xc_sr_save_pipeline *pl = &ctx->save.pipeline;
+    unsigned int i;
+
+    if ( pl->workers )
+    {
+        pthread_mutex_lock(&pl->lock);
+        pl->exit = true;
+        pthread_cond_broadcast(&pl->work_cond);
+        pthread_mutex_unlock(&pl->lock);
+
+        for ( i = 0; i < pl->nr_workers_started; ++i )
+            pthread_join(pl->workers[i], NULL);
+
+        pthread_cond_destroy(&pl->done_cond);
+        pthread_cond_destroy(&pl->work_cond);
+        pthread_mutex_destroy(&pl->lock);
+        free(pl->workers);
+    }
+
+    for ( i = 0; pl->batches && i < pl->nr_batches; ++i )
+    {
+        release_batch(ctx, &pl->batches[i]);
+        free_batch(&pl->batches[i]);
+    }
+    free(pl->batches);
+}
+
 /*
  * Pause/suspend the domain, and refresh ctx->dominfo if required.
  */
@@ -412,6 +727,169 @@ static int send_all_pages(struct xc_sr_context *ctx)
     return send_dirty_pages(ctx, ctx->save.p2m_size);
 }
 
+/* Number of ranges retrieved from Xen per hypercall. */
+#define DIRTY_RANGES_BATCH 1024
+
+/*
+ * Retrieve, and clean, the pages dirtied since the last call as a list of
+ * ranges in ctx->save.dirty_ranges.  The cost is proportional to the number
+ * of dirty pages rather than to p2m_size.
+ */
+static int get_dirty_ranges(struct xc_sr_context *ctx, uint32_t mode,
+                            unsigned long *dirty_count)
+{
+    xc_interface *xch = ctx->xch;
+    xc_dirty_range_t *new_ranges;
+    uint64_t cursor = 0;
+    unsigned long count = 0, max;
+    unsigned int i, nr;
+    DECLARE_HYPERCALL_BUFFER_SHADOW(xc_dirty_range_t, ranges,
+                                    &ctx->save.dirty_ranges_hbuf);
+
+    ctx->save.nr_dirty_ranges = 0;
+
+    while ( cursor < ctx->save.p2m_size )
+    {
+        nr = DIRTY_RANGES_BATCH;
+        if ( xc_shadow_dirty_ranges(xch, ctx->domid,
+                                    XEN_DOMCTL_SHADOW_OP_CLEAN_RANGES,
+                                    HYPERCALL_BUFFER(ranges), &nr, &cursor,
+                                    ctx->save.p2m_size, mode, NULL) )
+        {
+            PERROR("Failed to retrieve logdirty ranges");
+            return -1;
+        }
+
+        if ( ctx->save.nr_dirty_ranges + nr > ctx->save.max_dirty_ranges )
+        {
+            max = ctx->save.max_dirty_ranges * 2 ?: DIRTY_RANGES_BATCH;
+            while ( max < ctx->save.nr_dirty_ranges + nr )
+                max *= 2;
+
+            new_ranges = realloc(ctx->save.dirty_ranges,
+                                 max * sizeof(*new_ranges));
+            if ( !new_ranges )
+            {
+                ERROR("Unable to allocate memory for %lu dirty ranges", max);
+                return -1;
+            }
+
+            ctx->save.dirty_ranges = new_ranges;
+            ctx->save.max_dirty_ranges = max;
+        }
+
+        for ( i = 0; i < nr; ++i )
+        {
+            if ( ranges[i].pfn + ranges[i].nr > ctx->save.p2m_size )
+            {
+                ERROR("Dirty range %#"PRIx64"+%#"PRIx64" beyond p2m_size",
+                      ranges[i].pfn, ranges[i].nr);
+                return -1;
+            }
+
+            ctx->save.dirty_ranges[ctx->save.nr_dirty_ranges++] = ranges[i];
+            count += ranges[i].nr;
+        }
+    }
+
+    *dirty_count = count;
+
+    return 0;
+}
+
+/*
+ * Send the pages in ctx->save.dirty_ranges.  Equivalent to send_dirty_pages()
+ * for a bitmap holding the same pages, without scanning the clean ones.
+ */
+static int send_dirty_ranges(struct xc_sr_context *ctx,
+                             unsigned long entries)
+{
+    xc_interface *xch = ctx->xch;
+    const xc_dirty_range_t *r;
+    xen_pfn_t p;
+    unsigned long i, written = 0;
+    int rc;
+
+    for ( i = 0; i < ctx->save.nr_dirty_ranges; ++i )
+    {
+        r = &ctx->save.dirty_ranges[i];
+
+        for ( p = r->pfn; p < r->pfn + r->nr; ++p )
+        {
+            rc = add_to_batch(ctx, p);
+            if ( rc )
+                return rc;
+
+            /* Update progress every 4MB worth of memory sent. */
+            if ( (written & ((1U << (22 - 12)) - 1)) == 0 )
+                xc_report_progress_step(xch, written, entries);
+
+            ++written;
+        }
+    }
+
+    rc = flush_batch(ctx);
+    if ( rc )
+        return rc;
+
+    xc_report_progress_step(xch, entries, entries);
+
+    return ctx->save.ops.check_vm_state(ctx);
+}
+
+/* Set the bits in 'bitmap' for the pages in ctx->save.dirty_ranges. */
+static void dirty_ranges_to_bitmap(struct xc_sr_context *ctx,
+                                   unsigned long *bitmap)
+{
+    const xc_dirty_range_t *r;
+    xen_pfn_t p;
+    unsigned long i;
+
+    for ( i = 0; i < ctx->save.nr_dirty_ranges; ++i )
+    {
+        r = &ctx->save.dirty_ranges[i];
+
+        for ( p = r->pfn; p < r->pfn + r->nr; ++p )
+            set_bit(p, bitmap);
+    }
+}
+
+/*
+ * Retrieve, and clean, the pages dirtied since the last call into the dirty
+ * bitmap, for the rounds which run with the domain suspended.
+ */
+static int get_dirty_bitmap(struct xc_sr_context *ctx, uint32_t mode,
+                            xc_shadow_op_stats_t *stats)
+{
+    xc_interface *xch = ctx->xch;
+    unsigned long count;
+    DECLARE_HYPERCALL_BUFFER_SHADOW(unsigned long, dirty_bitmap,
+                                    &ctx->save.dirty_bitmap_hbuf);
+
+    if ( ctx->save.use_dirty_ranges )
+    {
+        if ( get_dirty_ranges(ctx, mode, &count) )
+            return -1;
+
+        bitmap_clear(dirty_bitmap, ctx->save.p2m_size);
+        dirty_ranges_to_bitmap(ctx, dirty_bitmap);
+        stats->dirty_count = count;
+
+        return 0;
+    }
+
+    if ( xc_shadow_control(
+             xch, ctx->domid, XEN_DOMCTL_SHADOW_OP_CLEAN,
+             HYPERCALL_BUFFER(dirty_bitmap), ctx->save.p2m_size,
+             NULL, mode, stats) != ctx->save.p2m_size )
+    {
+        PERROR("Failed to retrieve logdirty bitmap");
+        return -1;
+    }
+
+    return 0;
+}
+
 static int enable_logdirty(struct xc_sr_context *ctx)
 {
     xc_interface *xch = ctx->xch;
@@ -443,6 +921,23 @@ static int enable_logdirty(struct xc_sr_context *ctx)
         }
     }
 
+    /*
+     * Probe for the ranged interface with an empty request.  Shadow mode
+     * guests, and older hypervisors, only offer the bitmap.
+     */
+    {
+        uint64_t cursor = 0;
+        unsigned int nr = 0;
+
+        ctx->save.use_dirty_ranges =
+            !xc_shadow_dirty_ranges(xch, ctx->domid,
+                                    XEN_DOMCTL_SHADOW_OP_CLEAN_RANGES,
+                                    NULL, &nr, &cursor, 0, 0, NULL);
+        if ( !ctx->save.use_dirty_ranges )
+            DPRINTF("Logdirty ranges unavailable (%d), using the bitmap",
+                    errno);
+    }
+
     return 0;
 }
 
@@ -487,6 +982,245 @@ static int simple_precopy_policy(struct precopy_stats stats, void *user)
         : XGS_POLICY_CONTINUE_PRECOPY;
 }
 
+/*
+ * The default policy when post-copy is permitted.  A small dirty set is
+ * still worth a short stop-and-copy, but otherwise there is no point waiting
+ * for convergence: after SPP_POSTCOPY_ITERATIONS rounds the guest moves, and
+ * whatever is still dirty follows it.
+ */
+#define SPP_POSTCOPY_ITERATIONS 2
+
+static int postcopy_precopy_policy(struct precopy_stats stats, void *user)
+{
+    if ( stats.dirty_count >= 0 &&
+         stats.dirty_count < SPP_TARGET_DIRTY_COUNT )
+        return XGS_POLICY_STOP_AND_COPY;
+
+    return stats.iteration >= SPP_POSTCOPY_ITERATIONS
+        ? XGS_POLICY_POSTCOPY
+        : XGS_POLICY_CONTINUE_PRECOPY;
+}
+
+/*
+ * The auto-converge policy.  Rather than giving up after a fixed number of
+ * rounds, it works out how long sending the current dirty set would take at
+ * the rate pages went out during the last round, and stops once that fits
+ * in the downtime target.  Until then, each round, the vCPUs which dirtied
+ * at least their share of the last round's pages have their credit2 cap
+ * lowered, first to AC_INITIAL_CAP% and then by AC_CAP_STEP% at a time.
+ */
+#define AC_MAX_ITERATIONS 30
+#define AC_INITIAL_CAP    80
+#define AC_CAP_STEP       10
+#define AC_MIN_CAP        10
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Read the vCPUs' log-dirty counters.  Absent vCPUs read as 0. */
+static void get_vcpu_dirty_pages(struct xc_sr_context *ctx, uint64_t *dirty)
+{
+    xc_interface *xch = ctx->xch;
+    struct xc_sr_converge *ac = ctx->save.converge;
+    xc_vcpuinfo_t info;
+    unsigned int i;
+
+    for ( i = 0; i < ac->nr_vcpus; ++i )
+        dirty[i] = xc_vcpu_getinfo(xch, ctx->domid, i, &info)
+            ? 0 : info.dirty_pages;
+}
+
+/*
+ * Lower the caps of the vCPUs which dirtied the most pages since the last
+ * call.  Failure to throttle isn't fatal to the migration; it just won't
+ * converge as quickly.
+ */
+static void throttle_vcpus(struct xc_sr_context *ctx)
+{
+    xc_interface *xch = ctx->xch;
+    struct xc_sr_converge *ac = ctx->save.converge;
+    struct xen_domctl_schedparam_vcpu *vcpus = NULL;
+    struct xen_domctl_sched_credit2 sdom;
+    uint64_t *dirty = NULL, delta, total = 0;
+    unsigned int i, nr_dirtying = 0, nr = 0;
+    uint16_t cap;
+
+    dirty = malloc(ac->nr_vcpus * sizeof(*dirty));
+    vcpus = malloc(ac->nr_vcpus * sizeof(*vcpus));
+    if ( !dirty || !vcpus )
+    {
+        ERROR("Unable to allocate memory for throttling vCPUs");
+        goto out;
+    }
+
+    get_vcpu_dirty_pages(ctx, dirty);
+
+    for ( i = 0; i < ac->nr_vcpus; ++i )
+    {
+        delta = dirty[i] - ac->dirty_pages[i];
+        if ( delta )
+        {
+            total += delta;
+            nr_dirtying++;
+        }
+    }
+
+    for ( i = 0; nr_dirtying && i < ac->nr_vcpus; ++i )
+    {
+        delta = dirty[i] - ac->dirty_pages[i];
+        if ( !delta || delta * nr_dirtying < total )
+            continue;
+
+        cap = ac->caps[i] ? ac->caps[i] - AC_CAP_STEP : AC_INITIAL_CAP;
+        if ( cap < AC_MIN_CAP )
+            cap = AC_MIN_CAP;
+        if ( cap == ac->caps[i] )
+            continue;
+
+        DPRINTF("Throttling vCPU%u, %"PRIu64" pages dirtied, to %u%%",
+                i, delta, cap);
+
+        ac->caps[i] = cap;
+        vcpus[nr].vcpuid = i;
+        vcpus[nr].u.credit2.weight = 0;
+        vcpus[nr].u.credit2.cap = cap;
+        nr++;
+    }
+
+    memcpy(ac->dirty_pages, dirty, ac->nr_vcpus * sizeof(*dirty));
+
+    if ( !nr )
+        goto out;
+
+    /* Budget accounting, and so the vCPUs' caps, needs a domain cap. */
+    if ( !ac->throttled )
+    {
+        if ( xc_sched_credit2_domain_get(xch, ctx->domid, &sdom) )
+        {
+            PERROR("Unable to throttle vCPUs, not using credit2?");
+            ac->cant_throttle = true;
+            goto out;
+        }
+
+        ac->dom_cap = sdom.cap;
+        ac->throttled = true;
+
+        if ( !sdom.cap )
+        {
+            sdom.weight = 0;
+            sdom.cap = 100 * ac->nr_vcpus;
+            if ( xc_sched_credit2_domain_set(xch, ctx->domid, &sdom) )
+            {
+                PERROR("Unable to set a cap for d%u", ctx->domid);
+                ac->cant_throttle = true;
+                goto out;
+            }
+        }
+    }
+
+    if ( xc_sched_credit2_vcpu_set(xch, ctx->domid, vcpus, nr) )
+    {
+        PERROR("Unable to set vCPU caps for d%u", ctx->domid);
+        ac->cant_throttle = true;
+    }
+
+ out:
+    free(vcpus);
+    free(dirty);
+}
+
+/* Undo throttle_vcpus(). */
+static void unthrottle_vcpus(struct xc_sr_context *ctx)
+{
+    xc_interface *xch = ctx->xch;
+    struct xc_sr_converge *ac = ctx->save.converge;
+    struct xen_domctl_schedparam_vcpu *vcpus;
+    struct xen_domctl_sched_credit2 sdom = { .cap = 0 };
+    unsigned int i;
+
+    if ( !ac || !ac->throttled )
+        return;
+
+    vcpus = calloc(ac->nr_vcpus, sizeof(*vcpus));
+    if ( !vcpus )
+    {
+        ERROR("Unable to allocate memory to unthrottle vCPUs");
+        return;
+    }
+
+    for ( i = 0; i < ac->nr_vcpus; ++i )
+        vcpus[i].vcpuid = i;
+
+    if ( xc_sched_credit2_vcpu_set(xch, ctx->domid, vcpus, ac->nr_vcpus) )
+        PERROR("Unable to clear vCPU caps for d%u", ctx->domid);
+
+    sdom.cap = ac->dom_cap;
+    if ( xc_sched_credit2_domain_set(xch, ctx->domid, &sdom) )
+        PERROR("Unable to restore the cap of d%u", ctx->domid);
+
+    memset(ac->caps, 0, ac->nr_vcpus * sizeof(*ac->caps));
+    ac->throttled = false;
+
+    free(vcpus);
+}
+
+static int auto_converge_precopy_policy(struct precopy_stats stats,
+                                        void *user)
+{
+    struct xc_sr_context *ctx = user;
+    xc_interface *xch = ctx->xch;
+    struct xc_sr_converge *ac = ctx->save.converge;
+    uint64_t now = now_ns(), elapsed_us, sent, downtime_ms;
+
+    if ( stats.iteration >= AC_MAX_ITERATIONS )
+        return ctx->save.postcopy ? XGS_POLICY_POSTCOPY
+                                  : XGS_POLICY_STOP_AND_COPY;
+
+    /* Only act at the start of each round, with a fresh dirty count. */
+    if ( stats.dirty_count < 0 )
+        return XGS_POLICY_CONTINUE_PRECOPY;
+
+    if ( stats.iteration == 0 )
+    {
+        ac->round_start_ns = now;
+        ac->round_written = 0;
+        get_vcpu_dirty_pages(ctx, ac->dirty_pages);
+
+        return XGS_POLICY_CONTINUE_PRECOPY;
+    }
+
+    if ( stats.dirty_count < SPP_TARGET_DIRTY_COUNT )
+        return XGS_POLICY_STOP_AND_COPY;
+
+    elapsed_us = (now - ac->round_start_ns) / 1000;
+    sent = stats.total_written - ac->round_written;
+    if ( sent )
+    {
+        downtime_ms = stats.dirty_count * elapsed_us / sent / 1000;
+
+        DPRINTF("Round %u: %"PRIu64" pages in %"PRIu64"ms, %ld dirty, "
+                "projected downtime %"PRIu64"ms", stats.iteration, sent,
+                elapsed_us / 1000, stats.dirty_count, downtime_ms);
+
+        if ( downtime_ms <= ctx->save.max_downtime_ms )
+            return XGS_POLICY_STOP_AND_COPY;
+    }
+
+    if ( !ac->cant_throttle )
+        throttle_vcpus(ctx);
+
+    ac->round_start_ns = now;
+    ac->round_written = stats.total_written;
+
+    return XGS_POLICY_CONTINUE_PRECOPY;
+}
+
 /*
  * Send memory while guest is running.
  */
@@ -498,6 +1232,8 @@ static int send_memory_live(struct xc_sr_context *ctx)
     unsigned int x = 0;
     int rc;
     int policy_decision;
+    unsigned long dirty;
+    bool ranges = false;
 
     DECLARE_HYPERCALL_BUFFER_SHADOW(unsigned long, dirty_bitmap,
                                     &ctx->save.dirty_bitmap_hbuf);
@@ -515,8 +1251,14 @@ static int send_memory_live(struct xc_sr_context *ctx)
         { .dirty_count   = ctx->save.p2m_size };
     policy_stats = &ctx->save.stats;
 
-    if ( precopy_policy == NULL )
-         precopy_policy = simple_precopy_policy;
+    if ( precopy_policy == NULL && ctx->save.converge )
+    {
+        precopy_policy = auto_converge_precopy_policy;
+        data = ctx;
+    }
+    else if ( precopy_policy == NULL )
+         precopy_policy = ctx->save.postcopy ? postcopy_precopy_policy
+                                             : simple_precopy_policy;
 
     bitmap_set(dirty_bitmap, ctx->save.p2m_size);
 
@@ -525,13 +1267,25 @@ static int send_memory_live(struct xc_sr_context *ctx)
         policy_decision = precopy_policy(*policy_stats, data);
         x++;
 
+        if ( policy_decision == XGS_POLICY_POSTCOPY )
+        {
+            /* This round's dirty pages are left for post-copy. */
+            if ( ranges )
+                dirty_ranges_to_bitmap(ctx, ctx->save.deferred_pages);
+            else
+                bitmap_or(ctx->save.deferred_pages, dirty_bitmap,
+                          ctx->save.p2m_size);
+            break;
+        }
+
         if ( stats.dirty_count > 0 && policy_decision != XGS_POLICY_ABORT )
         {
             rc = update_progress_string(ctx, &progress_str);
             if ( rc )
                 goto out;
 
-            rc = send_dirty_pages(ctx, stats.dirty_count);
+            rc = ranges ? send_dirty_ranges(ctx, stats.dirty_count)
+                        : send_dirty_pages(ctx, stats.dirty_count);
             if ( rc )
                 goto out;
         }
@@ -548,18 +1302,39 @@ static int send_memory_live(struct xc_sr_context *ctx)
         if ( policy_decision != XGS_POLICY_CONTINUE_PRECOPY )
            break;
 
-        if ( xc_shadow_control(
-                 xch, ctx->domid, XEN_DOMCTL_SHADOW_OP_CLEAN,
-                 &ctx->save.dirty_bitmap_hbuf, ctx->save.p2m_size,
-                 NULL, 0, &stats) != ctx->save.p2m_size )
+        if ( ctx->save.use_dirty_ranges )
+        {
+            rc = get_dirty_ranges(ctx, 0, &dirty);
+            if ( rc )
+                goto out;
+
+            stats.dirty_count = dirty;
+            ranges = true;
+        }
+        else if ( xc_shadow_control(
+                      xch, ctx->domid, XEN_DOMCTL_SHADOW_OP_CLEAN,
+                      &ctx->save.dirty_bitmap_hbuf, ctx->save.p2m_size,
+                      NULL, 0, &stats) != ctx->save.p2m_size )
         {
             PERROR("Failed to retrieve logdirty bitmap");
             rc = -1;
             goto out;
         }
 
-        policy_stats->dirty_count = stats.dirty_count;
-
+        policy_stats->dirty_count = stats.dirty_count;
+
+    }
+
+    if ( policy_decision == XGS_POLICY_POSTCOPY )
+    {
+        if ( !ctx->save.postcopy )
+        {
+            ERROR("Precopy policy chose post-copy, which is not enabled");
+            rc = -1;
+            goto out;
+        }
+
+        ctx->save.enter_postcopy = true;
     }
 
  out:
@@ -638,16 +1413,9 @@ static int suspend_and_send_dirty(struct xc_sr_context *ctx)
     if ( rc )
         goto out;
 
-    if ( xc_shadow_control(
-             xch, ctx->domid, XEN_DOMCTL_SHADOW_OP_CLEAN,
-             HYPERCALL_BUFFER(dirty_bitmap), ctx->save.p2m_size,
-             NULL, XEN_DOMCTL_SHADOW_LOGDIRTY_FINAL, &stats) !=
-         ctx->save.p2m_size )
-    {
-        PERROR("Failed to retrieve logdirty bitmap");
-        rc = -1;
+    rc = get_dirty_bitmap(ctx, XEN_DOMCTL_SHADOW_LOGDIRTY_FINAL, &stats);
+    if ( rc )
         goto out;
-    }
 
     if ( ctx->save.live )
     {
@@ -683,6 +1451,315 @@ static int suspend_and_send_dirty(struct xc_sr_context *ctx)
     return rc;
 }
 
+/*
+ * Writes POSTCOPY_PFNS records listing the pfns in the dirty bitmap which
+ * have data.  Pfns without (ballooned out, broken, etc.) are dropped from the
+ * bitmap, leaving just those the receiver must wait for.
+ */
+static int write_postcopy_pfns(struct xc_sr_context *ctx)
+{
+    xc_interface *xch = ctx->xch;
+    xen_pfn_t *pfns = malloc(MAX_BATCH_SIZE * sizeof(*pfns)),
+        *types = malloc(MAX_BATCH_SIZE * sizeof(*types));
+    uint64_t *rec_pfns = malloc(MAX_BATCH_SIZE * sizeof(*rec_pfns));
+    struct xc_sr_record rec = { REC_TYPE_POSTCOPY_PFNS, 0, rec_pfns };
+    xen_pfn_t p = 0;
+    unsigned int i, nr_pfns, nr_rec_pfns;
+    int rc = -1;
+    DECLARE_HYPERCALL_BUFFER_SHADOW(unsigned long, dirty_bitmap,
+                                    &ctx->save.dirty_bitmap_hbuf);
+
+    if ( !pfns || !types || !rec_pfns )
+    {
+        ERROR("Unable to allocate memory for post-copy pfn list");
+        errno = ENOMEM;
+        goto err;
+    }
+
+    ctx->save.nr_postcopy_pfns = 0;
+
+    while ( p < ctx->save.p2m_size )
+    {
+        for ( nr_pfns = 0;
+              p < ctx->save.p2m_size && nr_pfns < MAX_BATCH_SIZE; ++p )
+        {
+            if ( test_bit(p, dirty_bitmap) )
+            {
+                pfns[nr_pfns] = p;
+                types[nr_pfns] = ctx->save.ops.pfn_to_gfn(ctx, p);
+                ++nr_pfns;
+            }
+        }
+
+        if ( !nr_pfns )
+            break;
+
+        rc = xc_get_pfn_type_batch(xch, ctx->domid, nr_pfns, types);
+        if ( rc )
+        {
+            PERROR("Failed to get types for post-copy pfns");
+            goto err;
+        }
+
+        for ( i = 0, nr_rec_pfns = 0; i < nr_pfns; ++i )
+        {
+            switch ( types[i] & XEN_DOMCTL_PFINFO_LTAB_MASK )
+            {
+            case XEN_DOMCTL_PFINFO_BROKEN:
+            case XEN_DOMCTL_PFINFO_XALLOC:
+            case XEN_DOMCTL_PFINFO_XTAB:
+                clear_bit(pfns[i], dirty_bitmap);
+                continue;
+            }
+
+            rec_pfns[nr_rec_pfns++] = pfns[i];
+        }
+
+        if ( !nr_rec_pfns )
+            continue;
+
+        rec.length = nr_rec_pfns * sizeof(*rec_pfns);
+        rc = write_record(ctx, &rec);
+        if ( rc )
+            goto err;
+
+        ctx->save.nr_postcopy_pfns += nr_rec_pfns;
+    }
+
+    rc = 0;
+
+ err:
+    free(rec_pfns);
+    free(types);
+    free(pfns);
+
+    return rc;
+}
+
+/*
+ * Sends the dirty pages which can't be left for post-copy: the receiver
+ * sets up the xenstore, console and ioreq pages as it restores HVM_PARAMS,
+ * and needs the vm_event rings in place, the paging ring in particular.
+ */
+static int send_postcopy_special_pfns(struct xc_sr_context *ctx)
+{
+    static const unsigned int params[] = {
+        HVM_PARAM_STORE_PFN,
+        HVM_PARAM_CONSOLE_PFN,
+        HVM_PARAM_IOREQ_PFN,
+        HVM_PARAM_BUFIOREQ_PFN,
+        HVM_PARAM_PAGING_RING_PFN,
+        HVM_PARAM_MONITOR_RING_PFN,
+        HVM_PARAM_SHARING_RING_PFN,
+    };
+
+    xc_interface *xch = ctx->xch;
+    unsigned int i;
+    uint64_t pfn;
+    int rc;
+    DECLARE_HYPERCALL_BUFFER_SHADOW(unsigned long, dirty_bitmap,
+                                    &ctx->save.dirty_bitmap_hbuf);
+
+    for ( i = 0; i < ARRAY_SIZE(params); i++ )
+    {
+        rc = xc_hvm_param_get(xch, ctx->domid, params[i], &pfn);
+        if ( rc )
+        {
+            PERROR("Failed to get HVMPARAM at index %u", params[i]);
+            return rc;
+        }
+
+        if ( !pfn || pfn >= ctx->save.p2m_size ||
+             !test_and_clear_bit(pfn, dirty_bitmap) )
+            continue;
+
+        rc = add_to_batch(ctx, pfn);
+        if ( rc )
+            return rc;
+    }
+
+    return flush_batch(ctx);
+}
+
+/*
+ * Suspend the domain and hand the remaining dirty memory over to post-copy.
+ * Only the special pages and the list of outstanding pfns are sent during
+ * downtime.  The rest of the checkpoint follows as usual, and the data
+ * itself after the POSTCOPY_TRANSITION record, by send_memory_postcopy().
+ */
+static int suspend_and_start_postcopy(struct xc_sr_context *ctx)
+{
+    xc_interface *xch = ctx->xch;
+    xc_shadow_op_stats_t stats = { 0, ctx->save.p2m_size };
+    struct xc_sr_record rec = { REC_TYPE_POSTCOPY_BEGIN, 0, NULL };
+    int rc;
+    DECLARE_HYPERCALL_BUFFER_SHADOW(unsigned long, dirty_bitmap,
+                                    &ctx->save.dirty_bitmap_hbuf);
+
+    rc = suspend_domain(ctx);
+    if ( rc )
+        return rc;
+
+    rc = get_dirty_bitmap(ctx, XEN_DOMCTL_SHADOW_LOGDIRTY_FINAL, &stats);
+    if ( rc )
+        return rc;
+
+    bitmap_or(dirty_bitmap, ctx->save.deferred_pages, ctx->save.p2m_size);
+    bitmap_clear(ctx->save.deferred_pages, ctx->save.p2m_size);
+    ctx->save.nr_deferred_pages = 0;
+
+    rc = send_postcopy_special_pfns(ctx);
+    if ( rc )
+        return rc;
+
+    /*
+     * The receiver discards its copies of the outstanding pages, so they
+     * can't be the base of a delta.
+     */
+    free_delta_cache(ctx->save.delta_cache);
+    ctx->save.delta_cache = NULL;
+
+    rc = write_record(ctx, &rec);
+    if ( rc )
+        return rc;
+
+    rc = write_postcopy_pfns(ctx);
+    if ( rc )
+        return rc;
+
+    IPRINTF("Entering post-copy with %lu pages outstanding",
+            ctx->save.nr_postcopy_pfns);
+
+    return 0;
+}
+
+/*
+ * Reads a POSTCOPY_FAULT record from the back channel, and queues whichever
+ * of the faulting pfns are still outstanding.
+ */
+static int read_postcopy_faults(struct xc_sr_context *ctx,
+                                struct xc_sr_postcopy_queue *q)
+{
+    xc_interface *xch = ctx->xch;
+    struct xc_sr_record rec = { 0, 0, NULL };
+    const uint64_t *pfns;
+    unsigned int i, count;
+    int rc;
+
+    rc = read_record(ctx, ctx->save.recv_fd, &rec);
+    if ( rc )
+        goto err;
+
+    rc = -1;
+    if ( rec.type != REC_TYPE_POSTCOPY_FAULT )
+    {
+        ERROR("Expected POSTCOPY_FAULT record, but received %s (%#x)",
+              rec_type_to_str(rec.type), rec.type);
+        goto err;
+    }
+
+    if ( rec.length % sizeof(*pfns) )
+    {
+        ERROR("Invalid POSTCOPY_FAULT record length %u", rec.length);
+        goto err;
+    }
+
+    pfns = rec.data;
+    count = rec.length / sizeof(*pfns);
+
+    for ( i = 0; i < count; ++i )
+    {
+        if ( postcopy_queue_fault(q, pfns[i]) )
+        {
+            PERROR("Failed to queue faulting pfn %#"PRIx64, pfns[i]);
+            goto err;
+        }
+    }
+
+    rc = 0;
+
+ err:
+    free(rec.data);
+
+    return rc;
+}
+
+/*
+ * Send the outstanding memory while the guest runs on the receiver.  Pages
+ * the guest has faulted on are sent as soon as the receiver asks for them;
+ * the rest are pushed in pfn order in the meantime.  Each batch is written
+ * out before the next is chosen, so a fault never waits behind more than
+ * the one batch already on its way.
+ */
+static int send_memory_postcopy(struct xc_sr_context *ctx)
+{
+    xc_interface *xch = ctx->xch;
+    struct xc_sr_record rec = { REC_TYPE_POSTCOPY_TRANSITION, 0, NULL };
+    struct pollfd pfd = { .fd = ctx->save.recv_fd, .events = POLLIN };
+    struct xc_sr_postcopy_queue q;
+    unsigned long total = ctx->save.nr_postcopy_pfns;
+    xen_pfn_t *pfns = malloc(MAX_BATCH_SIZE * sizeof(*pfns));
+    unsigned int i, n;
+    int rc;
+    DECLARE_HYPERCALL_BUFFER_SHADOW(unsigned long, dirty_bitmap,
+                                    &ctx->save.dirty_bitmap_hbuf);
+
+    postcopy_queue_init(&q, dirty_bitmap, ctx->save.p2m_size, total);
+
+    if ( !pfns )
+    {
+        ERROR("Unable to allocate memory for post-copy batch");
+        return -1;
+    }
+
+    rc = write_record(ctx, &rec);
+    if ( rc )
+        goto out;
+
+    xc_set_progress_prefix(xch, "Post-copy");
+
+    while ( q.nr_outstanding )
+    {
+        rc = poll(&pfd, 1, 0);
+        if ( rc < 0 )
+        {
+            if ( errno == EINTR )
+                continue;
+
+            PERROR("Failed to poll for post-copy faults");
+            goto out;
+        }
+
+        if ( rc > 0 )
+        {
+            rc = read_postcopy_faults(ctx, &q);
+            if ( rc )
+                goto out;
+        }
+
+        n = postcopy_queue_next(&q, pfns, MAX_BATCH_SIZE);
+        for ( i = 0; i < n; ++i )
+        {
+            rc = add_to_batch(ctx, pfns[i]);
+            if ( rc )
+                goto out;
+        }
+
+        rc = flush_batch(ctx);
+        if ( rc )
+            goto out;
+
+        xc_report_progress_step(xch, total - q.nr_outstanding, total);
+    }
+
+ out:
+    xc_set_progress_prefix(xch, NULL);
+    postcopy_queue_destroy(&q);
+    free(pfns);
+
+    return rc;
+}
+
 static int verify_frames(struct xc_sr_context *ctx)
 {
     xc_interface *xch = ctx->xch;
@@ -701,7 +1778,9 @@ static int verify_frames(struct xc_sr_context *ctx)
         goto out;
 
     xc_set_progress_prefix(xch, "Frames verify");
+    ctx->save.verifying = true;
     rc = send_all_pages(ctx);
+    ctx->save.verifying = false;
     if ( rc )
         goto out;
 
@@ -737,10 +1816,16 @@ static int send_domain_memory_live(struct xc_sr_context *ctx)
     if ( rc )
         goto out;
 
-    rc = suspend_and_send_dirty(ctx);
+    if ( ctx->save.enter_postcopy )
+        rc = suspend_and_start_postcopy(ctx);
+    else
+        rc = suspend_and_send_dirty(ctx);
     if ( rc )
         goto out;
 
+    /* A checkpointed stream runs the guest on from here. */
+    unthrottle_vcpus(ctx);
+
     if ( ctx->save.debug && ctx->save.checkpointed != XC_MIG_STREAM_NONE )
     {
         rc = verify_frames(ctx);
@@ -789,6 +1874,8 @@ static int setup(struct xc_sr_context *ctx)
     int rc;
     DECLARE_HYPERCALL_BUFFER_SHADOW(unsigned long, dirty_bitmap,
                                     &ctx->save.dirty_bitmap_hbuf);
+    DECLARE_HYPERCALL_BUFFER_SHADOW(xc_dirty_range_t, dirty_ranges,
+                                    &ctx->save.dirty_ranges_hbuf);
 
     rc = ctx->save.ops.setup(ctx);
     if ( rc )
@@ -796,20 +1883,58 @@ static int setup(struct xc_sr_context *ctx)
 
     dirty_bitmap = xc_hypercall_buffer_alloc_pages(
                    xch, dirty_bitmap, NRPAGES(bitmap_size(ctx->save.p2m_size)));
-    ctx->save.batch_pfns = malloc(MAX_BATCH_SIZE *
-                                  sizeof(*ctx->save.batch_pfns));
+    dirty_ranges = xc_hypercall_buffer_alloc(
+                   xch, dirty_ranges, DIRTY_RANGES_BATCH * sizeof(*dirty_ranges));
     ctx->save.deferred_pages = calloc(1, bitmap_size(ctx->save.p2m_size));
 
-    if ( !ctx->save.batch_pfns || !dirty_bitmap || !ctx->save.deferred_pages )
+    if ( !dirty_bitmap || !dirty_ranges || !ctx->save.deferred_pages )
     {
-        ERROR("Unable to allocate memory for dirty bitmaps, batch pfns and"
+        ERROR("Unable to allocate memory for dirty bitmaps and"
               " deferred pages");
         rc = -1;
         errno = ENOMEM;
         goto err;
     }
 
-    rc = 0;
+    /*
+     * A COLO secondary runs the guest between checkpoints, so its memory
+     * can't be relied upon as the base of a delta.
+     */
+    if ( ctx->save.encode_pages &&
+         ctx->save.checkpointed != XC_MIG_STREAM_COLO )
+    {
+        ctx->save.delta_cache = alloc_delta_cache(DELTA_CACHE_PAGES);
+        if ( !ctx->save.delta_cache )
+        {
+            ERROR("Unable to allocate memory for delta cache");
+            rc = -1;
+            errno = ENOMEM;
+            goto err;
+        }
+    }
+
+    if ( ctx->save.live && ctx->save.max_downtime_ms )
+    {
+        struct xc_sr_converge *ac = calloc(1, sizeof(*ac));
+
+        ctx->save.converge = ac;
+        if ( ac )
+        {
+            ac->nr_vcpus = ctx->dominfo.max_vcpu_id + 1;
+            ac->dirty_pages = calloc(ac->nr_vcpus, sizeof(*ac->dirty_pages));
+            ac->caps = calloc(ac->nr_vcpus, sizeof(*ac->caps));
+        }
+
+        if ( !ac || !ac->dirty_pages || !ac->caps )
+        {
+            ERROR("Unable to allocate memory for auto-converge");
+            rc = -1;
+            errno = ENOMEM;
+            goto err;
+        }
+    }
+
+    rc = setup_pipeline(ctx);
 
  err:
     return rc;
@@ -825,13 +1950,48 @@ static void cleanup(struct xc_sr_context *ctx)
     xc_shadow_control(xch, ctx->domid, XEN_DOMCTL_SHADOW_OP_OFF,
                       NULL, 0, NULL, 0, NULL);
 
+    cleanup_pipeline(ctx);
+    free_delta_cache(ctx->save.delta_cache);
+
+    unthrottle_vcpus(ctx);
+    if ( ctx->save.converge )
+    {
+        free(ctx->save.converge->dirty_pages);
+        free(ctx->save.converge->caps);
+        free(ctx->save.converge);
+    }
+
     if ( ctx->save.ops.cleanup(ctx) )
         PERROR("Failed to clean up");
 
     xc_hypercall_buffer_free_pages(xch, dirty_bitmap,
                                    NRPAGES(bitmap_size(ctx->save.p2m_size)));
+    xc__hypercall_buffer_free(xch, &ctx->save.dirty_ranges_hbuf);
+    free(ctx->save.dirty_ranges);
     free(ctx->save.deferred_pages);
-    free(ctx->save.batch_pfns);
+}
+
+/*
+ * Reports how well pages encoded over the whole stream.
+ */
+static void log_encode_stats(struct xc_sr_context *ctx)
+{
+    xc_interface *xch = ctx->xch;
+    uint64_t pages = 0, octets = 0;
+    unsigned int i;
+
+    for ( i = 0; i <= PAGE_ENCODING_MAX; ++i )
+    {
+        DPRINTF("  %-7s: %"PRIu64" pages, %"PRIu64" octets",
+                page_encoding_to_str(i), ctx->save.enc_pages[i],
+                ctx->save.enc_octets[i]);
+
+        pages += ctx->save.enc_pages[i];
+        octets += ctx->save.enc_octets[i];
+    }
+
+    IPRINTF("Encoded %"PRIu64" pages into %"PRIu64" octets (%"PRIu64"%%)",
+            pages, octets, pages ? (octets * 100) / (pages * PAGE_SIZE) : 0);
 }
 
 /*
@@ -890,6 +2050,13 @@ static int save(struct xc_sr_context *ctx, uint16_t guest_type)
         if ( rc )
             goto err;
 
+        if ( ctx->save.enter_postcopy )
+        {
+            rc = send_memory_postcopy(ctx);
+            if ( rc )
+                goto err;
+        }
+
         if ( ctx->save.checkpointed != XC_MIG_STREAM_NONE )
         {
             /*
@@ -939,6 +2106,9 @@ static int save(struct xc_sr_context *ctx, uint16_t guest_type)
         }
     } while ( ctx->save.checkpointed != XC_MIG_STREAM_NONE );
 
+    if ( ctx->save.encode_pages )
+        log_encode_stats(ctx);
+
     xc_report_progress_single(xch, "End of stream");
 
     rc = write_end_record(ctx);
@@ -967,7 +2137,8 @@ static int save(struct xc_sr_context *ctx, uint16_t guest_type)
 
 int xc_domain_save(xc_interface *xch, int io_fd, uint32_t dom,
                    uint32_t flags, struct save_callbacks* callbacks,
-                   int hvm, xc_migration_stream_t stream_type, int recv_fd)
+                   int hvm, xc_migration_stream_t stream_type, int recv_fd,
+                   unsigned int nr_workers, unsigned int max_downtime_ms)
 {
     struct xc_sr_context ctx =
         {
@@ -979,8 +2150,22 @@ int xc_domain_save(xc_interface *xch, int io_fd, uint32_t dom,
     ctx.save.callbacks = callbacks;
     ctx.save.live  = !!(flags & XCFLAGS_LIVE);
     ctx.save.debug = !!(flags & XCFLAGS_DEBUG);
+    ctx.save.encode_pages = !!(flags & XCFLAGS_PAGE_ENCODING);
+#ifndef XC_SR_PAGE_ENCODING
+    if ( ctx.save.encode_pages )
+    {
+        IPRINTF("PAGE_DATA_ENCODED not supported, sending PAGE_DATA");
+        ctx.save.encode_pages = false;
+    }
+#endif
+    ctx.save.postcopy = !!(flags & XCFLAGS_POSTCOPY);
+    if ( flags & XCFLAGS_AUTO_CONVERGE )
+        ctx.save.max_downtime_ms =
+            max_downtime_ms ?: XC_SAVE_DEFAULT_DOWNTIME_MS;
     ctx.save.checkpointed = stream_type;
     ctx.save.recv_fd = recv_fd;
+    ctx.save.pipeline.nr_workers =
+        min_t(unsigned int, nr_workers, XC_SAVE_MAX_WORKERS);
 
     /* If altering migration_stream update this assert too. */
     assert(stream_type == XC_MIG_STREAM_NONE ||
@@ -995,7 +2180,8 @@ int xc_domain_save(xc_interface *xch, int io_fd, uint32_t dom,
     if ( ctx.save.checkpointed == XC_MIG_STREAM_COLO )
         assert(callbacks->wait_checkpoint);
 
-    DPRINTF("fd %d, dom %u, flags %u, hvm %d", io_fd, dom, flags, hvm);
+    DPRINTF("fd %d, dom %u, flags %u, hvm %d, workers %u",
+            io_fd, dom, flags, hvm, nr_workers);
 
     if ( xc_domain_getinfo(xch, dom, 1, &ctx.dominfo) != 1 )
     {
@@ -1011,6 +2197,16 @@ int xc_domain_save(xc_interface *xch, int io_fd, uint32_t dom,
 
     ctx.domid = dom;
 
+    if ( ctx.save.postcopy &&
+         (!ctx.save.live || ctx.save.checkpointed != XC_MIG_STREAM_NONE ||
+          recv_fd < 0 || !ctx.dominfo.hvm) )
+    {
+        ERROR("Post-copy requires a live, uncheckpointed migration of an HVM"
+              " domain, with a back channel");
+        errno = EINVAL;
+        return -1;
+    }
+
     if ( ctx.dominfo.hvm )
     {
         ctx.save.ops = save_ops_x86_hvm;
@@ -76,6 +76,11 @@ struct xc_sr_rhdr
 #define REC_TYPE_VERIFY                     0x0000000dU
 #define REC_TYPE_CHECKPOINT                 0x0000000eU
 #define REC_TYPE_CHECKPOINT_DIRTY_PFN_LIST  0x0000000fU
+#define REC_TYPE_PAGE_DATA_ENCODED          0x00000010U
+#define REC_TYPE_POSTCOPY_BEGIN             0x00000011U
+#define REC_TYPE_POSTCOPY_PFNS              0x00000012U
+#define REC_TYPE_POSTCOPY_TRANSITION        0x00000013U
+#define REC_TYPE_POSTCOPY_FAULT             0x00000014U
 
 #define REC_TYPE_OPTIONAL             0x80000000U
 
@@ -90,6 +95,28 @@ struct xc_sr_rec_page_data_header
 #define PAGE_DATA_PFN_MASK  0x000fffffffffffffULL
 #define PAGE_DATA_TYPE_MASK 0xf000000000000000ULL
 
+/* PAGE_DATA_ENCODED, one per page with data, following the pfn array. */
+struct xc_sr_rec_page_encoding
+{
+    uint32_t length;
+    uint8_t encoding;
+    uint8_t _res[3];
+};
+
+#define PAGE_ENCODING_RAW     0x00U
+#define PAGE_ENCODING_ZERO    0x01U
+#define PAGE_ENCODING_PATTERN 0x02U
+#define PAGE_ENCODING_LZ4     0x03U
+#define PAGE_ENCODING_DELTA   0x04U
+#define PAGE_ENCODING_MAX     PAGE_ENCODING_DELTA
+
+/* A PAGE_ENCODING_DELTA run: skip words, then XOR the next count words. */
+struct xc_sr_page_delta_run
+{
+    uint16_t skip;
+    uint16_t count;
+};
+
 /* X86_PV_INFO */
 struct xc_sr_rec_x86_pv_info
 {
@@ -299,6 +299,15 @@
  */
 #define LIBXL_HAVE_SCHED_CREDIT2_PARAMS 1
 
+/*
+ * LIBXL_HAVE_SCHED_CREDIT2_LOCALITY indicates that the
+ * libxl_domain_sched_params structure has a 'locality' field which, for
+ * Credit2 domains, libxl_domain_sched_params_get() sets to the percentage
+ * of the domain's memory that is local to the NUMA nodes its vCPUs are
+ * running on.
+ */
+#define LIBXL_HAVE_SCHED_CREDIT2_LOCALITY 1
+
 /*
  * LIBXL_HAVE_SCHED_CREDIT_MIGR_DELAY indicates that there is a field
  * in libxl_sched_credit_params called vcpu_migr_delay_us which controls
@@ -1066,6 +1075,41 @@ void libxl_mac_copy(libxl_ctx *ctx, libxl_mac *dst, const libxl_mac *src);
  */
 #define LIBXL_HAVE_SRM_V1 1
 
+/*
+ * LIBXL_HAVE_SUSPEND_WORKERS
+ *
+ * If this is defined, then libxl_domain_suspend_with_params() exists, and
+ * libxl_domain_suspend_params has the workers field, giving the number of
+ * threads mapping guest memory ahead of the stream writer.
+ */
+#define LIBXL_HAVE_SUSPEND_WORKERS 1
+
+/*
+ * LIBXL_HAVE_SUSPEND_ENCODE_PAGES
+ *
+ * If this is defined, then the flags of libxl_domain_suspend() may carry
+ * LIBXL_SUSPEND_ENCODE_PAGES.
+ */
+#define LIBXL_HAVE_SUSPEND_ENCODE_PAGES 1
+
+/*
+ * LIBXL_HAVE_SUSPEND_AUTO_CONVERGE
+ *
+ * If this is defined, then the flags of libxl_domain_suspend() may carry
+ * LIBXL_SUSPEND_AUTO_CONVERGE, and libxl_domain_suspend_params has the
+ * max_downtime_ms field, giving its downtime target.
+ */
+#define LIBXL_HAVE_SUSPEND_AUTO_CONVERGE 1
+
+/*
+ * LIBXL_HAVE_RESTORE_WORKERS
+ *
+ * If this is defined, then libxl_domain_restore_params has the workers
+ * field, giving the number of threads copying page data into the guest.
+ * It must not be negative, and is capped at what libxc supports.
+ */
+#define LIBXL_HAVE_RESTORE_WORKERS 1
+
 /*
  * libxl_domain_build_info has the u.hvm.gfx_passthru_kind field and
  * the libxl_gfx_passthru_kind enumeration is defined.
@@ -1505,8 +1549,25 @@ int libxl_domain_suspend(libxl_ctx *ctx, uint32_t domid, int fd,
                          int flags, /* LIBXL_SUSPEND_* */
                          const libxl_asyncop_how *ao_how)
                          LIBXL_EXTERNAL_CALLERS_ONLY;
+/* As above, with the parameters in params rather than their defaults. */
+int libxl_domain_suspend_with_params(libxl_ctx *ctx, uint32_t domid, int fd,
+                                     int flags, /* LIBXL_SUSPEND_* */
+                                     const libxl_domain_suspend_params *params,
+                                     const libxl_asyncop_how *ao_how)
+                                     LIBXL_EXTERNAL_CALLERS_ONLY;
 #define LIBXL_SUSPEND_DEBUG 1
 #define LIBXL_SUSPEND_LIVE 2
+/*
+ * Send zero, repeated, compressible and re-dirtied pages in an encoded form.
+ * The receiving end must be running a libxl which understands them.
+ */
+#define LIBXL_SUSPEND_ENCODE_PAGES 4
+/*
+ * Throttle the guest's vCPUs which dirty memory fastest, until the final
+ * round of the migration is expected to take no longer than the downtime
+ * target.  Requires the domain to be running under credit2.
+ */
+#define LIBXL_SUSPEND_AUTO_CONVERGE 8
 
 /*
  * Only suspend domain, do not save its state to file, do not destroy it.
@@ -2260,6 +2321,7 @@ int libxl_sched_credit2_params_set(libxl_ctx *ctx, uint32_t poolid,
 #define LIBXL_DOMAIN_SCHED_PARAM_LATENCY_DEFAULT   -1
 #define LIBXL_DOMAIN_SCHED_PARAM_EXTRATIME_DEFAULT -1
 #define LIBXL_DOMAIN_SCHED_PARAM_BUDGET_DEFAULT    -1
+#define LIBXL_DOMAIN_SCHED_PARAM_LOCALITY_DEFAULT  -1
 
 /* Per-VCPU parameters */
 #define LIBXL_SCHED_PARAM_VCPU_INDEX_DEFAULT   -1
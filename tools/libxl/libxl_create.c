@@ -1678,6 +1678,11 @@ static int do_domain_create(libxl_ctx *ctx, libxl_domain_config *d_config,
     libxl__app_domain_create_state *cdcs;
     int rc;
 
+    if (restore_fd > -1 && params->workers < 0) {
+        rc = ERROR_INVAL;
+        goto out_err;
+    }
+
     GCNEW(cdcs);
     cdcs->dcs.ao = ao;
     cdcs->dcs.guest_config = d_config;
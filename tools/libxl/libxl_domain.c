@@ -486,12 +486,18 @@ static void domain_suspend_cb(libxl__egc *egc,
 
 }
 
-int libxl_domain_suspend(libxl_ctx *ctx, uint32_t domid, int fd, int flags,
-                         const libxl_asyncop_how *ao_how)
+static int domain_suspend(libxl_ctx *ctx, uint32_t domid, int fd, int flags,
+                          const libxl_domain_suspend_params *params,
+                          const libxl_asyncop_how *ao_how)
 {
     AO_CREATE(ctx, domid, ao_how);
     int rc;
 
+    if (params->workers < 0 || params->max_downtime_ms < 0) {
+        rc = ERROR_INVAL;
+        goto out_err;
+    }
+
     libxl_domain_type type = libxl__domain_type(gc, domid);
     if (type == LIBXL_DOMAIN_TYPE_INVALID) {
         rc = ERROR_FAIL;
@@ -509,6 +515,10 @@ int libxl_domain_suspend(libxl_ctx *ctx, uint32_t domid, int fd, int flags,
     dss->type = type;
     dss->live = flags & LIBXL_SUSPEND_LIVE;
     dss->debug = flags & LIBXL_SUSPEND_DEBUG;
+    dss->nr_workers = params->workers;
+    dss->encode_pages = flags & LIBXL_SUSPEND_ENCODE_PAGES;
+    dss->auto_converge = flags & LIBXL_SUSPEND_AUTO_CONVERGE;
+    dss->max_downtime_ms = params->max_downtime_ms;
     dss->checkpointed_stream = LIBXL_CHECKPOINTED_STREAM_NONE;
 
     rc = libxl__fd_flags_modify_save(gc, dss->fd,
@@ -523,6 +533,27 @@ int libxl_domain_suspend(libxl_ctx *ctx, uint32_t domid, int fd, int flags,
     return AO_CREATE_FAIL(rc);
 }
 
+int libxl_domain_suspend(libxl_ctx *ctx, uint32_t domid, int fd, int flags,
+                         const libxl_asyncop_how *ao_how)
+{
+    libxl_domain_suspend_params params;
+    int rc;
+
+    libxl_domain_suspend_params_init(&params);
+    rc = domain_suspend(ctx, domid, fd, flags, &params, ao_how);
+    libxl_domain_suspend_params_dispose(&params);
+
+    return rc;
+}
+
+int libxl_domain_suspend_with_params(libxl_ctx *ctx, uint32_t domid, int fd,
+                                     int flags,
+                                     const libxl_domain_suspend_params *params,
+                                     const libxl_asyncop_how *ao_how)
+{
+    return domain_suspend(ctx, domid, fd, flags, params, ao_how);
+}
+
 static void domain_suspend_empty_cb(libxl__egc *egc,
                               libxl__domain_suspend_state *dss, int rc)
 {
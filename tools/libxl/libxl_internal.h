@@ -3305,6 +3305,10 @@ struct libxl__domain_save_state {
     libxl_domain_type type;
     int live;
     int debug;
+    unsigned int nr_workers; /* 0 for a single threaded save */
+    bool encode_pages;
+    bool auto_converge;
+    unsigned int max_downtime_ms; /* 0 for the default */
     int checkpointed_stream;
     const libxl_domain_remus_info *remus;
     /* private */
@@ -63,6 +63,7 @@ void libxl__xc_domain_restore(libxl__egc *egc, libxl__domain_create_state *dcs,
         state->console_domid,
         hvm, pae,
         cbflags, dcs->restore_params.checkpointed_stream,
+        min(dcs->restore_params.workers, XC_RESTORE_MAX_WORKERS),
     };
 
     shs->ao = ao;
@@ -90,7 +91,7 @@ void libxl__xc_domain_save(libxl__egc *egc, libxl__domain_save_state *dss,
 
     const unsigned long argnums[] = {
         dss->domid, dss->xcflags, dss->hvm, cbflags,
-        dss->checkpointed_stream,
+        dss->checkpointed_stream, dss->nr_workers, dss->max_downtime_ms,
     };
 
     shs->ao = ao;
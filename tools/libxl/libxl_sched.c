@@ -415,6 +415,7 @@ static int sched_credit2_domain_get(libxl__gc *gc, uint32_t domid,
     scinfo->sched = LIBXL_SCHEDULER_CREDIT2;
     scinfo->weight = sdom.weight;
     scinfo->cap = sdom.cap;
+    scinfo->locality = sdom.locality;
 
     return 0;
 }
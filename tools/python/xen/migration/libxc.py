@@ -65,6 +65,11 @@ REC_TYPE_x86_pv_vcpu_msrs           = 0x0000000c
 REC_TYPE_verify                     = 0x0000000d
 REC_TYPE_checkpoint                 = 0x0000000e
 REC_TYPE_checkpoint_dirty_pfn_list  = 0x0000000f
+REC_TYPE_page_data_encoded          = 0x00000010
+REC_TYPE_postcopy_begin             = 0x00000011
+REC_TYPE_postcopy_pfns              = 0x00000012
+REC_TYPE_postcopy_transition        = 0x00000013
+REC_TYPE_postcopy_fault             = 0x00000014
 
 rec_type_to_str = {
     REC_TYPE_end                        : "End",
@@ -82,7 +87,12 @@ rec_type_to_str = {
     REC_TYPE_x86_pv_vcpu_msrs           : "x86 PV vcpu msrs",
     REC_TYPE_verify                     : "Verify",
     REC_TYPE_checkpoint                 : "Checkpoint",
-    REC_TYPE_checkpoint_dirty_pfn_list  : "Checkpoint dirty pfn list"
+    REC_TYPE_checkpoint_dirty_pfn_list  : "Checkpoint dirty pfn list",
+    REC_TYPE_page_data_encoded          : "Page data (encoded)",
+    REC_TYPE_postcopy_begin             : "Post-copy begin",
+    REC_TYPE_postcopy_pfns              : "Post-copy pfns",
+    REC_TYPE_postcopy_transition        : "Post-copy transition",
+    REC_TYPE_postcopy_fault             : "Post-copy fault",
 }
 
 # page_data
@@ -105,6 +115,15 @@ PAGE_DATA_TYPE_BROKEN        = (long(0xd) << PAGE_DATA_TYPE_SHIFT) # Broken
 PAGE_DATA_TYPE_XALLOC        = (long(0xe) << PAGE_DATA_TYPE_SHIFT) # Allocate-only
 PAGE_DATA_TYPE_XTAB          = (long(0xf) << PAGE_DATA_TYPE_SHIFT) # Invalid
 
+# page_data_encoded
+PAGE_ENCODING_FORMAT         = "IB3s"
+
+PAGE_ENCODING_RAW            = 0x00
+PAGE_ENCODING_ZERO           = 0x01
+PAGE_ENCODING_PATTERN        = 0x02
+PAGE_ENCODING_LZ4            = 0x03
+PAGE_ENCODING_DELTA          = 0x04
+
 # x86_pv_info
 X86_PV_INFO_FORMAT        = "BBHI"
 
@@ -242,24 +261,25 @@ class VerifyLibxc(VerifyBase):
             raise RecordError("End record with non-zero length")
 
 
-    def verify_record_page_data(self, content):
-        """ Page Data record """
+    def verify_page_data_pfns(self, content, name):
+        """ Header and pfns of a Page Data record.  Returns the size of
+        both, and the number of pages with data """
         minsz = calcsize(PAGE_DATA_FORMAT)
 
         if len(content) <= minsz:
-            raise RecordError("PAGE_DATA record must be at least %d bytes long"
-                              % (minsz, ))
+            raise RecordError("%s record must be at least %d bytes long"
+                              % (name, minsz))
 
         count, res1 = unpack(PAGE_DATA_FORMAT, content[:minsz])
 
         if res1 != 0:
-            raise StreamError("Reserved bits set in PAGE_DATA record 0x%04x"
-                              % (res1, ))
+            raise StreamError("Reserved bits set in %s record 0x%04x"
+                              % (name, res1))
 
         pfnsz = count * 8
         if (len(content) - minsz) < pfnsz:
-            raise RecordError("PAGE_DATA record must contain a pfn record for "
-                              "each count")
+            raise RecordError("%s record must contain a pfn record for "
+                              "each count" % (name, ))
 
         pfns = list(unpack("=%dQ" % (count,), content[minsz:minsz + pfnsz]))
 
@@ -279,10 +299,59 @@ class VerifyLibxc(VerifyBase):
                     <= PAGE_DATA_TYPE_L4TAB:
                 nr_pages += 1
 
+        return minsz + pfnsz, nr_pages
+
+
+    def verify_record_page_data(self, content):
+        """ Page Data record """
+
+        hdrsz, nr_pages = self.verify_page_data_pfns(content, "PAGE_DATA")
+
         pagesz = nr_pages * 4096
-        if len(content) != minsz + pfnsz + pagesz:
+        if len(content) != hdrsz + pagesz:
+            raise RecordError("Expected %u + %u, got %u"
+                              % (hdrsz, pagesz, len(content)))
+
+
+    def verify_record_page_data_encoded(self, content):
+        """ Page Data (encoded) record """
+
+        hdrsz, nr_pages = self.verify_page_data_pfns(content,
+                                                     "PAGE_DATA_ENCODED")
+
+        encsz = calcsize(PAGE_ENCODING_FORMAT)
+        if len(content) < hdrsz + nr_pages * encsz:
+            raise RecordError("PAGE_DATA_ENCODED record must contain an "
+                              "encoding for each page of data")
+
+        datasz = 0
+        for idx in range(nr_pages):
+            off = hdrsz + idx * encsz
+            length, encoding, _ = unpack(PAGE_ENCODING_FORMAT,
+                                         content[off:off + encsz])
+
+            if encoding == PAGE_ENCODING_RAW:
+                valid = length == 4096
+            elif encoding == PAGE_ENCODING_ZERO:
+                valid = length == 0
+            elif encoding == PAGE_ENCODING_PATTERN:
+                valid = length == 8
+            elif encoding in (PAGE_ENCODING_LZ4, PAGE_ENCODING_DELTA):
+                valid = 0 < length <= 4096
+            else:
+                raise RecordError("Unknown encoding %d for page %d"
+                                  % (encoding, idx))
+
+            if not valid:
+                raise RecordError("Invalid length %u for encoding %d of "
+                                  "page %d" % (length, encoding, idx))
+
+            datasz += length
+
+        encsz *= nr_pages
+        if len(content) != hdrsz + encsz + datasz:
             raise RecordError("Expected %u + %u + %u, got %u"
-                              % (minsz, pfnsz, pagesz, len(content)))
+                              % (hdrsz, encsz, datasz, len(content)))
 
 
     def verify_record_x86_pv_info(self, content):
@@ -424,6 +493,30 @@ class VerifyLibxc(VerifyBase):
         """ checkpoint dirty pfn list """
         raise RecordError("Found checkpoint dirty pfn list record in stream")
 
+    def verify_record_postcopy_begin(self, content):
+        """ post-copy begin record """
+
+        if len(content) != 0:
+            raise RecordError("Post-copy begin record with non-zero length")
+
+    def verify_record_postcopy_pfns(self, content):
+        """ post-copy pfns record """
+
+        if len(content) % 8 != 0:
+            raise RecordError("Length expected to be a multiple of 8, not %d"
+                              % (len(content), ))
+
+    def verify_record_postcopy_transition(self, content):
+        """ post-copy transition record """
+
+        if len(content) != 0:
+            raise RecordError("Post-copy transition record with non-zero "
+                              "length")
+
+    def verify_record_postcopy_fault(self, content):
+        """ post-copy fault record """
+        raise RecordError("Found post-copy fault record in stream")
+
 
 record_verifiers = {
     REC_TYPE_end:
@@ -466,4 +559,14 @@ record_verifiers = {
         VerifyLibxc.verify_record_checkpoint,
     REC_TYPE_checkpoint_dirty_pfn_list:
         VerifyLibxc.verify_record_checkpoint_dirty_pfn_list,
+    REC_TYPE_page_data_encoded:
+        VerifyLibxc.verify_record_page_data_encoded,
+    REC_TYPE_postcopy_begin:
+        VerifyLibxc.verify_record_postcopy_begin,
+    REC_TYPE_postcopy_pfns:
+        VerifyLibxc.verify_record_postcopy_pfns,
+    REC_TYPE_postcopy_transition:
+        VerifyLibxc.verify_record_postcopy_transition,
+    REC_TYPE_postcopy_fault:
+        VerifyLibxc.verify_record_postcopy_fault,
     }
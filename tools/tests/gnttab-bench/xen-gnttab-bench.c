@@ -0,0 +1,260 @@
+/*
+ * xen-gnttab-bench: measure grant map/unmap throughput.
+ *
+ * Each thread shares a batch of pages with the local domain through
+ * gntalloc, then maps and unmaps them through gntdev in a loop, as a
+ * netback/blkback queue would.  Every map and unmap is a GNTTABOP hypercall
+ * on the local domain's maptrack, so running several threads exercises the
+ * maptrack allocator from several vCPUs at once.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ */
+
+#include <err.h>
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include <xengnttab.h>
+#include <xenstore.h>
+
+#define NSEC_PER_SEC ((uint64_t)1000000000)
+
+static unsigned int nr_threads = 1;
+static unsigned int batch = 1;
+static unsigned int seconds = 5;
+static uint32_t domid;
+
+static volatile bool stop;
+
+struct bench_thread {
+    pthread_t thread;
+    uint64_t ops;
+    int err;
+};
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "Map and unmap locally granted pages in a loop and report the\n"
+            "number of map+unmap pairs per second for each thread.\n"
+            "Options:\n"
+            "  -t, --threads=N   number of threads (default 1)\n"
+            "  -b, --batch=N     grant refs mapped per call (default 1)\n"
+            "  -s, --seconds=N   duration of the run (default 5)\n"
+            "  -d, --domid=N     local domain ID (default: from xenstore)\n",
+            prog);
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static void *bench_thread_fn(void *arg)
+{
+    struct bench_thread *bt = arg;
+    xengntshr_handle *xgs;
+    xengnttab_handle *xgt;
+    uint32_t *refs;
+    void *shared = NULL;
+
+    refs = calloc(batch, sizeof(*refs));
+    xgs = xengntshr_open(NULL, 0);
+    xgt = xengnttab_open(NULL, 0);
+    if ( !refs || !xgs || !xgt )
+    {
+        bt->err = errno ?: ENOMEM;
+        goto out;
+    }
+
+    if ( xengnttab_set_max_grants(xgt, batch) )
+    {
+        bt->err = errno;
+        goto out;
+    }
+
+    shared = xengntshr_share_pages(xgs, domid, batch, refs, 1);
+    if ( !shared )
+    {
+        bt->err = errno;
+        goto out;
+    }
+
+    while ( !stop )
+    {
+        void *map = xengnttab_map_domain_grant_refs(xgt, batch, domid, refs,
+                                                    PROT_READ | PROT_WRITE);
+
+        if ( !map )
+        {
+            bt->err = errno;
+            break;
+        }
+
+        if ( xengnttab_unmap(xgt, map, batch) )
+        {
+            bt->err = errno;
+            break;
+        }
+
+        bt->ops += batch;
+    }
+
+ out:
+    if ( shared )
+        xengntshr_unshare(xgs, shared, batch);
+    if ( xgt )
+        xengnttab_close(xgt);
+    if ( xgs )
+        xengntshr_close(xgs);
+    free(refs);
+
+    return NULL;
+}
+
+static uint32_t local_domid(void)
+{
+    struct xs_handle *xsh = xs_open(XS_OPEN_READONLY);
+    unsigned int len;
+    char *val;
+    uint32_t id;
+
+    if ( !xsh )
+        err(1, "xs_open");
+
+    val = xs_read(xsh, XBT_NULL, "domid", &len);
+    if ( !val )
+        err(1, "unable to read domid from xenstore; use --domid");
+
+    id = strtoul(val, NULL, 10);
+
+    free(val);
+    xs_close(xsh);
+
+    return id;
+}
+
+int main(int argc, char **argv)
+{
+    static const struct option opts[] = {
+        { "threads", required_argument, NULL, 't' },
+        { "batch",   required_argument, NULL, 'b' },
+        { "seconds", required_argument, NULL, 's' },
+        { "domid",   required_argument, NULL, 'd' },
+        { "help",    no_argument,       NULL, 'h' },
+        { NULL },
+    };
+    struct bench_thread *threads;
+    bool have_domid = false;
+    uint64_t start, elapsed, total = 0;
+    unsigned int i;
+    int c, rc = 0;
+
+    while ( (c = getopt_long(argc, argv, "t:b:s:d:h", opts, NULL)) != -1 )
+    {
+        switch ( c )
+        {
+        case 't':
+            nr_threads = strtoul(optarg, NULL, 0);
+            break;
+        case 'b':
+            batch = strtoul(optarg, NULL, 0);
+            break;
+        case 's':
+            seconds = strtoul(optarg, NULL, 0);
+            break;
+        case 'd':
+            domid = strtoul(optarg, NULL, 0);
+            have_domid = true;
+            break;
+        case 'h':
+            usage(argv[0]);
+            return 0;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if ( !nr_threads || !batch || !seconds )
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if ( !have_domid )
+        domid = local_domid();
+
+    threads = calloc(nr_threads, sizeof(*threads));
+    if ( !threads )
+        err(1, "calloc");
+
+    start = now_ns();
+
+    for ( i = 0; i < nr_threads; i++ )
+    {
+        errno = pthread_create(&threads[i].thread, NULL, bench_thread_fn,
+                               &threads[i]);
+        if ( errno )
+            err(1, "pthread_create");
+    }
+
+    sleep(seconds);
+    stop = true;
+
+    for ( i = 0; i < nr_threads; i++ )
+        pthread_join(threads[i].thread, NULL);
+
+    elapsed = now_ns() - start;
+
+    for ( i = 0; i < nr_threads; i++ )
+    {
+        struct bench_thread *bt = &threads[i];
+
+        if ( bt->err )
+        {
+            fprintf(stderr, "thread %u: %s\n", i, strerror(bt->err));
+            rc = 1;
+        }
+
+        printf("thread %u: %" PRIu64 " map+unmap, %" PRIu64 "/s\n",
+               i, bt->ops, bt->ops * NSEC_PER_SEC / elapsed);
+        total += bt->ops;
+    }
+
+    printf("total: %" PRIu64 " map+unmap, %" PRIu64 "/s "
+           "(%u thread(s), batch %u, %u.%03"PRIu64"s)\n",
+           total, total * NSEC_PER_SEC / elapsed, nr_threads, batch,
+           (unsigned int)(elapsed / NSEC_PER_SEC),
+           elapsed % NSEC_PER_SEC / 1000000);
+
+    free(threads);
+
+    return rc;
+}
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
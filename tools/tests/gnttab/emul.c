@@ -0,0 +1,186 @@
+/*
+ * Fake gntdev driver for the libxengnttab unit tests.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdarg.h>
+
+#include "emul.h"
+
+unsigned int nr_map_calls, nr_mapped;
+bool fail_map;
+
+pthread_mutex_t copy_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t copy_cond = PTHREAD_COND_INITIALIZER;
+bool copy_gate_closed;
+unsigned int nr_copy_waiting, nr_copy_calls, nr_copy_segs;
+bool fail_copy;
+
+int osdep_gnttab_open(xengnttab_handle *xgt)
+{
+    xgt->fd = 0;
+    return 0;
+}
+
+int osdep_gnttab_close(xengnttab_handle *xgt)
+{
+    return 0;
+}
+
+int osdep_gnttab_set_max_grants(xengnttab_handle *xgt, uint32_t count)
+{
+    return 0;
+}
+
+void *osdep_gnttab_grant_map(xengnttab_handle *xgt,
+                             uint32_t count, int flags, int prot,
+                             uint32_t *domids, uint32_t *refs,
+                             uint32_t notify_offset,
+                             evtchn_port_t notify_port)
+{
+    char *addr;
+    uint32_t i;
+
+    nr_map_calls++;
+
+    if ( fail_map )
+    {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    addr = aligned_alloc(PAGE_SIZE, count * PAGE_SIZE);
+    CHECK(addr, "out of memory");
+
+    for ( i = 0; i < count; i++ )
+    {
+        struct tag *t = (struct tag *)(addr + i * PAGE_SIZE);
+
+        t->domid = domids[flags & XENGNTTAB_GRANT_MAP_SINGLE_DOMAIN ? 0 : i];
+        t->ref = refs[i];
+    }
+
+    nr_mapped += count;
+
+    return addr;
+}
+
+int osdep_gnttab_unmap(xengnttab_handle *xgt,
+                       void *start_address,
+                       uint32_t count)
+{
+    CHECK(nr_mapped >= count, "unmapping %u of %u pages", count, nr_mapped);
+    nr_mapped -= count;
+    free(start_address);
+
+    return 0;
+}
+
+int osdep_gnttab_grant_copy(xengnttab_handle *xgt,
+                            uint32_t count,
+                            xengnttab_grant_copy_segment_t *segs)
+{
+    uint32_t i;
+
+    pthread_mutex_lock(&copy_lock);
+
+    nr_copy_waiting++;
+    pthread_cond_broadcast(&copy_cond);
+    while ( copy_gate_closed )
+        pthread_cond_wait(&copy_cond, &copy_lock);
+    nr_copy_waiting--;
+
+    nr_copy_calls++;
+    nr_copy_segs += count;
+
+    for ( i = 0; i < count; i++ )
+        segs[i].status = segs[i].source.foreign.ref == BAD_REF ?
+                         GNTST_bad_gntref : GNTST_okay;
+
+    pthread_mutex_unlock(&copy_lock);
+
+    if ( fail_copy )
+    {
+        errno = EIO;
+        return -1;
+    }
+
+    return 0;
+}
+
+int osdep_gnttab_dmabuf_exp_from_refs(xengnttab_handle *xgt, uint32_t domid,
+                                      uint32_t flags, uint32_t count,
+                                      const uint32_t *refs, uint32_t *fd)
+{
+    abort();
+}
+
+int osdep_gnttab_dmabuf_exp_wait_released(xengnttab_handle *xgt,
+                                          uint32_t fd, uint32_t wait_to_ms)
+{
+    abort();
+}
+
+int osdep_gnttab_dmabuf_imp_to_refs(xengnttab_handle *xgt, uint32_t domid,
+                                    uint32_t fd, uint32_t count,
+                                    uint32_t *refs)
+{
+    abort();
+}
+
+int osdep_gnttab_dmabuf_imp_release(xengnttab_handle *xgt, uint32_t fd)
+{
+    abort();
+}
+
+/* Enough of libxentoolcore and libxentoollog for xengnttab_open(). */
+
+void xentoolcore__register_active_handle(Xentoolcore__Active_Handle *ah)
+{
+}
+
+void xentoolcore__deregister_active_handle(Xentoolcore__Active_Handle *ah)
+{
+}
+
+int xentoolcore__restrict_by_dup2_null(int fd)
+{
+    return 0;
+}
+
+xentoollog_logger_stdiostream *xtl_createlogger_stdiostream(
+    FILE *f, xentoollog_level min_level, unsigned flags)
+{
+    static xentoollog_logger_stdiostream *dummy;
+
+    return (void *)&dummy;
+}
+
+void xtl_logger_destroy(struct xentoollog_logger *logger)
+{
+}
+
+void xtl_log(struct xentoollog_logger *logger,
+             xentoollog_level level, int errnoval,
+             const char *context, const char *format, ...)
+{
+    va_list al;
+
+    va_start(al, format);
+    fprintf(stderr, "%s: ", context);
+    vfprintf(stderr, format, al);
+    fprintf(stderr, "\n");
+    va_end(al);
+}
@@ -0,0 +1,65 @@
+/*
+ * Fake gntdev driver for the libxengnttab unit tests.
+ *
+ * The library's OS independent code is built against fake osdep
+ * functions: mapping a grant allocates a page tagged with its domid and
+ * ref, and copying sets each segment's status without copying anything.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GNTTAB_TEST_EMUL_H
+#define GNTTAB_TEST_EMUL_H
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+#include "private.h"
+
+#define PAGE_SIZE (1UL << XEN_PAGE_SHIFT)
+
+#define CHECK(cond, fmt, ...) do {                                  \
+    if ( !(cond) )                                                  \
+    {                                                               \
+        fprintf(stderr, "%s:%d: " fmt "\n", __FILE__, __LINE__,     \
+               ##__VA_ARGS__);                                      \
+        abort();                                                    \
+    }                                                               \
+} while ( 0 )
+
+/* Contents of a page "mapped" by the fake driver. */
+struct tag {
+    uint32_t domid, ref;
+};
+
+extern unsigned int nr_map_calls, nr_mapped;
+extern bool fail_map;
+
+/* Copies whose source is this ref fail with GNTST_bad_gntref. */
+#define BAD_REF 0xdead
+
+/*
+ * Copies wait while the gate is closed.  Protected by copy_lock, and
+ * copy_cond is signalled whenever a copy starts waiting.
+ */
+extern pthread_mutex_t copy_lock;
+extern pthread_cond_t copy_cond;
+extern bool copy_gate_closed;
+extern unsigned int nr_copy_waiting, nr_copy_calls, nr_copy_segs;
+extern bool fail_copy;
+
+#endif
@@ -0,0 +1,206 @@
+/*
+ * Unit tests for the libxengnttab asynchronous grant copy queues.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <poll.h>
+
+#include "emul.h"
+
+#define NR_SEGS 4
+
+static char buf[PAGE_SIZE];
+
+static void init_segs(xengnttab_grant_copy_segment_t *segs, uint32_t ref)
+{
+    unsigned int i;
+
+    for ( i = 0; i < NR_SEGS; i++ )
+    {
+        segs[i].source.foreign.domid = 1;
+        segs[i].source.foreign.ref = ref;
+        segs[i].source.foreign.offset = 0;
+        segs[i].dest.virt = buf;
+        segs[i].len = 64;
+        segs[i].flags = GNTCOPY_source_gref;
+        segs[i].status = 1;
+    }
+}
+
+static void gate(bool closed)
+{
+    pthread_mutex_lock(&copy_lock);
+    copy_gate_closed = closed;
+    pthread_cond_broadcast(&copy_cond);
+    pthread_mutex_unlock(&copy_lock);
+}
+
+/* Wait for the worker to be blocked in the driver. */
+static void wait_for_worker(void)
+{
+    pthread_mutex_lock(&copy_lock);
+    while ( !nr_copy_waiting )
+        pthread_cond_wait(&copy_cond, &copy_lock);
+    pthread_mutex_unlock(&copy_lock);
+}
+
+static bool completion_pending(xengnttab_copy_queue *q, int timeout)
+{
+    struct pollfd pfd = { .fd = xengnttab_copy_queue_fd(q), .events = POLLIN };
+
+    return poll(&pfd, 1, timeout) == 1;
+}
+
+/* Reap exactly @nr requests, which must complete within a few seconds. */
+static void reap(xengnttab_copy_queue *q, unsigned int nr,
+                 void **cookies, int *rcs)
+{
+    unsigned int done = 0;
+
+    while ( done < nr )
+    {
+        int rc;
+
+        CHECK(completion_pending(q, 5000), "timed out waiting for copies");
+        rc = xengnttab_copy_reap(q, nr - done, cookies + done, rcs + done);
+        CHECK(rc >= 0, "reap failed: %d", errno);
+        done += rc;
+    }
+}
+
+static void test_single(xengnttab_handle *xgt)
+{
+    xengnttab_copy_queue *q = xengnttab_copy_queue_create(xgt, 4);
+    xengnttab_grant_copy_segment_t segs[NR_SEGS];
+    void *cookie;
+    unsigned int i;
+    int rc;
+
+    CHECK(q, "create failed: %d", errno);
+    CHECK(!completion_pending(q, 0), "completion on an idle queue");
+
+    init_segs(segs, 1);
+    CHECK(!xengnttab_copy_submit(q, NR_SEGS, segs, segs), "submit failed");
+    reap(q, 1, &cookie, &rc);
+    CHECK(cookie == segs && rc == 0, "bad completion %p %d", cookie, rc);
+    for ( i = 0; i < NR_SEGS; i++ )
+        CHECK(segs[i].status == GNTST_okay, "segment %u: %d", i,
+              segs[i].status);
+    CHECK(xengnttab_copy_reap(q, 1, &cookie, NULL) == 0, "spurious reap");
+
+    /* A failure of the driver call fails the request. */
+    fail_copy = true;
+    CHECK(!xengnttab_copy_submit(q, NR_SEGS, segs, segs), "submit failed");
+    reap(q, 1, &cookie, &rc);
+    CHECK(rc == -EIO, "rc %d", rc);
+    fail_copy = false;
+
+    xengnttab_copy_queue_destroy(q);
+}
+
+static void test_gather(xengnttab_handle *xgt)
+{
+    xengnttab_copy_queue *q = xengnttab_copy_queue_create(xgt, 8);
+    xengnttab_grant_copy_segment_t segs[4][NR_SEGS];
+    void *cookies[4];
+    int rcs[4];
+    unsigned int i, j;
+
+    CHECK(q, "create failed: %d", errno);
+
+    /* Hold the worker in the driver with the first request... */
+    gate(true);
+    nr_copy_calls = nr_copy_segs = 0;
+    init_segs(segs[0], 1);
+    CHECK(!xengnttab_copy_submit(q, NR_SEGS, segs[0], segs[0]),
+          "submit failed");
+    wait_for_worker();
+
+    /* ... while the next ones queue up behind it. */
+    for ( i = 1; i < 4; i++ )
+    {
+        init_segs(segs[i], i == 2 ? BAD_REF : i + 1);
+        CHECK(!xengnttab_copy_submit(q, NR_SEGS, segs[i], segs[i]),
+              "submit failed");
+    }
+    gate(false);
+
+    reap(q, 4, cookies, rcs);
+    CHECK(nr_copy_calls == 2, "%u driver calls", nr_copy_calls);
+    CHECK(nr_copy_segs == 4 * NR_SEGS, "%u segments", nr_copy_segs);
+
+    for ( i = 0; i < 4; i++ )
+    {
+        CHECK(cookies[i] == segs[i], "completion %u out of order", i);
+        CHECK(rcs[i] == 0, "request %u: %d", i, rcs[i]);
+        for ( j = 0; j < NR_SEGS; j++ )
+            CHECK(segs[i][j].status ==
+                  (i == 2 ? GNTST_bad_gntref : GNTST_okay),
+                  "request %u segment %u: %d", i, j, segs[i][j].status);
+    }
+
+    xengnttab_copy_queue_destroy(q);
+}
+
+static void test_full(xengnttab_handle *xgt)
+{
+    xengnttab_copy_queue *q = xengnttab_copy_queue_create(xgt, 3);
+    xengnttab_grant_copy_segment_t segs[NR_SEGS];
+    void *cookies[3];
+    int rcs[3];
+
+    CHECK(q, "create failed: %d", errno);
+
+    init_segs(segs, 1);
+    gate(true);
+    CHECK(!xengnttab_copy_submit(q, NR_SEGS, segs, NULL), "submit failed");
+    CHECK(!xengnttab_copy_submit(q, NR_SEGS, segs, NULL), "submit failed");
+    CHECK(!xengnttab_copy_submit(q, NR_SEGS, segs, NULL), "submit failed");
+    CHECK(xengnttab_copy_submit(q, NR_SEGS, segs, NULL) == -1 &&
+          errno == EAGAIN, "submit to a full queue succeeded");
+    gate(false);
+
+    /* Completions left behind by a short reap keep the fd readable. */
+    reap(q, 1, cookies, rcs);
+    reap(q, 1, cookies, rcs);
+    reap(q, 1, cookies, rcs);
+    CHECK(!completion_pending(q, 0), "completion on an idle queue");
+
+    /* Requests still queued are completed on destruction. */
+    gate(true);
+    nr_copy_calls = 0;
+    CHECK(!xengnttab_copy_submit(q, NR_SEGS, segs, NULL), "submit failed");
+    CHECK(!xengnttab_copy_submit(q, NR_SEGS, segs, NULL), "submit failed");
+    gate(false);
+    xengnttab_copy_queue_destroy(q);
+    CHECK(nr_copy_calls >= 1, "queued copies dropped");
+}
+
+int main(int argc, char **argv)
+{
+    xengnttab_handle *xgt = xengnttab_open(NULL, 0);
+
+    CHECK(xgt, "xengnttab_open failed");
+
+    test_single(xgt);
+    test_gather(xgt);
+    test_full(xgt);
+
+    xengnttab_close(xgt);
+
+    printf("gnttab copy queues: all tests passed\n");
+
+    return 0;
+}
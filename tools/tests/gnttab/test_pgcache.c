@@ -0,0 +1,241 @@
+/*
+ * Unit tests for the libxengnttab persistent grant cache.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "emul.h"
+
+static void check_page(void *addr, uint32_t domid, uint32_t ref)
+{
+    const struct tag *t = addr;
+
+    CHECK(addr && !((unsigned long)addr & (PAGE_SIZE - 1)),
+          "bad address %p", addr);
+    CHECK(t->domid == domid && t->ref == ref,
+          "page for %u/%u holds %u/%u", domid, ref, t->domid, t->ref);
+}
+
+static void get_one(xengnttab_pgcache *pgc, uint32_t domid, uint32_t ref)
+{
+    void *addr;
+
+    CHECK(!xengnttab_pgcache_get(pgc, 1, &domid, &ref, &addr),
+          "get %u/%u failed: %d", domid, ref, errno);
+    check_page(addr, domid, ref);
+}
+
+static void get_put_one(xengnttab_pgcache *pgc, uint32_t domid, uint32_t ref)
+{
+    get_one(pgc, domid, ref);
+    xengnttab_pgcache_put(pgc, 1, &domid, &ref);
+}
+
+static void test_hits(xengnttab_handle *xgt)
+{
+    xengnttab_pgcache *pgc = xengnttab_pgcache_create(xgt, 16, PROT_READ);
+    uint32_t domids[] = { 1, 1, 2, 1 };
+    uint32_t refs[] = { 10, 11, 10, 10 };
+    void *addrs[4], *again[4];
+    unsigned int i;
+
+    nr_map_calls = 0;
+
+    /* All misses are mapped in one go; repeats share an entry. */
+    CHECK(!xengnttab_pgcache_get(pgc, 4, domids, refs, addrs), "get failed");
+    CHECK(nr_map_calls == 1, "%u map calls", nr_map_calls);
+    CHECK(nr_mapped == 3, "%u pages mapped", nr_mapped);
+    CHECK(addrs[0] == addrs[3], "repeated grant mapped twice");
+    for ( i = 0; i < 4; i++ )
+        check_page(addrs[i], domids[i], refs[i]);
+    xengnttab_pgcache_put(pgc, 4, domids, refs);
+
+    /* Everything hits the second time. */
+    CHECK(!xengnttab_pgcache_get(pgc, 4, domids, refs, again), "get failed");
+    CHECK(nr_map_calls == 1, "%u map calls", nr_map_calls);
+    for ( i = 0; i < 4; i++ )
+        CHECK(again[i] == addrs[i], "entry %u moved", i);
+    xengnttab_pgcache_put(pgc, 4, domids, refs);
+
+    xengnttab_pgcache_destroy(pgc);
+    CHECK(nr_mapped == 0, "%u pages left mapped", nr_mapped);
+}
+
+static void test_lru(xengnttab_handle *xgt)
+{
+    xengnttab_pgcache *pgc = xengnttab_pgcache_create(xgt, 4, PROT_READ);
+    uint32_t ref;
+
+    for ( ref = 1; ref <= 4; ref++ )
+        get_put_one(pgc, 0, ref);
+    CHECK(nr_mapped == 4, "%u pages mapped", nr_mapped);
+
+    /* Touch 1, so that 2 is the least recently used. */
+    nr_map_calls = 0;
+    get_put_one(pgc, 0, 1);
+    CHECK(nr_map_calls == 0, "hit was mapped");
+
+    get_put_one(pgc, 0, 5);
+    CHECK(nr_mapped == 4, "%u pages mapped", nr_mapped);
+
+    nr_map_calls = 0;
+    get_put_one(pgc, 0, 1);
+    get_put_one(pgc, 0, 3);
+    get_put_one(pgc, 0, 4);
+    get_put_one(pgc, 0, 5);
+    CHECK(nr_map_calls == 0, "wrong entry evicted");
+    get_put_one(pgc, 0, 2);
+    CHECK(nr_map_calls == 1, "evicted entry still cached");
+
+    xengnttab_pgcache_destroy(pgc);
+    CHECK(nr_mapped == 0, "%u pages left mapped", nr_mapped);
+}
+
+static void test_full(xengnttab_handle *xgt)
+{
+    xengnttab_pgcache *pgc = xengnttab_pgcache_create(xgt, 2, PROT_READ);
+    uint32_t domids[] = { 0, 0, 0 };
+    uint32_t refs[] = { 1, 2, 3 };
+    void *addrs[3];
+
+    /* Entries in use are never evicted. */
+    CHECK(!xengnttab_pgcache_get(pgc, 2, domids, refs, addrs), "get failed");
+    CHECK(xengnttab_pgcache_get(pgc, 1, &domids[2], &refs[2], addrs) == -1 &&
+          errno == ENOSPC, "get succeeded in a full cache");
+
+    /* A failed call leaves nothing in use: 1 and 2 become evictable. */
+    CHECK(xengnttab_pgcache_get(pgc, 3, domids, refs, addrs) == -1 &&
+          errno == ENOSPC, "get succeeded in a full cache");
+    xengnttab_pgcache_put(pgc, 2, domids, refs);
+    get_put_one(pgc, 0, 3);
+    get_put_one(pgc, 0, 4);
+    CHECK(nr_mapped == 2, "%u pages mapped", nr_mapped);
+
+    /* A failed map leaves nothing behind. */
+    fail_map = true;
+    CHECK(xengnttab_pgcache_get(pgc, 2, domids, refs, addrs) == -1 &&
+          errno == ENOMEM, "get succeeded with failing map");
+    fail_map = false;
+    get_put_one(pgc, 0, 1);
+
+    xengnttab_pgcache_destroy(pgc);
+    CHECK(nr_mapped == 0, "%u pages left mapped", nr_mapped);
+}
+
+static void test_chunks(xengnttab_handle *xgt)
+{
+    xengnttab_pgcache *pgc = xengnttab_pgcache_create(xgt, 4, PROT_READ);
+    uint32_t domids[] = { 0, 0 };
+    uint32_t refs[] = { 1, 2 };
+    void *addrs[2];
+
+    /* Nothing to do is not an error. */
+    nr_map_calls = 0;
+    CHECK(!xengnttab_pgcache_get(pgc, 0, NULL, NULL, NULL), "empty get failed");
+    CHECK(nr_map_calls == 0, "%u map calls", nr_map_calls);
+
+    /* 1 and 2 share a mapping, as do 3 and 4.  1 and 3 stay in use. */
+    CHECK(!xengnttab_pgcache_get(pgc, 2, domids, refs, addrs), "get failed");
+    xengnttab_pgcache_put(pgc, 1, &domids[1], &refs[1]);
+    refs[0] = 3;
+    refs[1] = 4;
+    CHECK(!xengnttab_pgcache_get(pgc, 2, domids, refs, addrs), "get failed");
+    xengnttab_pgcache_put(pgc, 1, &domids[1], &refs[1]);
+    CHECK(nr_mapped == 4, "%u pages mapped", nr_mapped);
+
+    /* Evicting 2 and 4 would unmap nothing: fail, and keep them. */
+    refs[0] = 5;
+    CHECK(xengnttab_pgcache_get(pgc, 1, domids, refs, addrs) == -1 &&
+          errno == ENOSPC, "get succeeded in a full cache");
+    get_put_one(pgc, 0, 2);
+    get_put_one(pgc, 0, 4);
+    CHECK(nr_map_calls == 2, "entries evicted by a failed get");
+
+    /*
+     * With 3 released, its mapping can go.  2 is the least recently used
+     * entry, but evicting it is of no use while 1 is in use.
+     */
+    refs[0] = 3;
+    xengnttab_pgcache_put(pgc, 1, domids, refs);
+    get_put_one(pgc, 0, 5);
+    CHECK(nr_map_calls == 3, "%u map calls", nr_map_calls);
+    CHECK(nr_mapped == 3, "%u pages mapped", nr_mapped);
+    get_put_one(pgc, 0, 2);
+    CHECK(nr_map_calls == 3, "entry of a mapping in use evicted");
+
+    refs[0] = 1;
+    xengnttab_pgcache_put(pgc, 1, domids, refs);
+    xengnttab_pgcache_destroy(pgc);
+    CHECK(nr_mapped == 0, "%u pages left mapped", nr_mapped);
+}
+
+static void test_invalidate(xengnttab_handle *xgt)
+{
+    xengnttab_pgcache *pgc = xengnttab_pgcache_create(xgt, 16, PROT_READ);
+    uint32_t domids[] = { 1, 1, 2 };
+    uint32_t refs[] = { 1, 2, 1 };
+    void *addrs[3];
+    uint32_t ref;
+
+    /* Grants of a chunk are unmapped once all of them are gone. */
+    CHECK(!xengnttab_pgcache_get(pgc, 3, domids, refs, addrs), "get failed");
+    xengnttab_pgcache_put(pgc, 3, domids, refs);
+    ref = 1;
+    xengnttab_pgcache_invalidate(pgc, 1, 1, &ref);
+    CHECK(nr_mapped == 3, "chunk unmapped early");
+    xengnttab_pgcache_invalidate(pgc, 2, 0, NULL);
+    CHECK(nr_mapped == 3, "chunk unmapped early");
+    ref = 2;
+    xengnttab_pgcache_invalidate(pgc, 1, 1, &ref);
+    CHECK(nr_mapped == 0, "%u pages left mapped", nr_mapped);
+
+    /* Grants in use are unmapped when released, and can't be used. */
+    get_one(pgc, 3, 7);
+    get_put_one(pgc, 3, 8);
+    xengnttab_pgcache_invalidate(pgc, 3, 0, NULL);
+    CHECK(nr_mapped == 1, "%u pages mapped", nr_mapped);
+    domids[0] = 3;
+    refs[0] = 7;
+    CHECK(xengnttab_pgcache_get(pgc, 1, domids, refs, addrs) == -1 &&
+          errno == EBUSY, "got a stale grant");
+    xengnttab_pgcache_put(pgc, 1, domids, refs);
+    CHECK(nr_mapped == 0, "%u pages left mapped", nr_mapped);
+
+    /* Once released, the grant can be mapped afresh. */
+    nr_map_calls = 0;
+    get_put_one(pgc, 3, 7);
+    CHECK(nr_map_calls == 1, "%u map calls", nr_map_calls);
+
+    xengnttab_pgcache_destroy(pgc);
+    CHECK(nr_mapped == 0, "%u pages left mapped", nr_mapped);
+}
+
+int main(int argc, char **argv)
+{
+    xengnttab_handle *xgt = xengnttab_open(NULL, 0);
+
+    CHECK(xgt, "xengnttab_open failed");
+
+    test_hits(xgt);
+    test_lru(xgt);
+    test_full(xgt);
+    test_chunks(xgt);
+    test_invalidate(xgt);
+
+    xengnttab_close(xgt);
+
+    printf("gnttab pgcache: all tests passed\n");
+
+    return 0;
+}
@@ -0,0 +1,86 @@
+/*
+ * Unit tests for the PAGE_DATA_ENCODED page encodings.
+ *
+ * xc_sr_page_encoding.c is built on its own against this header, in place
+ * of the libxenguest internals it would otherwise include.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PAGE_ENCODING_TEST_EMUL_H
+#define PAGE_ENCODING_TEST_EMUL_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "xc_sr_stream_format.h"
+
+#define XC_SR_PAGE_ENCODING
+
+#define PAGE_SIZE 4096UL
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof(*(a)))
+#define BUILD_BUG_ON(p) ((void)sizeof(char[1 - 2 * !!(p)]))
+
+#define CHECK(cond, fmt, ...) do {                                  \
+    if ( !(cond) )                                                  \
+    {                                                               \
+        fprintf(stderr, "%s:%d: " fmt "\n", __FILE__, __LINE__,     \
+               ##__VA_ARGS__);                                      \
+        abort();                                                    \
+    }                                                               \
+} while ( 0 )
+
+typedef uint64_t xen_pfn_t;
+
+#define INVALID_MFN (~0UL)
+#define XEN_DOMCTL_PFINFO_NOTAB (0x0U << 28)
+#define XEN_DOMCTL_PFINFO_L1TAB (0x1U << 28)
+
+/* From xc_sr_common.h. */
+struct xc_sr_delta_cache;
+
+#define PAGE_ENCODE_WORK_SIZE (4096 * sizeof(uint16_t))
+
+void encode_page_data(struct xc_sr_delta_cache *cache, xen_pfn_t pfn,
+                      xen_pfn_t type, const void *page, void *buf,
+                      void *work, struct xc_sr_rec_page_encoding *enc,
+                      const void **data);
+int decode_page_data(const struct xc_sr_rec_page_encoding *enc,
+                     const void *data, void *page);
+bool page_encoding_valid(const struct xc_sr_rec_page_encoding *enc);
+const char *page_encoding_to_str(unsigned int encoding);
+struct xc_sr_delta_cache *alloc_delta_cache(unsigned int nr_slots);
+void free_delta_cache(struct xc_sr_delta_cache *cache);
+void invalidate_delta_cache(struct xc_sr_delta_cache *cache, xen_pfn_t pfn);
+
+/* From xen/include/xen/lz4.h, provided by lz4.c. */
+int lz4_decompress_unknownoutputsize(const unsigned char *src, size_t src_len,
+                                     unsigned char *dest, size_t *dest_len);
+
+#endif
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
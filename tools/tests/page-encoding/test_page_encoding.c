@@ -0,0 +1,227 @@
+/*
+ * Unit tests for the PAGE_DATA_ENCODED page encodings: every page the
+ * sender encodes has to decode to exactly what it read.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "emul.h"
+
+#define NR_SLOTS 4
+#define NR_PFNS  (2 * NR_SLOTS)
+
+static uint64_t page[PAGE_SIZE / sizeof(uint64_t)];
+static uint8_t buf[PAGE_SIZE];
+static uint16_t work[PAGE_ENCODE_WORK_SIZE / sizeof(uint16_t)];
+
+/* The restorer's copy of each pfn. */
+static uint8_t remote[NR_PFNS][PAGE_SIZE];
+
+static void fill_random(void *p, size_t len)
+{
+    uint8_t *b = p;
+
+    while ( len-- )
+        *b++ = rand();
+}
+
+/*
+ * Encode 'page' for 'pfn' as the sender would, check the encoding chosen,
+ * and apply it to the restorer's copy, which then has to match.
+ */
+static void send_page(struct xc_sr_delta_cache *cache, xen_pfn_t pfn,
+                      xen_pfn_t type, unsigned int expected)
+{
+    struct xc_sr_rec_page_encoding enc;
+    const void *data;
+
+    encode_page_data(cache, pfn, type, page, buf, work, &enc, &data);
+
+    CHECK(enc.encoding == expected, "pfn %lu: expected %s, got %s",
+          (unsigned long)pfn, page_encoding_to_str(expected),
+          page_encoding_to_str(enc.encoding));
+    CHECK(page_encoding_valid(&enc), "pfn %lu: invalid %s length %u",
+          (unsigned long)pfn, page_encoding_to_str(enc.encoding),
+          enc.length);
+    CHECK(!decode_page_data(&enc, data, remote[pfn]),
+          "pfn %lu: %s payload of %u bytes doesn't decode",
+          (unsigned long)pfn, page_encoding_to_str(enc.encoding),
+          enc.length);
+    CHECK(!memcmp(remote[pfn], page, PAGE_SIZE),
+          "pfn %lu: %s payload decodes to the wrong contents",
+          (unsigned long)pfn, page_encoding_to_str(enc.encoding));
+}
+
+/* Half random, half repeated text: well worth compressing. */
+static void fill_compressible(void)
+{
+    static const char text[] = "The quick brown fox jumps over the lazy dog. ";
+    uint8_t *p = (uint8_t *)page;
+    size_t i;
+
+    fill_random(p, PAGE_SIZE / 2);
+    for ( i = PAGE_SIZE / 2; i < PAGE_SIZE; i++ )
+        p[i] = text[i % (sizeof(text) - 1)];
+}
+
+static void test_stateless(void)
+{
+    /* Garbage in the restorer's copy must not survive any decoding. */
+    fill_random(remote[0], PAGE_SIZE);
+
+    memset(page, 0, PAGE_SIZE);
+    send_page(NULL, 0, XEN_DOMCTL_PFINFO_NOTAB, PAGE_ENCODING_ZERO);
+
+    memset(page, 0xa5, PAGE_SIZE);
+    send_page(NULL, 0, XEN_DOMCTL_PFINFO_NOTAB, PAGE_ENCODING_PATTERN);
+
+    fill_random(page, PAGE_SIZE);
+    send_page(NULL, 0, XEN_DOMCTL_PFINFO_NOTAB, PAGE_ENCODING_RAW);
+
+    fill_compressible();
+    send_page(NULL, 0, XEN_DOMCTL_PFINFO_NOTAB, PAGE_ENCODING_LZ4);
+
+    /* Long runs and long literals need LZ4's extended length octets. */
+    memset(page, 0, PAGE_SIZE);
+    fill_random(page, 1024);
+    send_page(NULL, 0, XEN_DOMCTL_PFINFO_NOTAB, PAGE_ENCODING_LZ4);
+}
+
+static void test_delta(void)
+{
+    struct xc_sr_delta_cache *cache = alloc_delta_cache(NR_SLOTS);
+    unsigned int i;
+
+    CHECK(cache, "can't allocate delta cache");
+
+    /* The first send of a page can't be a delta. */
+    fill_random(page, PAGE_SIZE);
+    send_page(cache, 1, XEN_DOMCTL_PFINFO_NOTAB, PAGE_ENCODING_RAW);
+
+    /* A few changed words, including the first and the last. */
+    page[0] ^= 1;
+    page[17] = 0;
+    page[18] = 0;
+    page[PAGE_SIZE / sizeof(uint64_t) - 1] = ~page[0];
+    send_page(cache, 1, XEN_DOMCTL_PFINFO_NOTAB, PAGE_ENCODING_DELTA);
+
+    /* Unchanged since the last send: still a non-empty delta. */
+    send_page(cache, 1, XEN_DOMCTL_PFINFO_NOTAB, PAGE_ENCODING_DELTA);
+
+    /* Changed all over: a delta isn't worth it. */
+    fill_random(page, PAGE_SIZE);
+    send_page(cache, 1, XEN_DOMCTL_PFINFO_NOTAB, PAGE_ENCODING_RAW);
+
+    /* Deltas are against what was last sent, not what was first sent. */
+    for ( i = 0; i < PAGE_SIZE / sizeof(uint64_t); i += 16 )
+        page[i]++;
+    send_page(cache, 1, XEN_DOMCTL_PFINFO_NOTAB, PAGE_ENCODING_DELTA);
+
+    /* From a page the restorer has as all zeroes. */
+    memset(page, 0, PAGE_SIZE);
+    send_page(cache, 2, XEN_DOMCTL_PFINFO_NOTAB, PAGE_ENCODING_ZERO);
+    page[100] = 42;
+    send_page(cache, 2, XEN_DOMCTL_PFINFO_NOTAB, PAGE_ENCODING_DELTA);
+
+    /* pfns sharing a slot evict one another. */
+    fill_random(page, PAGE_SIZE);
+    send_page(cache, 1 + NR_SLOTS, XEN_DOMCTL_PFINFO_NOTAB,
+              PAGE_ENCODING_RAW);
+    memcpy(page, remote[1], PAGE_SIZE);
+    page[0]++;
+    send_page(cache, 1, XEN_DOMCTL_PFINFO_NOTAB, PAGE_ENCODING_RAW);
+
+    /* Page tables get localised by the restorer, so are never deltas. */
+    send_page(cache, 3, XEN_DOMCTL_PFINFO_L1TAB, PAGE_ENCODING_RAW);
+    send_page(cache, 3, XEN_DOMCTL_PFINFO_L1TAB, PAGE_ENCODING_RAW);
+
+    /* Nor are pages whose cached copy has been invalidated. */
+    send_page(cache, 3, XEN_DOMCTL_PFINFO_NOTAB, PAGE_ENCODING_RAW);
+    invalidate_delta_cache(cache, 3);
+    send_page(cache, 3, XEN_DOMCTL_PFINFO_NOTAB, PAGE_ENCODING_RAW);
+
+    free_delta_cache(cache);
+}
+
+static void test_invalid(void)
+{
+    static const struct xc_sr_page_delta_run runs[] = {
+        { .skip = PAGE_SIZE / sizeof(uint64_t), .count = 1 },
+    };
+    static const struct {
+        uint8_t encoding;
+        uint32_t length;
+    } bad[] = {
+        { PAGE_ENCODING_RAW, PAGE_SIZE - 1 },
+        { PAGE_ENCODING_ZERO, 8 },
+        { PAGE_ENCODING_PATTERN, 0 },
+        { PAGE_ENCODING_LZ4, 0 },
+        { PAGE_ENCODING_LZ4, PAGE_SIZE + 1 },
+        { PAGE_ENCODING_DELTA, 0 },
+        { PAGE_ENCODING_DELTA, PAGE_SIZE + 1 },
+        { PAGE_ENCODING_MAX + 1, 0 },
+    };
+    struct xc_sr_rec_page_encoding enc = {};
+    const void *data;
+    unsigned int i;
+
+    for ( i = 0; i < ARRAY_SIZE(bad); i++ )
+    {
+        enc.encoding = bad[i].encoding;
+        enc.length = bad[i].length;
+        CHECK(!page_encoding_valid(&enc), "%s length %u accepted",
+              page_encoding_to_str(enc.encoding), enc.length);
+    }
+
+    /* Truncated run header. */
+    enc.encoding = PAGE_ENCODING_DELTA;
+    enc.length = 2;
+    CHECK(decode_page_data(&enc, runs, remote[0]), "truncated delta decoded");
+
+    /* Run past the end of the page. */
+    enc.length = sizeof(runs);
+    CHECK(decode_page_data(&enc, runs, remote[0]), "overlong delta decoded");
+
+    /* LZ4 block not decompressing to a whole page. */
+    memset(page, 0, PAGE_SIZE);
+    fill_compressible();
+    encode_page_data(NULL, 0, XEN_DOMCTL_PFINFO_NOTAB, page, buf, work,
+                     &enc, &data);
+    CHECK(enc.encoding == PAGE_ENCODING_LZ4, "page didn't compress");
+    enc.length /= 2;
+    CHECK(decode_page_data(&enc, data, remote[0]), "truncated LZ4 decoded");
+}
+
+int main(int argc, char **argv)
+{
+    srand(1);
+
+    test_stateless();
+    test_delta();
+    test_invalid();
+
+    printf("page encoding: all tests passed\n");
+
+    return 0;
+}
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,77 @@
+/*
+ * Unit tests for the order in which a post-copy sender sends pages.
+ *
+ * xc_sr_postcopy.c is built on its own against this header, in place of the
+ * libxenguest internals it would otherwise include.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef POSTCOPY_TEST_EMUL_H
+#define POSTCOPY_TEST_EMUL_H
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "xc_bitops.h"
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof(*(a)))
+
+#define CHECK(cond, fmt, ...) do {                                  \
+    if ( !(cond) )                                                  \
+    {                                                               \
+        fprintf(stderr, "%s:%d: " fmt "\n", __FILE__, __LINE__,     \
+               ##__VA_ARGS__);                                      \
+        abort();                                                    \
+    }                                                               \
+} while ( 0 )
+
+typedef uint64_t xen_pfn_t;
+
+/* From xc_sr_common.h. */
+struct xc_sr_postcopy_queue
+{
+    unsigned long *outstanding;
+    xen_pfn_t p2m_size;
+    unsigned long nr_outstanding;
+
+    xen_pfn_t next;
+
+    xen_pfn_t *faults;
+    unsigned int first_fault, nr_faults, max_faults;
+};
+
+void postcopy_queue_init(struct xc_sr_postcopy_queue *q,
+                         unsigned long *outstanding, xen_pfn_t p2m_size,
+                         unsigned long nr_outstanding);
+void postcopy_queue_destroy(struct xc_sr_postcopy_queue *q);
+int postcopy_queue_fault(struct xc_sr_postcopy_queue *q, xen_pfn_t pfn);
+unsigned int postcopy_queue_next(struct xc_sr_postcopy_queue *q,
+                                 xen_pfn_t *pfns, unsigned int max);
+
+#endif
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
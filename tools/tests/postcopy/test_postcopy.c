@@ -0,0 +1,223 @@
+/*
+ * Unit tests for the order in which a post-copy sender sends the outstanding
+ * pages: pfns the receiver faults on go out ahead of everything else, and
+ * every outstanding pfn goes out exactly once.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "emul.h"
+
+#define P2M_SIZE 4096
+#define BATCH    16
+
+static unsigned long bitmap[P2M_SIZE / (sizeof(unsigned long) * 8)];
+static unsigned int sent[P2M_SIZE];
+static xen_pfn_t pfns[P2M_SIZE];
+
+/* Outstanding: every pfn, or every other one. */
+static void setup(struct xc_sr_postcopy_queue *q, bool sparse)
+{
+    unsigned long nr = 0;
+    xen_pfn_t p;
+
+    memset(bitmap, 0, sizeof(bitmap));
+    memset(sent, 0, sizeof(sent));
+
+    for ( p = 0; p < P2M_SIZE; p += sparse ? 2 : 1, ++nr )
+        set_bit(p, bitmap);
+
+    postcopy_queue_init(q, bitmap, P2M_SIZE, nr);
+}
+
+static unsigned int next(struct xc_sr_postcopy_queue *q, unsigned int max)
+{
+    unsigned int i, n = postcopy_queue_next(q, pfns, max);
+
+    CHECK(n <= max, "%u pfns for a batch of %u", n, max);
+
+    for ( i = 0; i < n; ++i )
+    {
+        CHECK(pfns[i] < P2M_SIZE, "pfn %#lx out of range",
+              (unsigned long)pfns[i]);
+        ++sent[pfns[i]];
+    }
+
+    return n;
+}
+
+/* Drain the queue, and check that each outstanding pfn went out once. */
+static void finish(struct xc_sr_postcopy_queue *q, bool sparse)
+{
+    xen_pfn_t p;
+
+    while ( q->nr_outstanding )
+        CHECK(next(q, BATCH), "%lu pfns outstanding, but none returned",
+              q->nr_outstanding);
+
+    CHECK(next(q, BATCH) == 0, "pfns returned after the last");
+
+    for ( p = 0; p < P2M_SIZE; ++p )
+        CHECK(sent[p] == (sparse && (p & 1) ? 0 : 1),
+              "pfn %#lx sent %u times", (unsigned long)p, sent[p]);
+
+    postcopy_queue_destroy(q);
+}
+
+static void test_background(void)
+{
+    struct xc_sr_postcopy_queue q;
+    unsigned int i, n;
+
+    printf("%-40s", "Testing background push...");
+
+    setup(&q, true);
+
+    n = next(&q, BATCH);
+    CHECK(n == BATCH, "first batch of %u", n);
+    for ( i = 0; i < n; ++i )
+        CHECK(pfns[i] == 2 * i, "pfn %#lx at %u",
+              (unsigned long)pfns[i], i);
+    CHECK(q.nr_outstanding == P2M_SIZE / 2 - BATCH,
+          "%lu outstanding", q.nr_outstanding);
+
+    finish(&q, true);
+
+    printf("okay\n");
+}
+
+static void test_faults_first(void)
+{
+    struct xc_sr_postcopy_queue q;
+    unsigned int n;
+
+    printf("%-40s", "Testing faults ahead of background...");
+
+    setup(&q, false);
+    next(&q, BATCH);
+
+    CHECK(!postcopy_queue_fault(&q, 4000), "fault on 4000");
+    CHECK(!postcopy_queue_fault(&q, 100), "fault on 100");
+
+    /* Just the faults, in order, rather than a batch topped up. */
+    n = next(&q, BATCH);
+    CHECK(n == 2 && pfns[0] == 4000 && pfns[1] == 100,
+          "%u pfns, starting %#lx", n, (unsigned long)pfns[0]);
+
+    /* Then the background push carries on where it was. */
+    n = next(&q, BATCH);
+    CHECK(n == BATCH && pfns[0] == BATCH,
+          "%u pfns, starting %#lx", n, (unsigned long)pfns[0]);
+
+    /* A fault arriving mid-push still goes next. */
+    CHECK(!postcopy_queue_fault(&q, 3000), "fault on 3000");
+    n = next(&q, BATCH);
+    CHECK(n == 1 && pfns[0] == 3000,
+          "%u pfns, starting %#lx", n, (unsigned long)pfns[0]);
+
+    finish(&q, false);
+
+    printf("okay\n");
+}
+
+static void test_stale_faults(void)
+{
+    struct xc_sr_postcopy_queue q;
+    unsigned long nr;
+
+    printf("%-40s", "Testing stale and bad faults...");
+
+    setup(&q, true);
+    next(&q, BATCH);
+    nr = q.nr_outstanding;
+
+    /* Already sent, never outstanding, or asked for twice. */
+    CHECK(!postcopy_queue_fault(&q, 2), "fault on sent pfn");
+    CHECK(!postcopy_queue_fault(&q, 101), "fault on absent pfn");
+    CHECK(!postcopy_queue_fault(&q, 200), "fault on 200");
+    CHECK(!postcopy_queue_fault(&q, 200), "second fault on 200");
+    CHECK(q.nr_faults == 1, "%u faults queued", q.nr_faults);
+
+    errno = 0;
+    CHECK(postcopy_queue_fault(&q, P2M_SIZE) == -1 && errno == EINVAL,
+          "fault beyond p2m_size accepted");
+
+    CHECK(next(&q, BATCH) == 1 && pfns[0] == 200, "fault on 200 not sent");
+    CHECK(q.nr_outstanding == nr - 1, "%lu outstanding, expected %lu",
+          q.nr_outstanding, nr - 1);
+
+    finish(&q, true);
+
+    printf("okay\n");
+}
+
+static void test_many_faults(void)
+{
+    struct xc_sr_postcopy_queue q;
+    xen_pfn_t expect = P2M_SIZE - 1;
+    unsigned int i, n;
+
+    printf("%-40s", "Testing many faults...");
+
+    setup(&q, false);
+
+    /* Interleave queueing and sending, so the queue both wraps and grows. */
+    for ( i = 0; i < 300; ++i )
+    {
+        CHECK(!postcopy_queue_fault(&q, P2M_SIZE - 1 - i), "fault %u", i);
+
+        if ( i % 3 == 2 )
+        {
+            n = next(&q, 2);
+            CHECK(n == 2 && pfns[0] == expect && pfns[1] == expect - 1,
+                  "faults out of order at %u", i);
+            expect -= 2;
+        }
+    }
+
+    while ( q.nr_faults )
+    {
+        n = next(&q, BATCH);
+        for ( i = 0; i < n; ++i, --expect )
+            CHECK(pfns[i] == expect, "pfn %#lx, expected %#lx",
+                  (unsigned long)pfns[i], (unsigned long)expect);
+    }
+    CHECK(expect == P2M_SIZE - 1 - 300, "%#lx", (unsigned long)expect);
+
+    finish(&q, false);
+
+    printf("okay\n");
+}
+
+int main(int argc, char **argv)
+{
+    test_background();
+    test_faults_first();
+    test_stale_faults();
+    test_many_faults();
+
+    printf("post-copy: all tests passed\n");
+
+    return 0;
+}
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,234 @@
+/*
+ * Unit tests and microbenchmark for rangesets.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms and conditions of the GNU General Public
+ * License, version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <time.h>
+
+#include "emul.h"
+
+/* Universe for the randomised tests, checked against a reference bitmap. */
+#define NR_VALUES 512
+#define NR_OPS    20000
+
+static bool model[NR_VALUES];
+
+static unsigned long rnd(unsigned long n)
+{
+    return (unsigned long)random() % n;
+}
+
+#define CHECK(cond, fmt, ...) do {                                  \
+    if ( !(cond) )                                                  \
+    {                                                               \
+        fprintf(stderr, "%s:%d: " fmt "\n", __FILE__, __LINE__,     \
+               ##__VA_ARGS__);                                      \
+        abort();                                                    \
+    }                                                               \
+} while ( 0 )
+
+struct report_state {
+    unsigned long next;
+};
+
+/* Ranges must be reported in order, maximal, and match the model. */
+static int check_report(unsigned long s, unsigned long e, void *data)
+{
+    struct report_state *st = data;
+    unsigned long i;
+
+    CHECK(s >= st->next, "range %lu-%lu reported out of order", s, e);
+    for ( i = st->next; i < s; i++ )
+        CHECK(!model[i], "value %lu missing from report", i);
+    for ( i = s; i <= e; i++ )
+        CHECK(model[i], "value %lu reported but not present", i);
+    CHECK(s == 0 || st->next == 0 || !model[s - 1] || s == st->next,
+          "range %lu-%lu not merged with its predecessor", s, e);
+
+    st->next = e + 1;
+
+    return 0;
+}
+
+static void check_set(struct rangeset *r)
+{
+    struct report_state st = { 0 };
+    unsigned long i, s, e, n;
+    bool contains, overlaps;
+
+    CHECK(!rangeset_report_ranges(r, 0, NR_VALUES - 1, check_report, &st),
+          "report failed");
+    for ( i = st.next; i < NR_VALUES; i++ )
+        CHECK(!model[i], "value %lu missing from report", i);
+
+    for ( i = 0; i < NR_VALUES; i++ )
+        CHECK(rangeset_contains_singleton(r, i) == model[i],
+              "contains_singleton(%lu) != %d", i, model[i]);
+
+    for ( n = 0; n < 64; n++ )
+    {
+        s = rnd(NR_VALUES);
+        e = s + rnd(NR_VALUES - s);
+
+        contains = true;
+        overlaps = false;
+        for ( i = s; i <= e; i++ )
+        {
+            contains &= model[i];
+            overlaps |= model[i];
+        }
+
+        CHECK(rangeset_contains_range(r, s, e) == contains,
+              "contains_range(%lu, %lu) != %d", s, e, contains);
+        CHECK(rangeset_overlaps_range(r, s, e) == overlaps,
+              "overlaps_range(%lu, %lu) != %d", s, e, overlaps);
+    }
+
+    n = 0;
+    for ( i = 0; i < NR_VALUES; i++ )
+        n |= model[i];
+    CHECK(rangeset_is_empty(r) == !n, "is_empty != %d", !n);
+}
+
+static void test_random(void)
+{
+    struct rangeset *r = rangeset_new(NULL, "test", 0);
+    unsigned long i, j, s, e;
+
+    CHECK(r, "rangeset_new failed");
+
+    for ( i = 0; i < NR_OPS; i++ )
+    {
+        s = rnd(NR_VALUES);
+        e = s + rnd(min(NR_VALUES - s, 32UL));
+
+        if ( rnd(2) )
+        {
+            CHECK(!rangeset_add_range(r, s, e), "add %lu-%lu failed", s, e);
+            for ( j = s; j <= e; j++ )
+                model[j] = true;
+        }
+        else
+        {
+            CHECK(!rangeset_remove_range(r, s, e),
+                  "remove %lu-%lu failed", s, e);
+            for ( j = s; j <= e; j++ )
+                model[j] = false;
+        }
+
+        if ( !(i % 16) )
+            check_set(r);
+    }
+
+    check_set(r);
+    rangeset_destroy(r);
+}
+
+static void test_claim_and_swap(void)
+{
+    struct rangeset *a = rangeset_new(NULL, "a", 0);
+    struct rangeset *b = rangeset_new(NULL, "b", 0);
+    unsigned long s;
+
+    CHECK(a && b, "rangeset_new failed");
+
+    CHECK(!rangeset_add_range(a, 0, 9), "add failed");
+    CHECK(!rangeset_add_range(a, 20, 29), "add failed");
+    CHECK(!rangeset_claim_range(a, 10, &s) && s == 10,
+          "claim returned %lu", s);
+    CHECK(rangeset_contains_range(a, 10, 19), "claim not added");
+    CHECK(!rangeset_claim_range(a, 5, &s) && s == 30,
+          "claim returned %lu", s);
+    CHECK(rangeset_contains_range(a, 30, 34), "claim not added");
+
+    CHECK(!rangeset_add_singleton(b, 100), "add failed");
+    rangeset_swap(a, b);
+    CHECK(rangeset_contains_singleton(a, 100) &&
+          !rangeset_contains_singleton(a, 0), "swap failed");
+    CHECK(rangeset_contains_range(b, 30, 34) &&
+          !rangeset_contains_singleton(b, 100), "swap failed");
+
+    rangeset_limit(b, 0);
+    CHECK(rangeset_add_singleton(b, 50) == -ENOMEM, "limit not enforced");
+    CHECK(!rangeset_remove_singleton(b, 0), "remove failed");
+
+    rangeset_destroy(a);
+    rangeset_destroy(b);
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+#define NR_LOOKUPS 1000000
+
+/* Lookup latency in a set of nr disjoint ranges, [4i, 4i + 1] for each i. */
+static void bench_lookup(unsigned long nr)
+{
+    struct rangeset *r = rangeset_new(NULL, "bench", 0);
+    unsigned long i, hits = 0, *keys = malloc(NR_LOOKUPS * sizeof(*keys));
+    uint64_t start, insert, lookup;
+
+    CHECK(r && keys, "allocation failed");
+
+    start = now_ns();
+    for ( i = 0; i < nr; i++ )
+        CHECK(!rangeset_add_range(r, i * 4, i * 4 + 1), "add failed");
+    insert = now_ns() - start;
+
+    for ( i = 0; i < NR_LOOKUPS; i++ )
+        keys[i] = rnd(nr * 4);
+
+    start = now_ns();
+    for ( i = 0; i < NR_LOOKUPS; i++ )
+        hits += rangeset_contains_singleton(r, keys[i]);
+    lookup = now_ns() - start;
+
+    CHECK(hits > NR_LOOKUPS / 4 && hits < NR_LOOKUPS * 3 / 4,
+          "unexpected hit count %lu", hits);
+
+    printf("%8lu ranges: insert %6.1f ns/range, lookup %6.1f ns\n",
+           nr, (double)insert / nr, (double)lookup / NR_LOOKUPS);
+
+    rangeset_destroy(r);
+    free(keys);
+}
+
+int main(int argc, char **argv)
+{
+    srandom(1);
+
+    test_random();
+    test_claim_and_swap();
+
+    bench_lookup(10);
+    bench_lookup(1000);
+    bench_lookup(100000);
+
+    return 0;
+}
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
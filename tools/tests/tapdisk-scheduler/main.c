@@ -0,0 +1,262 @@
+/*
+ * Unit tests and microbenchmark for the tapdisk scheduler.
+ *
+ * Built once against each backend, to compare the per-completion cost of
+ * the select() and epoll event loops with many idle registered fds, as for
+ * a tapdisk process serving many VBDs.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms and conditions of the GNU General Public
+ * License, version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include "scheduler.h"
+#include "tapdisk-log.h"
+
+#ifdef SCHEDULER_EPOLL
+#define BACKEND "epoll"
+#else
+#define BACKEND "select"
+#endif
+
+#define CHECK(cond, fmt, ...) do {                                  \
+    if ( !(cond) )                                                  \
+    {                                                               \
+        fprintf(stderr, "%s:%d: " fmt "\n", __FILE__, __LINE__,     \
+               ##__VA_ARGS__);                                      \
+        abort();                                                    \
+    }                                                               \
+} while ( 0 )
+
+/* The scheduler only logs debug messages. */
+void __tlog_write(int level, const char *func, const char *fmt, ...)
+{
+}
+
+static scheduler_t sched;
+
+struct counter {
+    int fd;
+    unsigned int hits;
+    char mode;
+    event_id_t unregister;
+    int drain;
+};
+
+static void count_cb(event_id_t id, char mode, void *private)
+{
+    struct counter *c = private;
+    uint64_t val;
+
+    c->hits++;
+    c->mode = mode;
+
+    if ( c->drain )
+        CHECK(read(c->fd, &val, sizeof(val)) == sizeof(val), "drain failed");
+
+    if ( c->unregister )
+    {
+        scheduler_unregister_event(&sched, c->unregister);
+        c->unregister = 0;
+    }
+}
+
+static void signal_fd(int fd)
+{
+    uint64_t one = 1;
+
+    CHECK(write(fd, &one, sizeof(one)) == sizeof(one), "signal failed");
+}
+
+static void iterate(void)
+{
+    /* Don't wait on the timeouts. */
+    scheduler_set_max_timeout(&sched, 0);
+    CHECK(scheduler_wait_for_events(&sched) >= 0, "wait failed");
+}
+
+static void test_basic(void)
+{
+    struct counter a = { 0 }, b = { 0 }, t = { 0 };
+    event_id_t ida, idb, idt;
+    int fd = eventfd(0, 0), i, hits;
+
+    CHECK(!scheduler_initialize(&sched), "initialize failed");
+
+    /*
+     * Two events on one fd, both level triggered.  select() only ever ran
+     * the first of them.
+     */
+    a.fd = b.fd = fd;
+    ida = scheduler_register_event(&sched, SCHEDULER_POLL_READ_FD, fd, 0,
+                                   count_cb, &a);
+    idb = scheduler_register_event(&sched, SCHEDULER_POLL_READ_FD, fd, 0,
+                                   count_cb, &b);
+    CHECK(ida > 0 && idb > 0 && ida != idb, "register failed");
+
+    iterate();
+    CHECK(!a.hits && !b.hits, "idle fd reported");
+
+    signal_fd(fd);
+    for ( i = 1; i <= 3; i++ )
+    {
+        iterate();
+        CHECK(a.hits == i, "level triggered fd not reported");
+#ifdef SCHEDULER_EPOLL
+        CHECK(b.hits == i, "second event on fd not reported");
+#endif
+        CHECK(a.mode == SCHEDULER_POLL_READ_FD, "wrong mode %d", a.mode);
+    }
+
+    /* An event unregistered by an earlier callback isn't run any more. */
+    a.unregister = idb;
+    hits = b.hits;
+    iterate();
+    CHECK(a.hits == 4 && b.hits == hits, "unregistered event run");
+
+    /* Timeouts of 0 expire on every iteration, alongside the fds. */
+    idt = scheduler_register_event(&sched, SCHEDULER_POLL_TIMEOUT, -1, 0,
+                                   count_cb, &t);
+    CHECK(idt > 0, "register timeout failed");
+    iterate();
+    CHECK(a.hits == 5 && t.hits == 1, "timeout not run");
+    CHECK(t.mode == SCHEDULER_POLL_TIMEOUT, "wrong mode %d", t.mode);
+    scheduler_unregister_event(&sched, idt);
+
+    /* A draining callback stops the reports. */
+    a.drain = 1;
+    iterate();
+    iterate();
+    CHECK(a.hits == 6, "drained fd reported");
+
+    /* Edge triggered events are reported at least once per edge. */
+    scheduler_unregister_event(&sched, ida);
+    a.drain = 0;
+    a.hits = 0;
+    ida = scheduler_register_event(&sched,
+                                   SCHEDULER_POLL_READ_FD | SCHEDULER_POLL_EDGE,
+                                   fd, 0, count_cb, &a);
+    CHECK(ida > 0, "register edge failed");
+    signal_fd(fd);
+    iterate();
+    CHECK(a.hits == 1, "edge not reported");
+#ifdef SCHEDULER_EPOLL
+    iterate();
+    CHECK(a.hits == 1, "edge reported twice");
+    signal_fd(fd);
+    iterate();
+    CHECK(a.hits == 2, "second edge not reported");
+#endif
+    scheduler_unregister_event(&sched, ida);
+
+    /* A closed and reused fd number can be registered again. */
+    close(fd);
+    fd = eventfd(1, 0);
+    a.hits = 0;
+    a.fd = fd;
+    a.drain = 1;
+    ida = scheduler_register_event(&sched, SCHEDULER_POLL_READ_FD, fd, 0,
+                                   count_cb, &a);
+    CHECK(ida > 0, "register reused fd failed");
+    iterate();
+    CHECK(a.hits == 1, "reused fd not reported");
+    scheduler_unregister_event(&sched, ida);
+    close(fd);
+
+    printf("%s: basic tests passed\n", BACKEND);
+}
+
+/*
+ * One fd completing "I/O" on every iteration, with nr_idle other registered
+ * fds which never become ready.
+ */
+#define BENCH_ITERS 100000
+
+static void bench(unsigned int nr_idle)
+{
+    struct counter io = { 0 }, idle = { 0 };
+    struct timespec t0, t1;
+    int *fds = calloc(nr_idle, sizeof(*fds));
+    unsigned int i;
+    event_id_t id;
+    double ns;
+
+    CHECK(fds, "no memory");
+    CHECK(!scheduler_initialize(&sched), "initialize failed");
+
+    for ( i = 0; i < nr_idle; i++ )
+    {
+        fds[i] = eventfd(0, 0);
+        CHECK(fds[i] >= 0, "eventfd failed");
+        CHECK(scheduler_register_event(&sched, SCHEDULER_POLL_READ_FD,
+                                       fds[i], 0, count_cb, &idle) > 0,
+              "register idle failed");
+    }
+
+    io.fd = eventfd(0, 0);
+    io.drain = 1;
+    id = scheduler_register_event(&sched,
+                                  SCHEDULER_POLL_READ_FD | SCHEDULER_POLL_EDGE,
+                                  io.fd, 0, count_cb, &io);
+    CHECK(id > 0, "register io failed");
+
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t0);
+    for ( i = 0; i < BENCH_ITERS; i++ )
+    {
+        signal_fd(io.fd);
+        iterate();
+    }
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t1);
+
+    CHECK(io.hits == BENCH_ITERS && !idle.hits,
+          "%u completions, %u idle events", io.hits, idle.hits);
+
+    ns = (t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec);
+    printf("%s: %4u idle fds: %6.0f ns CPU per completion\n",
+           BACKEND, nr_idle, ns / BENCH_ITERS);
+
+    scheduler_unregister_event(&sched, id);
+    close(io.fd);
+    for ( i = 0; i < nr_idle; i++ )
+        close(fds[i]);
+    free(fds);
+}
+
+int main(int argc, char **argv)
+{
+    test_basic();
+
+    /* select() is limited to FD_SETSIZE, so stay below it. */
+    bench(0);
+    bench(64);
+    bench(256);
+    bench(900);
+
+    return 0;
+}
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -389,6 +389,80 @@ static struct x86_emulate_ops emulops = {
     .put_fpu    = emul_test_put_fpu,
 };
 
+#ifdef __x86_64__
+/* Register values the memory operands below get computed from. */
+#define MOV_RAX 0x0000000000001000UL
+#define MOV_RBX 0x0000000000200000UL
+#define MOV_RCX 0x0000000000000010UL
+#define MOV_RDX 0x1122334455667788UL
+#define MOV_RSP 0x00007fffffffe000UL
+#define MOV_R8  0xffff800000000000UL
+#define MOV_R9  0x8877665544332211UL
+#define MOV_R10 0x00000000deadbeefUL
+#define MOV_R13 0x0000000000003000UL
+#define MOV_RIP 0x0000000000400000UL
+
+static const struct {
+    const char *name;
+    uint8_t insn[MAX_INST_LEN];
+    unsigned int insn_bytes;
+    int rc;
+    unsigned int len, reg, bytes;
+    bool write;
+    unsigned long ea, data;
+} simple_movs[] = {
+    { "mov %ecx,(%rax)", { 0x89, 0x08 }, 2,
+      X86EMUL_OKAY, 2, 1, 4, true, MOV_RAX, MOV_RCX },
+    { "mov %cx,(%rax)", { 0x66, 0x89, 0x08 }, 3,
+      X86EMUL_OKAY, 3, 1, 2, true, MOV_RAX, MOV_RCX },
+    { "mov (%rbx,%rcx,4),%rdx", { 0x48, 0x8b, 0x14, 0x8b }, 4,
+      X86EMUL_OKAY, 4, 2, 8, false, MOV_RBX + MOV_RCX * 4 },
+    { "mov %dx,0x10(%r8)", { 0x66, 0x41, 0x89, 0x50, 0x10 }, 5,
+      X86EMUL_OKAY, 5, 2, 2, true, MOV_R8 + 0x10, MOV_RDX },
+    { "mov %dx,(%rax) (stale REX)", { 0x41, 0x66, 0x89, 0x10 }, 4,
+      X86EMUL_OKAY, 4, 2, 2, true, MOV_RAX, MOV_RDX },
+    { "mov %r10d,-0x80(%rbx,%rcx)", { 0x44, 0x89, 0x54, 0x0b, 0x80 }, 5,
+      X86EMUL_OKAY, 5, 10, 4, true, MOV_RBX + MOV_RCX - 0x80, MOV_R10 },
+    { "mov %r9,(%r8,%r13)", { 0x4f, 0x89, 0x0c, 0x28 }, 4,
+      X86EMUL_OKAY, 4, 9, 8, true, MOV_R8 + MOV_R13, MOV_R9 },
+    { "mov -8(%rip),%eax", { 0x8b, 0x05, 0xf8, 0xff, 0xff, 0xff }, 6,
+      X86EMUL_OKAY, 6, 0, 4, false, MOV_RIP + 6 - 8 },
+    { "mov 0x1000,%eax", { 0x8b, 0x04, 0x25, 0x00, 0x10, 0x00, 0x00 }, 7,
+      X86EMUL_OKAY, 7, 0, 4, false, 0x1000 },
+    { "mov (%r13),%eax", { 0x41, 0x8b, 0x45, 0x00 }, 4,
+      X86EMUL_OKAY, 4, 0, 4, false, MOV_R13 },
+    { "mov 0x100(%rax),%al", { 0x8a, 0x80, 0x00, 0x01, 0x00, 0x00 }, 6,
+      X86EMUL_OKAY, 6, 0, 1, false, MOV_RAX + 0x100 },
+    { "mov %spl,(%rax)", { 0x40, 0x88, 0x20 }, 3,
+      X86EMUL_OKAY, 3, 4, 1, true, MOV_RAX, MOV_RSP },
+    { "movb $0xab,(%rax)", { 0xc6, 0x00, 0xab }, 3,
+      X86EMUL_OKAY, 3, 0, 1, true, MOV_RAX, 0xab },
+    { "movw $0x1234,(%rax)", { 0x66, 0xc7, 0x00, 0x34, 0x12 }, 5,
+      X86EMUL_OKAY, 5, 0, 2, true, MOV_RAX, 0x1234 },
+    { "movl $-1,0x100(%rax)",
+      { 0xc7, 0x80, 0x00, 0x01, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff }, 10,
+      X86EMUL_OKAY, 10, 0, 4, true, MOV_RAX + 0x100, ~0UL },
+    { "movq $-0x80000000,(%rax)",
+      { 0x48, 0xc7, 0x00, 0x00, 0x00, 0x00, 0x80 }, 7,
+      X86EMUL_OKAY, 7, 0, 8, true, MOV_RAX, 0xffffffff80000000UL },
+    { "mov %ah,(%rax)", { 0x88, 0x20 }, 2, X86EMUL_UNIMPLEMENTED },
+    { "mov (%rax),%bh", { 0x8a, 0x38 }, 2, X86EMUL_UNIMPLEMENTED },
+    { "mov %eax,%ecx", { 0x89, 0xc1 }, 2, X86EMUL_UNIMPLEMENTED },
+    { "movl $0,(%rax) /1", { 0xc7, 0x08, 0, 0, 0, 0 }, 6,
+      X86EMUL_UNIMPLEMENTED },
+    { "movzbl (%rax),%eax", { 0x0f, 0xb6, 0x00 }, 3, X86EMUL_UNIMPLEMENTED },
+    { "mov %fs:(%rax),%eax", { 0x64, 0x8b, 0x00 }, 3, X86EMUL_UNIMPLEMENTED },
+    { "mov (%eax),%eax", { 0x67, 0x8b, 0x00 }, 3, X86EMUL_UNIMPLEMENTED },
+    { "4 prefixes", { 0x66, 0x66, 0x66, 0x66, 0x89, 0x08 }, 6,
+      X86EMUL_UNIMPLEMENTED },
+    { "truncated disp32", { 0x8b, 0x80, 0x00, 0x10 }, 4,
+      X86EMUL_UNHANDLEABLE },
+    { "truncated imm32", { 0xc7, 0x00, 0xff, 0xff }, 4,
+      X86EMUL_UNHANDLEABLE },
+    { "no bytes", {}, 0, X86EMUL_UNHANDLEABLE },
+};
+#endif
+
 #define EFLAGS_ALWAYS_SET (X86_EFLAGS_IF | X86_EFLAGS_MBS)
 #define EFLAGS_MASK (X86_EFLAGS_ARITH_MASK | EFLAGS_ALWAYS_SET)
 
@@ -409,6 +483,7 @@ int main(int argc, char **argv)
 
     ctxt.regs = &regs;
     ctxt.force_writeback = 0;
+    ctxt.decode_cache = NULL;
     ctxt.vendor    = X86_VENDOR_UNKNOWN;
     ctxt.lma       = sizeof(void *) == 8;
     ctxt.addr_size = 8 * sizeof(void *);
@@ -3383,6 +3458,109 @@ int main(int argc, char **argv)
     else
         printf("skipped\n");
 
+#ifdef __x86_64__
+    printf("%-40s", "Testing simple MOV decode...");
+    for ( j = 0; j < ARRAY_SIZE(simple_movs); j++ )
+    {
+        struct x86_simple_mov mov;
+
+        regs.rax = MOV_RAX;
+        regs.rbx = MOV_RBX;
+        regs.rcx = MOV_RCX;
+        regs.rdx = MOV_RDX;
+        regs.rsp = MOV_RSP;
+        regs.r8  = MOV_R8;
+        regs.r9  = MOV_R9;
+        regs.r10 = MOV_R10;
+        regs.r13 = MOV_R13;
+        regs.rip = MOV_RIP;
+        rc = x86_decode_simple_mov(simple_movs[j].insn,
+                                   simple_movs[j].insn_bytes, &regs, &mov);
+        if ( rc != simple_movs[j].rc ||
+             (rc == X86EMUL_OKAY &&
+              (mov.len != simple_movs[j].len ||
+               mov.reg != simple_movs[j].reg ||
+               mov.bytes != simple_movs[j].bytes ||
+               mov.write != simple_movs[j].write ||
+               mov.ea != simple_movs[j].ea ||
+               (mov.write && mov.data != simple_movs[j].data))) )
+        {
+            printf("%s: ", simple_movs[j].name);
+            goto fail;
+        }
+    }
+    printf("okay\n");
+#endif
+
+    printf("%-40s", "Testing decode cache...");
+    ctxt.decode_cache = calloc(1, x86_decode_cache_size());
+    if ( !ctxt.decode_cache )
+        goto fail;
+    /* movl %ecx,(%eax), twice: the second run is served from the cache. */
+    instr[0] = 0x89; instr[1] = 0x08;
+    for ( i = 0; i < 2; i++ )
+    {
+        regs.eflags = 0x200;
+        regs.eip    = (unsigned long)&instr[0];
+        regs.ecx    = 0x12345678 + i;
+        regs.eax    = (unsigned long)res;
+        *res        = 0;
+        rc = x86_emulate(&ctxt, &emulops);
+        if ( (rc != X86EMUL_OKAY) ||
+             (*res != 0x12345678 + i) ||
+             (regs.eip != (unsigned long)&instr[2]) ||
+             (x86_decode_cache_hits(ctxt.decode_cache) != i) )
+            goto fail;
+    }
+    /* A different base register value must not reuse the old address. */
+    regs.eip    = (unsigned long)&instr[0];
+    regs.eax    = (unsigned long)(res + 1);
+    res[0]      = 0;
+    res[1]      = 0;
+    rc = x86_emulate(&ctxt, &emulops);
+    if ( (rc != X86EMUL_OKAY) || res[0] || (res[1] != 0x12345679) ||
+         (x86_decode_cache_hits(ctxt.decode_cache) != 1) )
+        goto fail;
+    /* Modified code at the same address must get decoded afresh. */
+    instr[0] = 0x8b; /* movl (%eax),%ecx */
+    regs.eip    = (unsigned long)&instr[0];
+    regs.ecx    = 0;
+    rc = x86_emulate(&ctxt, &emulops);
+    if ( (rc != X86EMUL_OKAY) || (regs.ecx != 0x12345679) ||
+         (res[1] != 0x12345679) ||
+         (regs.eip != (unsigned long)&instr[2]) ||
+         (x86_decode_cache_hits(ctxt.decode_cache) != 1) )
+        goto fail;
+    /* Longer instruction at the same address. */
+    instr[0] = 0x89; instr[1] = 0x48; instr[2] = 0x04; /* movl %ecx,4(%eax) */
+    regs.eip    = (unsigned long)&instr[0];
+    regs.eax    = (unsigned long)res;
+    regs.ecx    = 0x87654321;
+    rc = x86_emulate(&ctxt, &emulops);
+    if ( (rc != X86EMUL_OKAY) || (res[1] != 0x87654321) ||
+         (regs.eip != (unsigned long)&instr[3]) ||
+         (x86_decode_cache_hits(ctxt.decode_cache) != 1) )
+        goto fail;
+    /* Which then gets cached itself. */
+    regs.eip    = (unsigned long)&instr[0];
+    regs.ecx    = 0x13579bdf;
+    rc = x86_emulate(&ctxt, &emulops);
+    if ( (rc != X86EMUL_OKAY) || (res[1] != 0x13579bdf) ||
+         (regs.eip != (unsigned long)&instr[3]) ||
+         (x86_decode_cache_hits(ctxt.decode_cache) != 2) )
+        goto fail;
+    /* Nothing is left to hit after a flush. */
+    x86_decode_cache_flush(ctxt.decode_cache);
+    regs.eip    = (unsigned long)&instr[0];
+    rc = x86_emulate(&ctxt, &emulops);
+    if ( (rc != X86EMUL_OKAY) ||
+         (x86_decode_cache_hits(ctxt.decode_cache) != 0) )
+        goto fail;
+    printf("okay\n");
+
+    free(ctxt.decode_cache);
+    ctxt.decode_cache = NULL;
+
     for ( j = 0; j < ARRAY_SIZE(blobs); j++ )
     {
         if ( blobs[j].check_cpu && !blobs[j].check_cpu() )
@@ -36,6 +36,8 @@
 #define WRITE_BUFFERS_N    10
 #define WRITE_BUFFERS_SIZE 4000
 #define MAX_TA_LOOPS       100
+#define WATCH_DOMAINS      1000
+#define WATCHES_PER_DOMAIN 4
 
 struct test {
     char *name;
@@ -404,6 +406,68 @@ static int test_ta3_deinit(uintptr_t par)
     return verify_node(paths[0], "b", 1);
 }
 
+/*
+ * Domain boot storm: every domain has a few watches below its own subtree,
+ * and each of them gets a node written.  This is dominated by the cost of
+ * finding the watches matching a modified node.
+ */
+static int watch_path(char *buf, size_t len, unsigned int dom, unsigned int w)
+{
+    return snprintf(buf, len, "%s/%u/%u", path, dom, w);
+}
+
+static int test_watch_init(uintptr_t par)
+{
+    char node[64];
+    unsigned int dom, w;
+
+    for ( dom = 0; dom < par; dom++ )
+        for ( w = 0; w < WATCHES_PER_DOMAIN; w++ )
+        {
+            watch_path(node, sizeof(node), dom, w);
+            if ( !xs_watch(xsh, node, "storm") )
+                return errno;
+        }
+
+    return 0;
+}
+
+static int test_watch(uintptr_t par)
+{
+    char node[64];
+    unsigned int dom;
+
+    for ( dom = 0; dom < par; dom++ )
+    {
+        watch_path(node, sizeof(node), dom, dom % WATCHES_PER_DOMAIN);
+        if ( !xs_write(xsh, XBT_NULL, node, write_buffers[0], 1) )
+            return errno;
+    }
+
+    return 0;
+}
+
+static int test_watch_deinit(uintptr_t par)
+{
+    char node[64], **ev;
+    unsigned int dom, w;
+    int rc = 0;
+
+    for ( dom = 0; dom < par; dom++ )
+        for ( w = 0; w < WATCHES_PER_DOMAIN; w++ )
+        {
+            watch_path(node, sizeof(node), dom, w);
+            if ( !xs_unwatch(xsh, node, "storm") )
+                rc = errno;
+        }
+
+    /* Drop the queued events. */
+    while ( (ev = xs_check_watch(xsh)) )
+        free(ev);
+
+    return rc;
+}
+
 #define TEST(s, f, p, l) { s, f ## _init, f, f ## _deinit, (uintptr_t)(p), l }
 struct test tests[] = {
 TEST("read 1", test_read, 1, "Read node with 1 byte data"),
@@ -418,6 +482,8 @@ TEST("ta empty x", test_ta1, 1, "Empty transaction abort"),
 TEST("ta rmw", test_ta2, 0, "Read-modify-write transaction"),
 TEST("ta rmw x", test_ta2, 1, "Read-modify-write transaction abort"),
 TEST("ta err", test_ta3, 0, "Transaction with conflict"),
+TEST("watch", test_watch, WATCH_DOMAINS,
+     "Write a node for each of 1000 domains with watches"),
 };
 
 static void cleanup(void)
@@ -226,6 +226,27 @@ hashtable_remove(struct hashtable *h, void *k)
     return NULL;
 }
 
+/*****************************************************************************/
+int
+hashtable_iterate(struct hashtable *h,
+                  int (*func)(void *k, void *v, void *data), void *data)
+{
+    unsigned int i;
+    struct entry *e, *next;
+    int ret;
+
+    for (i = 0; i < h->tablelength; i++)
+    {
+        for (e = h->table[i]; NULL != e; e = next)
+        {
+            next = e->next;
+            ret = func(e->k, e->v, data);
+            if (ret) return ret;
+        }
+    }
+    return 0;
+}
+
 /*****************************************************************************/
 /* destroy */
 void
@@ -157,6 +157,23 @@ unsigned int
 hashtable_count(struct hashtable *h);
 
 
+/*****************************************************************************
+ * hashtable_iterate
+   
+ * @name        hashtable_iterate
+ * @param   h   the hashtable
+ * @param   func    function to call for each entry, stops at non-zero return
+ * @param   data    private data passed to func
+ * @return      the first non-zero return value of func, or 0
+ *
+ * func may remove the entry it has been called for, but no other entries.
+ */
+
+int
+hashtable_iterate(struct hashtable *h,
+                  int (*func)(void *k, void *v, void *data), void *data);
+
+
 /*****************************************************************************
  * hashtable_destroy
    
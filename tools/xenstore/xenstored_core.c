@@ -29,6 +29,7 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdarg.h>
 #include <stdlib.h>
@@ -354,14 +355,189 @@ static void initialize_fds(int sock, int *p_sock_pollfd_idx,
 	}
 }
 
+/*
+ * The node store.
+ *
+ * All nodes are kept in memory, in a hashtable keyed by the node name (or
+ * the transaction specific name for nodes private to a transaction).  Node
+ * records are never modified once stored: writing a node replaces the record
+ * by a new one, while readers take a reference to the current one.  So
+ * reading a node is a lookup rather than fetching and unmarshalling a copy,
+ * and committing a transaction just moves its records into place.
+ *
+ * Records have the layout of the TDB records, and unless the database is
+ * internal they are written through to the TDB file, as a dump of the store
+ * for xs_tdb_dump and the like.  The TDB is never read.
+ */
+struct node_record {
+	unsigned int refcnt;
+
+	/* Size of hdr, including the perms, data and children following. */
+	unsigned int size;
+
+	struct xs_tdb_record_hdr hdr;
+};
+
+struct store_entry {
+	struct node_record *rec;
+};
+
+static struct hashtable *nodes;
+
+static void get_record(struct node_record *rec)
+{
+	rec->refcnt++;
+}
+
+static void put_record(struct node_record *rec)
+{
+	if (!--rec->refcnt)
+		free(rec);
+}
+
+static int release_record(void *_ref)
+{
+	struct node_record **ref = _ref;
+
+	put_record(*ref);
+	return 0;
+}
+
+static struct node_record *store_fetch(const char *key)
+{
+	struct store_entry *entry = hashtable_search(nodes, (void *)key);
+
+	return entry ? entry->rec : NULL;
+}
+
+/* Mirror a change of a (global) node to the TDB file, if there is one. */
+static void store_mirror(const char *key, struct node_record *rec)
+{
+	TDB_DATA tdb_key, data;
+
+	if (!tdb_ctx || key[0] != '/')
+		return;
+
+	tdb_key.dptr = (char *)key;
+	tdb_key.dsize = strlen(key);
+
+	if (!rec) {
+		tdb_delete(tdb_ctx, tdb_key);
+		return;
+	}
+
+	data.dptr = (void *)&rec->hdr;
+	data.dsize = rec->size;
+	if (tdb_store(tdb_ctx, tdb_key, data, TDB_REPLACE) != 0)
+		log("TDB error on write of %s: %s", key,
+		    tdb_errorstr(tdb_ctx));
+}
+
+/* Make key refer to rec, which gets an additional reference. */
+static int store_store(const char *key, struct node_record *rec)
+{
+	struct store_entry *entry = hashtable_search(nodes, (void *)key);
+	char *name;
+
+	if (!entry) {
+		entry = malloc(sizeof(*entry));
+		name = strdup(key);
+		if (!entry || !name || !hashtable_insert(nodes, name, entry)) {
+			free(name);
+			free(entry);
+			errno = ENOMEM;
+			return errno;
+		}
+	} else
+		put_record(entry->rec);
+
+	get_record(rec);
+	entry->rec = rec;
+	store_mirror(key, rec);
+
+	return 0;
+}
+
+int store_delete(const char *key)
+{
+	struct store_entry *entry;
+
+	if (!hashtable_search(nodes, (void *)key)) {
+		errno = ENOENT;
+		return errno;
+	}
+
+	/* Key may be the table's own copy, which removing the entry frees. */
+	store_mirror(key, NULL);
+	entry = hashtable_remove(nodes, (void *)key);
+	put_record(entry->rec);
+	free(entry);
+
+	return 0;
+}
+
+uint64_t store_generation(const char *key)
+{
+	struct node_record *rec = store_fetch(key);
+
+	return rec ? rec->hdr.generation : NO_GENERATION;
+}
+
+int store_link(const char *key, const char *target)
+{
+	struct node_record *rec = store_fetch(target);
+
+	if (!rec) {
+		errno = ENOENT;
+		return errno;
+	}
+
+	return store_store(key, rec);
+}
+
+int store_move(const char *from, const char *to, uint64_t generation)
+{
+	struct node_record *rec = store_fetch(from);
+	size_t size;
+	int ret;
+
+	if (!rec) {
+		errno = ENOENT;
+		return errno;
+	}
+
+	/* Only the generation changes, in place if nobody else can see it. */
+	if (rec->refcnt > 1) {
+		size = offsetof(struct node_record, hdr) + rec->size;
+		rec = malloc(size);
+		if (!rec) {
+			errno = ENOMEM;
+			return errno;
+		}
+		memcpy(rec, store_fetch(from), size);
+		rec->refcnt = 1;
+	} else
+		get_record(rec);
+
+	rec->hdr.generation = generation;
+	ret = store_store(to, rec);
+	put_record(rec);
+
+	return ret ? ret : store_delete(from);
+}
+
 /*
  * If it fails, returns NULL and sets errno.
  * Temporary memory allocations will be done with ctx.
+ *
+ * The node's perms, data and children point into the stored record, and must
+ * be replaced rather than modified in place.
  */
 static struct node *read_node(struct connection *conn, const void *ctx,
 			      const char *name)
 {
-	TDB_DATA key, data;
+	TDB_DATA key;
+	struct node_record *rec, **ref;
 	struct xs_tdb_record_hdr *hdr;
 	struct node *node;
 
@@ -380,26 +556,30 @@ static struct node *read_node(struct connection *conn, const void *ctx,
 	if (transaction_prepend(conn, name, &key))
 		return NULL;
 
-	data = tdb_fetch(tdb_ctx, key);
+	rec = store_fetch(key.dptr);
 
-	if (data.dptr == NULL) {
-		if (tdb_error(tdb_ctx) == TDB_ERR_NOEXIST) {
-			node->generation = NO_GENERATION;
-			access_node(conn, node, NODE_ACCESS_READ, NULL);
-			errno = ENOENT;
-		} else {
-			log("TDB error on read: %s", tdb_errorstr(tdb_ctx));
-			errno = EIO;
-		}
+	if (!rec) {
+		node->generation = NO_GENERATION;
+		access_node(conn, node, NODE_ACCESS_READ, NULL);
 		talloc_free(node);
+		errno = ENOENT;
+		return NULL;
+	}
+
+	ref = talloc(node, struct node_record *);
+	if (!ref) {
+		talloc_free(node);
+		errno = ENOMEM;
 		return NULL;
 	}
+	get_record(rec);
+	*ref = rec;
+	talloc_set_destructor(ref, release_record);
 
 	node->parent = NULL;
-	talloc_steal(node, data.dptr);
 
 	/* Datalen, childlen, number of permissions */
-	hdr = (void *)data.dptr;
+	hdr = &rec->hdr;
 	node->generation = hdr->generation;
 	node->num_perms = hdr->num_perms;
 	node->datalen = hdr->datalen;
@@ -419,22 +599,30 @@ static struct node *read_node(struct connection *conn, const void *ctx,
 
 int write_node_raw(struct connection *conn, TDB_DATA *key, struct node *node)
 {
-	TDB_DATA data;
-	void *p;
+	struct node_record *rec;
 	struct xs_tdb_record_hdr *hdr;
+	unsigned int size;
+	void *p;
+	int ret;
 
-	data.dsize = sizeof(*hdr)
+	size = sizeof(*hdr)
 		+ node->num_perms*sizeof(node->perms[0])
 		+ node->datalen + node->childlen;
 
-	if (domain_is_unprivileged(conn) &&
-	    data.dsize >= quota_max_entry_size) {
+	if (domain_is_unprivileged(conn) && size >= quota_max_entry_size) {
 		errno = ENOSPC;
 		return errno;
 	}
 
-	data.dptr = talloc_size(node, data.dsize);
-	hdr = (void *)data.dptr;
+	rec = malloc(offsetof(struct node_record, hdr) + size);
+	if (!rec) {
+		errno = ENOMEM;
+		return errno;
+	}
+	rec->refcnt = 1;
+	rec->size = size;
+
+	hdr = &rec->hdr;
 	hdr->generation = node->generation;
 	hdr->num_perms = node->num_perms;
 	hdr->datalen = node->datalen;
@@ -446,13 +634,10 @@ int write_node_raw(struct connection *conn, TDB_DATA *key, struct node *node)
 	p += node->datalen;
 	memcpy(p, node->children, node->childlen);
 
-	/* TDB should set errno, but doesn't even set ecode AFAICT. */
-	if (tdb_store(tdb_ctx, *key, data, TDB_REPLACE) != 0) {
-		corrupt(conn, "Write of %s failed", key->dptr);
-		errno = EIO;
-		return errno;
-	}
-	return 0;
+	ret = store_store(key->dptr, rec);
+	put_record(rec);
+
+	return ret;
 }
 
 static int write_node(struct connection *conn, struct node *node)
@@ -891,7 +1076,7 @@ static void delete_node_single(struct connection *conn, struct node *node)
 	if (access_node(conn, node, NODE_ACCESS_DELETE, &key))
 		return;
 
-	if (tdb_delete(tdb_ctx, key) != 0) {
+	if (store_delete(key.dptr)) {
 		corrupt(conn, "Could not delete '%s'", node->name);
 		return;
 	}
@@ -971,15 +1156,11 @@ nomem:
 static int destroy_node(void *_node)
 {
 	struct node *node = _node;
-	TDB_DATA key;
 
 	if (streq(node->name, "/"))
 		corrupt(NULL, "Destroying root node!");
 
-	key.dptr = (void *)node->name;
-	key.dsize = strlen(node->name);
-
-	tdb_delete(tdb_ctx, key);
+	store_delete(node->name);
 	return 0;
 }
 
@@ -1113,7 +1294,14 @@ static int remove_child_entry(struct connection *conn, struct node *node,
 			      size_t offset)
 {
 	size_t childlen = strlen(node->children + offset);
-	memdel(node->children, offset, childlen + 1, node->childlen);
+	char *children;
+
+	/* The children may still be those of the stored record. */
+	children = talloc_memdup(node, node->children, node->childlen);
+	if (!children)
+		return ENOMEM;
+	memdel(children, offset, childlen + 1, node->childlen);
+	node->children = children;
 	node->childlen -= childlen + 1;
 	return write_node(conn, node);
 }
@@ -1547,13 +1735,19 @@ static void setup_structure(void)
 	if (!tdbname)
 		barf_perror("Could not create tdbname");
 
-	if (!(tdb_flags & TDB_INTERNAL))
-		unlink(tdbname);
+	nodes = create_hashtable(7919, hash_from_key_fn, keys_equal_fn);
+	if (!nodes)
+		barf_perror("Could not create node store");
 
-	tdb_ctx = tdb_open_ex(tdbname, 7919, tdb_flags, O_RDWR|O_CREAT|O_EXCL,
-			      0640, &tdb_logger, NULL);
-	if (!tdb_ctx)
-		barf_perror("Could not create tdb file %s", tdbname);
+	/* The TDB file is only a dump of the store. */
+	if (!(tdb_flags & TDB_INTERNAL)) {
+		unlink(tdbname);
+		tdb_ctx = tdb_open_ex(tdbname, 7919, tdb_flags,
+				      O_RDWR|O_CREAT|O_EXCL, 0640,
+				      &tdb_logger, NULL);
+		if (!tdb_ctx)
+			barf_perror("Could not create tdb file %s", tdbname);
+	}
 
 	manual_node("/", "tool");
 	manual_node("/tool", "xenstored");
@@ -1563,7 +1757,7 @@ static void setup_structure(void)
 }
 
 
-static unsigned int hash_from_key_fn(void *k)
+unsigned int hash_from_key_fn(void *k)
 {
 	char *str = k;
 	unsigned int hash = 5381;
@@ -1576,7 +1770,7 @@ static unsigned int hash_from_key_fn(void *k)
 }
 
 
-static int keys_equal_fn(void *key1, void *key2)
+int keys_equal_fn(void *key1, void *key2)
 {
 	return 0 == strcmp((char *)key1, (char *)key2);
 }
@@ -1709,12 +1903,11 @@ static int check_store_(const char *name, struct hashtable *reachable)
 /**
  * Helper to clean_store below.
  */
-static int clean_store_(TDB_CONTEXT *tdb, TDB_DATA key, TDB_DATA val,
-			void *private)
+static int clean_store_(void *key, void *val, void *private)
 {
 	struct hashtable *reachable = private;
 	char *slash;
-	char * name = talloc_strndup(NULL, key.dptr, key.dsize);
+	char * name = talloc_strdup(NULL, key);
 
 	if (!name) {
 		log("clean_store: ENOMEM");
@@ -1729,7 +1922,7 @@ static int clean_store_(TDB_CONTEXT *tdb, TDB_DATA key, TDB_DATA val,
 	if (!hashtable_search(reachable, name)) {
 		log("clean_store: '%s' is orphaned!", name);
 		if (recovery) {
-			tdb_delete(tdb, key);
+			store_delete(key);
 		}
 	}
 
@@ -1745,7 +1938,7 @@ static int clean_store_(TDB_CONTEXT *tdb, TDB_DATA key, TDB_DATA val,
  */
 static void clean_store(struct hashtable *reachable)
 {
-	tdb_traverse(tdb_ctx, &clean_store_, reachable);
+	hashtable_iterate(nodes, &clean_store_, reachable);
 }
 
 
@@ -1878,7 +2071,7 @@ static void usage(void)
 "  -t, --transaction <nb>  limit the number of transaction allowed per domain,\n"
 "  -R, --no-recovery       to request that no recovery should be attempted when\n"
 "                          the store is corrupted (debug only),\n"
-"  -I, --internal-db       store database in memory, not on disk\n"
+"  -I, --internal-db       don't dump the database to a file on disk\n"
 "  -V, --verbose           to request verbose execution.\n");
 }
 
@@ -1918,7 +2111,7 @@ int main(int argc, char *argv[])
 	int timeout;
 
 
-	while ((opt = getopt_long(argc, argv, "DE:F:HNPS:t:T:RVW:", options,
+	while ((opt = getopt_long(argc, argv, "DE:F:HINPS:t:T:RVW:", options,
 				  NULL)) != -1) {
 		switch (opt) {
 		case 'D':
@@ -148,9 +148,21 @@ void send_ack(struct connection *conn, enum xsd_sockmsg_type type);
 /* Canonicalize this path if possible. */
 char *canonicalize(struct connection *conn, const void *ctx, const char *node);
 
-/* Write a node to the tdb data base. */
+/* Write a node to the node store. */
 int write_node_raw(struct connection *conn, TDB_DATA *key, struct node *node);
 
+/* Remove a record from the node store. */
+int store_delete(const char *key);
+
+/* Generation count of a stored record, or NO_GENERATION if there is none. */
+uint64_t store_generation(const char *key);
+
+/* Make key refer to the same record as target. */
+int store_link(const char *key, const char *target);
+
+/* Move a record to another key, setting its generation count. */
+int store_move(const char *from, const char *to, uint64_t generation);
+
 /* Get this node, checking we have permissions. */
 struct node *get_node(struct connection *conn,
 		      const void *ctx,
@@ -208,6 +220,10 @@ xengnttab_handle **xgt_handle;
 
 int remember_string(struct hashtable *hash, const char *str);
 
+/* Hash and compare functions for hashtables keyed by strings. */
+unsigned int hash_from_key_fn(void *k);
+int keys_equal_fn(void *key1, void *key2);
+
 #endif /* _XENSTORED_CORE_H */
 
 /*
@@ -40,7 +40,7 @@
  * Some notes regarding detection and handling of transaction conflicts:
  *
  * Basic source of reference is the 'generation' count. Each writing access
- * (either normal write or in a transaction) to the tdb data base will set
+ * (either normal write or in a transaction) to the node store will set
  * the node specific generation count to the global generation count.
  * For being able to identify a transaction the transaction specific generation
  * count is initialized with the global generation count when starting the
@@ -228,7 +228,6 @@ int access_node(struct connection *conn, struct node *node,
 {
 	struct accessed_node *i = NULL;
 	struct transaction *trans;
-	TDB_DATA local_key;
 	const char *trans_name = NULL;
 	int ret;
 	bool introduce = false;
@@ -268,15 +267,14 @@ int access_node(struct connection *conn, struct node *node,
 		 * Additional transaction-specific node for read type. We only
 		 * have to verify read nodes if we didn't write them.
 		 *
-		 * The node is created and written to DB here to distinguish
-		 * from the write types.
+		 * The transaction node shares the record of the global one
+		 * here, to distinguish from the write types.
 		 */
 		if (type == NODE_ACCESS_READ) {
 			i->generation = node->generation;
 			i->check_gen = true;
 			if (node->generation != NO_GENERATION) {
-				set_tdb_key(trans_name, &local_key);
-				ret = write_node_raw(conn, &local_key, node);
+				ret = store_link(trans_name, node->name);
 				if (ret)
 					goto err;
 				i->ta_node = true;
@@ -315,35 +313,17 @@ err:
 /*
  * Finalize transaction:
  * Walk through accessed nodes and check generation against global data.
- * If all entries match, read the transaction entries and write them without
- * transaction prepended. Delete all transaction specific nodes in the data
- * base.
+ * If all entries match, move the transaction entries to the global names.
+ * Delete all other transaction specific nodes in the store.
  */
 static int finalize_transaction(struct connection *conn,
 				struct transaction *trans)
 {
 	struct accessed_node *i;
-	TDB_DATA key, ta_key, data;
-	struct xs_tdb_record_hdr *hdr;
-	uint64_t gen;
 	char *trans_name;
-	int ret;
 
 	list_for_each_entry(i, &trans->accessed, list) {
-		if (!i->check_gen)
-			continue;
-
-		set_tdb_key(i->node, &key);
-		data = tdb_fetch(tdb_ctx, key);
-		hdr = (void *)data.dptr;
-		if (!data.dptr) {
-			if (tdb_error(tdb_ctx) != TDB_ERR_NOEXIST)
-				return EIO;
-			gen = NO_GENERATION;
-		} else
-			gen = hdr->generation;
-		talloc_free(data.dptr);
-		if (i->generation != gen)
+		if (i->check_gen && i->generation != store_generation(i->node))
 			return EAGAIN;
 	}
 
@@ -353,27 +333,15 @@ static int finalize_transaction(struct connection *conn,
 			/* We are doomed: the transaction is only partial. */
 			goto err;
 
-		set_tdb_key(trans_name, &ta_key);
-
 		if (i->modified) {
-			set_tdb_key(i->node, &key);
 			if (i->ta_node) {
-				data = tdb_fetch(tdb_ctx, ta_key);
-				if (!data.dptr)
-					goto err;
-				hdr = (void *)data.dptr;
-				hdr->generation = generation++;
-				ret = tdb_store(tdb_ctx, key, data,
-						TDB_REPLACE);
-				talloc_free(data.dptr);
-				if (ret)
+				if (store_move(trans_name, i->node,
+					       generation++))
 					goto err;
-			} else if (tdb_delete(tdb_ctx, key))
+			} else if (store_delete(i->node))
 					goto err;
 			fire_watches(conn, trans, i->node, false);
-		}
-
-		if (i->ta_node && tdb_delete(tdb_ctx, ta_key))
+		} else if (i->ta_node && store_delete(trans_name))
 			goto err;
 		list_del(&i->list);
 		talloc_free(i);
@@ -391,7 +359,6 @@ static int destroy_transaction(void *_transaction)
 	struct transaction *trans = _transaction;
 	struct accessed_node *i;
 	char *trans_name;
-	TDB_DATA key;
 
 	wrl_ntransactions--;
 	trace_destroy(trans, "transaction");
@@ -399,10 +366,8 @@ static int destroy_transaction(void *_transaction)
 		if (i->ta_node) {
 			trans_name = transaction_get_node_name(i, trans,
 							       i->node);
-			if (trans_name) {
-				set_tdb_key(trans_name, &key);
-				tdb_delete(tdb_ctx, key);
-			}
+			if (trans_name)
+				store_delete(trans_name);
 		}
 		list_del(&i->list);
 		talloc_free(i);
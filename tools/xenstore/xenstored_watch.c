@@ -37,6 +37,13 @@ struct watch
 	/* Watches on this connection */
 	struct list_head list;
 
+	/* Connection this watch belongs to. */
+	struct connection *conn;
+
+	/* Watches on the same path, and the index node holding them. */
+	struct list_head index_list;
+	struct watch_node *index;
+
 	/* Current outstanding events applying to this watch. */
 	struct list_head events;
 
@@ -47,31 +54,142 @@ struct watch
 	char *node;
 };
 
-static bool check_event_node(const char *node)
+/*
+ * All watches are indexed by path, so that firing watches for a node only
+ * has to look at the watches on the node, on its ancestors and, when a whole
+ * subtree changes, on its descendants, rather than at every watch of every
+ * connection.
+ *
+ * Each watched path and each of its ancestors has an index node, holding
+ * the watches on exactly that path and linking to the index nodes of its
+ * children.  Special "@" paths hang off "/", as a watch on "/" has always
+ * fired for every event, special or not.
+ */
+struct watch_node
 {
-	if (!node || !strstarts(node, "@")) {
-		errno = EINVAL;
-		return false;
+	/* Watches on exactly this path. */
+	struct list_head watches;
+
+	/* Index nodes of child paths, and our entry in our parent's list. */
+	struct list_head children;
+	struct list_head sibling;
+	struct watch_node *parent;
+
+	/* Key in watch_index, owned by the hashtable. */
+	char *path;
+};
+
+static struct hashtable *watch_index;
+
+/* Return the parent path for the index, or NULL for "/". */
+static char *watch_parent_path(const char *path)
+{
+	const char *slash;
+
+	if (streq(path, "/"))
+		return NULL;
+
+	slash = strrchr(path, '/');
+	if (!slash || slash == path)
+		return strdup("/");
+
+	return strndup(path, slash - path);
+}
+
+/* Free index nodes without watches or children, working towards "/". */
+static void watch_node_put(struct watch_node *node)
+{
+	struct watch_node *parent;
+
+	while (node && list_empty(&node->watches) &&
+	       list_empty(&node->children)) {
+		parent = node->parent;
+		if (parent)
+			list_del(&node->sibling);
+		hashtable_remove(watch_index, node->path);
+		free(node);
+		node = parent;
 	}
-	return true;
 }
 
-/* Is child a subnode of parent, or equal? */
-static bool is_child(const char *child, const char *parent)
+/* Find the index node for a path, creating it and its ancestors if needed. */
+static struct watch_node *watch_node_get(const char *path)
 {
-	unsigned int len = strlen(parent);
+	struct watch_node *node, *parent = NULL;
+	char *ppath;
+
+	if (!watch_index) {
+		watch_index = create_hashtable(128, hash_from_key_fn,
+					       keys_equal_fn);
+		if (!watch_index)
+			return NULL;
+	}
 
-	/*
-	 * / should really be "" for this algorithm to work, but that's a
-	 * usability nightmare.
-	 */
-	if (streq(parent, "/"))
-		return true;
+	node = hashtable_search(watch_index, (void *)path);
+	if (node)
+		return node;
+
+	if (!streq(path, "/")) {
+		ppath = watch_parent_path(path);
+		if (!ppath)
+			return NULL;
+		parent = watch_node_get(ppath);
+		free(ppath);
+		if (!parent)
+			return NULL;
+	}
 
-	if (strncmp(child, parent, len) != 0)
-		return false;
+	node = calloc(1, sizeof(*node));
+	if (node)
+		node->path = strdup(path);
+	if (!node || !node->path ||
+	    !hashtable_insert(watch_index, node->path, node)) {
+		if (node)
+			free(node->path);
+		free(node);
+		watch_node_put(parent);
+		return NULL;
+	}
+
+	INIT_LIST_HEAD(&node->watches);
+	INIT_LIST_HEAD(&node->children);
+	node->parent = parent;
+	if (parent)
+		list_add_tail(&node->sibling, &parent->children);
+
+	return node;
+}
 
-	return child[len] == '/' || child[len] == '\0';
+static int watch_index_add(struct watch *watch)
+{
+	struct watch_node *node = watch_node_get(watch->node);
+
+	if (!node)
+		return ENOMEM;
+
+	list_add_tail(&watch->index_list, &node->watches);
+	watch->index = node;
+
+	return 0;
+}
+
+static void watch_index_del(struct watch *watch)
+{
+	if (!watch->index)
+		return;
+
+	list_del(&watch->index_list);
+	watch_node_put(watch->index);
+	watch->index = NULL;
+}
+
+static bool check_event_node(const char *node)
+{
+	if (!node || !strstarts(node, "@")) {
+		errno = EINVAL;
+		return false;
+	}
+	return true;
 }
 
 /*
@@ -119,6 +237,32 @@ static void add_event(struct connection *conn,
 	talloc_free(data);
 }
 
+/* Send an event for name to each watch on exactly the given path. */
+static void fire_path_watches(void *ctx, const char *path, const char *name)
+{
+	struct watch_node *node = hashtable_search(watch_index, (void *)path);
+	struct watch *watch;
+
+	if (!node)
+		return;
+
+	list_for_each_entry(watch, &node->watches, index_list)
+		add_event(watch->conn, ctx, watch, name);
+}
+
+/* Send an event to each watch strictly below the given index node. */
+static void fire_subtree_watches(void *ctx, struct watch_node *node)
+{
+	struct watch_node *child;
+	struct watch *watch;
+
+	list_for_each_entry(child, &node->children, sibling) {
+		list_for_each_entry(watch, &child->watches, index_list)
+			add_event(watch->conn, ctx, watch, watch->node);
+		fire_subtree_watches(ctx, child);
+	}
+}
+
 /*
  * Check whether any watch events are to be sent.
  * Temporary memory allocations are done with ctx.
@@ -126,26 +270,42 @@ static void add_event(struct connection *conn,
 void fire_watches(struct connection *conn, void *ctx, const char *name,
 		  bool recurse)
 {
-	struct connection *i;
-	struct watch *watch;
+	struct watch_node *node;
+	char *path, *slash;
 
 	/* During transactions, don't fire watches. */
 	if (conn && conn->transaction)
 		return;
 
-	/* Create an event for each watch. */
-	list_for_each_entry(i, &connections, list) {
-		list_for_each_entry(watch, &i->watches, list) {
-			if (is_child(name, watch->node))
-				add_event(i, ctx, watch, name);
-			else if (recurse && is_child(watch->node, name))
-				add_event(i, ctx, watch, watch->node);
+	if (!watch_index)
+		return;
+
+	/* Watches on the node itself or on any of its ancestors. */
+	fire_path_watches(ctx, "/", name);
+	if (!streq(name, "/")) {
+		path = talloc_strdup(ctx, name);
+		if (!path)
+			return;
+		for (slash = path + 1; (slash = strchr(slash, '/')); slash++) {
+			*slash = '\0';
+			fire_path_watches(ctx, path, name);
+			*slash = '/';
 		}
+		fire_path_watches(ctx, path, name);
+		talloc_free(path);
+	}
+
+	/* Watches on any of its descendants, if they're affected too. */
+	if (recurse) {
+		node = hashtable_search(watch_index, (void *)name);
+		if (node)
+			fire_subtree_watches(ctx, node);
 	}
 }
 
 static int destroy_watch(void *_watch)
 {
+	watch_index_del(_watch);
 	trace_destroy(_watch, "watch");
 	return 0;
 }
@@ -197,8 +357,14 @@ int do_watch(struct connection *conn, struct buffered_data *in)
 	else
 		watch->relative_path = NULL;
 
+	watch->conn = conn;
 	INIT_LIST_HEAD(&watch->events);
 
+	if (watch_index_add(watch)) {
+		talloc_free(watch);
+		return ENOMEM;
+	}
+
 	domain_watch_inc(conn);
 	list_add_tail(&watch->list, &conn->watches);
 	trace_create(watch, "watch");
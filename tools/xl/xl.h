@@ -47,6 +47,7 @@ struct domain_create {
     const char *restore_file;
     char *colo_proxy_script;
     bool userspace_colo_proxy;
+    int restore_workers;
     int migrate_fd; /* -1 means none */
     int send_back_fd; /* -1 means none */
     char **migration_domname_r; /* from malloc */
@@ -167,6 +167,13 @@ struct cmd_spec cmd_table[] = {
       "-e              Do not wait in the background (on <host>) for the death\n"
       "                of the domain.\n"
       "--debug         Print huge (!) amount of debug during the migration process.\n"
+      "--workers <n>   Map guest memory using <n> threads alongside the sender,\n"
+      "                and copy it in using <n> threads on <host>.\n"
+      "--compress      Compress guest memory, eliding zero and unchanged data.\n"
+      "--auto-converge Throttle the vCPUs dirtying memory fastest, until the\n"
+      "                final pause is expected to be short enough.\n"
+      "--max-downtime <ms> Aim for a final pause of at most <ms>.  Implies\n"
+      "                --auto-converge.\n"
       "-p              Do not unpause domain after migrating it."
     },
     { "restore",
@@ -178,7 +185,9 @@ struct cmd_spec cmd_table[] = {
       "-e                       Do not wait in the background for the death of the domain.\n"
       "-d                       Enable debug messages.\n"
       "-V, --vncviewer          Connect to the VNC display after the domain is created.\n"
-      "-A, --vncviewer-autopass Pass VNC password to viewer via stdin."
+      "-A, --vncviewer-autopass Pass VNC password to viewer via stdin.\n"
+      "--workers <n>            Copy guest memory in using <n> threads alongside\n"
+      "                         the reader."
     },
     { "migrate-receive",
       &main_migrate_receive, 0, 1,
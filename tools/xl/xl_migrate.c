@@ -14,6 +14,7 @@
 
 #include <fcntl.h>
 #include <inttypes.h>
+#include <limits.h>
 #include <signal.h>
 #include <stdlib.h>
 #include <sys/stat.h>
@@ -176,7 +177,8 @@ static void migrate_do_preamble(int send_fd, int recv_fd, pid_t child,
 
 }
 
-static void migrate_domain(uint32_t domid, const char *rune, int debug,
+static void migrate_domain(uint32_t domid, const char *rune, int flags,
+                           const libxl_domain_suspend_params *params,
                            const char *override_config_file)
 {
     pid_t child = -1;
@@ -185,7 +187,7 @@ static void migrate_domain(uint32_t domid, const char *rune, int debug,
     char *away_domname;
     char rc_buf;
     uint8_t *config_data;
-    int config_len, flags = LIBXL_SUSPEND_LIVE;
+    int config_len;
 
     save_domain_core_begin(domid, override_config_file,
                            &config_data, &config_len);
@@ -203,9 +205,8 @@ static void migrate_domain(uint32_t domid, const char *rune, int debug,
 
     xtl_stdiostream_adjust_flags(logger, XTL_STDIOSTREAM_HIDE_PROGRESS, 0);
 
-    if (debug)
-        flags |= LIBXL_SUSPEND_DEBUG;
-    rc = libxl_domain_suspend(ctx, domid, send_fd, flags, NULL);
+    rc = libxl_domain_suspend_with_params(ctx, domid, send_fd, flags, params,
+                                          NULL);
     if (rc) {
         fprintf(stderr, "migration sender: libxl_domain_suspend failed"
                 " (rc=%d)\n", rc);
@@ -320,7 +321,8 @@ static void migrate_receive(int debug, int daemonize, int monitor,
                             int send_fd, int recv_fd,
                             libxl_checkpointed_stream checkpointed,
                             char *colo_proxy_script,
-                            bool userspace_colo_proxy)
+                            bool userspace_colo_proxy,
+                            int workers)
 {
     uint32_t domid;
     int rc, rc2;
@@ -349,6 +351,7 @@ static void migrate_receive(int debug, int daemonize, int monitor,
     dom_info.checkpointed_stream = checkpointed;
     dom_info.colo_proxy_script = colo_proxy_script;
     dom_info.userspace_colo_proxy = userspace_colo_proxy;
+    dom_info.restore_workers = workers;
 
     rc = create_domain(&dom_info);
     if (rc < 0) {
@@ -479,14 +482,15 @@ int main_migrate_receive(int argc, char **argv)
 {
     int debug = 0, daemonize = 1, monitor = 1, pause_after_migration = 0;
     libxl_checkpointed_stream checkpointed = LIBXL_CHECKPOINTED_STREAM_NONE;
-    int opt;
+    int opt, workers = 0;
     bool userspace_colo_proxy = false;
-    char *script = NULL;
+    char *script = NULL, *endptr;
     static struct option opts[] = {
         {"colo", 0, 0, 0x100},
         /* It is a shame that the management code for disk is not here. */
         {"coloft-script", 1, 0, 0x200},
         {"userspace-colo-proxy", 0, 0, 0x300},
+        {"workers", 1, 0, 0x400},
         COMMON_LONG_OPTS
     };
 
@@ -513,6 +517,13 @@ int main_migrate_receive(int argc, char **argv)
     case 0x300:
         userspace_colo_proxy = true;
         break;
+    case 0x400: /* --workers */
+        workers = strtol(optarg, &endptr, 10);
+        if (*endptr || workers < 0) {
+            fprintf(stderr, "Invalid number of workers \"%s\"\n", optarg);
+            return EXIT_FAILURE;
+        }
+        break;
     case 'p':
         pause_after_migration = 1;
         break;
@@ -524,7 +535,7 @@ int main_migrate_receive(int argc, char **argv)
     }
     migrate_receive(debug, daemonize, monitor, pause_after_migration,
                     STDOUT_FILENO, STDIN_FILENO,
-                    checkpointed, script, userspace_colo_proxy);
+                    checkpointed, script, userspace_colo_proxy, workers);
 
     return EXIT_SUCCESS;
 }
@@ -537,12 +548,22 @@ int main_migrate(int argc, char **argv)
     char *rune = NULL;
     char *host;
     int opt, daemonize = 1, monitor = 1, debug = 0, pause_after_migration = 0;
+    int flags = LIBXL_SUSPEND_LIVE;
+    libxl_domain_suspend_params params;
+    long downtime;
+    char *endptr;
     static struct option opts[] = {
         {"debug", 0, 0, 0x100},
         {"live", 0, 0, 0x200},
+        {"workers", 1, 0, 0x300},
+        {"compress", 0, 0, 0x400},
+        {"auto-converge", 0, 0, 0x500},
+        {"max-downtime", 1, 0, 0x600},
         COMMON_LONG_OPTS
     };
 
+    libxl_domain_suspend_params_init(&params);
+
     SWITCH_FOREACH_OPT(opt, "FC:s:ep", opts, "migrate", 2) {
     case 'C':
         config_filename = optarg;
@@ -566,8 +587,33 @@ int main_migrate(int argc, char **argv)
     case 0x200: /* --live */
         /* ignored for compatibility with xm */
         break;
+    case 0x300: /* --workers */
+        params.workers = strtol(optarg, &endptr, 10);
+        if (*endptr || params.workers < 0) {
+            fprintf(stderr, "Invalid number of workers \"%s\"\n", optarg);
+            return EXIT_FAILURE;
+        }
+        break;
+    case 0x400: /* --compress */
+        flags |= LIBXL_SUSPEND_ENCODE_PAGES;
+        break;
+    case 0x500: /* --auto-converge */
+        flags |= LIBXL_SUSPEND_AUTO_CONVERGE;
+        break;
+    case 0x600: /* --max-downtime */
+        downtime = strtol(optarg, &endptr, 10);
+        if (*endptr || downtime <= 0 || downtime > INT_MAX) {
+            fprintf(stderr, "Invalid downtime \"%s\"\n", optarg);
+            return EXIT_FAILURE;
+        }
+        params.max_downtime_ms = downtime;
+        flags |= LIBXL_SUSPEND_AUTO_CONVERGE;
+        break;
     }
 
+    if (debug)
+        flags |= LIBXL_SUSPEND_DEBUG;
+
     domid = find_domain(argv[optind]);
     host = argv[optind + 1];
 
@@ -578,6 +624,7 @@ int main_migrate(int argc, char **argv)
     } else {
         char verbose_buf[minmsglevel_default+3];
         int verbose_len;
+        char workers_buf[32] = "";
         verbose_buf[0] = ' ';
         verbose_buf[1] = '-';
         memset(verbose_buf+2, 'v', minmsglevel_default);
@@ -587,16 +634,21 @@ int main_migrate(int argc, char **argv)
         } else {
             verbose_len = (minmsglevel_default - minmsglevel) + 2;
         }
-        xasprintf(&rune, "exec %s %s xl%s%.*s migrate-receive%s%s%s",
+        if (params.workers)
+            snprintf(workers_buf, sizeof(workers_buf), " --workers %d",
+                     params.workers);
+        xasprintf(&rune, "exec %s %s xl%s%.*s migrate-receive%s%s%s%s",
                   ssh_command, host,
                   pass_tty_arg ? " -t" : "",
                   verbose_len, verbose_buf,
                   daemonize ? "" : " -e",
                   debug ? " -d" : "",
-                  pause_after_migration ? " -p" : "");
+                  pause_after_migration ? " -p" : "",
+                  workers_buf);
     }
 
-    migrate_domain(domid, rune, debug, config_filename);
+    migrate_domain(domid, rune, flags, &params, config_filename);
+    libxl_domain_suspend_params_dispose(&params);
     return EXIT_SUCCESS;
 }
 
@@ -165,11 +165,13 @@ int main_restore(int argc, char **argv)
     const char *config_file = NULL;
     struct domain_create dom_info;
     int paused = 0, debug = 0, daemonize = 1, monitor = 1,
-        console_autoconnect = 0, vnc = 0, vncautopass = 0;
+        console_autoconnect = 0, vnc = 0, vncautopass = 0, workers = 0;
     int opt, rc;
+    char *endptr;
     static struct option opts[] = {
         {"vncviewer", 0, 0, 'V'},
         {"vncviewer-autopass", 0, 0, 'A'},
+        {"workers", 1, 0, 0x100},
         COMMON_LONG_OPTS
     };
 
@@ -196,6 +198,13 @@ int main_restore(int argc, char **argv)
     case 'A':
         vnc = vncautopass = 1;
         break;
+    case 0x100: /* --workers */
+        workers = strtol(optarg, &endptr, 10);
+        if (*endptr || workers < 0) {
+            fprintf(stderr, "Invalid number of workers \"%s\"\n", optarg);
+            return EXIT_FAILURE;
+        }
+        break;
     }
 
     if (argc-optind == 1) {
@@ -220,6 +229,7 @@ int main_restore(int argc, char **argv)
     dom_info.vnc = vnc;
     dom_info.vncautopass = vncautopass;
     dom_info.console_autoconnect = console_autoconnect;
+    dom_info.restore_workers = workers;
 
     rc = create_domain(&dom_info);
     if (rc < 0)
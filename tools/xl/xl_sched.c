@@ -210,7 +210,8 @@ static int sched_credit2_domain_output(int domid)
     libxl_domain_sched_params scinfo;
 
     if (domid < 0) {
-        printf("%-33s %4s %6s %4s\n", "Name", "ID", "Weight", "Cap");
+        printf("%-33s %4s %6s %4s %8s\n", "Name", "ID", "Weight", "Cap",
+               "Locality");
         return 0;
     }
 
@@ -220,11 +221,12 @@ static int sched_credit2_domain_output(int domid)
         return 1;
     }
     domname = libxl_domid_to_name(ctx, domid);
-    printf("%-33s %4d %6d %4d\n",
+    printf("%-33s %4d %6d %4d %7d%%\n",
         domname,
         domid,
         scinfo.weight,
-        scinfo.cap);
+        scinfo.cap,
+        scinfo.locality);
     free(domname);
     libxl_domain_sched_params_dispose(&scinfo);
     return 0;
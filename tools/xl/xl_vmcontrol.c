@@ -909,6 +909,7 @@ start:
         params.colo_proxy_script = dom_info->colo_proxy_script;
         libxl_defbool_set(&params.userspace_colo_proxy,
                           dom_info->userspace_colo_proxy);
+        params.workers = dom_info->restore_workers;
 
         ret = libxl_domain_create_restore(ctx, &d_config,
                                           &domid, restore_fd,
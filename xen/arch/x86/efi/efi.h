@@ -0,0 +1 @@
+../../../common/efi/efi.h
\ No newline at end of file
@@ -442,12 +442,9 @@ static int dm_op(const struct dmop_args *op_args)
         const struct xen_dm_op_ioreq_server_range *data =
             &op.u.map_io_range_to_ioreq_server;
 
-        rc = -EINVAL;
-        if ( data->pad )
-            break;
-
         rc = hvm_map_io_range_to_ioreq_server(d, data->id, data->type,
-                                              data->start, data->end);
+                                              data->start, data->end,
+                                              data->flags);
         break;
     }
 
@@ -457,7 +454,7 @@ static int dm_op(const struct dmop_args *op_args)
             &op.u.unmap_io_range_from_ioreq_server;
 
         rc = -EINVAL;
-        if ( data->pad )
+        if ( data->flags )
             break;
 
         rc = hvm_unmap_io_range_from_ioreq_server(d, data->id, data->type,
@@ -298,7 +298,8 @@ static int hvmemul_do_io(
         else
         {
             rc = hvm_send_ioreq(s, &p, 0);
-            if ( rc != X86EMUL_RETRY || currd->is_shutting_down )
+            if ( rc != X86EMUL_RETRY || currd->is_shutting_down ||
+                 !hvm_io_pending(curr) )
                 vio->io_req.state = STATE_IOREQ_NONE;
             else if ( !hvm_ioreq_needs_completion(&vio->io_req) )
                 rc = X86EMUL_OKAY;
@@ -2395,6 +2396,170 @@ int hvm_emulate_one_mmio(unsigned long mfn, unsigned long gla)
     return rc;
 }
 
+/* Complete simple MOVs to/from emulated MMIO without x86_emulate(). */
+static bool __read_mostly opt_hvm_fast_mmio = true;
+boolean_param("hvm_fast_mmio", opt_hvm_fast_mmio);
+
+/* Outcomes of hvm_emulate_mmio_fast(), as recorded in TRC_HVM_MMIO_FAST. */
+#define MMIO_FAST_DONE    0
+#define MMIO_FAST_STATE   1 /* vCPU not in a suitable state */
+#define MMIO_FAST_FETCH   2 /* instruction bytes unavailable */
+#define MMIO_FAST_INSN    3 /* not a simple MOV */
+#define MMIO_FAST_ADDR    4 /* operand doesn't match the faulting access */
+
+static void mmio_fast_retire(struct cpu_user_regs *regs, unsigned int len,
+                             unsigned int reg, unsigned int size,
+                             uint8_t dir, unsigned long data)
+{
+    if ( dir == IOREQ_READ )
+    {
+        unsigned long *dst = decode_gpr(regs, reg);
+
+        if ( size == 4 ) /* Needs zero extension. */
+            *dst = (uint32_t)data;
+        else
+            memcpy(dst, &data, size);
+    }
+
+    regs->rip += len;
+    regs->eflags &= ~X86_EFLAGS_RF;
+}
+
+/*
+ * Try to complete an access to emulated MMIO at @gpa, raised by a simple MOV
+ * in 64-bit mode, without going through the full instruction emulator.
+ * Returns false if the caller is to use handle_mmio() instead.
+ */
+bool hvm_emulate_mmio_fast(paddr_t gpa, unsigned long gla,
+                           struct npfec access)
+{
+    struct vcpu *curr = current;
+    struct hvm_vcpu_io *vio = &curr->arch.hvm_vcpu.hvm_io;
+    struct cpu_user_regs *regs = guest_cpu_user_regs();
+    struct x86_simple_mov mov;
+    struct segment_register cs;
+    uint8_t insn[MAX_INST_LEN] = {};
+    unsigned int insn_bytes, res;
+    unsigned long one_rep = 1;
+    uint8_t dir;
+    int rc;
+
+    if ( !opt_hvm_fast_mmio )
+        return false;
+
+    res = MMIO_FAST_STATE;
+    if ( access.kind != npfec_kind_with_gla || access.insn_fetch ||
+         vio->io_req.state != STATE_IOREQ_NONE ||
+         (regs->eflags & X86_EFLAGS_TF) || !hvm_long_mode_active(curr) ||
+         hvm_funcs.get_interrupt_shadow(curr) )
+        goto out;
+
+    hvm_get_segment_register(curr, x86_seg_cs, &cs);
+    if ( !cs.l )
+        goto out;
+
+    insn_bytes = hvm_get_insn_bytes(curr, insn);
+    if ( !insn_bytes &&
+         hvm_fetch_from_guest_linear(insn, regs->rip, sizeof(insn),
+                                     PFEC_page_present |
+                                     (hvm_get_cpl(curr) == 3
+                                      ? PFEC_user_mode : 0),
+                                     NULL) == HVMTRANS_okay )
+        insn_bytes = sizeof(insn);
+
+    switch ( x86_decode_simple_mov(insn, insn_bytes, regs, &mov) )
+    {
+    case X86EMUL_OKAY:
+        break;
+    case X86EMUL_UNHANDLEABLE:
+        res = MMIO_FAST_FETCH;
+        goto out;
+    default:
+        res = MMIO_FAST_INSN;
+        goto out;
+    }
+
+    /*
+     * The memory operand must be the one the fault was raised for.  Where
+     * the linear address isn't reported (SVM), at least its page offset has
+     * to be the GPA's.  The access also must not leave the page.
+     */
+    res = MMIO_FAST_ADDR;
+    if ( mov.write != access.write_access ||
+         (access.gla_valid ? mov.ea != gla : (mov.ea ^ gpa) & ~PAGE_MASK) ||
+         (gpa & ~PAGE_MASK) + mov.bytes > PAGE_SIZE )
+        goto out;
+
+    res = MMIO_FAST_DONE;
+
+ out:
+    HVMTRACE_3D(MMIO_FAST, res, gpa, gpa >> 32);
+
+    if ( res != MMIO_FAST_DONE )
+    {
+        perfc_incr(hvm_mmio_fast_fallback);
+        return false;
+    }
+
+    perfc_incr(hvm_mmio_fast);
+
+    dir = mov.write ? IOREQ_WRITE : IOREQ_READ;
+    rc = hvmemul_do_mmio_buffer(gpa, &one_rep, mov.bytes, dir, 0, &mov.data);
+
+    switch ( rc )
+    {
+    case X86EMUL_OKAY:
+        mmio_fast_retire(regs, mov.len, mov.reg, mov.bytes, dir, mov.data);
+        break;
+
+    case X86EMUL_RETRY:
+        if ( hvm_ioreq_needs_completion(&vio->io_req) )
+        {
+            vio->io_completion = HVMIO_mmio_fast_completion;
+            vio->mmio_fast_len = mov.len;
+            vio->mmio_fast_reg = mov.reg;
+        }
+        break;
+
+    case X86EMUL_UNHANDLEABLE:
+        gdprintk(XENLOG_WARNING, "MMIO fast path: %s of %#"PRIpaddr" failed\n",
+                 mov.write ? "write" : "read", gpa);
+        hvm_inject_hw_exception(TRAP_gp_fault, 0);
+        break;
+
+    default:
+        gdprintk(XENLOG_ERR, "Weird HVM ioemulation status %d.\n", rc);
+        domain_crash(curr->domain);
+        break;
+    }
+
+    return true;
+}
+
+/* Retire a MOV handled by hvm_emulate_mmio_fast() once its ioreq is done. */
+bool hvm_emulate_mmio_fast_completion(void)
+{
+    struct hvm_vcpu_io *vio = &current->arch.hvm_vcpu.hvm_io;
+    const ioreq_t *p = &vio->io_req;
+    unsigned long data = 0, one_rep = 1;
+    unsigned int size = p->size;
+    uint8_t dir = p->dir;
+    int rc;
+
+    rc = hvmemul_do_mmio_buffer(p->addr, &one_rep, size, dir, 0, &data);
+    if ( rc != X86EMUL_OKAY )
+    {
+        gdprintk(XENLOG_ERR, "Weird HVM ioemulation status %d.\n", rc);
+        domain_crash(current->domain);
+        return false;
+    }
+
+    mmio_fast_retire(guest_cpu_user_regs(), vio->mmio_fast_len,
+                     vio->mmio_fast_reg, size, dir, data);
+
+    return true;
+}
+
 void hvm_emulate_one_vm_event(enum emul_kind kind, unsigned int trapnr,
     unsigned int errcode)
 {
@@ -2473,6 +2638,7 @@ void hvm_emulate_init_once(
     hvmemul_ctxt->ctxt.regs = regs;
     hvmemul_ctxt->ctxt.vendor = curr->domain->arch.cpuid->x86_vendor;
     hvmemul_ctxt->ctxt.force_writeback = true;
+    hvmemul_ctxt->ctxt.decode_cache = curr->arch.hvm_vcpu.hvm_io.decode_cache;
 }
 
 void hvm_emulate_init_per_insn(
@@ -1530,6 +1530,10 @@ int hvm_vcpu_initialise(struct vcpu *v)
 
     v->arch.hvm_vcpu.inject_event.vector = HVM_EVENT_VECTOR_UNSET;
 
+    /* Optional: instructions simply always get decoded in full without. */
+    v->arch.hvm_vcpu.hvm_io.decode_cache =
+        _xzalloc(x86_decode_cache_size(), SMP_CACHE_BYTES);
+
     rc = setup_compat_arg_xlat(v); /* teardown: free_compat_arg_xlat() */
     if ( rc != 0 )
         goto fail4;
@@ -1559,6 +1563,7 @@ int hvm_vcpu_initialise(struct vcpu *v)
  fail5:
     free_compat_arg_xlat(v);
  fail4:
+    XFREE(v->arch.hvm_vcpu.hvm_io.decode_cache);
     hvm_funcs.vcpu_destroy(v);
  fail3:
     vlapic_destroy(v);
@@ -1581,6 +1586,8 @@ void hvm_vcpu_destroy(struct vcpu *v)
 
     free_compat_arg_xlat(v);
 
+    XFREE(v->arch.hvm_vcpu.hvm_io.decode_cache);
+
     tasklet_kill(&v->arch.hvm_vcpu.assert_evtchn_irq_tasklet);
     hvm_funcs.vcpu_destroy(v);
 
@@ -1857,7 +1864,12 @@ int hvm_hap_nested_page_fault(paddr_t gpa, unsigned long gla,
          (npfec.write_access &&
           (p2m_is_discard_write(p2mt) || (p2mt == p2m_ioreq_server))) )
     {
-        if ( !handle_mmio_with_translation(gla, gpa >> PAGE_SHIFT, npfec) )
+        bool done = (p2mt == p2m_mmio_dm || p2mt == p2m_ioreq_server) &&
+                    !nestedhvm_vcpu_in_guestmode(curr) &&
+                    hvm_emulate_mmio_fast(gpa, gla, npfec);
+
+        if ( !done &&
+             !handle_mmio_with_translation(gla, gpa >> PAGE_SHIFT, npfec) )
             hvm_inject_hw_exception(TRAP_gp_fault, 0);
         rc = 1;
         goto out_put_gfn;
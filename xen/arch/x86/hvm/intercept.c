@@ -211,28 +211,95 @@ int hvm_process_io_intercept(const struct hvm_io_handler *handler,
     return rc;
 }
 
+/* Find the fixed range port I/O handler covering port, if any. */
+static const struct hvm_io_handler *hvm_find_portio_handler(
+    const struct hvm_domain *hd, unsigned int port)
+{
+    unsigned int lo = 0, hi = hd->portio_count;
+
+    while ( lo < hi )
+    {
+        unsigned int mid = (lo + hi) / 2;
+        const struct hvm_io_handler *handler =
+            &hd->io_handler[hd->portio_index[mid]];
+
+        if ( port < handler->portio.port )
+            hi = mid;
+        else if ( port >= handler->portio.port + handler->portio.size )
+            lo = mid + 1;
+        else
+            return handler;
+    }
+
+    return NULL;
+}
+
+/*
+ * Handlers are looked for in registration order.  The fixed range port I/O
+ * handlers are indexed by port though, so that only the handlers with an
+ * accept() hook of their own registered before the one covering the port
+ * need probing.  For MMIO, the handler which accepted the vCPU's previous
+ * access is tried first.  Either way, the ranges accepted by the various
+ * handlers are not expected to overlap.
+ */
 static const struct hvm_io_handler *hvm_find_io_handler(const ioreq_t *p)
 {
-    struct domain *curr_d = current->domain;
-    unsigned int i;
+    struct vcpu *curr = current;
+    const struct hvm_domain *hd = &curr->domain->arch.hvm_domain;
+    const struct hvm_io_handler *handler = NULL;
+    unsigned int i, hint = NR_IO_HANDLERS, end = hd->io_handler_count;
+    unsigned int probes = 0;
 
     BUG_ON((p->type != IOREQ_TYPE_PIO) &&
            (p->type != IOREQ_TYPE_COPY));
 
-    for ( i = 0; i < curr_d->arch.hvm_domain.io_handler_count; i++ )
+    if ( p->type == IOREQ_TYPE_PIO )
     {
-        const struct hvm_io_handler *handler =
-            &curr_d->arch.hvm_domain.io_handler[i];
-        const struct hvm_io_ops *ops = handler->ops;
+        handler = hvm_find_portio_handler(hd, p->addr);
+        if ( handler )
+        {
+            probes++;
+            if ( handler->ops->accept(handler, p) )
+                end = handler - hd->io_handler;
+            else
+                handler = NULL;
+        }
+    }
+    else
+    {
+        hint = curr->arch.hvm_vcpu.hvm_io.mmio_handler_hint;
+        if ( hint < end && hd->io_handler[hint].type == p->type )
+        {
+            probes++;
+            if ( hd->io_handler[hint].ops->accept(&hd->io_handler[hint], p) )
+            {
+                handler = &hd->io_handler[hint];
+                end = 0;
+            }
+        }
+    }
 
-        if ( handler->type != p->type )
+    for ( i = 0; i < end; i++ )
+    {
+        const struct hvm_io_handler *h = &hd->io_handler[i];
+
+        if ( h->type != p->type || h->ops == &portio_ops || i == hint )
             continue;
 
-        if ( ops->accept(handler, p) )
-            return handler;
+        probes++;
+        if ( h->ops->accept(h, p) )
+        {
+            handler = h;
+            break;
+        }
     }
 
-    return NULL;
+    perfc_incr_histo(hvm_io_probes, probes);
+
+    if ( handler && p->type == IOREQ_TYPE_COPY )
+        curr->arch.hvm_vcpu.hvm_io.mmio_handler_hint = handler - hd->io_handler;
+
+    return handler;
 }
 
 int hvm_io_intercept(ioreq_t *p)
@@ -283,6 +350,30 @@ void register_mmio_handler(struct domain *d,
     handler->mmio.ops = ops;
 }
 
+/* Insert io_handler[idx] into the port-sorted index. */
+static void portio_index_add(struct hvm_domain *hd, unsigned int idx)
+{
+    unsigned int port = hd->io_handler[idx].portio.port;
+    unsigned int i = hd->portio_count++;
+
+    for ( ; i && hd->io_handler[hd->portio_index[i - 1]].portio.port > port;
+          i-- )
+        hd->portio_index[i] = hd->portio_index[i - 1];
+    hd->portio_index[i] = idx;
+}
+
+static void portio_index_del(struct hvm_domain *hd, unsigned int idx)
+{
+    unsigned int i = 0;
+
+    while ( hd->portio_index[i] != idx )
+        i++;
+    ASSERT(i < hd->portio_count);
+
+    memmove(&hd->portio_index[i], &hd->portio_index[i + 1],
+            (--hd->portio_count - i) * sizeof(*hd->portio_index));
+}
+
 void register_portio_handler(struct domain *d, unsigned int port,
                              unsigned int size, portio_action_t action)
 {
@@ -296,6 +387,9 @@ void register_portio_handler(struct domain *d, unsigned int port,
     handler->portio.port = port;
     handler->portio.size = size;
     handler->portio.action = action;
+
+    portio_index_add(&d->arch.hvm_domain,
+                     handler - d->arch.hvm_domain.io_handler);
 }
 
 void relocate_portio_handler(struct domain *d, unsigned int old_port,
@@ -308,13 +402,15 @@ void relocate_portio_handler(struct domain *d, unsigned int old_port,
         struct hvm_io_handler *handler =
             &d->arch.hvm_domain.io_handler[i];
 
-        if ( handler->type != IOREQ_TYPE_PIO )
+        if ( handler->ops != &portio_ops )
             continue;
 
         if ( (handler->portio.port == old_port) &&
              (handler->portio.size = size) )
         {
+            portio_index_del(&d->arch.hvm_domain, i);
             handler->portio.port = new_port;
+            portio_index_add(&d->arch.hvm_domain, i);
             break;
         }
     }
@@ -26,6 +26,7 @@
 #include <xen/domain.h>
 #include <xen/event.h>
 #include <xen/paging.h>
+#include <xen/perfc.h>
 #include <xen/vpci.h>
 
 #include <asm/hvm/hvm.h>
@@ -181,6 +182,29 @@ static bool hvm_wait_for_io(struct hvm_ioreq_vcpu *sv, ioreq_t *p)
     return true;
 }
 
+/*
+ * Whether the device model of @s has consumed the writes posted to it up
+ * to index @prod.
+ */
+static bool hvm_posted_drained(const struct hvm_ioreq_server *s,
+                               uint32_t prod)
+{
+    const posted_iopage_t *pg = s->posted_ring[0].va;
+
+    return !pg || (int32_t)(read_atomic(&pg->cons) - prod) >= 0;
+}
+
+static void hvm_wait_for_posted(struct hvm_ioreq_server *s,
+                                struct hvm_ioreq_vcpu *sv)
+{
+    while ( !hvm_posted_drained(s, sv->drain_prod) )
+        wait_on_xen_event_channel(s->bufioreq_evtchn,
+                                  hvm_posted_drained(s, sv->drain_prod));
+
+    sv->drain = false;
+    sv->vcpu->arch.hvm_vcpu.hvm_io.posted_drain = false;
+}
+
 bool handle_hvm_io_completion(struct vcpu *v)
 {
     struct domain *d = v->domain;
@@ -197,13 +221,16 @@ bool handle_hvm_io_completion(struct vcpu *v)
                               &s->ioreq_vcpu_list,
                               list_entry )
         {
-            if ( sv->vcpu == v && sv->pending )
-            {
-                if ( !hvm_wait_for_io(sv, get_ioreq(s, v)) )
-                    return false;
+            if ( sv->vcpu != v )
+                continue;
 
-                break;
-            }
+            if ( sv->drain )
+                hvm_wait_for_posted(s, sv);
+
+            if ( sv->pending && !hvm_wait_for_io(sv, get_ioreq(s, v)) )
+                return false;
+
+            break;
         }
     }
 
@@ -218,6 +245,9 @@ bool handle_hvm_io_completion(struct vcpu *v)
     case HVMIO_mmio_completion:
         return handle_mmio();
 
+    case HVMIO_mmio_fast_completion:
+        return hvm_emulate_mmio_fast_completion();
+
     case HVMIO_pio_completion:
         return handle_pio(vio->io_req.addr, vio->io_req.size,
                           vio->io_req.dir);
@@ -324,23 +354,9 @@ static int hvm_map_ioreq_gfn(struct hvm_ioreq_server *s, bool buf)
     return rc;
 }
 
-static int hvm_alloc_ioreq_mfn(struct hvm_ioreq_server *s, bool buf)
+static int hvm_alloc_ioreq_page(struct hvm_ioreq_server *s,
+                                struct hvm_ioreq_page *iorp)
 {
-    struct hvm_ioreq_page *iorp = buf ? &s->bufioreq : &s->ioreq;
-
-    if ( iorp->page )
-    {
-        /*
-         * If a guest frame has already been mapped (which may happen
-         * on demand if hvm_get_ioreq_server_info() is called), then
-         * allocating a page is not permitted.
-         */
-        if ( !gfn_eq(iorp->gfn, INVALID_GFN) )
-            return -EPERM;
-
-        return 0;
-    }
-
     /*
      * Allocated IOREQ server pages are assigned to the emulating
      * domain, not the target domain. This is safe because the emulating
@@ -374,10 +390,8 @@ static int hvm_alloc_ioreq_mfn(struct hvm_ioreq_server *s, bool buf)
     return -ENOMEM;
 }
 
-static void hvm_free_ioreq_mfn(struct hvm_ioreq_server *s, bool buf)
+static void hvm_free_ioreq_page(struct hvm_ioreq_page *iorp)
 {
-    struct hvm_ioreq_page *iorp = buf ? &s->bufioreq : &s->ioreq;
-
     if ( !iorp->page )
         return;
 
@@ -388,6 +402,71 @@ static void hvm_free_ioreq_mfn(struct hvm_ioreq_server *s, bool buf)
     iorp->page = NULL;
 }
 
+static int hvm_alloc_ioreq_mfn(struct hvm_ioreq_server *s, bool buf)
+{
+    struct hvm_ioreq_page *iorp = buf ? &s->bufioreq : &s->ioreq;
+
+    if ( iorp->page )
+    {
+        /*
+         * If a guest frame has already been mapped (which may happen
+         * on demand if hvm_get_ioreq_server_info() is called), then
+         * allocating a page is not permitted.
+         */
+        if ( !gfn_eq(iorp->gfn, INVALID_GFN) )
+            return -EPERM;
+
+        return 0;
+    }
+
+    return hvm_alloc_ioreq_page(s, iorp);
+}
+
+static void hvm_free_ioreq_mfn(struct hvm_ioreq_server *s, bool buf)
+{
+    hvm_free_ioreq_page(buf ? &s->bufioreq : &s->ioreq);
+}
+
+/*
+ * The posted write ring is only ever handed out through
+ * XENMEM_acquire_resource, so its pages never have a guest frame.
+ */
+static int hvm_alloc_posted_ring(struct hvm_ioreq_server *s)
+{
+    unsigned int i;
+    int rc;
+
+    if ( s->posted_ring[0].page )
+        return 0;
+
+    for ( i = 0; i < ARRAY_SIZE(s->posted_ring); i++ )
+    {
+        rc = hvm_alloc_ioreq_page(s, &s->posted_ring[i]);
+        if ( rc )
+            goto fail;
+    }
+
+    /* Ask for a notification on the first posted write. */
+    ((posted_iopage_t *)s->posted_ring[0].va)->prod_event = 1;
+    s->posted_prod = 0;
+
+    return 0;
+
+ fail:
+    while ( i-- )
+        hvm_free_ioreq_page(&s->posted_ring[i]);
+
+    return rc;
+}
+
+static void hvm_free_posted_ring(struct hvm_ioreq_server *s)
+{
+    unsigned int i;
+
+    for ( i = 0; i < ARRAY_SIZE(s->posted_ring); i++ )
+        hvm_free_ioreq_page(&s->posted_ring[i]);
+}
+
 bool is_ioreq_server_page(struct domain *d, const struct page_info *page)
 {
     const struct hvm_ioreq_server *s;
@@ -398,11 +477,20 @@ bool is_ioreq_server_page(struct domain *d, const struct page_info *page)
 
     FOR_EACH_IOREQ_SERVER(d, id, s)
     {
+        unsigned int i;
+
         if ( (s->ioreq.page == page) || (s->bufioreq.page == page) )
         {
             found = true;
             break;
         }
+
+        for ( i = 0; i < ARRAY_SIZE(s->posted_ring); i++ )
+            if ( s->posted_ring[i].page == page )
+                found = true;
+
+        if ( found )
+            break;
     }
 
     spin_unlock_recursive(&d->arch.hvm_domain.ioreq_server.lock);
@@ -460,6 +548,21 @@ static void hvm_update_ioreq_evtchn(struct hvm_ioreq_server *s,
 #define HANDLE_BUFIOREQ(s) \
     ((s)->bufioreq_handling != HVM_IOREQSRV_BUFIOREQ_OFF)
 
+/*
+ * The device model notifies the buffered ioreq event channel once it has
+ * consumed the posted writes up to cons_event.  Wake every vCPU waiting
+ * for that, rather than the one the channel happens to be bound to.
+ */
+static void hvm_posted_drain_notification(struct vcpu *v, unsigned int port)
+{
+    struct vcpu *w;
+
+    for_each_vcpu ( v->domain, w )
+        if ( w->arch.hvm_vcpu.hvm_io.posted_drain &&
+             test_and_clear_bit(_VPF_blocked_in_xen, &w->pause_flags) )
+            vcpu_wake(w);
+}
+
 static int hvm_ioreq_server_add_vcpu(struct hvm_ioreq_server *s,
                                      struct vcpu *v)
 {
@@ -486,7 +589,8 @@ static int hvm_ioreq_server_add_vcpu(struct hvm_ioreq_server *s,
         struct domain *d = s->target;
 
         rc = alloc_unbound_xen_event_channel(v->domain, 0,
-                                             s->emulator->domain_id, NULL);
+                                             s->emulator->domain_id,
+                                             hvm_posted_drain_notification);
         if ( rc < 0 )
             goto fail3;
 
@@ -560,6 +664,14 @@ static void hvm_ioreq_server_remove_all_vcpus(struct hvm_ioreq_server *s)
 
         list_del(&sv->list_entry);
 
+        if ( sv->drain )
+        {
+            /* Nothing will drain the ring now: let the vCPU retry. */
+            v->arch.hvm_vcpu.hvm_io.posted_drain = false;
+            if ( test_and_clear_bit(_VPF_blocked_in_xen, &v->pause_flags) )
+                vcpu_wake(v);
+        }
+
         if ( v->vcpu_id == 0 && HANDLE_BUFIOREQ(s) )
             free_xen_event_channel(v->domain, s->bufioreq_evtchn);
 
@@ -609,6 +721,7 @@ static int hvm_ioreq_server_alloc_pages(struct hvm_ioreq_server *s)
 
 static void hvm_ioreq_server_free_pages(struct hvm_ioreq_server *s)
 {
+    hvm_free_posted_ring(s);
     hvm_free_ioreq_mfn(s, true);
     hvm_free_ioreq_mfn(s, false);
 }
@@ -622,6 +735,9 @@ static void hvm_ioreq_server_free_rangesets(struct hvm_ioreq_server *s)
 
     for ( i = 0; i < NR_IO_RANGE_TYPES; i++ )
         rangeset_destroy(s->range[i]);
+
+    for ( i = 0; i < ARRAY_SIZE(s->posted); i++ )
+        rangeset_destroy(s->posted[i]);
 }
 
 static int hvm_ioreq_server_alloc_rangesets(struct hvm_ioreq_server *s,
@@ -659,6 +775,27 @@ static int hvm_ioreq_server_alloc_rangesets(struct hvm_ioreq_server *s,
         rangeset_limit(s->range[i], MAX_NR_IO_RANGES);
     }
 
+    for ( i = 0; i < ARRAY_SIZE(s->posted); i++ )
+    {
+        char *name;
+
+        rc = asprintf(&name, "ioreq_server %d posted %s", id,
+                      (i == XEN_DMOP_IO_RANGE_PORT) ? "port" : "memory");
+        if ( rc )
+            goto fail;
+
+        s->posted[i] = rangeset_new(s->target, name,
+                                    RANGESETF_prettyprint_hex);
+
+        xfree(name);
+
+        rc = -ENOMEM;
+        if ( !s->posted[i] )
+            goto fail;
+
+        rangeset_limit(s->posted[i], MAX_NR_IO_RANGES);
+    }
+
  done:
     return 0;
 
@@ -1001,6 +1138,18 @@ int hvm_get_ioreq_server_frame(struct domain *d, ioservid_t id,
         rc = 0;
         break;
 
+    case XENMEM_resource_ioreq_server_frame_posted(0) ...
+         XENMEM_resource_ioreq_server_frame_posted(IOREQ_POSTED_PAGES):
+        idx -= XENMEM_resource_ioreq_server_frame_posted(0);
+
+        rc = -ENOENT;
+        if ( !s->posted_ring[idx].page )
+            goto out;
+
+        *mfn = page_to_mfn(s->posted_ring[idx].page);
+        rc = 0;
+        break;
+
     default:
         rc = -EINVAL;
         break;
@@ -1014,13 +1163,13 @@ int hvm_get_ioreq_server_frame(struct domain *d, ioservid_t id,
 
 int hvm_map_io_range_to_ioreq_server(struct domain *d, ioservid_t id,
                                      uint32_t type, uint64_t start,
-                                     uint64_t end)
+                                     uint64_t end, uint32_t flags)
 {
     struct hvm_ioreq_server *s;
-    struct rangeset *r;
+    struct rangeset *r, *posted = NULL;
     int rc;
 
-    if ( start > end )
+    if ( start > end || (flags & ~XEN_DMOP_io_range_posted) )
         return -EINVAL;
 
     if ( id == DEFAULT_IOSERVID )
@@ -1061,7 +1210,26 @@ int hvm_map_io_range_to_ioreq_server(struct domain *d, ioservid_t id,
     if ( rangeset_overlaps_range(r, start, end) )
         goto out;
 
+    if ( flags & XEN_DMOP_io_range_posted )
+    {
+        rc = -EINVAL;
+        if ( type == XEN_DMOP_IO_RANGE_PCI || !HANDLE_BUFIOREQ(s) )
+            goto out;
+
+        posted = s->posted[type];
+
+        rc = hvm_alloc_posted_ring(s);
+        if ( rc )
+            goto out;
+    }
+
     rc = rangeset_add_range(r, start, end);
+    if ( rc || !posted )
+        goto out;
+
+    rc = rangeset_add_range(posted, start, end);
+    if ( rc && rangeset_remove_range(r, start, end) )
+        WARN();
 
  out:
     spin_unlock_recursive(&d->arch.hvm_domain.ioreq_server.lock);
@@ -1120,6 +1288,9 @@ int hvm_unmap_io_range_from_ioreq_server(struct domain *d, ioservid_t id,
 
     rc = rangeset_remove_range(r, start, end);
 
+    if ( !rc && type != XEN_DMOP_IO_RANGE_PCI )
+        rc = rangeset_remove_range(s->posted[type], start, end);
+
  out:
     spin_unlock_recursive(&d->arch.hvm_domain.ioreq_server.lock);
 
@@ -1480,6 +1651,137 @@ static int hvm_send_buffered_ioreq(struct hvm_ioreq_server *s, ioreq_t *p)
     return X86EMUL_OKAY;
 }
 
+static bool hvm_ioreq_is_posted(const struct hvm_ioreq_server *s,
+                                const ioreq_t *p)
+{
+    if ( IS_DEFAULT(s) || p->dir != IOREQ_WRITE || p->data_is_ptr ||
+         p->count != 1 )
+        return false;
+
+    switch ( p->type )
+    {
+    case IOREQ_TYPE_PIO:
+        return rangeset_contains_range(s->posted[XEN_DMOP_IO_RANGE_PORT],
+                                       p->addr, p->addr + p->size - 1);
+
+    case IOREQ_TYPE_COPY:
+        return rangeset_contains_range(s->posted[XEN_DMOP_IO_RANGE_MEMORY],
+                                       hvm_mmio_first_byte(p),
+                                       hvm_mmio_last_byte(p));
+    }
+
+    return false;
+}
+
+/*
+ * Queue a write to a posted range and let the vCPU carry on.  The device
+ * model is only notified when it asked to be, through prod_event, so a
+ * burst of doorbell writes costs it a single wakeup.
+ */
+static int hvm_send_posted_ioreq(struct hvm_ioreq_server *s, ioreq_t *p)
+{
+    struct domain *d = current->domain;
+    posted_iopage_t *pg = s->posted_ring[0].va;
+    posted_ioreq_t *slot;
+    uint32_t idx;
+
+    BUILD_BUG_ON(sizeof(posted_iopage_t) > PAGE_SIZE);
+    BUILD_BUG_ON(IOREQ_POSTED_SLOTS_PER_PAGE * sizeof(posted_ioreq_t) !=
+                 PAGE_SIZE);
+
+    spin_lock(&s->bufioreq_lock);
+
+    idx = s->posted_prod;
+    if ( idx - read_atomic(&pg->cons) >= IOREQ_POSTED_SLOT_NUM )
+    {
+        /* The ring is full: the write waits behind it on the normal path. */
+        spin_unlock(&s->bufioreq_lock);
+        perfc_incr(ioreq_posted_full);
+        return X86EMUL_UNHANDLEABLE;
+    }
+
+    idx %= IOREQ_POSTED_SLOT_NUM;
+    slot = s->posted_ring[1 + idx / IOREQ_POSTED_SLOTS_PER_PAGE].va;
+    slot += idx % IOREQ_POSTED_SLOTS_PER_PAGE;
+
+    slot->addr = p->addr;
+    slot->data = p->data;
+    slot->type = p->type;
+    slot->size = p->size;
+
+    /* Make the slot visible /before/ prod. */
+    smp_wmb();
+    write_atomic(&pg->prod, ++s->posted_prod);
+
+    /* Order the write of prod against the read of prod_event. */
+    smp_mb();
+    if ( s->posted_prod == read_atomic(&pg->prod_event) )
+        notify_via_xen_event_channel(d, s->bufioreq_evtchn);
+
+    spin_unlock(&s->bufioreq_lock);
+
+    perfc_incr(ioreq_posted);
+
+    return X86EMUL_OKAY;
+}
+
+/*
+ * A synchronous ioreq must not overtake writes posted to the same server.
+ * While any are yet to be consumed, have the device model notify Xen once
+ * it has consumed them, and make @sv's vCPU wait for that in
+ * handle_hvm_io_completion() before it retries the access.  The device
+ * model is only kicked when cons_event moves, i.e. once per drain however
+ * many vCPUs end up waiting.
+ */
+static bool hvm_posted_hold_back(struct hvm_ioreq_server *s,
+                                 struct hvm_ioreq_vcpu *sv, const ioreq_t *p)
+{
+    posted_iopage_t *pg = s->posted_ring[0].va;
+    uint32_t prod;
+
+    if ( !pg )
+        return false;
+
+    switch ( p->type )
+    {
+    case IOREQ_TYPE_PIO:
+    case IOREQ_TYPE_COPY:
+    case IOREQ_TYPE_PCI_CONFIG:
+        break;
+
+    default:
+        return false;
+    }
+
+    spin_lock(&s->bufioreq_lock);
+
+    prod = s->posted_prod;
+    if ( hvm_posted_drained(s, prod) )
+    {
+        spin_unlock(&s->bufioreq_lock);
+        return false;
+    }
+
+    if ( read_atomic(&pg->cons_event) != prod )
+    {
+        write_atomic(&pg->cons_event, prod);
+        notify_via_xen_event_channel(s->target, s->bufioreq_evtchn);
+    }
+
+    spin_unlock(&s->bufioreq_lock);
+
+    sv->drain_prod = prod;
+    sv->drain = true;
+    sv->vcpu->arch.hvm_vcpu.hvm_io.posted_drain = true;
+
+    /* Get to hvm_do_resume() before going back to the guest. */
+    raise_softirq(SCHEDULE_SOFTIRQ);
+
+    perfc_incr(ioreq_posted_drain);
+
+    return true;
+}
+
 int hvm_send_ioreq(struct hvm_ioreq_server *s, ioreq_t *proto_p,
                    bool buffered)
 {
@@ -1492,8 +1794,9 @@ int hvm_send_ioreq(struct hvm_ioreq_server *s, ioreq_t *proto_p,
     if ( buffered )
         return hvm_send_buffered_ioreq(s, proto_p);
 
-    if ( unlikely(!vcpu_start_shutdown_deferral(curr)) )
-        return X86EMUL_RETRY;
+    if ( hvm_ioreq_is_posted(s, proto_p) &&
+         hvm_send_posted_ioreq(s, proto_p) == X86EMUL_OKAY )
+        return X86EMUL_OKAY;
 
     list_for_each_entry ( sv,
                           &s->ioreq_vcpu_list,
@@ -1504,6 +1807,16 @@ int hvm_send_ioreq(struct hvm_ioreq_server *s, ioreq_t *proto_p,
             evtchn_port_t port = sv->ioreq_evtchn;
             ioreq_t *p = get_ioreq(s, curr);
 
+            /*
+             * Nothing is sent while held back, so hvm_io_pending() stays
+             * false and the caller has the vCPU retry the access.
+             */
+            if ( hvm_posted_hold_back(s, sv, proto_p) )
+                return X86EMUL_RETRY;
+
+            if ( unlikely(!vcpu_start_shutdown_deferral(curr)) )
+                return X86EMUL_RETRY;
+
             if ( unlikely(p->state != STATE_IOREQ_NONE) )
             {
                 gprintk(XENLOG_ERR, "device model set bad IO state %d\n",
@@ -3961,6 +3961,7 @@ int donate_page(
     page->count_info = PGC_allocated | 1;
     page_set_owner(page, d);
     page_list_add_tail(page,&d->page_list);
+    domain_adjust_node_pages(d, page, 1);
 
     spin_unlock(&d->page_alloc_lock);
     return 0;
@@ -4025,6 +4026,7 @@ int steal_page(
     if ( !(memflags & MEMF_no_refcount) && !domain_adjust_tot_pages(d, -1) )
         drop_dom_ref = true;
     page_list_del(page, &d->page_list);
+    domain_adjust_node_pages(d, page, -1);
 
     spin_unlock(&d->page_alloc_lock);
     if ( unlikely(drop_dom_ref) )
@@ -237,6 +237,30 @@ static void hap_clean_dirty_bitmap(struct domain *d)
     flush_tlb_mask(d->dirty_cpumask);
 }
 
+/*
+ * As above, but only for the given pfns.  This goes entry by entry, like
+ * paging_log_dirty_range(), rather than through p2m_change_type_range(),
+ * which would also record the ranges in the p2m's log-dirty rangeset.
+ */
+static void hap_clean_dirty_ranges(struct domain *d,
+                                   const struct xen_domctl_dirty_range *r,
+                                   unsigned int nr)
+{
+    struct p2m_domain *p2m = p2m_get_hostp2m(d);
+    unsigned long pfn;
+    unsigned int i;
+
+    p2m_lock(p2m);
+
+    for ( i = 0; i < nr; i++ )
+        for ( pfn = r[i].pfn; pfn < r[i].pfn + r[i].nr; pfn++ )
+            p2m_change_type_one(d, pfn, p2m_ram_rw, p2m_ram_logdirty);
+
+    p2m_unlock(p2m);
+
+    flush_tlb_mask(d->dirty_cpumask);
+}
+
 /************************************************/
 /*             HAP SUPPORT FUNCTIONS            */
 /************************************************/
@@ -429,6 +453,7 @@ void hap_domain_init(struct domain *d)
         .enable  = hap_enable_log_dirty,
         .disable = hap_disable_log_dirty,
         .clean   = hap_clean_dirty_bitmap,
+        .clean_ranges = hap_clean_dirty_ranges,
     };
 
     INIT_PAGE_LIST_HEAD(&d->arch.paging.hap.freelist);
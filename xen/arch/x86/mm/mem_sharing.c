@@ -625,6 +625,7 @@ static int page_make_sharable(struct domain *d,
     page_set_owner(page, dom_cow);
     drop_dom_ref = !domain_adjust_tot_pages(d, -1);
     page_list_del(page, &d->page_list);
+    domain_adjust_node_pages(d, page, -1);
     spin_unlock(&d->page_alloc_lock);
 
     if ( drop_dom_ref )
@@ -673,6 +674,7 @@ static int page_make_private(struct domain *d, struct page_info *page)
     if ( domain_adjust_tot_pages(d, 1) == 1 )
         get_knownalive_domain(d);
     page_list_add_tail(page, &d->page_list);
+    domain_adjust_node_pages(d, page, 1);
     spin_unlock(&d->page_alloc_lock);
 
     put_page(page);
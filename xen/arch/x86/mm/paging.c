@@ -256,8 +256,11 @@ static int paging_log_dirty_disable(struct domain *d, bool_t resuming)
     return ret;
 }
 
-/* Mark a page as dirty, with taking guest pfn as parameter */
-void paging_mark_pfn_dirty(struct domain *d, pfn_t pfn)
+/*
+ * Mark a page as dirty, crediting it to vcpu @v (if any) when newly dirty,
+ * for the toolstack's per-vcpu dirty rate estimates.
+ */
+static void mark_pfn_dirty(struct domain *d, pfn_t pfn, struct vcpu *v)
 {
     bool changed;
     mfn_t mfn, *l4, *l3, *l2;
@@ -326,6 +329,8 @@ void paging_mark_pfn_dirty(struct domain *d, pfn_t pfn)
                      "d%d: marked mfn %" PRI_mfn " (pfn %" PRI_pfn ")\n",
                      d->domain_id, mfn_x(mfn), pfn_x(pfn));
         d->arch.paging.log_dirty.dirty_count++;
+        if ( v )
+            v->arch.paging.log_dirty_count++;
     }
 
 out:
@@ -334,6 +339,18 @@ out:
     return;
 }
 
+void paging_mark_pfn_dirty(struct domain *d, pfn_t pfn)
+{
+    struct vcpu *curr = current;
+
+    mark_pfn_dirty(d, pfn, curr->domain == d ? curr : NULL);
+}
+
+void paging_mark_pfn_dirty_vcpu(struct vcpu *v, pfn_t pfn)
+{
+    mark_pfn_dirty(v->domain, pfn, v);
+}
+
 /* Mark a page as dirty */
 void paging_mark_dirty(struct domain *d, mfn_t gmfn)
 {
@@ -586,6 +603,223 @@ static int paging_log_dirty_op(struct domain *d,
     return rv;
 }
 
+/* Order of the number of pfns covered by a leaf, and by L3 and L4 entries. */
+#define LOGDIRTY_LEAF_SHIFT (PAGE_SHIFT + 3)
+#define LOGDIRTY_L3E_SHIFT  (LOGDIRTY_LEAF_SHIFT + PAGETABLE_ORDER)
+#define LOGDIRTY_L4E_SHIFT  (LOGDIRTY_L3E_SHIFT + PAGETABLE_ORDER)
+#define LOGDIRTY_LEAF_BITS  (1UL << LOGDIRTY_LEAF_SHIFT)
+
+/* Ranges gathered under the paging lock before being re-armed and copied. */
+#define LOGDIRTY_RANGES_BATCH 32
+/* Populated leaves looked at between preemption checks. */
+#define LOGDIRTY_RANGES_LEAVES 64
+/* Pfns cleaned, i.e. write protected again, between preemption checks. */
+#define LOGDIRTY_RANGES_PFNS 4096
+
+static inline unsigned long logdirty_next(unsigned long pfn, unsigned int shift)
+{
+    return (pfn | ((1UL << shift) - 1)) + 1;
+}
+
+/*
+ * Gather up to @max ranges of dirty pfns in [*@ppfn, @end), leaving *@ppfn
+ * where the next call should carry on.  Missing subtrees are skipped
+ * without being looked at.  When cleaning, leaves which end up empty are
+ * freed, so that later passes only visit leaves dirtied in the meantime.
+ */
+static unsigned int paging_log_dirty_gather(struct domain *d,
+                                            unsigned long *ppfn,
+                                            unsigned long end,
+                                            xen_domctl_dirty_range_t *r,
+                                            unsigned int max, bool clean)
+{
+    struct log_dirty_domain *ld = &d->arch.paging.log_dirty;
+    unsigned long pfn = *ppfn, todo = clean ? LOGDIRTY_RANGES_PFNS : ~0UL;
+    unsigned int nr = 0, leaves = 0;
+    mfn_t mfn, *l4, *l3, *l2;
+    unsigned long *l1;
+
+    ASSERT(paging_locked_by_me(d));
+
+    l4 = paging_map_log_dirty_bitmap(d);
+    if ( !l4 )
+    {
+        *ppfn = end;
+        return 0;
+    }
+
+    while ( pfn < end && leaves < LOGDIRTY_RANGES_LEAVES && todo )
+    {
+        unsigned long base, lim, i, j;
+
+        mfn = l4[L4_LOGDIRTY_IDX(_pfn(pfn))];
+        if ( !mfn_valid(mfn) )
+        {
+            pfn = logdirty_next(pfn, LOGDIRTY_L4E_SHIFT);
+            continue;
+        }
+
+        l3 = map_domain_page(mfn);
+        mfn = l3[L3_LOGDIRTY_IDX(_pfn(pfn))];
+        unmap_domain_page(l3);
+        if ( !mfn_valid(mfn) )
+        {
+            pfn = logdirty_next(pfn, LOGDIRTY_L3E_SHIFT);
+            continue;
+        }
+
+        l2 = map_domain_page(mfn);
+        mfn = l2[L2_LOGDIRTY_IDX(_pfn(pfn))];
+        if ( !mfn_valid(mfn) )
+        {
+            unmap_domain_page(l2);
+            pfn = logdirty_next(pfn, LOGDIRTY_LEAF_SHIFT);
+            continue;
+        }
+
+        leaves++;
+        l1 = map_domain_page(mfn);
+        base = pfn & ~(LOGDIRTY_LEAF_BITS - 1);
+        lim = min(end - base, LOGDIRTY_LEAF_BITS);
+
+        for ( i = pfn - base; (i = find_next_bit(l1, lim, i)) < lim; i = j )
+        {
+            if ( !todo )
+                break;
+
+            j = find_next_zero_bit(l1, lim, i);
+            if ( j - i > todo )
+                j = i + todo;
+
+            if ( nr && r[nr - 1].pfn + r[nr - 1].nr == base + i )
+                r[nr - 1].nr += j - i;
+            else if ( nr < max )
+            {
+                r[nr].pfn = base + i;
+                r[nr].nr = j - i;
+                nr++;
+            }
+            else
+                break;
+
+            todo -= j - i;
+
+            if ( clean )
+            {
+                unsigned long k;
+
+                for ( k = i; k < j; k++ )
+                    __clear_bit(k, l1);
+                ld->dirty_count -= min_t(unsigned long, j - i,
+                                         ld->dirty_count);
+            }
+        }
+        pfn = base + min(i, lim);
+
+        if ( clean && bitmap_empty(l1, LOGDIRTY_LEAF_BITS) )
+        {
+            l2[L2_LOGDIRTY_IDX(_pfn(base))] = INVALID_MFN;
+            paging_free_log_dirty_page(d, mfn);
+        }
+
+        unmap_domain_page(l1);
+        unmap_domain_page(l2);
+
+        if ( i < lim )
+            break;
+    }
+
+    unmap_domain_page(l4);
+
+    *ppfn = pfn;
+    return nr;
+}
+
+/*
+ * Return the log-dirty bitmap as a list of dirty ranges, rather than as
+ * a bitmap covering the whole guest.  With CLEAN_RANGES, only the pages
+ * returned are cleaned: the domain is only paused to flush hardware
+ * buffers, there is no global p2m type change, and one pass costs in
+ * proportion to the number of pages dirty.
+ */
+static int paging_log_dirty_ranges(struct domain *d,
+                                   struct xen_domctl_shadow_op *sc)
+{
+    const struct log_dirty_ops *ops = d->arch.paging.log_dirty.ops;
+    bool clean = (sc->op == XEN_DOMCTL_SHADOW_OP_CLEAN_RANGES);
+    xen_domctl_dirty_range_t r[LOGDIRTY_RANGES_BATCH];
+    unsigned long pfn = sc->cursor, end = sc->pages;
+    unsigned int done = 0, nr;
+    int rc = 0;
+
+    if ( !paging_mode_log_dirty(d) || pfn > end )
+        return -EINVAL;
+
+    /* Cleaning has to revoke write access page by page. */
+    if ( clean && !ops->clean_ranges )
+        return -EOPNOTSUPP;
+
+    if ( is_hvm_domain(d) && (sc->mode & XEN_DOMCTL_SHADOW_LOGDIRTY_FINAL) )
+        hvm_mapped_guest_frames_mark_dirty(d);
+
+    /*
+     * Pick up pages logged by hardware (e.g. PML) but not yet in the trie.
+     * The buffers can only be flushed with the vCPUs descheduled.
+     */
+    domain_pause(d);
+    p2m_flush_hardware_cached_dirty(d);
+    domain_unpause(d);
+
+    sc->stats.fault_count = d->arch.paging.log_dirty.fault_count;
+    sc->stats.dirty_count = d->arch.paging.log_dirty.dirty_count;
+
+    while ( pfn < end && done < sc->nr_ranges )
+    {
+        paging_lock(d);
+
+        if ( unlikely(d->arch.paging.log_dirty.failed_allocs) )
+        {
+            paging_unlock(d);
+            rc = -ENOMEM;
+            break;
+        }
+
+        nr = paging_log_dirty_gather(d, &pfn, end, r,
+                                     min_t(unsigned int, sc->nr_ranges - done,
+                                           ARRAY_SIZE(r)),
+                                     clean);
+
+        if ( clean && pfn >= end )
+            d->arch.paging.log_dirty.fault_count = 0;
+
+        paging_unlock(d);
+
+        /*
+         * The bits are clear already, so writes from here on go unlogged
+         * until the ranges are write protected again.  That is fine as the
+         * caller has not yet read these pages, and does so only after we
+         * return.  The log-dirty ops must be called without the paging lock.
+         */
+        if ( clean && nr )
+            ops->clean_ranges(d, r, nr);
+
+        if ( nr && copy_to_guest_offset(sc->dirty_ranges, done, r, nr) )
+        {
+            rc = -EFAULT;
+            break;
+        }
+        done += nr;
+
+        if ( pfn < end && hypercall_preempt_check() )
+            break;
+    }
+
+    sc->cursor = pfn;
+    sc->nr_ranges = done;
+
+    return rc;
+}
+
 void paging_log_dirty_range(struct domain *d,
                            unsigned long begin_pfn,
                            unsigned long nr,
@@ -739,6 +973,12 @@ int paging_domctl(struct domain *d, struct xen_domctl_shadow_op *sc,
         if ( sc->mode & ~XEN_DOMCTL_SHADOW_LOGDIRTY_FINAL )
             return -EINVAL;
         return paging_log_dirty_op(d, sc, resuming);
+
+    case XEN_DOMCTL_SHADOW_OP_CLEAN_RANGES:
+    case XEN_DOMCTL_SHADOW_OP_PEEK_RANGES:
+        if ( sc->mode & ~XEN_DOMCTL_SHADOW_LOGDIRTY_FINAL )
+            return -EINVAL;
+        return paging_log_dirty_ranges(d, sc);
     }
 
     /* Here, dispatch domctl to the appropriate paging code */
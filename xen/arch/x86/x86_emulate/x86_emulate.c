@@ -700,6 +700,8 @@ struct x86_emulate_state {
     uint8_t modrm, modrm_mod, modrm_reg, modrm_rm;
     uint8_t sib_index, sib_scale;
     uint8_t rex_prefix;
+    uint16_t ea_gprs; /* GPRs used in computing ea.mem.off. */
+    bool no_cache;  /* Decode depended on CR0 (see x86_decode_cached()). */
     bool lock_prefix;
     bool not_64bit; /* Instruction not available in 64bit. */
     bool fpu_ctrl;  /* Instruction is an FPU control one. */
@@ -2520,6 +2522,14 @@ x86_decode_0f3a(
     return X86EMUL_OKAY;
 }
 
+/* Read a GPR taking part in a memory operand's address computation. */
+static unsigned long ea_gpr(struct x86_emulate_state *state, unsigned int n)
+{
+    state->ea_gprs |= 1u << n;
+
+    return *decode_gpr(state->regs, n);
+}
+
 static int
 x86_decode(
     struct x86_emulate_state *state,
@@ -2661,7 +2671,10 @@ x86_decode(
                     break;
                 /* fall through */
             case 4:
-                if ( modrm_mod != 3 || in_realmode(ctxt, ops) )
+                if ( modrm_mod != 3 )
+                    break;
+                state->no_cache = true;
+                if ( in_realmode(ctxt, ops) )
                     break;
                 /* fall through */
             case 8:
@@ -2882,33 +2895,33 @@ x86_decode(
             switch ( modrm_rm )
             {
             case 0:
-                ea.mem.off = state->regs->bx + state->regs->si;
+                ea.mem.off = ea_gpr(state, 3) + ea_gpr(state, 6);
                 break;
             case 1:
-                ea.mem.off = state->regs->bx + state->regs->di;
+                ea.mem.off = ea_gpr(state, 3) + ea_gpr(state, 7);
                 break;
             case 2:
                 ea.mem.seg = x86_seg_ss;
-                ea.mem.off = state->regs->bp + state->regs->si;
+                ea.mem.off = ea_gpr(state, 5) + ea_gpr(state, 6);
                 break;
             case 3:
                 ea.mem.seg = x86_seg_ss;
-                ea.mem.off = state->regs->bp + state->regs->di;
+                ea.mem.off = ea_gpr(state, 5) + ea_gpr(state, 7);
                 break;
             case 4:
-                ea.mem.off = state->regs->si;
+                ea.mem.off = ea_gpr(state, 6);
                 break;
             case 5:
-                ea.mem.off = state->regs->di;
+                ea.mem.off = ea_gpr(state, 7);
                 break;
             case 6:
                 if ( modrm_mod == 0 )
                     break;
                 ea.mem.seg = x86_seg_ss;
-                ea.mem.off = state->regs->bp;
+                ea.mem.off = ea_gpr(state, 5);
                 break;
             case 7:
-                ea.mem.off = state->regs->bx;
+                ea.mem.off = ea_gpr(state, 3);
                 break;
             }
             switch ( modrm_mod )
@@ -2938,7 +2951,7 @@ x86_decode(
                 state->sib_scale = (sib >> 6) & 3;
                 if ( state->sib_index != 4 && !(d & vSIB) )
                 {
-                    ea.mem.off = *decode_gpr(state->regs, state->sib_index);
+                    ea.mem.off = ea_gpr(state, state->sib_index);
                     ea.mem.off <<= state->sib_scale;
                 }
                 if ( (modrm_mod == 0) && ((sib_base & 7) == 5) )
@@ -2946,7 +2959,7 @@ x86_decode(
                 else if ( sib_base == 4 )
                 {
                     ea.mem.seg  = x86_seg_ss;
-                    ea.mem.off += state->regs->r(sp);
+                    ea.mem.off += ea_gpr(state, 4);
                     if ( !ext && (b == 0x8f) )
                         /* POP <rm> computes its EA post increment. */
                         ea.mem.off += ((mode_64bit() && (op_bytes == 4))
@@ -2955,16 +2968,16 @@ x86_decode(
                 else if ( sib_base == 5 )
                 {
                     ea.mem.seg  = x86_seg_ss;
-                    ea.mem.off += state->regs->r(bp);
+                    ea.mem.off += ea_gpr(state, 5);
                 }
                 else
-                    ea.mem.off += *decode_gpr(state->regs, sib_base);
+                    ea.mem.off += ea_gpr(state, sib_base);
             }
             else
             {
                 generate_exception_if(d & vSIB, EXC_UD);
                 modrm_rm |= (rex_prefix & 1) << 3;
-                ea.mem.off = *decode_gpr(state->regs, modrm_rm);
+                ea.mem.off = ea_gpr(state, modrm_rm);
                 if ( (modrm_rm == 5) && (modrm_mod != 0) )
                     ea.mem.seg = x86_seg_ss;
             }
@@ -3153,6 +3166,128 @@ x86_decode(
 #undef insn_fetch_bytes
 #undef insn_fetch_type
 
+#define DECODE_CACHE_ENTRIES 4
+
+struct x86_decode_cache {
+    unsigned int next; /* Entry to replace next. */
+    unsigned long hits;
+    struct {
+        unsigned int len; /* 0 if the entry is unused. */
+        unsigned long ip;
+        unsigned int addr_size, sp_size;
+        bool vm86;
+        unsigned int opcode;
+        uint8_t insn[MAX_INST_LEN];
+        unsigned long gprs[X86_NR_GPRS];
+        struct x86_emulate_state state;
+    } ent[DECODE_CACHE_ENTRIES];
+};
+
+size_t x86_decode_cache_size(void)
+{
+    return sizeof(struct x86_decode_cache);
+}
+
+void x86_decode_cache_flush(struct x86_decode_cache *cache)
+{
+    memset(cache, 0, sizeof(*cache));
+}
+
+unsigned long x86_decode_cache_hits(const struct x86_decode_cache *cache)
+{
+    return cache->hits;
+}
+
+/*
+ * x86_decode(), going through ctxt->decode_cache if there is one.  The
+ * only piece of state beyond the key which decoding may depend upon is
+ * CR0.PE (telling LES/LDS from VEX encodings outside of 64-bit mode), so
+ * instructions for which it was consulted don't get cached.
+ */
+static int
+x86_decode_cached(
+    struct x86_emulate_state *state,
+    struct x86_emulate_ctxt *ctxt,
+    const struct x86_emulate_ops *ops)
+{
+    struct x86_decode_cache *cache = ctxt->decode_cache;
+    struct cpu_user_regs *regs = ctxt->regs;
+    bool vm86 = regs->eflags & X86_EFLAGS_VM;
+    uint8_t insn[MAX_INST_LEN];
+    unsigned int i, n;
+    int rc;
+
+    if ( !cache )
+        return x86_decode(state, ctxt, ops);
+
+    for ( i = 0; i < DECODE_CACHE_ENTRIES; i++ )
+    {
+        typeof(cache->ent[0]) *ent = &cache->ent[i];
+
+        if ( !ent->len || ent->ip != regs->r(ip) ||
+             ent->addr_size != ctxt->addr_size ||
+             ent->sp_size != ctxt->sp_size || ent->vm86 != vm86 )
+            continue;
+
+        for ( n = 0; n < X86_NR_GPRS; n++ )
+            if ( (ent->state.ea_gprs & (1u << n)) &&
+                 *decode_gpr(regs, n) != ent->gprs[n] )
+                break;
+        if ( n < X86_NR_GPRS )
+            continue;
+
+        /*
+         * Leave any fault to be raised by a full decode, which fetches
+         * piecemeal.
+         */
+        if ( ops->insn_fetch(x86_seg_cs, ent->ip, insn, ent->len,
+                             ctxt) != X86EMUL_OKAY )
+            break;
+
+        if ( memcmp(insn, ent->insn, ent->len) )
+        {
+            ent->len = 0;
+            break;
+        }
+
+        *state = ent->state;
+        state->regs = regs;
+        ctxt->opcode = ent->opcode;
+        ctxt->retire.raw = 0;
+        x86_emul_reset_event(ctxt);
+        cache->hits++;
+
+        return X86EMUL_OKAY;
+    }
+
+    rc = x86_decode(state, ctxt, ops);
+    if ( rc == X86EMUL_OKAY && !state->no_cache )
+    {
+        typeof(cache->ent[0]) *ent =
+            &cache->ent[cache->next++ % DECODE_CACHE_ENTRIES];
+
+        ent->len = state->ip - regs->r(ip);
+        ent->ip = regs->r(ip);
+        if ( ops->insn_fetch(x86_seg_cs, ent->ip, ent->insn, ent->len,
+                             ctxt) != X86EMUL_OKAY )
+        {
+            ent->len = 0;
+            x86_emul_reset_event(ctxt);
+            return rc;
+        }
+        ent->addr_size = ctxt->addr_size;
+        ent->sp_size = ctxt->sp_size;
+        ent->vm86 = vm86;
+        ent->opcode = ctxt->opcode;
+        for ( n = 0; n < X86_NR_GPRS; n++ )
+            if ( state->ea_gprs & (1u << n) )
+                ent->gprs[n] = *decode_gpr(regs, n);
+        ent->state = *state;
+    }
+
+    return rc;
+}
+
 /* Undo DEBUG wrapper. */
 #undef x86_emulate
 
@@ -3185,7 +3320,7 @@ x86_emulate(
 
     ASSERT(ops->read);
 
-    rc = x86_decode(&state, ctxt, ops);
+    rc = x86_decode_cached(&state, ctxt, ops);
     if ( rc != X86EMUL_OKAY )
         return rc;
 
@@ -9219,3 +9354,128 @@ x86_insn_length(const struct x86_emulate_state *state,
 }
 
 #endif
+
+#ifdef __x86_64__
+int x86_decode_simple_mov(const uint8_t *insn, unsigned int insn_bytes,
+                          struct cpu_user_regs *regs,
+                          struct x86_simple_mov *mov)
+{
+    unsigned int i, rex = 0, op_bytes = 4, modrm, mod, rm;
+    unsigned long ea;
+    bool imm = false, rip_rel = false;
+    uint8_t opc;
+
+    /*
+     * Prefixes, opcode, ModRM, SIB, disp32 and imm32 fit in MAX_INST_LEN
+     * bytes.  Those past @insn_bytes are zero, and the length gets checked
+     * once known.
+     */
+    if ( !insn_bytes )
+        return X86EMUL_UNHANDLEABLE;
+
+    for ( i = 0; ; ++i )
+    {
+        if ( i >= 4 )
+            return X86EMUL_UNIMPLEMENTED;
+        if ( insn[i] == 0x66 )
+        {
+            op_bytes = 2;
+            rex = 0; /* A REX prefix only counts right before the opcode. */
+        }
+        else if ( (insn[i] & 0xf0) == 0x40 )
+            rex = insn[i];
+        else
+            break;
+    }
+
+    switch ( opc = insn[i++] )
+    {
+    case 0xc6: case 0xc7: /* mov $imm,m */
+        imm = true;
+        /* fall through */
+    case 0x88: case 0x89: /* mov r,m */
+        mov->write = true;
+        break;
+    case 0x8a: case 0x8b: /* mov m,r */
+        mov->write = false;
+        break;
+    default:
+        return X86EMUL_UNIMPLEMENTED;
+    }
+
+    if ( !(opc & 1) )
+        mov->bytes = 1;
+    else
+        mov->bytes = (rex & 8) ? 8 : op_bytes;
+
+    modrm = insn[i++];
+    mod = modrm >> 6;
+    rm = modrm & 7;
+    mov->reg = ((modrm >> 3) & 7) | ((rex & 4) << 1);
+
+    if ( mod == 3 || (imm && (modrm & 0x38)) )
+        return X86EMUL_UNIMPLEMENTED;
+    /* Leave %ah/%ch/%dh/%bh to x86_emulate(). */
+    if ( mov->bytes == 1 && !imm && !rex && mov->reg >= 4 )
+        return X86EMUL_UNIMPLEMENTED;
+
+    if ( rm == 4 )
+    {
+        uint8_t sib = insn[i++];
+        unsigned int index = ((sib >> 3) & 7) | ((rex & 2) << 2);
+        unsigned int base = (sib & 7) | ((rex & 1) << 3);
+
+        ea = index != 4 ? *decode_gpr(regs, index) << (sib >> 6) : 0;
+        if ( mod == 0 && (base & 7) == 5 )
+        {
+            ea += *(const int32_t *)&insn[i];
+            i += 4;
+        }
+        else
+            ea += *decode_gpr(regs, base);
+    }
+    else if ( mod == 0 && rm == 5 )
+    {
+        ea = *(const int32_t *)&insn[i];
+        i += 4;
+        rip_rel = true;
+    }
+    else
+        ea = *decode_gpr(regs, rm | ((rex & 1) << 3));
+
+    if ( mod == 1 )
+        ea += (int8_t)insn[i++];
+    else if ( mod == 2 )
+    {
+        ea += *(const int32_t *)&insn[i];
+        i += 4;
+    }
+
+    if ( imm )
+    {
+        switch ( mov->bytes )
+        {
+        case 1:
+            mov->data = insn[i];
+            break;
+        case 2:
+            mov->data = *(const uint16_t *)&insn[i];
+            break;
+        default:
+            mov->data = *(const int32_t *)&insn[i];
+            break;
+        }
+        i += mov->bytes < 4 ? mov->bytes : 4;
+    }
+    else if ( mov->write )
+        mov->data = *decode_gpr(regs, mov->reg);
+
+    if ( i > insn_bytes )
+        return X86EMUL_UNHANDLEABLE;
+
+    mov->len = i;
+    mov->ea = rip_rel ? ea + regs->rip + i : ea;
+
+    return X86EMUL_OKAY;
+}
+#endif
@@ -509,6 +509,9 @@ struct x86_emulate_ctxt
     /* Caller data that can be used by x86_emulate_ops' routines. */
     void *data;
 
+    /* Decoded instruction cache (optional, see x86_decode_cache_size()). */
+    struct x86_decode_cache *decode_cache;
+
     /*
      * Input/output state:
      */
@@ -662,6 +665,42 @@ static inline unsigned long *decode_gpr(struct cpu_user_regs *regs,
     return (void *)regs + cpu_user_regs_gpr_offsets[modrm];
 }
 
+/*
+ * Decoded instruction cache.  Callers emulating the same instructions over
+ * and over may supply one through x86_emulate_ctxt, as a zeroed block of
+ * x86_decode_cache_size() bytes, to avoid repeatedly decoding them.  Entries
+ * are matched on rIP, execution mode, the instruction bytes and the values
+ * of the registers used in computing the memory operand's address, so they
+ * need no invalidation for correctness.
+ */
+size_t x86_decode_cache_size(void);
+void x86_decode_cache_flush(struct x86_decode_cache *cache);
+/* Number of lookups served from the cache since it was last flushed. */
+unsigned long x86_decode_cache_hits(const struct x86_decode_cache *cache);
+
+#ifdef __x86_64__
+/* A MOV between memory and a GPR or an immediate. */
+struct x86_simple_mov {
+    unsigned int len;
+    unsigned int reg;   /* GPR operand (unless an immediate store). */
+    unsigned int bytes;
+    bool write;
+    unsigned long ea;   /* Effective address of the memory operand. */
+    unsigned long data; /* Data for stores. */
+};
+
+/*
+ * Decode a MOV between memory and a GPR or an immediate in 64-bit mode, with
+ * at most operand size and REX prefixes, without the overhead of
+ * x86_emulate().  @insn needs to cover MAX_INST_LEN bytes, of which those
+ * past @insn_bytes must be zero.  Returns X86EMUL_UNIMPLEMENTED for any other
+ * instruction, and X86EMUL_UNHANDLEABLE if more than @insn_bytes are needed.
+ */
+int x86_decode_simple_mov(const uint8_t *insn, unsigned int insn_bytes,
+                          struct cpu_user_regs *regs,
+                          struct x86_simple_mov *mov);
+#endif
+
 /* Unhandleable read, write or instruction fetch */
 int
 x86emul_unhandleable_rw(
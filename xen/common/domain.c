@@ -375,6 +375,10 @@ struct domain *domain_create(domid_t domid,
         d->pbuf = xzalloc_array(char, DOMAIN_PBUF_SIZE);
         if ( !d->pbuf )
             goto fail;
+
+        d->node_pages = xzalloc_array(unsigned int, MAX_NUMNODES);
+        if ( !d->node_pages )
+            goto fail;
     }
 
     if ( (err = arch_domain_create(d, config)) != 0 )
@@ -419,6 +423,7 @@ struct domain *domain_create(domid_t domid,
         hardware_domain = old_hwdom;
     atomic_set(&d->refcnt, DOMAIN_DESTROYED);
     xfree(d->pbuf);
+    xfree(d->node_pages);
 
     sched_destroy_domain(d);
 
@@ -858,6 +863,7 @@ static void complete_domain_destroy(struct rcu_head *head)
 #endif
 
     xfree(d->pbuf);
+    xfree(d->node_pages);
 
     for ( i = d->max_vcpus - 1; i >= 0; i-- )
         if ( (v = d->vcpu[i]) != NULL )
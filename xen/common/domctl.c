@@ -903,6 +903,7 @@ long do_domctl(XEN_GUEST_HANDLE_PARAM(xen_domctl_t) u_domctl)
         op->u.getvcpuinfo.running  = v->is_running;
         op->u.getvcpuinfo.cpu_time = runstate.time[RUNSTATE_running];
         op->u.getvcpuinfo.cpu      = v->processor;
+        op->u.getvcpuinfo.dirty_pages = paging_vcpu_dirty_pages(v);
         ret = 0;
         copyback = 1;
         break;
@@ -25,6 +25,9 @@
 #include <xen/guest_access.h>
 #include <xen/keyhandler.h>
 #include <xen/event_fifo.h>
+#include <xen/perfc.h>
+#include <xen/sort.h>
+#include <xen/timer.h>
 #include <asm/current.h>
 
 #include <public/xen.h>
@@ -112,6 +115,26 @@ static bool virq_is_global(unsigned int virq)
 }
 
 
+/* Longest interval accepted by EVTCHNOP_set_moderation. */
+#define EVTCHN_MODERATION_MAX_INTERVAL_US 1000000
+
+/*
+ * Moderation state of a channel, allocated by the first
+ * EVTCHNOP_set_moderation on it and freed with its bucket.  The lock nests
+ * inside the channel locks.
+ */
+struct evtchn_moderation {
+    spinlock_t lock;
+    struct domain *d;
+    struct evtchn *chn;
+    struct timer timer;         /* Flushes a deferred event. */
+    unsigned int max_events;    /* 0: moderation off. */
+    s_time_t interval;
+    s_time_t window_start;
+    unsigned int count;         /* Events delivered in this interval. */
+    bool deferred;
+};
+
 static struct evtchn *alloc_evtchn_bucket(struct domain *d, unsigned int port)
 {
     struct evtchn *chn;
@@ -144,7 +167,16 @@ static void free_evtchn_bucket(struct domain *d, struct evtchn *bucket)
         return;
 
     for ( i = 0; i < EVTCHNS_PER_BUCKET; i++ )
+    {
+        struct evtchn_moderation *mod = bucket[i].moderation;
+
+        if ( mod )
+        {
+            kill_timer(&mod->timer);
+            xfree(mod);
+        }
         xsm_free_security_evtchn(bucket + i);
+    }
 
     xfree(bucket);
 }
@@ -214,6 +246,19 @@ void evtchn_free(struct domain *d, struct evtchn *chn)
     chn->notify_vcpu_id = 0;
     chn->xen_consumer   = 0;
 
+    /* Moderation does not survive the binding; drop any deferred event. */
+    if ( chn->moderation )
+    {
+        struct evtchn_moderation *mod = chn->moderation;
+
+        spin_lock(&mod->lock);
+        mod->max_events = 0;
+        mod->deferred = false;
+        spin_unlock(&mod->lock);
+
+        stop_timer(&mod->timer);
+    }
+
     xsm_evtchn_close_post(chn);
 }
 
@@ -669,6 +714,81 @@ int evtchn_close(struct domain *d1, int port1, bool guest)
     return rc;
 }
 
+/*
+ * Account an event sent to @chn, which is interdomain, by a guest or by Xen.
+ * Returns true if the event must not be delivered now: it is then delivered
+ * by the moderation timer at the end of the current interval.  An event
+ * delivered now also delivers any deferred one, which the timer then drops.
+ */
+static bool evtchn_moderate(struct evtchn *chn)
+{
+    struct evtchn_moderation *mod = read_atomic(&chn->moderation);
+    bool defer = false;
+
+    if ( likely(!mod) )
+        return false;
+
+    spin_lock(&mod->lock);
+
+    if ( mod->max_events )
+    {
+        s_time_t now = NOW();
+
+        if ( now - mod->window_start >= mod->interval )
+        {
+            mod->window_start = now;
+            mod->count = 0;
+        }
+
+        if ( mod->count < mod->max_events )
+            mod->count++;
+        else
+        {
+            defer = true;
+            if ( !mod->deferred )
+            {
+                mod->deferred = true;
+                set_timer(&mod->timer, mod->window_start + mod->interval);
+            }
+        }
+    }
+
+    if ( !defer )
+        mod->deferred = false;
+
+    spin_unlock(&mod->lock);
+
+    if ( defer )
+        perfc_incr(evtchn_moderated);
+
+    return defer;
+}
+
+static void evtchn_moderation_timer_fn(void *data)
+{
+    struct evtchn_moderation *mod = data;
+    struct evtchn *chn = mod->chn;
+    bool deferred;
+
+    spin_lock(&chn->lock);
+
+    spin_lock(&mod->lock);
+    deferred = mod->deferred;
+    if ( deferred )
+    {
+        /* The flushed event opens a new interval. */
+        mod->deferred = false;
+        mod->window_start = NOW();
+        mod->count = 1;
+    }
+    spin_unlock(&mod->lock);
+
+    if ( deferred && chn->state == ECS_INTERDOMAIN )
+        evtchn_port_set_pending(mod->d, chn->notify_vcpu_id, chn);
+
+    spin_unlock(&chn->lock);
+}
+
 int evtchn_send(struct domain *ld, unsigned int lport)
 {
     struct evtchn *lchn, *rchn;
@@ -701,7 +821,7 @@ int evtchn_send(struct domain *ld, unsigned int lport)
         rchn  = evtchn_from_port(rd, rport);
         if ( consumer_is_xen(rchn) )
             xen_notification_fn(rchn)(rd->vcpu[rchn->notify_vcpu_id], rport);
-        else
+        else if ( !evtchn_moderate(rchn) )
             evtchn_port_set_pending(rd, rchn->notify_vcpu_id, rchn);
         break;
     case ECS_IPI:
@@ -720,6 +840,157 @@ out:
     return ret;
 }
 
+struct send_batch_target {
+    struct domain *d;
+    struct evtchn *chn;
+    unsigned int vcpu_id;
+    unsigned int priority;
+    unsigned int idx;
+};
+
+static int cmp_evtchn(const void *a, const void *b)
+{
+    const struct evtchn *x = *(const struct evtchn *const *)a;
+    const struct evtchn *y = *(const struct evtchn *const *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+/* Group targets by vcpu and queue, keeping the order they were given in. */
+static int cmp_send_batch_target(const void *a, const void *b)
+{
+    const struct send_batch_target *x = a, *y = b;
+
+    if ( x->d != y->d )
+        return x->d < y->d ? -1 : 1;
+    if ( x->vcpu_id != y->vcpu_id )
+        return x->vcpu_id < y->vcpu_id ? -1 : 1;
+    if ( x->priority != y->priority )
+        return x->priority < y->priority ? -1 : 1;
+    return x->idx < y->idx ? -1 : x->idx > y->idx;
+}
+
+static long evtchn_send_batch(struct domain *ld,
+                              const struct evtchn_send_batch *batch)
+{
+    struct evtchn *chns[EVTCHN_SEND_BATCH_MAX];
+    struct evtchn *locked[EVTCHN_SEND_BATCH_MAX];
+    struct evtchn *pending[EVTCHN_SEND_BATCH_MAX];
+    struct send_batch_target targets[EVTCHN_SEND_BATCH_MAX];
+    unsigned int i, j, nr = 0, nr_targets = 0;
+    long rc = 0;
+
+    if ( batch->nr_ports > EVTCHN_SEND_BATCH_MAX )
+        return -EINVAL;
+
+    perfc_incr(evtchn_send_batch);
+
+    for ( i = 0; i < batch->nr_ports; i++ )
+    {
+        evtchn_port_t port = batch->ports[i];
+        struct evtchn *chn;
+
+        if ( !port_is_valid(ld, port) )
+            return -EINVAL;
+
+        chn = evtchn_from_port(ld, port);
+        for ( j = 0; j < nr && chns[j] != chn; j++ )
+            continue;
+        if ( j == nr )
+            chns[nr++] = chn;
+    }
+
+    /* Lock in address order, as double_evtchn_lock() does. */
+    memcpy(locked, chns, nr * sizeof(*chns));
+    sort(locked, nr, sizeof(*locked), cmp_evtchn, NULL);
+    for ( i = 0; i < nr; i++ )
+        spin_lock(&locked[i]->lock);
+
+    /* Check every port before sending anything. */
+    for ( i = 0; i < nr; i++ )
+    {
+        struct evtchn *lchn = chns[i];
+
+        /* Guest cannot send via a Xen-attached event channel. */
+        if ( unlikely(consumer_is_xen(lchn)) )
+        {
+            rc = -EINVAL;
+            goto out;
+        }
+
+        rc = xsm_evtchn_send(XSM_HOOK, ld, lchn);
+        if ( rc )
+            goto out;
+
+        if ( lchn->state != ECS_INTERDOMAIN && lchn->state != ECS_IPI &&
+             lchn->state != ECS_UNBOUND )
+        {
+            rc = -EINVAL;
+            goto out;
+        }
+    }
+
+    for ( i = 0; i < nr; i++ )
+    {
+        struct evtchn *lchn = chns[i], *rchn;
+        struct domain *rd;
+        int rport;
+
+        switch ( lchn->state )
+        {
+        case ECS_INTERDOMAIN:
+            rd    = lchn->u.interdomain.remote_dom;
+            rport = lchn->u.interdomain.remote_port;
+            rchn  = evtchn_from_port(rd, rport);
+            if ( consumer_is_xen(rchn) )
+            {
+                xen_notification_fn(rchn)(rd->vcpu[rchn->notify_vcpu_id],
+                                          rport);
+                continue;
+            }
+            if ( evtchn_moderate(rchn) )
+                continue;
+            break;
+        case ECS_IPI:
+            rd   = ld;
+            rchn = lchn;
+            break;
+        default:
+            /* ECS_UNBOUND: silently drop the notification */
+            continue;
+        }
+
+        targets[nr_targets].d        = rd;
+        targets[nr_targets].chn      = rchn;
+        targets[nr_targets].vcpu_id  = rchn->notify_vcpu_id;
+        targets[nr_targets].priority = rchn->priority;
+        targets[nr_targets].idx      = i;
+        nr_targets++;
+    }
+
+    sort(targets, nr_targets, sizeof(*targets), cmp_send_batch_target, NULL);
+
+    for ( i = 0; i < nr_targets; i = j )
+    {
+        for ( j = i; j < nr_targets; j++ )
+        {
+            if ( targets[j].d != targets[i].d ||
+                 targets[j].vcpu_id != targets[i].vcpu_id )
+                break;
+            pending[j - i] = targets[j].chn;
+        }
+
+        evtchn_port_set_pending_batch(targets[i].d, targets[i].vcpu_id,
+                                      pending, j - i);
+    }
+
+ out:
+    for ( i = 0; i < nr; i++ )
+        spin_unlock(&locked[i]->lock);
+
+    return rc;
+}
+
 int guest_enabled_event(struct vcpu *v, uint32_t virq)
 {
     return ((v != NULL) && (v->virq_to_evtchn[virq] != 0));
@@ -1045,6 +1316,75 @@ static long evtchn_set_priority(const struct evtchn_set_priority *set_priority)
     return ret;
 }
 
+static long evtchn_set_moderation(const struct evtchn_set_moderation *set)
+{
+    struct domain *d = current->domain;
+    struct evtchn_moderation *mod;
+    struct evtchn *chn;
+    long rc = 0;
+
+    if ( set->max_events &&
+         (!set->interval_us ||
+          set->interval_us > EVTCHN_MODERATION_MAX_INTERVAL_US) )
+        return -EINVAL;
+
+    spin_lock(&d->event_lock);
+
+    if ( !port_is_valid(d, set->port) )
+    {
+        rc = -EINVAL;
+        goto out;
+    }
+
+    chn = evtchn_from_port(d, set->port);
+    if ( consumer_is_xen(chn) ||
+         (chn->state != ECS_UNBOUND && chn->state != ECS_INTERDOMAIN) )
+    {
+        rc = -EINVAL;
+        goto out;
+    }
+
+    mod = chn->moderation;
+    if ( !mod )
+    {
+        if ( !set->max_events )
+            goto out;
+
+        mod = xzalloc(struct evtchn_moderation);
+        if ( !mod )
+        {
+            rc = -ENOMEM;
+            goto out;
+        }
+
+        spin_lock_init(&mod->lock);
+        mod->d = d;
+        mod->chn = chn;
+        init_timer(&mod->timer, evtchn_moderation_timer_fn, mod,
+                   d->vcpu[chn->notify_vcpu_id]->processor);
+
+        /* Senders look at chn->moderation without d->event_lock. */
+        smp_wmb();
+        write_atomic(&chn->moderation, mod);
+    }
+
+    /*
+     * An event already deferred is still delivered by the timer, even if
+     * moderation is being turned off, unless another one is delivered
+     * first.
+     */
+    spin_lock(&mod->lock);
+    mod->max_events = set->max_events;
+    mod->interval = MICROSECS(set->interval_us);
+    mod->count = 0;
+    spin_unlock(&mod->lock);
+
+ out:
+    spin_unlock(&d->event_lock);
+
+    return rc;
+}
+
 long do_event_channel_op(int cmd, XEN_GUEST_HANDLE_PARAM(void) arg)
 {
     long rc;
@@ -1117,6 +1457,14 @@ long do_event_channel_op(int cmd, XEN_GUEST_HANDLE_PARAM(void) arg)
         break;
     }
 
+    case EVTCHNOP_send_batch: {
+        struct evtchn_send_batch batch;
+        if ( copy_from_guest(&batch, arg, 1) != 0 )
+            return -EFAULT;
+        rc = evtchn_send_batch(current->domain, &batch);
+        break;
+    }
+
     case EVTCHNOP_status: {
         struct evtchn_status status;
         if ( copy_from_guest(&status, arg, 1) != 0 )
@@ -1188,6 +1536,14 @@ long do_event_channel_op(int cmd, XEN_GUEST_HANDLE_PARAM(void) arg)
         break;
     }
 
+    case EVTCHNOP_set_moderation: {
+        struct evtchn_set_moderation set_moderation;
+        if ( copy_from_guest(&set_moderation, arg, 1) != 0 )
+            return -EFAULT;
+        rc = evtchn_set_moderation(&set_moderation);
+        break;
+    }
+
     default:
         rc = -ENOSYS;
         break;
@@ -1254,7 +1610,8 @@ void notify_via_xen_event_channel(struct domain *ld, int lport)
         ASSERT(consumer_is_xen(lchn));
         rd    = lchn->u.interdomain.remote_dom;
         rchn  = evtchn_from_port(rd, lchn->u.interdomain.remote_port);
-        evtchn_port_set_pending(rd, rchn->notify_vcpu_id, rchn);
+        if ( !evtchn_moderate(rchn) )
+            evtchn_port_set_pending(rd, rchn->notify_vcpu_id, rchn);
     }
 
     spin_unlock(&lchn->lock);
@@ -1414,6 +1771,9 @@ static void domain_dump_evtchn_info(struct domain *d)
             printk(" d=%d p=%d",
                    chn->u.interdomain.remote_dom->domain_id,
                    chn->u.interdomain.remote_port);
+            if ( chn->moderation && chn->moderation->max_events )
+                printk(" m=%u/%"PRI_stime"us", chn->moderation->max_events,
+                       chn->moderation->interval / MICROSECS(1));
             break;
         case ECS_PIRQ:
             irq = domain_pirq_to_irq(d, chn->u.pirq.irq);
@@ -1433,6 +1793,8 @@ static void domain_dump_evtchn_info(struct domain *d)
         }
     }
 
+    evtchn_fifo_dump_queues(d);
+
     spin_unlock(&d->event_lock);
 }
 
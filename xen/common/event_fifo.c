@@ -16,6 +16,7 @@
 #include <xen/paging.h>
 #include <xen/mm.h>
 #include <xen/domain_page.h>
+#include <xen/perfc.h>
 
 #include <public/event_channel.h>
 
@@ -55,6 +56,17 @@ static void evtchn_fifo_init(struct domain *d, struct evtchn *evtchn)
                  d->domain_id, evtchn->port);
 }
 
+/* Take a queue lock, counting the acquisitions which had to wait for it. */
+static void lock_queue(struct evtchn_fifo_queue *q, unsigned long *flags)
+{
+    if ( spin_trylock_irqsave(&q->lock, *flags) )
+        return;
+
+    spin_lock_irqsave(&q->lock, *flags);
+    q->contended++;
+    perfc_incr(evtchn_fifo_contended);
+}
+
 static struct evtchn_fifo_queue *lock_old_queue(const struct domain *d,
                                                 struct evtchn *evtchn,
                                                 unsigned long *flags)
@@ -68,7 +80,7 @@ static struct evtchn_fifo_queue *lock_old_queue(const struct domain *d,
         v = d->vcpu[evtchn->last_vcpu_id];
         old_q = &v->evtchn_fifo->queue[evtchn->last_priority];
 
-        spin_lock_irqsave(&old_q->lock, *flags);
+        lock_queue(old_q, flags);
 
         v = d->vcpu[evtchn->last_vcpu_id];
         q = &v->evtchn_fifo->queue[evtchn->last_priority];
@@ -226,7 +238,7 @@ static void evtchn_fifo_set_pending(struct vcpu *v, struct evtchn *evtchn)
             evtchn->last_priority = evtchn->priority;
 
             spin_unlock_irqrestore(&old_q->lock, flags);
-            spin_lock_irqsave(&q->lock, flags);
+            lock_queue(q, &flags);
         }
 
         /*
@@ -247,6 +259,8 @@ static void evtchn_fifo_set_pending(struct vcpu *v, struct evtchn *evtchn)
         if ( !linked )
             write_atomic(q->head, port);
         q->tail = port;
+        q->links++;
+        perfc_incr(evtchn_fifo_link);
 
         spin_unlock_irqrestore(&q->lock, flags);
 
@@ -260,6 +274,111 @@ static void evtchn_fifo_set_pending(struct vcpu *v, struct evtchn *evtchn)
         evtchn_check_pollers(d, port);
 }
 
+static void unlock_queue(struct vcpu *v, struct evtchn_fifo_queue *q,
+                         unsigned long flags, bool_t notify)
+{
+    spin_unlock_irqrestore(&q->lock, flags);
+
+    if ( notify
+         && !test_and_set_bit(q->priority,
+                              &v->evtchn_fifo->control_block->ready) )
+        vcpu_mark_events_pending(v);
+}
+
+/*
+ * Raise several events on one vcpu, linking each run of events for the
+ * same queue under a single acquisition of its lock.  An event that must
+ * move to a different queue, or that has no event word yet, is raised
+ * with evtchn_fifo_set_pending().
+ */
+static void evtchn_fifo_set_pending_batch(struct vcpu *v,
+                                          struct evtchn **evtchns,
+                                          unsigned int nr)
+{
+    struct domain *d = v->domain;
+    struct evtchn_fifo_queue *q = NULL;
+    unsigned long flags, raised = 0;
+    bool_t notify = 0;
+    unsigned int i;
+
+    ASSERT(nr <= BITS_PER_LONG);
+
+    for ( i = 0; i < nr; i++ )
+    {
+        struct evtchn *evtchn = evtchns[i];
+        unsigned int port = evtchn->port;
+        struct evtchn_fifo_queue *new_q;
+        event_word_t *word, *tail_word;
+        bool_t linked = 0;
+
+        word = evtchn_fifo_word_from_port(d, port);
+        if ( unlikely(!word) || unlikely(!v->evtchn_fifo->control_block) )
+        {
+            if ( q )
+                unlock_queue(v, q, flags, notify);
+            q = NULL;
+            evtchn_fifo_set_pending(v, evtchn);
+            continue;
+        }
+
+        if ( !test_and_set_bit(EVTCHN_FIFO_PENDING, word) )
+            __set_bit(i, &raised);
+
+        if ( test_bit(EVTCHN_FIFO_MASKED, word)
+             || test_bit(EVTCHN_FIFO_LINKED, word) )
+            continue;
+
+        new_q = &v->evtchn_fifo->queue[evtchn->priority];
+        if ( new_q != q )
+        {
+            if ( q )
+                unlock_queue(v, q, flags, notify);
+            q = new_q;
+            notify = 0;
+            lock_queue(q, &flags);
+        }
+
+        /* Last linked on another queue? */
+        if ( unlikely(d->vcpu[evtchn->last_vcpu_id] != v
+                      || evtchn->last_priority != q->priority) )
+        {
+            unlock_queue(v, q, flags, notify);
+            q = NULL;
+            evtchn_fifo_set_pending(v, evtchn);
+            continue;
+        }
+
+        if ( test_and_set_bit(EVTCHN_FIFO_LINKED, word) )
+            continue;
+
+        /* As in evtchn_fifo_set_pending(), with old_q == q. */
+        if ( q->tail == port )
+            q->tail = 0;
+
+        if ( q->tail )
+        {
+            tail_word = evtchn_fifo_word_from_port(d, q->tail);
+            linked = evtchn_fifo_set_link(d, tail_word, port);
+        }
+        if ( !linked )
+        {
+            write_atomic(q->head, port);
+            notify = 1;
+        }
+        q->tail = port;
+        q->links++;
+        q->batched++;
+        perfc_incr(evtchn_fifo_link);
+        perfc_incr(evtchn_fifo_batch_link);
+    }
+
+    if ( q )
+        unlock_queue(v, q, flags, notify);
+
+    for_each_set_bit ( i, &raised, nr )
+        evtchn_check_pollers(d, evtchns[i]->port);
+}
+
 static void evtchn_fifo_clear_pending(struct domain *d, struct evtchn *evtchn)
 {
     event_word_t *word;
@@ -349,6 +468,7 @@ static const struct evtchn_port_ops evtchn_port_ops_fifo =
 {
     .init          = evtchn_fifo_init,
     .set_pending   = evtchn_fifo_set_pending,
+    .set_pending_batch = evtchn_fifo_set_pending_batch,
     .clear_pending = evtchn_fifo_clear_pending,
     .unmask        = evtchn_fifo_unmask,
     .is_pending    = evtchn_fifo_is_pending,
@@ -634,6 +754,33 @@ void evtchn_fifo_destroy(struct domain *d)
     cleanup_event_array(d);
 }
 
+void evtchn_fifo_dump_queues(const struct domain *d)
+{
+    const struct vcpu *v;
+    unsigned int i;
+
+    if ( !d->evtchn_fifo )
+        return;
+
+    printk("FIFO queues [links/batched/contended]:\n");
+    for_each_vcpu ( d, v )
+    {
+        if ( !v->evtchn_fifo )
+            continue;
+
+        printk("    %pv:", v);
+        for ( i = 0; i <= EVTCHN_FIFO_PRIORITY_MIN; i++ )
+        {
+            const struct evtchn_fifo_queue *q = &v->evtchn_fifo->queue[i];
+
+            if ( q->links || q->contended )
+                printk(" q%u=%lu/%lu/%lu", i, q->links, q->batched,
+                       q->contended);
+        }
+        printk("\n");
+    }
+}
+
 /*
  * Local variables:
  * mode: C
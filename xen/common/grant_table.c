@@ -35,6 +35,7 @@
 #include <xen/domain_page.h>
 #include <xen/iommu.h>
 #include <xen/paging.h>
+#include <xen/perfc.h>
 #include <xen/keyhandler.h>
 #include <xen/vmap.h>
 #include <xsm/xsm.h>
@@ -47,7 +48,7 @@ struct grant_table {
      * entry list, etc.)
      */
     percpu_rwlock_t       lock;
-    /* Lock protecting the maptrack limit */
+    /* Lock protecting the maptrack limit and the shared maptrack pool */
     spinlock_t            maptrack_lock;
     /*
      * Defaults to v1.  May be changed with GNTTABOP_set_version.  All other
@@ -63,6 +64,9 @@ struct grant_table {
     unsigned int          nr_status_frames;
     /* Number of available maptrack entries. */
     unsigned int          maptrack_limit;
+    /* Free maptrack entries not held by any vCPU. */
+    unsigned int          maptrack_pool_head;
+    unsigned int          maptrack_pool_nr;
     /* Shared grant table (see include/public/grant_table.h). */
     union {
         void **shared_raw;
@@ -186,8 +190,7 @@ struct grant_mapping {
     grant_ref_t ref;        /* grant ref */
     uint16_t flags;         /* 0-4: GNTMAP_* ; 5-15: unused */
     domid_t  domid;         /* granting domain */
-    uint32_t vcpu;          /* vcpu which created the grant mapping */
-    uint32_t pad;           /* round size to a power of 2 */
+    uint32_t pad[2];        /* round size to a power of 2 */
 };
 
 /* Number of grant table frames. Caller must hold d's grant table lock. */
@@ -439,51 +442,123 @@ double_gt_unlock(struct grant_table *lgt, struct grant_table *rgt)
 
 #define INVALID_MAPTRACK_HANDLE UINT_MAX
 
+/*
+ * Free maptrack handles are kept on singly linked lists, threaded through
+ * the ref field of the entries and terminated by MAPTRACK_TAIL.
+ *
+ * Each vCPU has a small list of its own (a magazine) which it allocates
+ * handles from and frees handles to, whichever vCPU originally allocated
+ * them.  Only the vCPU itself touches its magazine on the fast path, so its
+ * lock is uncontended there.  Handles move between the magazines and a
+ * pool shared by the whole domain MAPTRACK_BATCH at a time, under
+ * maptrack_lock; new maptrack frames are added to the pool.  Only when the
+ * domain is out of maptrack frames and the pool is empty does a vCPU take
+ * handles out of other vCPUs' magazines.
+ *
+ * Lock order: maptrack_freelist_lock, then maptrack_lock.
+ */
+#define MAPTRACK_BATCH   32
+#define MAPTRACK_MAG_MAX (2 * MAPTRACK_BATCH)
+
 static inline grant_handle_t
-_get_maptrack_handle(struct grant_table *t, struct vcpu *v)
+maptrack_pop(struct grant_table *t, unsigned int *head, unsigned int *nr)
 {
-    unsigned int head, next, prev_head;
+    grant_handle_t handle = *head;
 
-    spin_lock(&v->maptrack_freelist_lock);
+    ASSERT(*nr && handle != MAPTRACK_TAIL);
+    *head = maptrack_entry(t, handle).ref;
+    (*nr)--;
 
-    do {
-        /* No maptrack pages allocated for this VCPU yet? */
-        head = read_atomic(&v->maptrack_head);
-        if ( unlikely(head == MAPTRACK_TAIL) )
-        {
-            spin_unlock(&v->maptrack_freelist_lock);
-            return INVALID_MAPTRACK_HANDLE;
-        }
+    return handle;
+}
 
-        /*
-         * Always keep one entry in the free list to make it easier to
-         * add free entries to the tail.
-         */
-        next = read_atomic(&maptrack_entry(t, head).ref);
-        if ( unlikely(next == MAPTRACK_TAIL) )
-        {
-            spin_unlock(&v->maptrack_freelist_lock);
-            return INVALID_MAPTRACK_HANDLE;
-        }
+static inline void
+maptrack_push(struct grant_table *t, unsigned int *head, unsigned int *nr,
+              grant_handle_t handle)
+{
+    maptrack_entry(t, handle).ref = *head;
+    *head = handle;
+    (*nr)++;
+}
+
+/* Move up to @count handles from a vCPU's magazine to the shared pool. */
+static void
+maptrack_drain(struct grant_table *t, struct vcpu *v, unsigned int count)
+{
+    ASSERT(spin_is_locked(&v->maptrack_freelist_lock));
+
+    spin_lock(&t->maptrack_lock);
+    while ( count-- && v->maptrack_nr )
+        maptrack_push(t, &t->maptrack_pool_head, &t->maptrack_pool_nr,
+                      maptrack_pop(t, &v->maptrack_head, &v->maptrack_nr));
+    spin_unlock(&t->maptrack_lock);
+
+    perfc_incr(maptrack_drain);
+}
+
+/* Add a new maptrack frame to the shared pool.  Called with maptrack_lock. */
+static bool
+maptrack_grow(struct grant_table *t)
+{
+    struct grant_mapping *new_mt;
+    grant_handle_t handle = t->maptrack_limit;
+    unsigned int i;
+
+    ASSERT(spin_is_locked(&t->maptrack_lock));
+
+    if ( nr_maptrack_frames(t) >= t->max_maptrack_frames ||
+         (new_mt = alloc_xenheap_page()) == NULL )
+        return false;
+
+    clear_page(new_mt);
+
+    for ( i = 0; i < MAPTRACK_PER_PAGE; i++ )
+    {
+        BUILD_BUG_ON(sizeof(new_mt->ref) < sizeof(handle));
+        new_mt[i].ref = handle + i + 1;
+    }
+    new_mt[i - 1].ref = t->maptrack_pool_head;
+
+    t->maptrack[nr_maptrack_frames(t)] = new_mt;
+    smp_wmb();
+    t->maptrack_limit += MAPTRACK_PER_PAGE;
+
+    t->maptrack_pool_head = handle;
+    t->maptrack_pool_nr += MAPTRACK_PER_PAGE;
+
+    return true;
+}
+
+/* Refill an empty magazine from the shared pool, growing it if need be. */
+static void
+maptrack_refill(struct grant_table *t, struct vcpu *v)
+{
+    unsigned int count = MAPTRACK_BATCH;
+
+    ASSERT(spin_is_locked(&v->maptrack_freelist_lock));
+
+    spin_lock(&t->maptrack_lock);
+
+    if ( !t->maptrack_pool_nr )
+        maptrack_grow(t);
 
-        prev_head = head;
-        head = cmpxchg(&v->maptrack_head, prev_head, next);
-    } while ( head != prev_head );
+    while ( count-- && t->maptrack_pool_nr )
+        maptrack_push(t, &v->maptrack_head, &v->maptrack_nr,
+                      maptrack_pop(t, &t->maptrack_pool_head,
+                                   &t->maptrack_pool_nr));
 
-    spin_unlock(&v->maptrack_freelist_lock);
+    spin_unlock(&t->maptrack_lock);
 
-    return head;
+    perfc_incr(maptrack_refill);
 }
 
 /*
  * Try to "steal" a free maptrack entry from another VCPU.
  *
- * A stolen entry is transferred to the thief, so the number of
- * entries for each VCPU should tend to the usage pattern.
- *
- * To avoid having to atomically count the number of free entries on
- * each VCPU and to avoid two VCPU repeatedly stealing entries from
- * each other, the initial victim VCPU is selected randomly.
+ * A domain which has used up all of its maptrack frames may still have
+ * free entries sitting in the magazines of VCPUs other than the one which
+ * needs one.  The initial victim VCPU is selected randomly, so as not to
+ * always drain the same VCPU first.
  */
 static grant_handle_t steal_maptrack_handle(struct grant_table *t,
                                             const struct vcpu *curr)
@@ -495,14 +570,20 @@ static grant_handle_t steal_maptrack_handle(struct grant_table *t,
     first = i = get_random() % currd->max_vcpus;
 
     do {
-        if ( currd->vcpu[i] )
+        struct vcpu *v = currd->vcpu[i];
+
+        if ( v && v != curr && read_atomic(&v->maptrack_nr) )
         {
-            grant_handle_t handle;
+            grant_handle_t handle = INVALID_MAPTRACK_HANDLE;
+
+            spin_lock(&v->maptrack_freelist_lock);
+            if ( v->maptrack_nr )
+                handle = maptrack_pop(t, &v->maptrack_head, &v->maptrack_nr);
+            spin_unlock(&v->maptrack_freelist_lock);
 
-            handle = _get_maptrack_handle(t, currd->vcpu[i]);
             if ( handle != INVALID_MAPTRACK_HANDLE )
             {
-                maptrack_entry(t, handle).vcpu = curr->vcpu_id;
+                perfc_incr(maptrack_steal);
                 return handle;
             }
         }
@@ -520,109 +601,40 @@ static inline void
 put_maptrack_handle(
     struct grant_table *t, grant_handle_t handle)
 {
-    struct domain *currd = current->domain;
-    struct vcpu *v;
-    unsigned int prev_tail, cur_tail;
-
-    /* 1. Set entry to be a tail. */
-    maptrack_entry(t, handle).ref = MAPTRACK_TAIL;
-
-    /* 2. Add entry to the tail of the list on the original VCPU. */
-    v = currd->vcpu[maptrack_entry(t, handle).vcpu];
-
-    spin_lock(&v->maptrack_freelist_lock);
+    struct vcpu *curr = current;
 
-    cur_tail = read_atomic(&v->maptrack_tail);
-    do {
-        prev_tail = cur_tail;
-        cur_tail = cmpxchg(&v->maptrack_tail, prev_tail, handle);
-    } while ( cur_tail != prev_tail );
+    spin_lock(&curr->maptrack_freelist_lock);
 
-    /* 3. Update the old tail entry to point to the new entry. */
-    write_atomic(&maptrack_entry(t, prev_tail).ref, handle);
+    maptrack_push(t, &curr->maptrack_head, &curr->maptrack_nr, handle);
+    if ( unlikely(curr->maptrack_nr > MAPTRACK_MAG_MAX) )
+        maptrack_drain(t, curr, MAPTRACK_BATCH);
 
-    spin_unlock(&v->maptrack_freelist_lock);
+    spin_unlock(&curr->maptrack_freelist_lock);
 }
 
 static inline grant_handle_t
 get_maptrack_handle(
     struct grant_table *lgt)
 {
-    struct vcpu          *curr = current;
-    unsigned int          i, head;
-    grant_handle_t        handle;
-    struct grant_mapping *new_mt = NULL;
+    struct vcpu   *curr = current;
+    grant_handle_t handle = INVALID_MAPTRACK_HANDLE;
 
-    handle = _get_maptrack_handle(lgt, curr);
-    if ( likely(handle != INVALID_MAPTRACK_HANDLE) )
-        return handle;
-
-    spin_lock(&lgt->maptrack_lock);
-
-    /*
-     * If we've run out of handles and still have frame headroom, try
-     * allocating a new maptrack frame.  If there is no headroom, or we're
-     * out of memory, try stealing an entry from another VCPU (in case the
-     * guest isn't mapping across its VCPUs evenly).
-     */
-    if ( nr_maptrack_frames(lgt) < lgt->max_maptrack_frames )
-        new_mt = alloc_xenheap_page();
+    spin_lock(&curr->maptrack_freelist_lock);
 
-    if ( !new_mt )
-    {
-        spin_unlock(&lgt->maptrack_lock);
+    if ( unlikely(!curr->maptrack_nr) )
+        maptrack_refill(lgt, curr);
 
-        /*
-         * Uninitialized free list? Steal an extra entry for the tail
-         * sentinel.
-         */
-        if ( curr->maptrack_tail == MAPTRACK_TAIL )
-        {
-            handle = steal_maptrack_handle(lgt, curr);
-            if ( handle == INVALID_MAPTRACK_HANDLE )
-                return handle;
-            spin_lock(&curr->maptrack_freelist_lock);
-            maptrack_entry(lgt, handle).ref = MAPTRACK_TAIL;
-            curr->maptrack_tail = handle;
-            if ( curr->maptrack_head == MAPTRACK_TAIL )
-                write_atomic(&curr->maptrack_head, handle);
-            spin_unlock(&curr->maptrack_freelist_lock);
-        }
-        return steal_maptrack_handle(lgt, curr);
-    }
+    if ( likely(curr->maptrack_nr) )
+        handle = maptrack_pop(lgt, &curr->maptrack_head, &curr->maptrack_nr);
 
-    clear_page(new_mt);
+    spin_unlock(&curr->maptrack_freelist_lock);
 
     /*
-     * Use the first new entry and add the remaining entries to the
-     * head of the free list.
+     * Out of maptrack frames (or memory): try stealing an entry from another
+     * VCPU, in case the guest isn't mapping across its VCPUs evenly.
      */
-    handle = lgt->maptrack_limit;
-
-    for ( i = 0; i < MAPTRACK_PER_PAGE; i++ )
-    {
-        BUILD_BUG_ON(sizeof(new_mt->ref) < sizeof(handle));
-        new_mt[i].ref = handle + i + 1;
-        new_mt[i].vcpu = curr->vcpu_id;
-    }
-
-    /* Set tail directly if this is the first page for this VCPU. */
-    if ( curr->maptrack_tail == MAPTRACK_TAIL )
-        curr->maptrack_tail = handle + MAPTRACK_PER_PAGE - 1;
-
-    lgt->maptrack[nr_maptrack_frames(lgt)] = new_mt;
-    smp_wmb();
-    lgt->maptrack_limit += MAPTRACK_PER_PAGE;
-
-    spin_unlock(&lgt->maptrack_lock);
-    spin_lock(&curr->maptrack_freelist_lock);
-
-    do {
-        new_mt[i - 1].ref = read_atomic(&curr->maptrack_head);
-        head = cmpxchg(&curr->maptrack_head, new_mt[i - 1].ref, handle + 1);
-    } while ( head != new_mt[i - 1].ref );
-
-    spin_unlock(&curr->maptrack_freelist_lock);
+    if ( unlikely(handle == INVALID_MAPTRACK_HANDLE) )
+        handle = steal_maptrack_handle(lgt, curr);
 
     return handle;
 }
@@ -2241,6 +2253,7 @@ gnttab_transfer(
         }
 
         page_list_add_tail(page, &e->page_list);
+        domain_adjust_node_pages(e, page, 1);
         page_set_owner(page, e);
 
         spin_unlock(&e->page_alloc_lock);
@@ -2650,64 +2663,96 @@ struct gnttab_copy_buf {
     bool_t have_type;
 };
 
-static int gnttab_copy_lock_domain(domid_t domid, bool is_gref,
-                                   struct gnttab_copy_buf *buf)
-{
-    /* Only DOMID_SELF may reference via frame. */
-    if ( domid != DOMID_SELF && !is_gref )
-        return GNTST_permission_denied;
-
-    buf->domain = rcu_lock_domain_by_any_id(domid);
-
-    if ( !buf->domain )
-        return GNTST_bad_domain;
+/*
+ * Domains referenced by a gnttab_copy() call stay locked until the end of
+ * the call, so that a batch whose ops alternate between a few (source,
+ * destination) pairs - e.g. a backend copying for several frontends at
+ * once - looks up domains and does the XSM check once per pair rather than
+ * once per op.
+ */
+#define GNTTAB_COPY_PAIRS 4
 
-    buf->ptr.domid = domid;
+struct gnttab_copy_domains {
+    unsigned int nr, next;
+    struct {
+        domid_t src_id, dest_id;
+        struct domain *src, *dest;
+    } pair[GNTTAB_COPY_PAIRS];
+};
 
-    return GNTST_okay;
+static void gnttab_copy_unlock_pair(struct gnttab_copy_domains *doms,
+                                    unsigned int i)
+{
+    rcu_unlock_domain(doms->pair[i].src);
+    rcu_unlock_domain(doms->pair[i].dest);
 }
 
-static void gnttab_copy_unlock_domains(struct gnttab_copy_buf *src,
-                                       struct gnttab_copy_buf *dest)
+static void gnttab_copy_unlock_domains(struct gnttab_copy_domains *doms)
 {
-    if ( src->domain )
-    {
-        rcu_unlock_domain(src->domain);
-        src->domain = NULL;
-    }
-    if ( dest->domain )
-    {
-        rcu_unlock_domain(dest->domain);
-        dest->domain = NULL;
-    }
+    while ( doms->nr )
+        gnttab_copy_unlock_pair(doms, --doms->nr);
 }
 
 static int gnttab_copy_lock_domains(const struct gnttab_copy *op,
+                                    struct gnttab_copy_domains *doms,
                                     struct gnttab_copy_buf *src,
                                     struct gnttab_copy_buf *dest)
 {
-    int rc;
+    struct domain *sd, *dd;
+    unsigned int i;
+
+    /* Only DOMID_SELF may reference via frame. */
+    if ( (op->source.domid != DOMID_SELF &&
+          !(op->flags & GNTCOPY_source_gref)) ||
+         (op->dest.domid != DOMID_SELF &&
+          !(op->flags & GNTCOPY_dest_gref)) )
+        return GNTST_permission_denied;
+
+    for ( i = 0; i < doms->nr; i++ )
+        if ( doms->pair[i].src_id == op->source.domid &&
+             doms->pair[i].dest_id == op->dest.domid )
+            goto found;
 
-    rc = gnttab_copy_lock_domain(op->source.domid,
-                                 op->flags & GNTCOPY_source_gref, src);
-    if ( rc < 0 )
-        goto error;
-    rc = gnttab_copy_lock_domain(op->dest.domid,
-                                 op->flags & GNTCOPY_dest_gref, dest);
-    if ( rc < 0 )
-        goto error;
+    sd = rcu_lock_domain_by_any_id(op->source.domid);
+    if ( !sd )
+        return GNTST_bad_domain;
 
-    rc = xsm_grant_copy(XSM_HOOK, src->domain, dest->domain);
-    if ( rc < 0 )
+    dd = rcu_lock_domain_by_any_id(op->dest.domid);
+    if ( !dd )
     {
-        rc = GNTST_permission_denied;
-        goto error;
+        rcu_unlock_domain(sd);
+        return GNTST_bad_domain;
     }
-    return 0;
 
- error:
-    gnttab_copy_unlock_domains(src, dest);
-    return rc;
+    if ( xsm_grant_copy(XSM_HOOK, sd, dd) < 0 )
+    {
+        rcu_unlock_domain(dd);
+        rcu_unlock_domain(sd);
+        return GNTST_permission_denied;
+    }
+
+    /* Replace pairs round robin once the table is full. */
+    if ( doms->nr < GNTTAB_COPY_PAIRS )
+        i = doms->nr++;
+    else
+    {
+        i = doms->next;
+        doms->next = (i + 1) % GNTTAB_COPY_PAIRS;
+        gnttab_copy_unlock_pair(doms, i);
+    }
+
+    doms->pair[i].src_id = op->source.domid;
+    doms->pair[i].dest_id = op->dest.domid;
+    doms->pair[i].src = sd;
+    doms->pair[i].dest = dd;
+
+ found:
+    src->domain = doms->pair[i].src;
+    src->ptr.domid = op->source.domid;
+    dest->domain = doms->pair[i].dest;
+    dest->ptr.domid = op->dest.domid;
+
+    return GNTST_okay;
 }
 
 static void gnttab_copy_release_buf(struct gnttab_copy_buf *buf)
@@ -2834,6 +2879,7 @@ static int gnttab_copy_buf(const struct gnttab_copy *op,
 }
 
 static int gnttab_copy_one(const struct gnttab_copy *op,
+                           struct gnttab_copy_domains *doms,
                            struct gnttab_copy_buf *dest,
                            struct gnttab_copy_buf *src)
 {
@@ -2844,9 +2890,9 @@ static int gnttab_copy_one(const struct gnttab_copy *op,
     {
         gnttab_copy_release_buf(src);
         gnttab_copy_release_buf(dest);
-        gnttab_copy_unlock_domains(src, dest);
+        src->domain = dest->domain = NULL;
 
-        rc = gnttab_copy_lock_domains(op, src, dest);
+        rc = gnttab_copy_lock_domains(op, doms, src, dest);
         if ( rc < 0 )
             goto out;
     }
@@ -2876,6 +2922,9 @@ static int gnttab_copy_one(const struct gnttab_copy *op,
     return rc;
 }
 
+/* Number of copy ops read from the guest at once. */
+#define GNTTAB_COPY_BATCH 16U
+
 /*
  * gnttab_copy(), other than the various other helpers of
  * do_grant_table_op(), returns (besides possible error indicators)
@@ -2887,8 +2936,9 @@ static int gnttab_copy_one(const struct gnttab_copy *op,
 static long gnttab_copy(
     XEN_GUEST_HANDLE_PARAM(gnttab_copy_t) uop, unsigned int count)
 {
-    unsigned int i;
-    struct gnttab_copy op;
+    unsigned int i, j;
+    struct gnttab_copy ops[GNTTAB_COPY_BATCH];
+    struct gnttab_copy_domains doms = {};
     struct gnttab_copy_buf src = {};
     struct gnttab_copy_buf dest = {};
     long rc = 0;
@@ -2901,13 +2951,20 @@ static long gnttab_copy(
             break;
         }
 
-        if ( unlikely(__copy_from_guest(&op, uop, 1)) )
+        /* Read ops from the guest a batch at a time. */
+        j = i % GNTTAB_COPY_BATCH;
+        if ( !j )
         {
-            rc = -EFAULT;
-            break;
+            unsigned int nr = min(count - i, GNTTAB_COPY_BATCH);
+
+            if ( unlikely(__copy_from_guest(ops, uop, nr)) )
+            {
+                rc = -EFAULT;
+                break;
+            }
         }
 
-        rc = gnttab_copy_one(&op, &dest, &src);
+        rc = gnttab_copy_one(&ops[j], &doms, &dest, &src);
         if ( rc > 0 )
         {
             rc = count - i;
@@ -2919,9 +2976,9 @@ static long gnttab_copy(
             gnttab_copy_release_buf(&dest);
         }
 
-        op.status = rc;
+        ops[j].status = rc;
         rc = 0;
-        if ( unlikely(__copy_field_to_guest(uop, &op, status)) )
+        if ( unlikely(__copy_field_to_guest(uop, &ops[j], status)) )
         {
             rc = -EFAULT;
             break;
@@ -2931,7 +2988,7 @@ static long gnttab_copy(
 
     gnttab_copy_release_buf(&src);
     gnttab_copy_release_buf(&dest);
-    gnttab_copy_unlock_domains(&src, &dest);
+    gnttab_copy_unlock_domains(&doms);
 
     return rc;
 }
@@ -3580,6 +3637,7 @@ grant_table_create(
     /* Simple stuff. */
     percpu_rwlock_resource_init(&t->lock, grant_rwlock);
     spin_lock_init(&t->maptrack_lock);
+    t->maptrack_pool_head = MAPTRACK_TAIL;
 
     t->gt_version = 1;
 
@@ -3783,7 +3841,7 @@ void grant_table_init_vcpu(struct vcpu *v)
 {
     spin_lock_init(&v->maptrack_freelist_lock);
     v->maptrack_head = MAPTRACK_TAIL;
-    v->maptrack_tail = MAPTRACK_TAIL;
+    v->maptrack_nr = 0;
 }
 
 int grant_table_set_limits(struct domain *d, unsigned int grant_frames,
@@ -318,6 +318,14 @@ static void dump_domains(unsigned char key)
                 printk("    watchdog %d expires in %d seconds\n",
                        i, (u32)((d->watchdog_timer[i].expires - NOW()) >> 30));
 
+#ifdef CONFIG_HAS_PASSTHROUGH
+        if ( iommu_enabled && dom_iommu(d)->platform_ops )
+            printk("    iommu: map_ops=%u unmap_ops=%u iotlb_flushes=%u\n",
+                   atomic_read(&dom_iommu(d)->map_ops),
+                   atomic_read(&dom_iommu(d)->unmap_ops),
+                   atomic_read(&dom_iommu(d)->iotlb_flushes));
+#endif
+
         arch_dump_domain_info(d);
 
         rangeset_domain_printk(d);
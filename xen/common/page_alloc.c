@@ -121,6 +121,7 @@
  */
 
 #include <xen/init.h>
+#include <xen/cpu.h>
 #include <xen/types.h>
 #include <xen/lib.h>
 #include <xen/sched.h>
@@ -448,6 +449,20 @@ out:
     return d->tot_pages;
 }
 
+/*
+ * Account for @pages pages on @pg's NUMA node joining (or, if negative,
+ * leaving) @d's page_list.  The schedulers use the result as a hint of
+ * where the domain's memory lives.
+ */
+void domain_adjust_node_pages(struct domain *d, const struct page_info *pg,
+                              int pages)
+{
+    ASSERT(spin_is_locked(&d->page_alloc_lock));
+
+    if ( d->node_pages )
+        d->node_pages[phys_to_nid(page_to_maddr(pg))] += pages;
+}
+
 int domain_set_outstanding_pages(struct domain *d, unsigned long pages)
 {
     int ret = -ENOMEM;
@@ -869,6 +884,8 @@ static struct page_info *get_free_buddy(unsigned int zone_lo,
     }
 }
 
+static bool page_cache_flush(void);
+
 /* Allocate 2^@order contiguous pages. */
 static struct page_info *alloc_heap_pages(
     unsigned int zone_lo, unsigned int zone_hi,
@@ -882,6 +899,7 @@ static struct page_info *alloc_heap_pages(
     bool need_tlbflush = false;
     uint32_t tlbflush_timestamp = 0;
     unsigned int dirty_cnt = 0;
+    bool flushed = false;
 
     /* Make sure there are enough bits in memflags for nodeID. */
     BUILD_BUG_ON((_MEMF_bits - _MEMF_node) < (8 * sizeof(nodeid_t)));
@@ -892,6 +910,7 @@ static struct page_info *alloc_heap_pages(
     if ( unlikely(order > MAX_ORDER) )
         return NULL;
 
+ retry:
     spin_lock(&heap_lock);
 
     /*
@@ -904,7 +923,7 @@ static struct page_info *alloc_heap_pages(
            !d || d->outstanding_pages < request) )
     {
         spin_unlock(&heap_lock);
-        return NULL;
+        goto fail;
     }
 
     /*
@@ -932,7 +951,7 @@ static struct page_info *alloc_heap_pages(
     {
         /* No suitable memory blocks. Fail the request. */
         spin_unlock(&heap_lock);
-        return NULL;
+        goto fail;
     }
 
     node = phys_to_nid(page_to_maddr(pg));
@@ -1030,6 +1049,16 @@ static struct page_info *alloc_heap_pages(
         filtered_flush_tlb_mask(tlbflush_timestamp);
 
     return pg;
+
+ fail:
+    /* Free pages may be sitting in per-CPU caches.  Reclaim them and retry. */
+    if ( !flushed && page_cache_flush() )
+    {
+        flushed = true;
+        goto retry;
+    }
+
+    return NULL;
 }
 
 /* Remove any offlined page in the buddy pointed to by head. */
@@ -1341,8 +1370,8 @@ bool scrub_free_pages(void)
     return node_to_scrub(false) != NUMA_NO_NODE;
 }
 
-/* Free 2^@order set of pages. */
-static void free_heap_pages(
+/* Free 2^@order set of pages, with heap_lock held. */
+static void free_heap_pages_locked(
     struct page_info *pg, unsigned int order, bool need_scrub)
 {
     unsigned long mask;
@@ -1352,8 +1381,7 @@ static void free_heap_pages(
 
     ASSERT(order <= MAX_ORDER);
     ASSERT(node >= 0);
-
-    spin_lock(&heap_lock);
+    ASSERT(spin_is_locked(&heap_lock));
 
     for ( i = 0; i < (1 << order); i++ )
     {
@@ -1463,11 +1491,335 @@ static void free_heap_pages(
 
     if ( tainted )
         reserve_offlined_page(pg);
+}
 
+/* Free 2^@order set of pages. */
+static void free_heap_pages(
+    struct page_info *pg, unsigned int order, bool need_scrub)
+{
+    spin_lock(&heap_lock);
+    free_heap_pages_locked(pg, order, need_scrub);
     spin_unlock(&heap_lock);
 }
 
 
+/*************************
+ * PER-CPU PAGE CACHE
+ *
+ * Single pages are allocated and freed far more often than anything else,
+ * so each CPU keeps a small cache of them in front of the heap, which saves
+ * taking heap_lock on most such requests.  Each cache has a lock of its own.
+ * It is normally only taken by its CPU and so isn't contended, but lets an
+ * allocation which the heap can't satisfy return the pages sitting in all
+ * caches to the heap and try again, rather than fail while memory is free.
+ *
+ * To the rest of the allocator a cached page is simply in use and unowned:
+ * it is accounted as allocated, and is out of reach of buddy merging and of
+ * the scrubber.  A page freed without having been scrubbed keeps
+ * PGC_need_scrub, and is scrubbed when handed out again.  A cache only holds
+ * pages from its own CPU's node and from above the DMA zone, so that it
+ * doesn't change where allocations are satisfied from.
+ */
+
+static unsigned int __read_mostly opt_page_cache = 64;
+integer_param("page_cache", opt_page_cache);
+
+/* Pages moved between a cache and the heap at a time. */
+#define PAGE_CACHE_BATCH_ORDER 4
+#define PAGE_CACHE_BATCH       (1U << PAGE_CACHE_BATCH_ORDER)
+
+struct page_cache {
+    spinlock_t lock;
+    struct page_list_head list;
+    unsigned int count;
+    bool enabled;
+};
+
+static DEFINE_PER_CPU(struct page_cache, page_cache);
+static unsigned int __read_mostly page_cache_zone_lo;
+
+/*
+ * Return up to @nr pages from the cache of a CPU to the heap.  Returns the
+ * number of pages returned.
+ */
+static unsigned int page_cache_drain(struct page_cache *pc, unsigned int nr)
+{
+    PAGE_LIST_HEAD(list);
+    struct page_info *pg;
+    unsigned int i;
+    bool need_tlbflush = false;
+    uint32_t tlbflush_timestamp = 0;
+
+    spin_lock(&pc->lock);
+    for ( i = 0; i < nr && !page_list_empty(&pc->list); i++ )
+    {
+        /* The least recently freed pages are at the tail. */
+        pg = page_list_last(&pc->list);
+        page_list_del(pg, &pc->list);
+        pc->count--;
+
+        accumulate_tlbflush(&need_tlbflush, pg, &tlbflush_timestamp);
+        page_list_add_tail(pg, &list);
+    }
+    spin_unlock(&pc->lock);
+
+    if ( !i )
+        return 0;
+
+    /*
+     * The heap considers the last owner of a page when it is freed, and
+     * these pages no longer have one.  Flush on the owners' behalf now.
+     */
+    if ( need_tlbflush )
+        filtered_flush_tlb_mask(tlbflush_timestamp);
+
+    spin_lock(&heap_lock);
+    while ( (pg = page_list_remove_head(&list)) != NULL )
+        free_heap_pages_locked(pg, 0, test_bit(_PGC_need_scrub,
+                                               &pg->count_info));
+    spin_unlock(&heap_lock);
+
+    perfc_incr(page_cache_drain);
+
+    return i;
+}
+
+/*
+ * Return the pages in every CPU's cache to the heap.  Returns whether there
+ * were any.
+ */
+static bool page_cache_flush(void)
+{
+    unsigned int cpu;
+    bool flushed = false;
+
+    for_each_online_cpu ( cpu )
+    {
+        struct page_cache *pc = &per_cpu(page_cache, cpu);
+
+        if ( read_atomic(&pc->count) && page_cache_drain(pc, UINT_MAX) )
+            flushed = true;
+    }
+
+    if ( flushed )
+        perfc_incr(page_cache_flush);
+
+    return flushed;
+}
+
+/* Called without the cache's lock held, as the heap may flush all caches. */
+static bool page_cache_refill(struct page_cache *pc, nodeid_t node)
+{
+    struct page_info *pg;
+    unsigned int i;
+
+    pg = alloc_heap_pages(page_cache_zone_lo, NR_ZONES - 1,
+                          PAGE_CACHE_BATCH_ORDER,
+                          MEMF_node(node) | MEMF_exact_node, NULL);
+    if ( !pg )
+        return false;
+
+    /* alloc_heap_pages() has scrubbed the pages and flushed as necessary. */
+    spin_lock(&pc->lock);
+    for ( i = 0; i < PAGE_CACHE_BATCH; i++ )
+    {
+        pg[i].u.free.need_tlbflush = false;
+        page_list_add_tail(&pg[i], &pc->list);
+    }
+    pc->count += PAGE_CACHE_BATCH;
+    spin_unlock(&pc->lock);
+
+    perfc_incr(page_cache_refill);
+
+    return true;
+}
+
+/*
+ * Allocate a single page for a domheap request from the local CPU's cache,
+ * if the request can be satisfied from it.
+ */
+static struct page_info *page_cache_alloc(
+    unsigned int zone_hi, unsigned int memflags, struct domain *d)
+{
+    struct page_cache *pc = &this_cpu(page_cache);
+    nodeid_t node = cpu_to_node(smp_processor_id());
+    nodeid_t req_node = MEMF_get_node(memflags);
+    struct page_info *pg;
+    bool need_tlbflush = false;
+    uint32_t tlbflush_timestamp = 0;
+
+    if ( !pc->enabled || zone_hi != NR_ZONES - 1 ||
+         (req_node != NUMA_NO_NODE && req_node != node) ||
+         (d && !node_isset(node, d->node_affinity)) )
+    {
+        perfc_incr(page_cache_bypass);
+        return NULL;
+    }
+
+    spin_lock(&pc->lock);
+
+    if ( !page_list_empty(&pc->list) )
+        perfc_incr(page_cache_hit);
+
+    for ( ; ; )
+    {
+        if ( page_list_empty(&pc->list) )
+        {
+            spin_unlock(&pc->lock);
+            if ( !page_cache_refill(pc, node) )
+                return NULL;
+            spin_lock(&pc->lock);
+            continue;
+        }
+
+        pg = page_list_remove_head(&pc->list);
+        pc->count--;
+
+        if ( likely(page_state_is(pg, inuse)) )
+            break;
+
+        /* Being offlined: let the heap take it out of use. */
+        free_heap_pages(pg, 0, test_bit(_PGC_need_scrub, &pg->count_info));
+    }
+
+    spin_unlock(&pc->lock);
+
+    if ( d != NULL )
+        d->last_alloc_node = node;
+
+    if ( !(memflags & MEMF_no_tlbflush) )
+        accumulate_tlbflush(&need_tlbflush, pg, &tlbflush_timestamp);
+
+    /* Initialise fields which have other uses for cached pages. */
+    pg->u.inuse.type_info = 0;
+
+    if ( test_bit(_PGC_need_scrub, &pg->count_info) )
+    {
+        if ( !(memflags & MEMF_no_scrub) )
+            scrub_one_page(pg);
+        clear_bit(_PGC_need_scrub, &pg->count_info);
+    }
+    else if ( !(memflags & MEMF_no_scrub) )
+        check_one_page(pg);
+
+    flush_page_to_ram(mfn_x(page_to_mfn(pg)),
+                      !(memflags & MEMF_no_icache_flush));
+
+    if ( need_tlbflush )
+        filtered_flush_tlb_mask(tlbflush_timestamp);
+
+    return pg;
+}
+
+/* Free a single domheap page to the local CPU's cache, if it may go there. */
+static bool page_cache_free(struct page_info *pg, bool need_scrub)
+{
+    struct page_cache *pc = &this_cpu(page_cache);
+    unsigned long x, nx, y = pg->count_info;
+    bool drain;
+
+    if ( !pc->enabled ||
+         phys_to_nid(page_to_maddr(pg)) != cpu_to_node(smp_processor_id()) ||
+         page_to_zone(pg) < page_cache_zone_lo )
+        return false;
+
+    /*
+     * Pages being offlined go back to the heap.  offline_page() may change
+     * the state of the page under our feet, hence the cmpxchg().
+     */
+    do {
+        x = y;
+        if ( (x & PGC_state) != PGC_state_inuse || (x & PGC_broken) )
+            return false;
+        nx = PGC_state_inuse | (need_scrub ? PGC_need_scrub : 0);
+    } while ( (y = cmpxchg(&pg->count_info, x, nx)) != x );
+
+    /* If a page has no owner it will need no safety TLB flush. */
+    pg->u.free.need_tlbflush = (page_get_owner(pg) != NULL);
+    if ( pg->u.free.need_tlbflush )
+        page_set_tlbflush_timestamp(pg);
+
+    /* This page is not a guest frame any more. */
+    page_set_owner(pg, NULL); /* set_gpfn_from_mfn snoops pg owner */
+    set_gpfn_from_mfn(mfn_x(page_to_mfn(pg)), INVALID_M2P_ENTRY);
+
+    if ( need_scrub )
+        poison_one_page(pg);
+
+    spin_lock(&pc->lock);
+    page_list_add(pg, &pc->list);
+    drain = ++pc->count > opt_page_cache;
+    spin_unlock(&pc->lock);
+
+    if ( drain )
+        page_cache_drain(pc, PAGE_CACHE_BATCH);
+
+    perfc_incr(page_cache_free);
+
+    return true;
+}
+
+static int page_cache_cpu_callback(
+    struct notifier_block *nfb, unsigned long action, void *hcpu)
+{
+    unsigned int cpu = (unsigned long)hcpu;
+    struct page_cache *pc = &per_cpu(page_cache, cpu);
+
+    switch ( action )
+    {
+    case CPU_UP_PREPARE:
+        spin_lock_init(&pc->lock);
+        INIT_PAGE_LIST_HEAD(&pc->list);
+        pc->count = 0;
+        pc->enabled = opt_page_cache;
+        break;
+    case CPU_UP_CANCELED:
+    case CPU_DEAD:
+        pc->enabled = false;
+        page_cache_drain(pc, UINT_MAX);
+        break;
+    default:
+        break;
+    }
+
+    return NOTIFY_DONE;
+}
+
+static struct notifier_block page_cache_cpu_nfb = {
+    .notifier_call = page_cache_cpu_callback
+};
+
+static int __init page_cache_init(void)
+{
+    void *cpu = (void *)(long)smp_processor_id();
+
+    /* Keep DMA memory out of the caches. */
+    page_cache_zone_lo = dma_bitsize ? bits_to_zone(dma_bitsize) + 1
+                                     : MEMZONE_XEN + 1;
+    if ( page_cache_zone_lo >= NR_ZONES )
+        opt_page_cache = 0;
+    else if ( opt_page_cache )
+        opt_page_cache = max(opt_page_cache, 2 * PAGE_CACHE_BATCH);
+
+    page_cache_cpu_callback(&page_cache_cpu_nfb, CPU_UP_PREPARE, cpu);
+    register_cpu_notifier(&page_cache_cpu_nfb);
+
+    return 0;
+}
+presmp_initcall(page_cache_init);
+
+static unsigned long page_cache_pages(void)
+{
+    unsigned int cpu;
+    unsigned long total = 0;
+
+    for_each_online_cpu ( cpu )
+        total += per_cpu(page_cache, cpu).count;
+
+    return total;
+}
+
+
 /*
  * Following rules applied for page offline:
  * Once a page is broken, it can't be assigned anymore
@@ -2226,6 +2578,7 @@ int assign_pages(
         smp_wmb(); /* Domain pointer must be visible before updating refcnt. */
         pg[i].count_info = PGC_allocated | 1;
         page_list_add_tail(&pg[i], &d->page_list);
+        domain_adjust_node_pages(d, &pg[i], 1);
     }
 
  out:
@@ -2251,7 +2604,11 @@ struct page_info *alloc_domheap_pages(
     if ( memflags & MEMF_no_owner )
         memflags |= MEMF_no_refcount;
 
-    if ( dma_bitsize && ((dma_zone = bits_to_zone(dma_bitsize)) < zone_hi) )
+    if ( order == 0 )
+        pg = page_cache_alloc(zone_hi, memflags, d);
+
+    if ( (pg == NULL) && dma_bitsize &&
+         ((dma_zone = bits_to_zone(dma_bitsize)) < zone_hi) )
         pg = alloc_heap_pages(dma_zone + 1, zone_hi, order, memflags, d);
 
     if ( (pg == NULL) &&
@@ -2304,6 +2661,7 @@ void free_domheap_pages(struct page_info *pg, unsigned int order)
             {
                 BUG_ON((pg[i].u.inuse.type_info & PGT_count_mask) != 0);
                 arch_free_heap_page(d, &pg[i]);
+                domain_adjust_node_pages(d, &pg[i], -1);
             }
 
             drop_dom_ref = !domain_adjust_tot_pages(d, -(1 << order));
@@ -2331,7 +2689,8 @@ void free_domheap_pages(struct page_info *pg, unsigned int order)
             scrub = 1;
         }
 
-        free_heap_pages(pg, order, scrub);
+        if ( order || !page_cache_free(pg, scrub) )
+            free_heap_pages(pg, order, scrub);
     }
 
     if ( drop_dom_ref )
@@ -2390,6 +2749,8 @@ static void pagealloc_info(unsigned char key)
     }
 
     printk("    Dom heap: %lukB free\n", total << (PAGE_SHIFT-10));
+    printk("    CPU page caches: %lukB\n",
+           page_cache_pages() << (PAGE_SHIFT-10));
 }
 
 static __init int pagealloc_keyhandler_init(void)
@@ -16,6 +16,7 @@
 #include <xen/domain.h>
 #include <xen/delay.h>
 #include <xen/event.h>
+#include <xen/guest_access.h>
 #include <xen/time.h>
 #include <xen/perfc.h>
 #include <xen/sched-if.h>
@@ -112,6 +113,14 @@
  *   two vCPUs use 80%, one uses 10% and the other 30%; or that each use
  *   50% (and so on and so forth).
  *
+ * - on top of that, a vCPU can be given a cap of its own, with
+ *   XEN_DOMCTL_SCHEDOP_putvcpuinfo, which limits how much of the domain's
+ *   budget that vCPU can use in each period. It is only enforced while the
+ *   domain has a cap too (possibly 100 * nr_vCPUs, i.e., no limit at the
+ *   domain level), as that is what turns budget accounting on. The
+ *   toolstack uses this to slow down the vCPUs that dirty memory fastest,
+ *   so that a live migration can converge.
+ *
  * For implementing this, we use the following approach:
  *
  * - each domain is given a 'budget', an each domain has a timer, which
@@ -403,6 +412,20 @@ integer_param("credit2_balance_over", opt_overload_balance_tolerance);
 static unsigned int __read_mostly opt_cap_period = 10;    /* ms */
 integer_param("credit2_cap_period_ms", opt_cap_period);
 
+/*
+ * NUMA memory locality.
+ *
+ * When picking a runqueue for a vcpu, and when balancing load between two
+ * runqueues, the fraction of the domain's memory that is not on the NUMA
+ * node(s) of a runqueue is accounted as extra load on that runqueue.
+ * opt_locality_weight is how much, as a percentage of the load of one fully
+ * busy vcpu, having all the memory remote weighs. Default is 50, i.e., a
+ * runqueue far from all of a domain's memory is considered as loaded as one
+ * close to it, plus half a vcpu. 0 disables this.
+ */
+static unsigned int __read_mostly opt_locality_weight = 50;
+integer_param("credit2_locality_weight", opt_locality_weight);
+
 /*
  * Runqueue organization.
  *
@@ -420,7 +443,9 @@ integer_param("credit2_cap_period_ms", opt_cap_period);
  * - per-socket: meaning that there will be one runqueue per each physical
  *               socket (AKA package, which often, but not always, also
  *               matches a NUMA node) of the host; This will happen if
- *               the opt_runqueue parameter is set to 'socket';
+ *               the opt_runqueue parameter is set to 'socket'. Sockets
+ *               spanning more than one NUMA node are split, so that each
+ *               runqueue only has cpus from one node;
  *
  * - per-node: meaning that there will be one runqueue per each physical
  *             NUMA node of the host. This will happen if the opt_runqueue
@@ -483,6 +508,7 @@ struct csched2_runqueue_data {
         smt_idle,              /* Fully idle-and-untickled cores (see below) */
         tickled,               /* Have been asked to go through schedule     */
         idle;                  /* Currently idle pcpus                       */
+    nodemask_t nodes;          /* NUMA nodes of the CPUs in active           */
 
     struct list_head svc;      /* List of all vcpus assigned to the runqueue */
     unsigned int max_weight;   /* Max weight of the vcpus in this runqueue   */
@@ -529,6 +555,9 @@ struct csched2_vcpu {
     s_time_t budget;                   /* Current budget (if domains has cap) */
                                        /* but clear_bit() does not like that) */
     s_time_t budget_quota;             /* Budget to which vCPU is entitled    */
+    s_time_t cap_budget;               /* Budget left under the vCPU's cap    */
+    s_time_t cap_repl;                 /* Replenishment cap_budget is from    */
+    uint16_t cap;                      /* vCPU's own cap (0 if none)          */
 
     s_time_t start_time;               /* Time we were scheduled (for credit) */
 
@@ -541,6 +570,8 @@ struct csched2_vcpu {
     struct list_head rqd_elem;         /* On csched2_runqueue_data's svc list */
     struct csched2_runqueue_data *migrate_rqd; /* Pre-determined migr. target */
     int tickled_cpu;                   /* Cpu that will pick us (-1 if none)  */
+    s_time_t numa_cost;                /* Locality cost of a balance_load()   */
+                                       /* move (negative if it's a gain)      */
 };
 
 /*
@@ -831,6 +862,81 @@ static void deactivate_runqueue(struct csched2_private *prv, int rqi)
     __cpumask_clear_cpu(rqi, &prv->active_queues);
 }
 
+/* Recompute the NUMA nodes spanned by a runqueue, as its cpus change. */
+static void update_runqueue_nodes(struct csched2_runqueue_data *rqd)
+{
+    unsigned int cpu;
+
+    nodes_clear(rqd->nodes);
+    for_each_cpu ( cpu, &rqd->active )
+        node_set(cpu_to_node(cpu), rqd->nodes);
+}
+
+/*
+ * Percentage of d's memory that lives on the NUMA nodes of rqd. The per-node
+ * page counts are updated under d->page_alloc_lock, which we do not take, so
+ * this is only a (good enough) estimate.
+ */
+static unsigned int rqd_locality(const struct csched2_runqueue_data *rqd,
+                                 const struct domain *d)
+{
+    uint64_t local = 0, total = 0;
+    unsigned int node;
+
+    if ( !d->node_pages )
+        return 100;
+
+    for_each_online_node ( node )
+    {
+        unsigned int pages = read_atomic(&d->node_pages[node]);
+
+        total += pages;
+        if ( node_isset(node, rqd->nodes) )
+            local += pages;
+    }
+
+    return total ? (local * 100) / total : 100;
+}
+
+/*
+ * Extra load, in the same units as the runqueue load averages, that running
+ * a vcpu of d on rqd costs, because of d's memory not being local to it.
+ */
+static s_time_t locality_penalty(const struct csched2_private *prv,
+                                 const struct csched2_runqueue_data *rqd,
+                                 const struct domain *d)
+{
+    if ( !opt_locality_weight || num_online_nodes() <= 1 )
+        return 0;
+
+    return (((s_time_t)(100 - rqd_locality(rqd, d)) * opt_locality_weight)
+            << prv->load_precision_shift) / (100 * 100);
+}
+
+/*
+ * Locality score of a domain: the average of the locality of the runqueues
+ * its vcpus are currently assigned to.
+ */
+static unsigned int dom_locality(const struct domain *d)
+{
+    const struct vcpu *v;
+    unsigned int locality = 0, nr = 0;
+
+    for_each_vcpu ( d, v )
+    {
+        const struct csched2_runqueue_data *rqd =
+            read_atomic(&csched2_vcpu(v)->rqd);
+
+        if ( rqd == NULL )
+            continue;
+
+        locality += rqd_locality(rqd, d);
+        nr++;
+    }
+
+    return nr ? locality / nr : 100;
+}
+
 static inline bool same_node(unsigned int cpua, unsigned int cpub)
 {
     return cpu_to_node(cpua) == cpu_to_node(cpub);
@@ -883,7 +989,8 @@ cpu_to_runqueue(struct csched2_private *prv, unsigned int cpu)
             continue;
         if ( opt_runqueue == OPT_RUNQUEUE_ALL ||
              (opt_runqueue == OPT_RUNQUEUE_CORE && same_core(peer_cpu, cpu)) ||
-             (opt_runqueue == OPT_RUNQUEUE_SOCKET && same_socket(peer_cpu, cpu)) ||
+             (opt_runqueue == OPT_RUNQUEUE_SOCKET && same_socket(peer_cpu, cpu) &&
+              same_node(peer_cpu, cpu)) ||
              (opt_runqueue == OPT_RUNQUEUE_NODE && same_node(peer_cpu, cpu)) )
             break;
     }
@@ -1815,7 +1922,24 @@ static bool vcpu_grab_budget(struct csched2_vcpu *svc)
      */
     sdom->budget += svc->budget;
 
-    if ( sdom->budget > 0 )
+    /*
+     * A vCPU with a cap of its own is charged the same way, and has its
+     * allowance topped up the first time it gets here after each of the
+     * domain's replenishments.
+     */
+    if ( unlikely(svc->cap) )
+    {
+        s_time_t cap_tot = CSCHED2_BDGT_REPL_PERIOD * svc->cap / 100;
+
+        svc->cap_budget += svc->budget;
+        if ( svc->cap_repl != sdom->next_repl )
+        {
+            svc->cap_budget = min(svc->cap_budget + cap_tot, cap_tot);
+            svc->cap_repl = sdom->next_repl;
+        }
+    }
+
+    if ( sdom->budget > 0 && (likely(!svc->cap) || svc->cap_budget > 0) )
     {
         s_time_t budget;
 
@@ -1825,6 +1949,12 @@ static bool vcpu_grab_budget(struct csched2_vcpu *svc)
         else
             budget = sdom->budget;
 
+        if ( unlikely(svc->cap) )
+        {
+            budget = min(budget, svc->cap_budget);
+            svc->cap_budget -= budget;
+        }
+
         svc->budget = budget;
         sdom->budget -= budget;
     }
@@ -1858,6 +1988,8 @@ vcpu_return_budget(struct csched2_vcpu *svc, struct list_head *parked)
      * pool.
      */
     sdom->budget += svc->budget;
+    if ( unlikely(svc->cap) )
+        svc->cap_budget += svc->budget;
     svc->budget = 0;
 
     /*
@@ -2062,6 +2194,7 @@ csched2_alloc_vdata(const struct scheduler *ops, struct vcpu *vc, void *dd)
 
     svc->budget = STIME_MAX;
     svc->budget_quota = 0;
+    svc->cap = 0;
     INIT_LIST_HEAD(&svc->parked_elem);
 
     SCHED_STAT_CRANK(vcpu_alloc);
@@ -2320,6 +2453,13 @@ csched2_cpu_pick(const struct scheduler *ops, struct vcpu *vc)
             spin_unlock(&rqd->lock);
         }
 
+        /*
+         * Make runqueues far from the domain's memory look busier than they
+         * are, so we prefer the ones close to it, if the load allows that.
+         */
+        if ( rqd_avgload != MAX_LOAD )
+            rqd_avgload += locality_penalty(prv, rqd, vc->domain);
+
         /*
          * if svc has a soft-affinity, and some cpus of rqd are part of it,
          * see if we need to update the "soft-affinity minimum".
@@ -2455,6 +2595,12 @@ static void consider(balance_state_t *st,
     if ( delta < 0 )
         delta = -delta;
 
+    /* Moving vcpus away from (or towards) their memory costs (or gains). */
+    if ( push_svc )
+        delta += push_svc->numa_cost;
+    if ( pull_svc )
+        delta += pull_svc->numa_cost;
+
     if ( delta < st->load_delta )
     {
         st->load_delta = delta;
@@ -2547,6 +2693,17 @@ static bool vcpu_is_migrateable(struct csched2_vcpu *svc,
            cpumask_intersects(cpumask_scratch_cpu(cpu), &rqd->active);
 }
 
+/* Locality cost of moving svc from its runqueue to rqd. */
+static void update_svc_numa_cost(const struct csched2_private *prv,
+                                 struct csched2_vcpu *svc,
+                                 const struct csched2_runqueue_data *rqd)
+{
+    const struct domain *d = svc->vcpu->domain;
+
+    svc->numa_cost = locality_penalty(prv, rqd, d) -
+                     locality_penalty(prv, svc->rqd, d);
+}
+
 static void balance_load(const struct scheduler *ops, int cpu, s_time_t now)
 {
     struct csched2_private *prv = csched2_priv(ops);
@@ -2677,6 +2834,13 @@ retry:
 
     SCHED_STAT_CRANK(acct_load_balance);
 
+    list_for_each( push_iter, &st.lrqd->svc )
+        update_svc_numa_cost(prv, list_entry(push_iter, struct csched2_vcpu,
+                                             rqd_elem), st.orqd);
+    list_for_each( pull_iter, &st.orqd->svc )
+        update_svc_numa_cost(prv, list_entry(pull_iter, struct csched2_vcpu,
+                                             rqd_elem), st.lrqd);
+
     /* Look for "swap" which gives the best load average
      * FIXME: O(n^2)! */
 
@@ -2818,6 +2982,7 @@ csched2_dom_cntl(
         read_lock_irqsave(&prv->lock, flags);
         op->u.credit2.weight = sdom->weight;
         op->u.credit2.cap = sdom->cap;
+        op->u.credit2.locality = dom_locality(d);
         read_unlock_irqrestore(&prv->lock, flags);
         break;
     case XEN_DOMCTL_SCHEDOP_putinfo:
@@ -2986,6 +3151,75 @@ csched2_dom_cntl(
         }
         write_unlock_irqrestore(&prv->lock, flags);
         break;
+    case XEN_DOMCTL_SCHEDOP_getvcpuinfo:
+    case XEN_DOMCTL_SCHEDOP_putvcpuinfo:
+    {
+        struct xen_domctl_schedparam_vcpu local_sched;
+        unsigned int index = 0;
+
+        /* Only the cap can be set per-vCPU; the weight is domain-wide. */
+        while ( index < op->u.v.nr_vcpus )
+        {
+            struct csched2_vcpu *svc;
+
+            if ( copy_from_guest_offset(&local_sched,
+                                        op->u.v.vcpus, index, 1) )
+            {
+                rc = -EFAULT;
+                break;
+            }
+            if ( local_sched.vcpuid >= d->max_vcpus ||
+                 d->vcpu[local_sched.vcpuid] == NULL )
+            {
+                rc = -EINVAL;
+                break;
+            }
+
+            svc = csched2_vcpu(d->vcpu[local_sched.vcpuid]);
+
+            if ( op->cmd == XEN_DOMCTL_SCHEDOP_getvcpuinfo )
+            {
+                read_lock_irqsave(&prv->lock, flags);
+                local_sched.u.credit2.weight = svc->weight;
+                local_sched.u.credit2.cap = svc->cap;
+                local_sched.u.credit2.locality =
+                    svc->rqd ? rqd_locality(svc->rqd, d) : 100;
+                read_unlock_irqrestore(&prv->lock, flags);
+
+                if ( copy_to_guest_offset(op->u.v.vcpus, index,
+                                          &local_sched, 1) )
+                {
+                    rc = -EFAULT;
+                    break;
+                }
+            }
+            else
+            {
+                if ( local_sched.u.credit2.cap > 100 )
+                {
+                    rc = -EINVAL;
+                    break;
+                }
+
+                /* The vCPU's allowance is only touched with budget_lock. */
+                write_lock_irqsave(&prv->lock, flags);
+                spin_lock(&sdom->budget_lock);
+                svc->cap = local_sched.u.credit2.cap;
+                svc->cap_budget = 0;
+                svc->cap_repl = 0;
+                spin_unlock(&sdom->budget_lock);
+                write_unlock_irqrestore(&prv->lock, flags);
+            }
+
+            /* Process at most 64 vCPUs without checking for preemptions. */
+            if ( (++index > 63) && hypercall_preempt_check() )
+                break;
+        }
+        if ( !rc )
+            /* notify upper caller how many vcpus have been processed. */
+            op->u.v.nr_vcpus = index;
+        break;
+    }
     default:
         rc = -EINVAL;
         break;
@@ -3639,6 +3873,9 @@ csched2_dump_vcpu(struct csched2_private *prv, struct csched2_vcpu *svc)
         printk(" budget=%"PRI_stime"(%"PRI_stime")",
                svc->budget, svc->budget_quota);
 
+    if ( svc->cap )
+        printk(" cap=%u%% (%"PRI_stime")", svc->cap, svc->cap_budget);
+
     printk(" load=%"PRI_stime" (~%"PRI_stime"%%)", svc->avgload,
            (svc->avgload * 100) >> prv->load_precision_shift);
 
@@ -3709,6 +3946,8 @@ csched2_dump(const struct scheduler *ops)
                prv->rqd[i].avgload,
                fraction);
 
+        nodelist_scnprintf(cpustr, sizeof(cpustr), &prv->rqd[i].nodes);
+        printk("\tnodes: %s\n", cpustr);
         cpumask_scnprintf(cpustr, sizeof(cpustr), &prv->rqd[i].idle);
         printk("\tidlers: %s\n", cpustr);
         cpumask_scnprintf(cpustr, sizeof(cpustr), &prv->rqd[i].tickled);
@@ -3726,11 +3965,12 @@ csched2_dump(const struct scheduler *ops)
 
         sdom = list_entry(iter_sdom, struct csched2_dom, sdom_elem);
 
-        printk("\tDomain: %d w %d c %u v %d\n",
+        printk("\tDomain: %d w %d c %u v %d l %u%%\n",
                sdom->dom->domain_id,
                sdom->weight,
                sdom->cap,
-               sdom->nr_vcpus);
+               sdom->nr_vcpus,
+               dom_locality(sdom->dom));
 
         for_each_vcpu( sdom->dom, v )
         {
@@ -3807,6 +4047,7 @@ init_pdata(struct csched2_private *prv, unsigned int cpu)
     __cpumask_set_cpu(cpu, &rqd->active);
     __cpumask_set_cpu(cpu, &prv->initialized);
     __cpumask_set_cpu(cpu, &rqd->smt_idle);
+    node_set(cpu_to_node(cpu), rqd->nodes);
 
     if ( cpumask_weight(&rqd->active) == 1 )
         rqd->pick_bias = cpu;
@@ -3917,6 +4158,7 @@ csched2_deinit_pdata(const struct scheduler *ops, void *pcpu, int cpu)
     __cpumask_clear_cpu(cpu, &rqd->idle);
     __cpumask_clear_cpu(cpu, &rqd->smt_idle);
     __cpumask_clear_cpu(cpu, &rqd->active);
+    update_runqueue_nodes(rqd);
 
     if ( cpumask_empty(&rqd->active) )
     {
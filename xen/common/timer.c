@@ -28,12 +28,47 @@
 static unsigned int timer_slop __read_mostly = 50000; /* 50 us */
 integer_param("timer_slop", timer_slop);
 
+/* Keep active timers on a hierarchical timer wheel rather than a heap. */
+static bool __read_mostly opt_timer_wheel;
+boolean_param("timer_wheel", opt_timer_wheel);
+
+/*
+ * The wheel has WHEEL_LEVELS levels of WHEEL_LVL_SIZE buckets.  A level-0
+ * bucket spans 2^WHEEL_TICK_SHIFT ns (one tick), and each level's buckets
+ * are 2^WHEEL_LVL_SHIFT times wider than the level below, so that the
+ * wheel covers about 2.4 hours.  Timers further away are parked in the
+ * last bucket.
+ */
+#define WHEEL_TICK_SHIFT 16
+#define WHEEL_LVL_BITS   6
+#define WHEEL_LVL_SIZE   (1U << WHEEL_LVL_BITS)
+#define WHEEL_LVL_SHIFT  3
+#define WHEEL_LEVELS     8
+#define WHEEL_SIZE       (WHEEL_LEVELS * WHEEL_LVL_SIZE)
+/* Pseudo-bucket for expired timers waiting to be executed. */
+#define WHEEL_EXPIRED    WHEEL_SIZE
+
+/* Statistics histograms have log2 buckets: [0], [1], [2,3], [4,7], ... */
+#define TIMER_HIST_SIZE  12
+
 struct timers {
     spinlock_t     lock;
     struct timer **heap;
     struct timer  *list;
     struct timer  *running;
     struct list_head inactive;
+
+    /* Timer wheel (timer_wheel boot option). */
+    struct list_head *wheel;
+    DECLARE_BITMAP(wheel_pending, WHEEL_SIZE);
+    struct list_head wheel_expired;
+    uint64_t       wheel_clk;   /* Last tick processed. */
+    s_time_t       wheel_next;  /* Earliest expiry, or earlier. */
+
+    /* Statistics. */
+    unsigned int   nr_active;
+    unsigned long  run_timers_hist[TIMER_HIST_SIZE]; /* timers per softirq */
+    unsigned long  run_time_hist[TIMER_HIST_SIZE];   /* softirq time, us */
 } __cacheline_aligned;
 
 static DEFINE_PER_CPU(struct timers, timers);
@@ -166,6 +201,185 @@ static int add_to_list(struct timer **pprev, struct timer *t)
 }
 
 
+/****************************************************************************
+ * TIMER WHEEL OPERATIONS.
+ */
+
+/*
+ * A level-L bucket holds the timers whose expiry tick, shifted right by
+ * L * WHEEL_LVL_SHIFT, equals the bucket's index.  A timer goes on the
+ * lowest level where this index is less than WHEEL_LVL_SIZE away from the
+ * current tick's, and so never in a bucket which has already been
+ * processed.  Buckets are processed when the current tick reaches their
+ * start, and their timers are then either expired or moved to a lower level.
+ */
+static unsigned int wheel_bucket(const struct timers *ts, s_time_t expires)
+{
+    uint64_t clk = ts->wheel_clk, tick = 0;
+    unsigned int lvl, shift = 0;
+
+    if ( expires > 0 )
+        tick = (uint64_t)expires >> WHEEL_TICK_SHIFT;
+    if ( tick < clk )
+        tick = clk;
+
+    for ( lvl = 0; lvl < WHEEL_LEVELS; lvl++ )
+    {
+        shift = lvl * WHEEL_LVL_SHIFT;
+        if ( (tick >> shift) - (clk >> shift) < WHEEL_LVL_SIZE )
+            break;
+    }
+
+    if ( lvl == WHEEL_LEVELS )
+    {
+        lvl = WHEEL_LEVELS - 1;
+        tick = ((clk >> shift) + WHEEL_LVL_SIZE - 1) << shift;
+    }
+
+    return lvl * WHEEL_LVL_SIZE + ((tick >> shift) & (WHEEL_LVL_SIZE - 1));
+}
+
+/* Add @t to the wheel. Return TRUE if it is the new earliest timer. */
+static int add_to_wheel(struct timers *ts, struct timer *t)
+{
+    unsigned int b = wheel_bucket(ts, t->expires);
+
+    t->wheel_bucket = b;
+    list_add_tail(&t->wheel, &ts->wheel[b]);
+    __set_bit(b, ts->wheel_pending);
+
+    if ( t->expires >= ts->wheel_next )
+        return 0;
+
+    ts->wheel_next = t->expires;
+    return 1;
+}
+
+/* Delete @t from the wheel. Return TRUE if it may have been the earliest. */
+static int remove_from_wheel(struct timers *ts, struct timer *t)
+{
+    unsigned int b = t->wheel_bucket;
+
+    list_del(&t->wheel);
+    if ( b != WHEEL_EXPIRED && list_empty(&ts->wheel[b]) )
+        __clear_bit(b, ts->wheel_pending);
+
+    return (t->expires <= ts->wheel_next);
+}
+
+/* Queue @t for execution, keeping the expired list in expiry order. */
+static void wheel_expire(struct timers *ts, struct timer *t)
+{
+    struct list_head *pos = ts->wheel_expired.prev;
+
+    while ( pos != &ts->wheel_expired &&
+            list_entry(pos, struct timer, wheel)->expires > t->expires )
+        pos = pos->prev;
+
+    t->wheel_bucket = WHEEL_EXPIRED;
+    list_add(&t->wheel, pos);
+}
+
+/*
+ * Process every bucket whose start is no later than @now: expired timers
+ * are moved to the expired list, the others to lower levels.
+ */
+static void wheel_advance(struct timers *ts, s_time_t now)
+{
+    uint64_t clk = ts->wheel_clk, new_clk = (uint64_t)now >> WHEEL_TICK_SHIFT;
+    unsigned int lvl;
+    LIST_HEAD(todo);
+
+    for ( lvl = 0; lvl < WHEEL_LEVELS; lvl++ )
+    {
+        unsigned int shift = lvl * WHEEL_LVL_SHIFT;
+        /* The current level-0 bucket may have been refilled since. */
+        uint64_t first = (clk >> shift) + (lvl != 0), last = new_clk >> shift;
+        uint64_t i;
+
+        if ( last < first )
+            break;
+        if ( last - first >= WHEEL_LVL_SIZE )
+            first = last - WHEEL_LVL_SIZE + 1;
+
+        for ( i = first; i <= last; i++ )
+        {
+            unsigned int b = lvl * WHEEL_LVL_SIZE +
+                             (i & (WHEEL_LVL_SIZE - 1));
+
+            if ( __test_and_clear_bit(b, ts->wheel_pending) )
+                list_splice_init(&ts->wheel[b], &todo);
+        }
+    }
+
+    ts->wheel_clk = new_clk;
+
+    while ( !list_empty(&todo) )
+    {
+        struct timer *t = list_first_entry(&todo, struct timer, wheel);
+
+        list_del(&t->wheel);
+        if ( t->expires < now )
+            wheel_expire(ts, t);
+        else
+            add_to_wheel(ts, t);
+    }
+}
+
+/*
+ * Earliest expiry on the wheel.  Within a level, the first non-empty bucket
+ * from the current tick holds the level's earliest timers.
+ */
+static s_time_t wheel_deadline(const struct timers *ts)
+{
+    s_time_t deadline = STIME_MAX;
+    unsigned int lvl;
+
+    for ( lvl = 0; lvl < WHEEL_LEVELS; lvl++ )
+    {
+        const unsigned long *pending = ts->wheel_pending;
+        unsigned int start = lvl * WHEEL_LVL_SIZE;
+        unsigned int end = start + WHEEL_LVL_SIZE;
+        unsigned int b = start + ((ts->wheel_clk >> (lvl * WHEEL_LVL_SHIFT)) &
+                                  (WHEEL_LVL_SIZE - 1));
+        const struct timer *t;
+
+        b = find_next_bit(pending, end, b);
+        if ( b >= end )
+            b = find_next_bit(pending, end, start);
+        if ( b >= end )
+            continue;
+
+        list_for_each_entry ( t, &ts->wheel[b], wheel )
+            if ( t->expires < deadline )
+                deadline = t->expires;
+    }
+
+    return deadline;
+}
+
+static int alloc_wheel(struct timers *ts)
+{
+    unsigned int b;
+
+    if ( ts->wheel )
+        return 0;
+
+    ts->wheel = xmalloc_array(struct list_head, WHEEL_SIZE);
+    if ( !ts->wheel )
+        return -ENOMEM;
+
+    for ( b = 0; b < WHEEL_SIZE; b++ )
+        INIT_LIST_HEAD(&ts->wheel[b]);
+    bitmap_zero(ts->wheel_pending, WHEEL_SIZE);
+    INIT_LIST_HEAD(&ts->wheel_expired);
+    ts->wheel_clk = (uint64_t)NOW() >> WHEEL_TICK_SHIFT;
+    ts->wheel_next = STIME_MAX;
+
+    return 0;
+}
+
+
 /****************************************************************************
  * TIMER OPERATIONS.
  */
@@ -183,11 +397,15 @@ static int remove_entry(struct timer *t)
     case TIMER_STATUS_in_list:
         rc = remove_from_list(&timers->list, t);
         break;
+    case TIMER_STATUS_in_wheel:
+        rc = remove_from_wheel(timers, t);
+        break;
     default:
         rc = 0;
         BUG();
     }
 
+    timers->nr_active--;
     t->status = TIMER_STATUS_invalid;
     return rc;
 }
@@ -199,6 +417,14 @@ static int add_entry(struct timer *t)
 
     ASSERT(t->status == TIMER_STATUS_invalid);
 
+    timers->nr_active++;
+
+    if ( opt_timer_wheel )
+    {
+        t->status = TIMER_STATUS_in_wheel;
+        return add_to_wheel(timers, t);
+    }
+
     /* Try to add to heap. t->heap_offset indicates whether we succeed. */
     t->heap_offset = 0;
     t->status = TIMER_STATUS_in_heap;
@@ -276,7 +502,7 @@ static inline void timer_unlock(struct timer *timer)
 static bool_t active_timer(struct timer *timer)
 {
     ASSERT(timer->status >= TIMER_STATUS_inactive);
-    ASSERT(timer->status <= TIMER_STATUS_in_list);
+    ASSERT(timer->status <= TIMER_STATUS_in_wheel);
     return (timer->status >= TIMER_STATUS_in_heap);
 }
 
@@ -441,15 +667,49 @@ static void execute_timer(struct timers *ts, struct timer *t)
 }
 
 
+static void timer_hist_add(unsigned long *hist, unsigned long val)
+{
+    hist[min_t(unsigned int, val ? flsl(val) : 0, TIMER_HIST_SIZE - 1)]++;
+}
+
+static s_time_t timer_softirq_wheel(struct timers *ts, s_time_t now,
+                                    unsigned int *nr_run)
+{
+    struct timer *t;
+
+    wheel_advance(ts, now);
+
+    while ( !list_empty(&ts->wheel_expired) )
+    {
+        t = list_first_entry(&ts->wheel_expired, struct timer, wheel);
+        remove_entry(t);
+        execute_timer(ts, t);
+        ++*nr_run;
+    }
+
+    ts->wheel_next = wheel_deadline(ts);
+
+    return ts->wheel_next;
+}
+
 static void timer_softirq_action(void)
 {
     struct timer  *t, **heap, *next;
     struct timers *ts;
-    s_time_t       now, deadline;
+    s_time_t       start, now, deadline;
+    unsigned int   nr_run = 0;
 
     ts = &this_cpu(timers);
     heap = ts->heap;
 
+    if ( opt_timer_wheel )
+    {
+        spin_lock_irq(&ts->lock);
+        start = NOW();
+        deadline = timer_softirq_wheel(ts, start, &nr_run);
+        goto reprogram;
+    }
+
     /* If we overflowed the heap, try to allocate a larger heap. */
     if ( unlikely(ts->list != NULL) )
     {
@@ -472,21 +732,23 @@ static void timer_softirq_action(void)
 
     spin_lock_irq(&ts->lock);
 
-    now = NOW();
+    now = start = NOW();
 
     /* Execute ready heap timers. */
     while ( (GET_HEAP_SIZE(heap) != 0) &&
             ((t = heap[1])->expires < now) )
     {
-        remove_from_heap(heap, t);
+        remove_entry(t);
         execute_timer(ts, t);
+        nr_run++;
     }
 
     /* Execute ready list timers. */
     while ( ((t = ts->list) != NULL) && (t->expires < now) )
     {
-        ts->list = t->list_next;
+        remove_entry(t);
         execute_timer(ts, t);
+        nr_run++;
     }
 
     /* Try to move timers from linked list to more efficient heap. */
@@ -496,6 +758,7 @@ static void timer_softirq_action(void)
     {
         next = t->list_next;
         t->status = TIMER_STATUS_invalid;
+        ts->nr_active--;
         add_entry(t);
     }
 
@@ -505,7 +768,11 @@ static void timer_softirq_action(void)
         deadline = heap[1]->expires;
     if ( (ts->list != NULL) && (ts->list->expires < deadline) )
         deadline = ts->list->expires;
+
+ reprogram:
     now = NOW();
+    timer_hist_add(ts->run_timers_hist, nr_run);
+    timer_hist_add(ts->run_time_hist, (now - start) / MICROSECS(1));
     this_cpu(timer_deadline) =
         (deadline == STIME_MAX) ? 0 : MAX(deadline, now + timer_slop);
 
@@ -529,6 +796,16 @@ static void dump_timer(struct timer *t, s_time_t now)
            (t->expires - now) / 1000, t, t->function, t->data);
 }
 
+static void dump_timer_hist(const char *name, const unsigned long *hist)
+{
+    unsigned int i;
+
+    printk("  %s:", name);
+    for ( i = 0; i < TIMER_HIST_SIZE; i++ )
+        printk(" %lu", hist[i]);
+    printk("\n");
+}
+
 static void dump_timerq(unsigned char key)
 {
     struct timer  *t;
@@ -537,20 +814,60 @@ static void dump_timerq(unsigned char key)
     s_time_t       now = NOW();
     int            i, j;
 
-    printk("Dumping timer queues:\n");
+    printk("Dumping timer queues (%s):\n", opt_timer_wheel ? "wheel" : "heap");
 
     for_each_online_cpu( i )
     {
         ts = &per_cpu(timers, i);
 
-        printk("CPU%02d:\n", i);
+        printk("CPU%02d: %u active\n", i, ts->nr_active);
         spin_lock_irqsave(&ts->lock, flags);
         for ( j = 1; j <= GET_HEAP_SIZE(ts->heap); j++ )
             dump_timer(ts->heap[j], now);
         for ( t = ts->list, j = 0; t != NULL; t = t->list_next, j++ )
             dump_timer(t, now);
+        if ( ts->wheel )
+        {
+            for ( j = 0; j < WHEEL_SIZE; j++ )
+                list_for_each_entry ( t, &ts->wheel[j], wheel )
+                    dump_timer(t, now);
+            list_for_each_entry ( t, &ts->wheel_expired, wheel )
+                dump_timer(t, now);
+        }
         spin_unlock_irqrestore(&ts->lock, flags);
     }
+
+    printk("Timer softirq histograms, log2 buckets [0] [1] [2,3] [4,7] ...:\n");
+
+    for_each_online_cpu( i )
+    {
+        ts = &per_cpu(timers, i);
+
+        printk("CPU%02d:\n", i);
+        dump_timer_hist("timers run", ts->run_timers_hist);
+        dump_timer_hist("time (us) ", ts->run_time_hist);
+    }
+}
+
+/* Any active timer of @ts, or NULL. */
+static struct timer *first_active_timer(struct timers *ts)
+{
+    unsigned int b;
+
+    if ( GET_HEAP_SIZE(ts->heap) )
+        return ts->heap[1];
+    if ( ts->list )
+        return ts->list;
+    if ( !ts->wheel )
+        return NULL;
+
+    if ( !list_empty(&ts->wheel_expired) )
+        return list_first_entry(&ts->wheel_expired, struct timer, wheel);
+    b = find_first_bit(ts->wheel_pending, WHEEL_SIZE);
+    if ( b < WHEEL_SIZE )
+        return list_first_entry(&ts->wheel[b], struct timer, wheel);
+
+    return NULL;
 }
 
 static void migrate_timers_from_cpu(unsigned int old_cpu)
@@ -576,8 +893,7 @@ static void migrate_timers_from_cpu(unsigned int old_cpu)
         spin_lock(&old_ts->lock);
     }
 
-    while ( (t = GET_HEAP_SIZE(old_ts->heap)
-             ? old_ts->heap[1] : old_ts->list) != NULL )
+    while ( (t = first_active_timer(old_ts)) != NULL )
     {
         remove_entry(t);
         write_atomic(&t->cpu, new_cpu);
@@ -610,6 +926,9 @@ static int cpu_callback(
     switch ( action )
     {
     case CPU_UP_PREPARE:
+        /* The wheel is kept across offlining, as the heap is. */
+        if ( opt_timer_wheel && alloc_wheel(ts) )
+            return notifier_from_errno(-ENOMEM);
         INIT_LIST_HEAD(&ts->inactive);
         spin_lock_init(&ts->lock);
         ts->heap = &dummy_heap;
@@ -643,7 +962,8 @@ void __init timer_init(void)
     SET_HEAP_SIZE(&dummy_heap, 0);
     SET_HEAP_LIMIT(&dummy_heap, 0);
 
-    cpu_callback(&cpu_nfb, CPU_UP_PREPARE, cpu);
+    if ( cpu_callback(&cpu_nfb, CPU_UP_PREPARE, cpu) != NOTIFY_DONE )
+        panic("Unable to allocate the timer wheel\n");
     register_cpu_notifier(&cpu_nfb);
 
     register_keyhandler('a', dump_timerq, "dump timer queues", 1);
@@ -23,7 +23,10 @@
  * Adapted for Xen by Dan Magenheimer (dan.magenheimer@oracle.com)
  */
 
+#include <xen/cpu.h>
+#include <xen/init.h>
 #include <xen/irq.h>
+#include <xen/keyhandler.h>
 #include <xen/mm.h>
 #include <xen/pfn.h>
 #include <asm/time.h>
@@ -374,24 +377,35 @@ void xmem_pool_destroy(struct xmem_pool *pool)
     free_xenheap_pages(pool,pool_order);
 }
 
-void *xmem_pool_alloc(unsigned long size, struct xmem_pool *pool)
+static bool xmem_pool_init_region(struct xmem_pool *pool)
 {
-    struct bhdr *b, *b2, *next_b, *region;
-    int fl, sl;
-    unsigned long tmp_size;
+    struct bhdr *region;
 
     if ( pool->init_region == NULL )
     {
         if ( (region = pool->get_mem(pool->init_size)) == NULL )
-            goto out;
+            return false;
         ADD_REGION(region, pool->init_size, pool);
         pool->init_region = region;
     }
 
+    return true;
+}
+
+/*
+ * Called with the pool lock held, which is dropped and re-acquired if the
+ * pool needs to grow.
+ */
+static void *xmem_pool_alloc_locked(unsigned long size,
+                                    struct xmem_pool *pool)
+{
+    struct bhdr *b, *b2, *next_b, *region;
+    int fl, sl;
+    unsigned long tmp_size;
+
     size = (size < MIN_BLOCK_SIZE) ? MIN_BLOCK_SIZE : ROUNDUP_SIZE(size);
     /* Rounding up the requested size and calculating fl and sl */
 
-    spin_lock(&pool->lock);
  retry_find:
     MAPPING_SEARCH(&size, &fl, &sl);
 
@@ -400,15 +414,16 @@ void *xmem_pool_alloc(unsigned long size, struct xmem_pool *pool)
     {
         /* Not found */
         if ( size > (pool->grow_size - 2 * BHDR_OVERHEAD) )
-            goto out_locked;
+            return NULL;
         if ( pool->max_size && (pool->init_size +
                                 pool->num_regions * pool->grow_size
                                 > pool->max_size) )
-            goto out_locked;
+            return NULL;
         spin_unlock(&pool->lock);
-        if ( (region = pool->get_mem(pool->grow_size)) == NULL )
-            goto out;
+        region = pool->get_mem(pool->grow_size);
         spin_lock(&pool->lock);
+        if ( region == NULL )
+            return NULL;
         ADD_REGION(region, pool->grow_size, pool);
         goto retry_find;
     }
@@ -441,28 +456,31 @@ void *xmem_pool_alloc(unsigned long size, struct xmem_pool *pool)
 
     pool->used_size += (b->size & BLOCK_SIZE_MASK) + BHDR_OVERHEAD;
 
-    spin_unlock(&pool->lock);
     return (void *)b->ptr.buffer;
+}
 
-    /* Failed alloc */
- out_locked:
+void *xmem_pool_alloc(unsigned long size, struct xmem_pool *pool)
+{
+    void *p;
+
+    if ( !xmem_pool_init_region(pool) )
+        return NULL;
+
+    spin_lock(&pool->lock);
+    p = xmem_pool_alloc_locked(size, pool);
     spin_unlock(&pool->lock);
 
- out:
-    return NULL;
+    return p;
 }
 
-void xmem_pool_free(void *ptr, struct xmem_pool *pool)
+/* Called with the pool lock held. */
+static void xmem_pool_free_locked(void *ptr, struct xmem_pool *pool)
 {
     struct bhdr *b, *tmp_b;
     int fl = 0, sl = 0;
 
-    if ( unlikely(ptr == NULL) )
-        return;
-
     b = (struct bhdr *)((char *) ptr - BHDR_OVERHEAD);
 
-    spin_lock(&pool->lock);
     b->size |= FREE_BLOCK;
     pool->used_size -= (b->size & BLOCK_SIZE_MASK) + BHDR_OVERHEAD;
     b->ptr.free_ptr = (struct free_ptr) { NULL, NULL};
@@ -491,14 +509,22 @@ void xmem_pool_free(void *ptr, struct xmem_pool *pool)
         pool->put_mem(b);
         pool->num_regions--;
         pool->used_size -= BHDR_OVERHEAD; /* sentinel block header */
-        goto out;
+        return;
     }
 
     INSERT_BLOCK(b, pool, fl, sl);
 
     tmp_b->size |= PREV_FREE;
     tmp_b->prev_hdr = b;
- out:
+}
+
+void xmem_pool_free(void *ptr, struct xmem_pool *pool)
+{
+    if ( unlikely(ptr == NULL) )
+        return;
+
+    spin_lock(&pool->lock);
+    xmem_pool_free_locked(ptr, pool);
     spin_unlock(&pool->lock);
 }
 
@@ -559,6 +585,251 @@ static void tlsf_init(void)
     BUG_ON(!xenpool);
 }
 
+/*
+ * Per-CPU caches of small blocks.
+ *
+ * Most xmalloc() requests are for a few dozen to a few hundred bytes, and
+ * during domain creation and destruction there are a great many of them,
+ * all serialised on the pool lock.  Each CPU therefore keeps a short list
+ * of free blocks for each of a handful of size classes, which it allocates
+ * from and frees to without taking the lock.  Blocks move between a cache
+ * and the pool in batches, under a single acquisition of the lock.
+ *
+ * To TLSF a cached block is simply in use.  Blocks aren't tied to the CPU
+ * which allocated them: a block freed on another CPU goes into that CPU's
+ * cache, and comes back to the pool with the next batch drained from there.
+ * xmalloc() isn't usable in interrupt context, so nothing can get at the
+ * local cache behind our back.
+ */
+
+static unsigned int __read_mostly opt_xmalloc_cache = 32;
+integer_param("xmalloc_cache", opt_xmalloc_cache);
+
+/* Blocks moved between a cache and the pool at a time. */
+#define XMALLOC_CACHE_BATCH 8
+
+static const unsigned int xmalloc_cache_sizes[] = {
+    16, 32, 48, 64, 96, 128, 192, 256, 384, 512
+};
+#define XMALLOC_CACHE_CLASSES  ARRAY_SIZE(xmalloc_cache_sizes)
+#define XMALLOC_CACHE_MAX_SIZE xmalloc_cache_sizes[XMALLOC_CACHE_CLASSES - 1]
+
+struct xmalloc_cache_class {
+    void *head;             /* Free blocks, linked through their first word. */
+    unsigned int count;
+    unsigned long hits, misses, frees, drains;
+};
+
+struct xmalloc_cache {
+    struct xmalloc_cache_class class[XMALLOC_CACHE_CLASSES];
+    bool enabled;
+};
+
+static DEFINE_PER_CPU(struct xmalloc_cache, xmalloc_cache);
+
+/* Smallest class which can hold @size bytes. */
+static unsigned int xmalloc_cache_class(unsigned long size)
+{
+    unsigned int i;
+
+    for ( i = 0; i < XMALLOC_CACHE_CLASSES; i++ )
+        if ( size <= xmalloc_cache_sizes[i] )
+            break;
+
+    return i;
+}
+
+/* Return up to @nr blocks from a cache class to the pool. */
+static void xmalloc_cache_drain(struct xmalloc_cache_class *cc, unsigned int nr)
+{
+    void *p;
+
+    if ( !cc->count )
+        return;
+
+    spin_lock(&xenpool->lock);
+    for ( ; nr && (p = cc->head) != NULL; nr-- )
+    {
+        cc->head = *(void **)p;
+        cc->count--;
+        xmem_pool_free_locked(p, xenpool);
+    }
+    spin_unlock(&xenpool->lock);
+
+    cc->drains++;
+}
+
+/*
+ * Allocate a batch of blocks for a cache class, returning the first to the
+ * caller and caching the rest.
+ */
+static void *xmalloc_cache_refill(struct xmalloc_cache_class *cc,
+                                  unsigned int size)
+{
+    void *res, *p;
+    unsigned int i;
+
+    if ( !xmem_pool_init_region(xenpool) )
+        return NULL;
+
+    spin_lock(&xenpool->lock);
+    res = xmem_pool_alloc_locked(size, xenpool);
+    for ( i = 1; res && i < XMALLOC_CACHE_BATCH; i++ )
+    {
+        if ( (p = xmem_pool_alloc_locked(size, xenpool)) == NULL )
+            break;
+        *(void **)p = cc->head;
+        cc->head = p;
+        cc->count++;
+    }
+    spin_unlock(&xenpool->lock);
+
+    cc->misses++;
+
+    return res;
+}
+
+static void *xmalloc_cache_alloc(unsigned long size)
+{
+    struct xmalloc_cache *xc = &this_cpu(xmalloc_cache);
+    struct xmalloc_cache_class *cc;
+    unsigned int idx;
+    void *p;
+
+    if ( !xc->enabled )
+        return NULL;
+
+    idx = xmalloc_cache_class(size);
+    ASSERT(idx < XMALLOC_CACHE_CLASSES);
+    cc = &xc->class[idx];
+
+    if ( (p = cc->head) == NULL )
+        return xmalloc_cache_refill(cc, xmalloc_cache_sizes[idx]);
+
+    cc->head = *(void **)p;
+    cc->count--;
+    cc->hits++;
+
+    return p;
+}
+
+/* Free a block to the local CPU's cache, if it fits one of the classes. */
+static bool xmalloc_cache_free(void *p)
+{
+    struct xmalloc_cache *xc = &this_cpu(xmalloc_cache);
+    const struct bhdr *b = (struct bhdr *)((char *)p - BHDR_OVERHEAD);
+    unsigned long size = b->size & BLOCK_SIZE_MASK;
+    struct xmalloc_cache_class *cc;
+    unsigned int idx;
+
+    if ( !xc->enabled || size >= XMALLOC_CACHE_MAX_SIZE + sizeof(struct bhdr) )
+        return false;
+
+    /*
+     * TLSF hands out blocks up to (not including) a minimal block larger
+     * than asked for.  Anything larger than that wasn't allocated for a
+     * class, and would waste memory sitting in a cache.
+     */
+    idx = xmalloc_cache_class(size);
+    if ( idx == XMALLOC_CACHE_CLASSES || size < xmalloc_cache_sizes[idx] )
+    {
+        if ( !idx )
+            return false;
+        idx--;
+        if ( size - xmalloc_cache_sizes[idx] >= sizeof(struct bhdr) )
+            return false;
+    }
+
+    cc = &xc->class[idx];
+    *(void **)p = cc->head;
+    cc->head = p;
+    cc->frees++;
+
+    if ( ++cc->count > opt_xmalloc_cache )
+        xmalloc_cache_drain(cc, XMALLOC_CACHE_BATCH);
+
+    return true;
+}
+
+static int xmalloc_cache_cpu_callback(
+    struct notifier_block *nfb, unsigned long action, void *hcpu)
+{
+    unsigned int cpu = (unsigned long)hcpu, i;
+    struct xmalloc_cache *xc = &per_cpu(xmalloc_cache, cpu);
+
+    switch ( action )
+    {
+    case CPU_UP_PREPARE:
+        memset(xc, 0, sizeof(*xc));
+        xc->enabled = opt_xmalloc_cache;
+        break;
+    case CPU_UP_CANCELED:
+    case CPU_DEAD:
+        xc->enabled = false;
+        for ( i = 0; i < XMALLOC_CACHE_CLASSES; i++ )
+            xmalloc_cache_drain(&xc->class[i], xc->class[i].count);
+        break;
+    default:
+        break;
+    }
+
+    return NOTIFY_DONE;
+}
+
+static struct notifier_block xmalloc_cache_cpu_nfb = {
+    .notifier_call = xmalloc_cache_cpu_callback
+};
+
+static void dump_xmalloc_cache(unsigned char key)
+{
+    unsigned int cpu, i;
+
+    printk("xmalloc per-CPU caches (max %u blocks per class):\n",
+           opt_xmalloc_cache);
+
+    for ( i = 0; i < XMALLOC_CACHE_CLASSES; i++ )
+    {
+        unsigned long cached = 0, hits = 0, misses = 0, frees = 0, drains = 0;
+
+        for_each_online_cpu ( cpu )
+        {
+            const struct xmalloc_cache_class *cc =
+                &per_cpu(xmalloc_cache, cpu).class[i];
+
+            cached += cc->count;
+            hits += cc->hits;
+            misses += cc->misses;
+            frees += cc->frees;
+            drains += cc->drains;
+        }
+
+        printk("  %4u bytes: %5lu cached, %lu hits, %lu refills (%lu%% hit), "
+               "%lu frees, %lu drains\n",
+               xmalloc_cache_sizes[i], cached, hits, misses,
+               hits + misses ? hits * 100 / (hits + misses) : 0,
+               frees, drains);
+    }
+}
+
+static int __init xmalloc_cache_init(void)
+{
+    void *cpu = (void *)(long)smp_processor_id();
+
+    if ( opt_xmalloc_cache )
+        opt_xmalloc_cache = max(opt_xmalloc_cache, 2U * XMALLOC_CACHE_BATCH);
+
+    if ( !xenpool )
+        tlsf_init();
+
+    xmalloc_cache_cpu_callback(&xmalloc_cache_cpu_nfb, CPU_UP_PREPARE, cpu);
+    register_cpu_notifier(&xmalloc_cache_cpu_nfb);
+
+    register_keyhandler('X', dump_xmalloc_cache, "dump xmalloc caches", 1);
+
+    return 0;
+}
+presmp_initcall(xmalloc_cache_init);
+
 /*
  * xmalloc()
  */
@@ -586,7 +857,9 @@ void *_xmalloc(unsigned long size, unsigned long align)
     if ( !xenpool )
         tlsf_init();
 
-    if ( size < PAGE_SIZE )
+    if ( size <= XMALLOC_CACHE_MAX_SIZE )
+        p = xmalloc_cache_alloc(size);
+    if ( p == NULL && size < PAGE_SIZE )
         p = xmem_pool_alloc(size, xenpool);
     if ( p == NULL )
         return xmalloc_whole_pages(size - align + MEM_ALIGN, align);
@@ -648,5 +921,6 @@ void xfree(void *p)
         ASSERT(!(b->size & 1));
     }
 
-    xmem_pool_free(p, xenpool);
+    if ( !xmalloc_cache_free(p) )
+        xmem_pool_free(p, xenpool);
 }
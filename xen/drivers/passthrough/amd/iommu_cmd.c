@@ -348,6 +348,8 @@ static void _amd_iommu_flush_pages(struct domain *d,
     struct amd_iommu *iommu;
     unsigned int dom_id = d->domain_id;
 
+    atomic_inc(&dom_iommu(d)->iotlb_flushes);
+
     /* send INVALIDATE_IOMMU_PAGES command */
     for_each_amd_iommu ( iommu )
     {
@@ -372,6 +374,33 @@ void amd_iommu_flush_pages(struct domain *d,
     _amd_iommu_flush_pages(d, (uint64_t) gfn << PAGE_SHIFT, order);
 }
 
+/*
+ * Flush a range of pages with a single command, using the smallest
+ * supported (4k, 2M or 1G) aligned block covering it.
+ */
+int amd_iommu_iotlb_flush(struct domain *d, unsigned long gfn,
+                          unsigned int page_count)
+{
+    unsigned int order = 0;
+
+    if ( page_count > 1 )
+        order = flsl(gfn ^ (gfn + page_count - 1));
+
+    if ( !page_count || gfn == gfn_x(INVALID_GFN) || order > 18 )
+        amd_iommu_flush_all_pages(d);
+    else
+        amd_iommu_flush_pages(d, gfn, order ? (order <= 9 ? 9 : 18) : 0);
+
+    return 0;
+}
+
+int amd_iommu_iotlb_flush_all(struct domain *d)
+{
+    amd_iommu_flush_all_pages(d);
+
+    return 0;
+}
+
 void amd_iommu_flush_device(struct amd_iommu *iommu, uint16_t bdf)
 {
     ASSERT( spin_is_locked(&iommu->lock) );
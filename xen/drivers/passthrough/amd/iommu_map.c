@@ -766,7 +766,8 @@ int amd_iommu_unmap_page(struct domain *d, unsigned long gfn)
     clear_iommu_pte_present(pt_mfn[1], gfn);
     spin_unlock(&hd->arch.mapping_lock);
 
-    amd_iommu_flush_pages(d, gfn, 0);
+    if ( !this_cpu(iommu_dont_flush_iotlb) )
+        amd_iommu_flush_pages(d, gfn, 0);
 
     return 0;
 }
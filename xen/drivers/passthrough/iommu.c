@@ -42,6 +42,7 @@ integer_param("iommu_dev_iotlb_timeout", iommu_dev_iotlb_timeout);
  *   dom0-passthrough           No DMA translation at all for Dom0
  *   dom0-strict                No 1:1 memory mapping for Dom0
  *   no-sharept                 Don't share VT-d and EPT page tables
+ *   no-superpages              Don't use superpages in VT-d page tables
  *   no-snoop                   Disable VT-d Snoop Control
  *   no-qinval                  Disable VT-d Queued Invalidation
  *   no-igfx                    Disable VT-d for IGD devices (insecure)
@@ -69,6 +70,7 @@ bool_t __read_mostly iommu_intremap = 1;
  */
 bool_t __read_mostly iommu_intpost;
 bool_t __read_mostly iommu_hap_pt_share = 1;
+bool_t __read_mostly iommu_superpages = 1;
 bool_t __read_mostly iommu_debug;
 bool_t __read_mostly amd_iommu_perdev_intremap = 1;
 
@@ -126,6 +128,8 @@ static int __init parse_iommu_param(const char *s)
             iommu_dom0_strict = val;
         else if ( !strncmp(s, "sharept", ss - s) )
             iommu_hap_pt_share = val;
+        else if ( !strncmp(s, "superpages", ss - s) )
+            iommu_superpages = val;
         else
             rc = -EINVAL;
 
@@ -258,12 +262,14 @@ void iommu_domain_destroy(struct domain *d)
 int iommu_map_page(struct domain *d, unsigned long gfn, unsigned long mfn,
                    unsigned int flags)
 {
-    const struct domain_iommu *hd = dom_iommu(d);
+    struct domain_iommu *hd = dom_iommu(d);
     int rc;
 
     if ( !iommu_enabled || !hd->platform_ops )
         return 0;
 
+    atomic_inc(&hd->map_ops);
+
     rc = hd->platform_ops->map_page(d, gfn, mfn, flags);
     if ( unlikely(rc) )
     {
@@ -281,12 +287,14 @@ int iommu_map_page(struct domain *d, unsigned long gfn, unsigned long mfn,
 
 int iommu_unmap_page(struct domain *d, unsigned long gfn)
 {
-    const struct domain_iommu *hd = dom_iommu(d);
+    struct domain_iommu *hd = dom_iommu(d);
     int rc;
 
     if ( !iommu_enabled || !hd->platform_ops )
         return 0;
 
+    atomic_inc(&hd->unmap_ops);
+
     rc = hd->platform_ops->unmap_page(d, gfn);
     if ( unlikely(rc) )
     {
@@ -302,6 +310,116 @@ int iommu_unmap_page(struct domain *d, unsigned long gfn)
     return rc;
 }
 
+static int __must_check unmap_pages(struct domain *d, unsigned long gfn,
+                                    unsigned int order)
+{
+    const struct domain_iommu *hd = dom_iommu(d);
+    bool_t dont_flush = this_cpu(iommu_dont_flush_iotlb);
+    unsigned long i;
+    int rc = 0;
+
+    if ( hd->platform_ops->unmap_pages )
+        return hd->platform_ops->unmap_pages(d, gfn, order);
+
+    /*
+     * Unmap page by page, but flush only once at the end, if the backend
+     * lets us do that.  Keep going on errors, so as to leave as little as
+     * possible mapped.
+     */
+    if ( hd->platform_ops->iotlb_flush )
+        this_cpu(iommu_dont_flush_iotlb) = 1;
+
+    for ( i = 0; i < (1UL << order); i++ )
+    {
+        int ret = hd->platform_ops->unmap_page(d, gfn + i);
+
+        if ( !rc )
+            rc = ret;
+    }
+
+    if ( hd->platform_ops->iotlb_flush )
+    {
+        this_cpu(iommu_dont_flush_iotlb) = dont_flush;
+        if ( !dont_flush )
+        {
+            int ret = hd->platform_ops->iotlb_flush(d, gfn, 1u << order);
+
+            if ( !rc )
+                rc = ret;
+        }
+    }
+
+    return rc;
+}
+
+int iommu_map_pages(struct domain *d, unsigned long gfn, unsigned long mfn,
+                    unsigned int order, unsigned int flags)
+{
+    struct domain_iommu *hd = dom_iommu(d);
+    unsigned long i;
+    int rc = 0;
+
+    if ( !iommu_enabled || !hd->platform_ops )
+        return 0;
+
+    atomic_inc(&hd->map_ops);
+
+    if ( hd->platform_ops->map_pages )
+        rc = hd->platform_ops->map_pages(d, gfn, mfn, order, flags);
+    else
+        for ( i = 0; i < (1UL << order); i++ )
+        {
+            rc = hd->platform_ops->map_page(d, gfn + i, mfn + i, flags);
+            if ( unlikely(rc) )
+            {
+                /* Undo what this call installed, leaving the rest alone. */
+                while ( i-- )
+                    /* If statement to satisfy __must_check. */
+                    if ( hd->platform_ops->unmap_page(d, gfn + i) )
+                        continue;
+                break;
+            }
+        }
+
+    if ( unlikely(rc) )
+    {
+        if ( !d->is_shutting_down && printk_ratelimit() )
+            printk(XENLOG_ERR
+                   "d%d: IOMMU mapping gfn %#lx to mfn %#lx order %u failed: %d\n",
+                   d->domain_id, gfn, mfn, order, rc);
+
+        if ( !is_hardware_domain(d) )
+            domain_crash(d);
+    }
+
+    return rc;
+}
+
+int iommu_unmap_pages(struct domain *d, unsigned long gfn, unsigned int order)
+{
+    struct domain_iommu *hd = dom_iommu(d);
+    int rc;
+
+    if ( !iommu_enabled || !hd->platform_ops )
+        return 0;
+
+    atomic_inc(&hd->unmap_ops);
+
+    rc = unmap_pages(d, gfn, order);
+    if ( unlikely(rc) )
+    {
+        if ( !d->is_shutting_down && printk_ratelimit() )
+            printk(XENLOG_ERR
+                   "d%d: IOMMU unmapping gfn %#lx order %u failed: %d\n",
+                   d->domain_id, gfn, order, rc);
+
+        if ( !is_hardware_domain(d) )
+            domain_crash(d);
+    }
+
+    return rc;
+}
+
 static void iommu_free_pagetables(unsigned long unused)
 {
     do {
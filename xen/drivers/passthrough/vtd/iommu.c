@@ -52,6 +52,9 @@ bool __read_mostly untrusted_msi;
 
 int nr_iommus;
 
+/* Highest page table level at which all units support superpages. */
+static unsigned int __read_mostly vtd_max_sp_level = 3;
+
 static struct tasklet vtd_fault_tasklet;
 
 static int setup_hwdom_device(u8 devfn, struct pci_dev *);
@@ -249,16 +252,66 @@ static u64 bus_to_context_maddr(struct iommu *iommu, u8 bus)
     return maddr;
 }
 
-static u64 addr_to_dma_page_maddr(struct domain *domain, u64 addr, int alloc)
+/* Replace the superpage at *pte by a page table mapping the same range. */
+static u64 dma_split_superpage(struct domain *domain, struct dma_pte *pte,
+                               unsigned int level)
+{
+    struct acpi_drhd_unit *drhd;
+    struct pci_dev *pdev;
+    struct dma_pte *table, new = { 0 };
+    u64 maddr;
+    unsigned int i;
+
+    pdev = pci_get_pdev_by_domain(domain, -1, -1, -1);
+    drhd = acpi_find_matched_drhd_unit(pdev);
+    maddr = alloc_pgtable_maddr(drhd, 1);
+    if ( !maddr )
+        return 0;
+
+    table = (struct dma_pte *)map_vtd_domain_page(maddr);
+    for ( i = 0; i < PTE_NUM; i++ )
+    {
+        table[i].val = pte->val + offset_level_address(i, level - 1);
+        if ( level == 2 )
+            table[i].val &= ~DMA_PTE_SP;
+    }
+    iommu_flush_cache_page(table, 1);
+    unmap_vtd_domain_page(table);
+
+    /*
+     * The translations don't change, so the IOTLB needn't be flushed: the
+     * next flush covering any part of the range will drop the superpage.
+     */
+    dma_set_pte_addr(new, maddr);
+    dma_set_pte_readable(new);
+    dma_set_pte_writable(new);
+    write_atomic(&pte->val, new.val);
+    iommu_flush_cache_entry(pte, sizeof(struct dma_pte));
+
+    return maddr;
+}
+
+/*
+ * Return the machine address of the page table holding the level *level
+ * entry for addr.  If alloc is set, missing tables are allocated and
+ * superpages in the way are split.  Otherwise the walk stops at the first
+ * missing table or superpage, and *level is set to the level of the entry
+ * at which it stopped: 0 is returned for a missing table, and the address
+ * of the table holding the entry for a superpage.
+ */
+static u64 addr_to_dma_page_maddr(struct domain *domain, u64 addr,
+                                  unsigned int *level, bool_t alloc)
 {
     struct acpi_drhd_unit *drhd;
     struct pci_dev *pdev;
     struct domain_iommu *hd = dom_iommu(domain);
     int addr_width = agaw_to_width(hd->arch.agaw);
     struct dma_pte *parent, *pte = NULL;
-    int level = agaw_to_level(hd->arch.agaw);
+    unsigned int cur = agaw_to_level(hd->arch.agaw);
     int offset;
-    u64 pte_maddr = 0;
+    u64 parent_maddr, pte_maddr = 0;
+
+    ASSERT(*level >= 1 && *level <= cur);
 
     addr &= (((u64)1) << addr_width) - 1;
     ASSERT(spin_is_locked(&hd->arch.mapping_lock));
@@ -271,20 +324,40 @@ static u64 addr_to_dma_page_maddr(struct domain *domain, u64 addr, int alloc)
         pdev = pci_get_pdev_by_domain(domain, -1, -1, -1);
         drhd = acpi_find_matched_drhd_unit(pdev);
         if ( !alloc || ((hd->arch.pgd_maddr = alloc_pgtable_maddr(drhd, 1)) == 0) )
+        {
+            *level = cur;
             goto out;
+        }
     }
 
-    parent = (struct dma_pte *)map_vtd_domain_page(hd->arch.pgd_maddr);
-    while ( level > 1 )
+    parent_maddr = pte_maddr = hd->arch.pgd_maddr;
+    parent = (struct dma_pte *)map_vtd_domain_page(parent_maddr);
+    while ( cur > *level )
     {
-        offset = address_level_offset(addr, level);
+        offset = address_level_offset(addr, cur);
         pte = &parent[offset];
 
         pte_maddr = dma_pte_addr(*pte);
-        if ( !pte_maddr )
+        if ( pte_maddr && dma_pte_superpage(*pte) )
         {
             if ( !alloc )
+            {
+                *level = cur;
+                pte_maddr = parent_maddr;
                 break;
+            }
+
+            pte_maddr = dma_split_superpage(domain, pte, cur);
+            if ( !pte_maddr )
+                break;
+        }
+        else if ( !pte_maddr )
+        {
+            if ( !alloc )
+            {
+                *level = cur;
+                break;
+            }
 
             pdev = pci_get_pdev_by_domain(domain, -1, -1, -1);
             drhd = acpi_find_matched_drhd_unit(pdev);
@@ -303,12 +376,13 @@ static u64 addr_to_dma_page_maddr(struct domain *domain, u64 addr, int alloc)
             iommu_flush_cache_entry(pte, sizeof(struct dma_pte));
         }
 
-        if ( level == 2 )
+        if ( cur == *level + 1 )
             break;
 
         unmap_vtd_domain_page(parent);
-        parent = map_vtd_domain_page(pte_maddr);
-        level--;
+        parent_maddr = pte_maddr;
+        parent = map_vtd_domain_page(parent_maddr);
+        cur--;
     }
 
     unmap_vtd_domain_page(parent);
@@ -595,6 +669,11 @@ static int __must_check iommu_flush_iotlb(struct domain *d,
     bool_t flush_dev_iotlb;
     int iommu_domid;
     int rc = 0;
+    /* Smallest aligned block covering the range, for page selective flush. */
+    unsigned int order = page_count > 1 ? flsl(gfn ^ (gfn + page_count - 1))
+                                        : PAGE_ORDER_4K;
+
+    atomic_inc(&hd->iotlb_flushes);
 
     /*
      * No need pcideves_lock here because we have flush
@@ -612,14 +691,13 @@ static int __must_check iommu_flush_iotlb(struct domain *d,
         if ( iommu_domid == -1 )
             continue;
 
-        if ( page_count != 1 || gfn == gfn_x(INVALID_GFN) )
+        if ( !page_count || gfn == gfn_x(INVALID_GFN) )
             rc = iommu_flush_iotlb_dsi(iommu, iommu_domid,
                                        0, flush_dev_iotlb);
         else
             rc = iommu_flush_iotlb_psi(iommu, iommu_domid,
                                        (paddr_t)gfn << PAGE_SHIFT_4K,
-                                       PAGE_ORDER_4K,
-                                       !dma_old_pte_present,
+                                       order, !dma_old_pte_present,
                                        flush_dev_iotlb);
 
         if ( rc > 0 )
@@ -644,43 +722,77 @@ static int __must_check iommu_flush_iotlb_all(struct domain *d)
     return iommu_flush_iotlb(d, gfn_x(INVALID_GFN), 0, 0);
 }
 
-/* clear one page's page table */
-static int __must_check dma_pte_clear_one(struct domain *domain, u64 addr)
+/*
+ * Largest level (bounded by max_level) at which a single entry can map gfn
+ * (and mfn) with at least nr pages left in the range.
+ */
+static unsigned int dma_pte_level(unsigned long gfn, unsigned long mfn,
+                                  unsigned long nr, unsigned int max_level)
+{
+    unsigned int level = 1;
+
+    while ( level < max_level &&
+            !((gfn | mfn) & ((1UL << level_to_order(level + 1)) - 1)) &&
+            nr >= (1UL << level_to_order(level + 1)) )
+        level++;
+
+    return level;
+}
+
+/*
+ * Clear the mapping of gfn, removing at most nr pages.  Return the number
+ * of pages dealt with, or -ENOMEM if a superpage couldn't be split.
+ */
+static long dma_pte_clear(struct domain *domain, unsigned long gfn,
+                          unsigned long nr, bool_t *flush)
 {
     struct domain_iommu *hd = dom_iommu(domain);
-    struct dma_pte *page = NULL, *pte = NULL;
+    struct dma_pte *page, *pte;
+    u64 addr = (paddr_t)gfn << PAGE_SHIFT_4K;
     u64 pg_maddr;
-    int rc = 0;
+    unsigned int level = 1;
+    unsigned long mask, done;
 
     spin_lock(&hd->arch.mapping_lock);
-    /* get last level pte */
-    pg_maddr = addr_to_dma_page_maddr(domain, addr, 0);
+
+    /* get last level pte, or whatever stops the walk */
+    pg_maddr = addr_to_dma_page_maddr(domain, addr, &level, 0);
+    mask = (1UL << level_to_order(level)) - 1;
+    done = mask + 1 - (gfn & mask);
     if ( pg_maddr == 0 )
     {
+        /* Nothing is mapped up to the end of the missing table. */
         spin_unlock(&hd->arch.mapping_lock);
-        return 0;
+        return min(done, nr);
+    }
+
+    if ( level > 1 && ((gfn & mask) || nr <= mask) )
+    {
+        /* Only part of the superpage goes: split it. */
+        level = dma_pte_level(gfn, 0, nr, level - 1);
+        pg_maddr = addr_to_dma_page_maddr(domain, addr, &level, 1);
+        if ( pg_maddr == 0 )
+        {
+            spin_unlock(&hd->arch.mapping_lock);
+            return -ENOMEM;
+        }
+        done = 1UL << level_to_order(level);
     }
 
     page = (struct dma_pte *)map_vtd_domain_page(pg_maddr);
-    pte = page + address_level_offset(addr, 1);
+    pte = page + address_level_offset(addr, level);
 
-    if ( !dma_pte_present(*pte) )
+    if ( dma_pte_present(*pte) )
     {
-        spin_unlock(&hd->arch.mapping_lock);
-        unmap_vtd_domain_page(page);
-        return 0;
+        dma_clear_pte(*pte);
+        iommu_flush_cache_entry(pte, sizeof(struct dma_pte));
+        *flush = 1;
     }
 
-    dma_clear_pte(*pte);
     spin_unlock(&hd->arch.mapping_lock);
-    iommu_flush_cache_entry(pte, sizeof(struct dma_pte));
-
-    if ( !this_cpu(iommu_dont_flush_iotlb) )
-        rc = iommu_flush_iotlb_pages(domain, addr >> PAGE_SHIFT_4K, 1);
-
     unmap_vtd_domain_page(page);
 
-    return rc;
+    return done;
 }
 
 static void iommu_free_pagetable(u64 pt_maddr, int level)
@@ -711,7 +823,7 @@ static void iommu_free_page_table(struct page_info *pg)
         if ( !dma_pte_present(*pte) )
             continue;
 
-        if ( next_level >= 1 )
+        if ( next_level >= 1 && !dma_pte_superpage(*pte) )
             iommu_free_pagetable(dma_pte_addr(*pte), next_level);
 
         dma_clear_pte(*pte);
@@ -1403,7 +1515,9 @@ int domain_context_mapping_one(
         /* Ensure we have pagetables allocated down to leaf PTE. */
         if ( hd->arch.pgd_maddr == 0 )
         {
-            addr_to_dma_page_maddr(domain, 0, 1);
+            unsigned int level = 1;
+
+            addr_to_dma_page_maddr(domain, 0, &level, 1);
             if ( hd->arch.pgd_maddr == 0 )
             {
             nomem:
@@ -1766,70 +1880,161 @@ static void iommu_domain_teardown(struct domain *d)
     spin_unlock(&hd->arch.mapping_lock);
 }
 
-static int __must_check intel_iommu_map_page(struct domain *d,
-                                             unsigned long gfn,
-                                             unsigned long mfn,
-                                             unsigned int flags)
+/*
+ * Map gfn to mfn with a single entry at the given level, unless a page
+ * table is in the way.  Return the number of pages mapped, or -ENOMEM.
+ */
+static long dma_pte_set(struct domain *d, unsigned long gfn,
+                        unsigned long mfn, unsigned int level,
+                        unsigned int flags, bool_t *flush)
 {
     struct domain_iommu *hd = dom_iommu(d);
-    struct dma_pte *page = NULL, *pte = NULL, old, new = { 0 };
+    struct dma_pte *page, *pte, old, new = { 0 };
+    u64 addr = (paddr_t)gfn << PAGE_SHIFT_4K;
     u64 pg_maddr;
-    int rc = 0;
-
-    /* Do nothing if VT-d shares EPT page table */
-    if ( iommu_use_hap_pt(d) )
-        return 0;
-
-    /* Do nothing if hardware domain and iommu supports pass thru. */
-    if ( iommu_passthrough && is_hardware_domain(d) )
-        return 0;
 
     spin_lock(&hd->arch.mapping_lock);
 
-    pg_maddr = addr_to_dma_page_maddr(d, (paddr_t)gfn << PAGE_SHIFT_4K, 1);
-    if ( pg_maddr == 0 )
+    for ( ; ; level-- )
     {
-        spin_unlock(&hd->arch.mapping_lock);
-        return -ENOMEM;
+        pg_maddr = addr_to_dma_page_maddr(d, addr, &level, 1);
+        if ( pg_maddr == 0 )
+        {
+            spin_unlock(&hd->arch.mapping_lock);
+            return -ENOMEM;
+        }
+        page = (struct dma_pte *)map_vtd_domain_page(pg_maddr);
+        pte = page + address_level_offset(addr, level);
+        old = *pte;
+
+        /*
+         * Don't replace a page table by a superpage: it would have to be
+         * freed, after flushing.  Map at the next level down instead.
+         */
+        if ( level == 1 || !dma_pte_present(old) || dma_pte_superpage(old) )
+            break;
+
+        unmap_vtd_domain_page(page);
     }
-    page = (struct dma_pte *)map_vtd_domain_page(pg_maddr);
-    pte = page + (gfn & LEVEL_MASK);
-    old = *pte;
+
     dma_set_pte_addr(new, (paddr_t)mfn << PAGE_SHIFT_4K);
     dma_set_pte_prot(new,
                      ((flags & IOMMUF_readable) ? DMA_PTE_READ  : 0) |
                      ((flags & IOMMUF_writable) ? DMA_PTE_WRITE : 0));
+    if ( level > 1 )
+        dma_set_pte_superpage(new);
 
     /* Set the SNP on leaf page table if Snoop Control available */
     if ( iommu_snoop )
         dma_set_pte_snp(new);
 
-    if ( old.val == new.val )
+    if ( old.val != new.val )
     {
-        spin_unlock(&hd->arch.mapping_lock);
-        unmap_vtd_domain_page(page);
-        return 0;
+        write_atomic(&pte->val, new.val);
+        iommu_flush_cache_entry(pte, sizeof(struct dma_pte));
+        if ( dma_pte_present(old) )
+            *flush = 1;
     }
-    *pte = new;
 
-    iommu_flush_cache_entry(pte, sizeof(struct dma_pte));
     spin_unlock(&hd->arch.mapping_lock);
     unmap_vtd_domain_page(page);
 
+    return 1L << level_to_order(level);
+}
+
+static int __must_check dma_pte_clear_range(struct domain *d,
+                                            unsigned long gfn,
+                                            unsigned long nr)
+{
+    unsigned long i;
+    bool_t flush = 0;
+    long rc = 0;
+
+    for ( i = 0; i < nr; i += rc )
+    {
+        rc = dma_pte_clear(d, gfn + i, nr - i, &flush);
+        if ( rc < 0 )
+            break;
+    }
+
+    if ( flush && !this_cpu(iommu_dont_flush_iotlb) )
+    {
+        int ret = iommu_flush_iotlb_pages(d, gfn, nr);
+
+        if ( rc >= 0 )
+            rc = ret;
+    }
+
+    return rc < 0 ? rc : 0;
+}
+
+static int __must_check intel_iommu_map_pages(struct domain *d,
+                                              unsigned long gfn,
+                                              unsigned long mfn,
+                                              unsigned int order,
+                                              unsigned int flags)
+{
+    const struct domain_iommu *hd = dom_iommu(d);
+    unsigned long i, nr = 1UL << order;
+    unsigned int max_level = min_t(unsigned int, vtd_max_sp_level,
+                                   agaw_to_level(hd->arch.agaw));
+    bool_t flush = 0;
+    long rc = 0;
+
+    /* Do nothing if VT-d shares EPT page table */
+    if ( iommu_use_hap_pt(d) )
+        return 0;
+
+    /* Do nothing if hardware domain and iommu supports pass thru. */
+    if ( iommu_passthrough && is_hardware_domain(d) )
+        return 0;
+
+    for ( i = 0; i < nr; i += rc )
+    {
+        rc = dma_pte_set(d, gfn + i, mfn + i,
+                         dma_pte_level(gfn + i, mfn + i, nr - i, max_level),
+                         flags, &flush);
+        if ( rc < 0 )
+        {
+            /*
+             * Undo what this call installed, leaving the rest alone.  If
+             * statement to satisfy __must_check.
+             */
+            if ( i && dma_pte_clear_range(d, gfn, i) )
+                ;
+            return rc;
+        }
+    }
+
     if ( !this_cpu(iommu_dont_flush_iotlb) )
-        rc = iommu_flush_iotlb(d, gfn, dma_pte_present(old), 1);
+        return iommu_flush_iotlb(d, gfn, flush, nr);
 
-    return rc;
+    return 0;
 }
 
-static int __must_check intel_iommu_unmap_page(struct domain *d,
-                                               unsigned long gfn)
+static int __must_check intel_iommu_unmap_pages(struct domain *d,
+                                                unsigned long gfn,
+                                                unsigned int order)
 {
     /* Do nothing if hardware domain and iommu supports pass thru. */
     if ( iommu_passthrough && is_hardware_domain(d) )
         return 0;
 
-    return dma_pte_clear_one(d, (paddr_t)gfn << PAGE_SHIFT_4K);
+    return dma_pte_clear_range(d, gfn, 1UL << order);
+}
+
+static int __must_check intel_iommu_map_page(struct domain *d,
+                                             unsigned long gfn,
+                                             unsigned long mfn,
+                                             unsigned int flags)
+{
+    return intel_iommu_map_pages(d, gfn, mfn, PAGE_ORDER_4K, flags);
+}
+
+static int __must_check intel_iommu_unmap_page(struct domain *d,
+                                               unsigned long gfn)
+{
+    return intel_iommu_unmap_pages(d, gfn, PAGE_ORDER_4K);
 }
 
 int iommu_pte_flush(struct domain *d, u64 gfn, u64 *pte,
@@ -1843,6 +2048,7 @@ int iommu_pte_flush(struct domain *d, u64 gfn, u64 *pte,
     int rc = 0;
 
     iommu_flush_cache_entry(pte, sizeof(struct dma_pte));
+    atomic_inc(&hd->iotlb_flushes);
 
     for_each_drhd_unit ( drhd )
     {
@@ -2266,6 +2472,11 @@ int __init intel_vtd_setup(void)
 
         printk(".\n");
 
+        if ( !cap_sps_2mb(iommu->cap) )
+            vtd_max_sp_level = 1;
+        else if ( !cap_sps_1gb(iommu->cap) )
+            vtd_max_sp_level = min(vtd_max_sp_level, 2u);
+
         if ( iommu_snoop && !ecap_snp_ctl(iommu->ecap) )
             iommu_snoop = 0;
 
@@ -2299,6 +2510,9 @@ int __init intel_vtd_setup(void)
 
     softirq_tasklet_init(&vtd_fault_tasklet, do_iommu_page_fault, 0);
 
+    if ( !iommu_superpages )
+        vtd_max_sp_level = 1;
+
     if ( !iommu_qinval && iommu_intremap )
     {
         iommu_intremap = 0;
@@ -2313,6 +2527,7 @@ int __init intel_vtd_setup(void)
     P(iommu_intremap, "Interrupt Remapping");
     P(iommu_intpost, "Posted Interrupt");
     P(iommu_hap_pt_share, "Shared EPT tables");
+    P(vtd_max_sp_level > 1, "Superpage mappings");
 #undef P
 
     ret = scan_pci_devices();
@@ -2622,9 +2837,15 @@ static void vtd_dump_p2m_table_level(paddr_t pt_maddr, int level, paddr_t gpa,
             continue;
 
         address = gpa + offset_level_address(i, level);
-        if ( next_level >= 1 ) 
+        if ( next_level >= 1 && !dma_pte_superpage(*pte) )
             vtd_dump_p2m_table_level(dma_pte_addr(*pte), next_level, 
                                      address, indent + 1);
+        else if ( next_level >= 1 )
+            printk("%*sgfn: %08lx mfn: %08lx order: %u\n",
+                   indent, "",
+                   (unsigned long)(address >> PAGE_SHIFT_4K),
+                   (unsigned long)(dma_pte_addr(*pte) >> PAGE_SHIFT_4K),
+                   next_level * LEVEL_STRIDE);
         else
             printk("%*sgfn: %08lx mfn: %08lx\n",
                    indent, "",
@@ -2657,6 +2878,8 @@ const struct iommu_ops intel_iommu_ops = {
     .teardown = iommu_domain_teardown,
     .map_page = intel_iommu_map_page,
     .unmap_page = intel_iommu_unmap_page,
+    .map_pages = intel_iommu_map_pages,
+    .unmap_pages = intel_iommu_unmap_pages,
     .free_page_table = iommu_free_page_table,
     .reassign_device = reassign_device_ownership,
     .get_device_group_id = intel_iommu_group_id,
@@ -240,6 +240,7 @@ struct context_entry {
 #define agaw_to_width(val) (30 + val * LEVEL_STRIDE)
 #define width_to_agaw(w)   ((w - 30)/LEVEL_STRIDE)
 #define level_to_offset_bits(l) (12 + (l - 1) * LEVEL_STRIDE)
+#define level_to_order(l)  (((l) - 1) * LEVEL_STRIDE)
 #define address_level_offset(addr, level) \
             ((addr >> level_to_offset_bits(level)) & LEVEL_MASK)
 #define offset_level_address(offset, level) \
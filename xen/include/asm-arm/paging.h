@@ -3,6 +3,7 @@
 
 #define paging_mode_translate(d)              (1)
 #define paging_mode_external(d)               (1)
+#define paging_vcpu_dirty_pages(v)            (0)
 
 #endif /* XEN_PAGING_H */
 
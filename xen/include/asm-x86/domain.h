@@ -172,6 +172,8 @@ struct hap_domain {
 /************************************************/
 /*       common paging data structure           */
 /************************************************/
+struct xen_domctl_dirty_range;
+
 struct log_dirty_domain {
     /* log-dirty radix tree to record dirty pages */
     mfn_t          top;
@@ -187,6 +189,10 @@ struct log_dirty_domain {
         int        (*enable  )(struct domain *d, bool log_global);
         int        (*disable )(struct domain *d);
         void       (*clean   )(struct domain *d);
+        /* Optional: revoke write access to just the given ranges again. */
+        void       (*clean_ranges)(struct domain *d,
+                                   const struct xen_domctl_dirty_range *r,
+                                   unsigned int nr);
     } *ops;
 };
 
@@ -237,6 +243,9 @@ struct paging_vcpu {
     struct shadow_vtlb *vtlb;
     spinlock_t          vtlb_lock;
 
+    /* Pages newly marked dirty by this vcpu in the log-dirty bitmap. */
+    unsigned long log_dirty_count;
+
     /* paging support extension */
     struct shadow_vcpu shadow;
 };
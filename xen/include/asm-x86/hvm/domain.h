@@ -34,6 +34,7 @@
 #include <public/hvm/save.h>
 #include <public/hvm/hvm_op.h>
 #include <public/hvm/dm_op.h>
+#include <public/hvm/ioreq.h>
 
 struct hvm_ioreq_page {
     gfn_t gfn;
@@ -46,6 +47,9 @@ struct hvm_ioreq_vcpu {
     struct vcpu      *vcpu;
     evtchn_port_t    ioreq_evtchn;
     bool             pending;
+    /* Waiting for the posted write ring to be consumed up to drain_prod. */
+    bool             drain;
+    uint32_t         drain_prod;
 };
 
 #define NR_IO_RANGE_TYPES (XEN_DMOP_IO_RANGE_PCI + 1)
@@ -61,10 +65,17 @@ struct hvm_ioreq_server {
     struct list_head       ioreq_vcpu_list;
     struct hvm_ioreq_page  bufioreq;
 
-    /* Lock to serialize access to buffered ioreq ring */
+    /* Lock to serialize access to buffered and posted ioreq rings */
     spinlock_t             bufioreq_lock;
     evtchn_port_t          bufioreq_evtchn;
     struct rangeset        *range[NR_IO_RANGE_TYPES];
+
+    /* Port and memory ranges (subsets of range[]) with posted writes. */
+    struct rangeset        *posted[XEN_DMOP_IO_RANGE_MEMORY + 1];
+    /* Indexes, then slots, of the posted write ring (see posted_iopage_t). */
+    struct hvm_ioreq_page  posted_ring[1 + IOREQ_POSTED_PAGES];
+    uint32_t               posted_prod;
+
     bool                   enabled;
     uint8_t                bufioreq_handling;
 };
@@ -119,6 +130,9 @@ struct hvm_domain {
 
     struct hvm_io_handler *io_handler;
     unsigned int          io_handler_count;
+    /* Port I/O handlers of fixed range, as io_handler[] indices by port. */
+    uint8_t               portio_index[NR_IO_HANDLERS];
+    unsigned int          portio_count;
 
     /* Lock protects access to irq, vpic and vioapic. */
     spinlock_t             irq_lock;
@@ -82,6 +82,9 @@ struct segment_register *hvmemul_get_seg_reg(
     enum x86_segment seg,
     struct hvm_emulate_ctxt *hvmemul_ctxt);
 int hvm_emulate_one_mmio(unsigned long mfn, unsigned long gla);
+bool hvm_emulate_mmio_fast(paddr_t gpa, unsigned long gla,
+                           struct npfec access);
+bool hvm_emulate_mmio_fast_completion(void);
 
 static inline bool handle_mmio(void)
 {
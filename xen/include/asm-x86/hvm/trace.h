@@ -49,6 +49,7 @@
 #define DO_TRC_HVM_INVLPG64    DEFAULT_HVM_MISC
 #define DO_TRC_HVM_IO_ASSIST   DEFAULT_HVM_MISC
 #define DO_TRC_HVM_MMIO_ASSIST DEFAULT_HVM_MISC
+#define DO_TRC_HVM_MMIO_FAST   DEFAULT_HVM_IO
 #define DO_TRC_HVM_CLTS        DEFAULT_HVM_MISC
 #define DO_TRC_HVM_LMSW        DEFAULT_HVM_MISC
 #define DO_TRC_HVM_LMSW64      DEFAULT_HVM_MISC
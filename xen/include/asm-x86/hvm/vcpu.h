@@ -32,6 +32,7 @@
 enum hvm_io_completion {
     HVMIO_no_completion,
     HVMIO_mmio_completion,
+    HVMIO_mmio_fast_completion,
     HVMIO_pio_completion,
     HVMIO_realmode_completion
 };
@@ -78,17 +79,30 @@ struct hvm_vcpu_io {
     /* For retries we shouldn't re-fetch the instruction. */
     unsigned int mmio_insn_bytes;
     unsigned char mmio_insn[16];
+
+    /* Instructions recently decoded by the emulator (NULL if none). */
+    struct x86_decode_cache *decode_cache;
+
+    /* Length and register of a MOV being completed by the MMIO fast path. */
+    uint8_t mmio_fast_len, mmio_fast_reg;
+
     /*
      * For string instruction emulation we need to be able to signal a
      * necessary retry through other than function return codes.
      */
     bool_t mmio_retry;
 
+    /* Blocked until a posted write ring drains (see hvm_send_ioreq()). */
+    bool posted_drain;
+
     unsigned long msix_unmask_address;
     unsigned long msix_snoop_address;
     unsigned long msix_snoop_gpa;
 
     const struct g2m_ioport *g2m_ioport;
+
+    /* io_handler[] index of the last MMIO handler to accept an access. */
+    unsigned int mmio_handler_hint;
 };
 
 static inline bool hvm_ioreq_needs_completion(const ioreq_t *ioreq)
@@ -152,6 +152,11 @@ void paging_log_dirty_init(struct domain *d, const struct log_dirty_ops *ops);
 void paging_mark_dirty(struct domain *d, mfn_t gmfn);
 /* mark a page as dirty with taking guest pfn as parameter */
 void paging_mark_pfn_dirty(struct domain *d, pfn_t pfn);
+/* as above, on behalf of a vcpu other than (possibly) current */
+void paging_mark_pfn_dirty_vcpu(struct vcpu *v, pfn_t pfn);
+
+/* pages newly marked dirty by this vcpu, for dirty rate estimates */
+#define paging_vcpu_dirty_pages(v) ((v)->arch.paging.log_dirty_count)
 
 /* is this guest page dirty? 
  * This is called from inside paging code, with the paging lock held. */
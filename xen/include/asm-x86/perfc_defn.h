@@ -15,6 +15,14 @@ PERFCOUNTER_ARRAY(svmexits,             "SVMexits", SVM_PERF_EXIT_REASON_SIZE)
 
 PERFCOUNTER(seg_fixups,             "segmentation fixups")
 
+#define PERFC_hvm_io_probes_BUCKET_SIZE 1
+PERFCOUNTER_ARRAY(hvm_io_probes,    "hvm io handler lookup probes", 10)
+PERFCOUNTER(hvm_mmio_fast,          "hvm mmio fast path")
+PERFCOUNTER(hvm_mmio_fast_fallback, "hvm mmio fast path fallback")
+PERFCOUNTER(ioreq_posted,           "ioreq posted writes")
+PERFCOUNTER(ioreq_posted_full,      "ioreq posted ring full")
+PERFCOUNTER(ioreq_posted_drain,     "ioreq waits for posted ring")
+
 PERFCOUNTER(apic_timer,             "apic timer interrupts")
 
 PERFCOUNTER(domain_page_tlb_flush,  "domain page tlb flushes")
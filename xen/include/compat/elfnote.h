@@ -0,0 +1,7 @@
+#ifndef _COMPAT_ELFNOTE_H
+#define _COMPAT_ELFNOTE_H
+#include <xen/compat.h>
+#include <public/elfnote.h>
+#pragma pack(4)
+#pragma pack()
+#endif /* _COMPAT_ELFNOTE_H */
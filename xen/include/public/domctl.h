@@ -38,7 +38,7 @@
 #include "hvm/save.h"
 #include "memory.h"
 
-#define XEN_DOMCTL_INTERFACE_VERSION 0x00000010
+#define XEN_DOMCTL_INTERFACE_VERSION 0x00000011
 
 /*
  * NB. xen_domctl.domain is an IN/OUT parameter for this operation.
@@ -169,6 +169,15 @@ struct xen_domctl_getpageframeinfo3 {
 #define XEN_DOMCTL_SHADOW_OP_CLEAN       11
  /* Return the bitmap but do not modify internal copy. */
 #define XEN_DOMCTL_SHADOW_OP_PEEK        12
+ /*
+  * Return dirty pfns from 'cursor' onwards as ranges, and clean the
+  * internal copy of those returned.  Each call returns at most
+  * 'nr_ranges' ranges and may stop early; the caller repeats the call
+  * with the updated 'cursor' until it reaches 'pages'.
+  */
+#define XEN_DOMCTL_SHADOW_OP_CLEAN_RANGES 13
+ /* As CLEAN_RANGES, but do not modify internal copy. */
+#define XEN_DOMCTL_SHADOW_OP_PEEK_RANGES  14
 
 /* Memory allocation accessors. */
 #define XEN_DOMCTL_SHADOW_OP_GET_ALLOCATION   30
@@ -206,7 +215,7 @@ struct xen_domctl_getpageframeinfo3 {
   */
 #define XEN_DOMCTL_SHADOW_ENABLE_EXTERNAL  (1 << 4)
 
-/* Mode flags for XEN_DOMCTL_SHADOW_OP_{CLEAN,PEEK}. */
+/* Mode flags for XEN_DOMCTL_SHADOW_OP_{CLEAN,PEEK}{,_RANGES}. */
  /*
   * This is the final iteration: Requesting to include pages mapped
   * writably by the hypervisor in the dirty bitmap.
@@ -218,6 +227,13 @@ struct xen_domctl_shadow_op_stats {
     uint32_t dirty_count;
 };
 
+struct xen_domctl_dirty_range {
+    uint64_aligned_t pfn;   /* First dirty pfn. */
+    uint64_aligned_t nr;    /* Number of contiguous dirty pfns. */
+};
+typedef struct xen_domctl_dirty_range xen_domctl_dirty_range_t;
+DEFINE_XEN_GUEST_HANDLE(xen_domctl_dirty_range_t);
+
 struct xen_domctl_shadow_op {
     /* IN variables. */
     uint32_t       op;       /* XEN_DOMCTL_SHADOW_OP_* */
@@ -232,7 +248,14 @@ struct xen_domctl_shadow_op {
     /* OP_PEEK / OP_CLEAN */
     XEN_GUEST_HANDLE_64(uint8) dirty_bitmap;
     uint64_aligned_t pages; /* Size of buffer. Updated with actual size. */
+                            /* OP_*_RANGES: end of the pfn space to scan. */
     struct xen_domctl_shadow_op_stats stats;
+
+    /* OP_PEEK_RANGES / OP_CLEAN_RANGES */
+    XEN_GUEST_HANDLE_64(xen_domctl_dirty_range_t) dirty_ranges;
+    uint64_aligned_t cursor;  /* IN: first pfn to scan. OUT: where to resume. */
+    uint32_t nr_ranges;       /* IN: size of buffer. OUT: ranges returned. */
+    uint32_t pad;
 };
 
 
@@ -261,6 +284,8 @@ struct xen_domctl_getvcpuinfo {
     uint8_t  running;                 /* currently scheduled on its CPU? */
     uint64_aligned_t cpu_time;        /* total cpu time consumed (ns) */
     uint32_t cpu;                     /* current mapping   */
+    uint64_aligned_t dirty_pages;     /* pages newly marked dirty in the
+                                         log-dirty bitmap by this vcpu */
 };
 
 
@@ -332,6 +357,11 @@ struct xen_domctl_sched_credit {
 struct xen_domctl_sched_credit2 {
     uint16_t weight;
     uint16_t cap;
+    /*
+     * OUT (get only): percentage of the domain's memory that is on the NUMA
+     * nodes the vCPU (or, on average, the domain's vCPUs) is running on.
+     */
+    uint16_t locality;
 };
 
 struct xen_domctl_sched_rtds {
@@ -355,7 +385,8 @@ DEFINE_XEN_GUEST_HANDLE(xen_domctl_schedparam_vcpu_t);
 
 /*
  * Set or get info?
- * For schedulers supporting per-vcpu settings (e.g., RTDS):
+ * For schedulers supporting per-vcpu settings (e.g., RTDS, and Credit2
+ * for the cap only):
  *  XEN_DOMCTL_SCHEDOP_putinfo sets params for all vcpus;
  *  XEN_DOMCTL_SCHEDOP_getinfo gets default params;
  *  XEN_DOMCTL_SCHEDOP_put(get)vcpuinfo sets (gets) params of vcpus;
@@ -74,6 +74,8 @@
 #define EVTCHNOP_init_control    11
 #define EVTCHNOP_expand_array    12
 #define EVTCHNOP_set_priority    13
+#define EVTCHNOP_send_batch      14
+#define EVTCHNOP_set_moderation  15
 /* ` } */
 
 typedef uint32_t evtchn_port_t;
@@ -312,6 +314,36 @@ struct evtchn_set_priority {
 };
 typedef struct evtchn_set_priority evtchn_set_priority_t;
 
+/*
+ * EVTCHNOP_send_batch: Send an event on each of <ports>, as EVTCHNOP_send
+ * would.  Events for the same vcpu are raised together, with at most one
+ * upcall.  Nothing is sent if any port is invalid.  A port listed more than
+ * once is only sent once.
+ */
+#define EVTCHN_SEND_BATCH_MAX 16
+struct evtchn_send_batch {
+    /* IN parameters. */
+    uint32_t nr_ports;
+    evtchn_port_t ports[EVTCHN_SEND_BATCH_MAX];
+};
+typedef struct evtchn_send_batch evtchn_send_batch_t;
+
+/*
+ * EVTCHNOP_set_moderation: Moderate the events sent to local port <port>
+ * by its remote end, be it a domain or Xen.  At most <max_events> events are delivered in each
+ * interval of <interval_us> microseconds (at most 1 second); further sends
+ * within the interval are merged into one event delivered at its end.
+ * A <max_events> of 0 turns moderation off.  The port must be unbound or
+ * interdomain, and closing it turns moderation off.
+ */
+struct evtchn_set_moderation {
+    /* IN parameters. */
+    uint32_t port;
+    uint32_t max_events;
+    uint32_t interval_us;
+};
+typedef struct evtchn_set_moderation evtchn_set_moderation_t;
+
 /*
  * ` enum neg_errnoval
  * ` HYPERVISOR_event_channel_op_compat(struct evtchn_op *op)
@@ -132,6 +132,11 @@ struct xen_dm_op_get_ioreq_server_info {
  *
  * NOTE: unless an emulation request falls entirely within a range mapped
  * by a secondary emulator, it will not be passed to that emulator.
+ *
+ * Writes to port or memory ranges mapped with XEN_DMOP_io_range_posted
+ * are queued in the server's ring of posted writes (see posted_iopage_t)
+ * instead of the vCPU waiting for them to be handled, unless the ring is
+ * full.  This requires the server to handle buffered ioreqs.
  */
 #define XEN_DMOP_map_io_range_to_ioreq_server 3
 #define XEN_DMOP_unmap_io_range_from_ioreq_server 4
@@ -139,7 +144,12 @@ struct xen_dm_op_get_ioreq_server_info {
 struct xen_dm_op_ioreq_server_range {
     /* IN - server id */
     ioservid_t id;
-    uint16_t pad;
+    /* IN - flags (must be zero for unmapping) */
+    uint16_t flags;
+
+#define _XEN_DMOP_io_range_posted 0
+#define XEN_DMOP_io_range_posted (1u << _XEN_DMOP_io_range_posted)
+
     /* IN - type of range */
     uint32_t type;
 # define XEN_DMOP_IO_RANGE_PORT   0 /* I/O port range */
@@ -98,6 +98,47 @@ struct buffered_iopage {
 }; /* NB. Size of this structure must be no greater than one page. */
 typedef struct buffered_iopage buffered_iopage_t;
 
+/*
+ * Ring of posted writes, for ranges an IOREQ Server registered with
+ * XEN_DMOP_io_range_posted.  The indexes live in the first frame of the
+ * ring (see XENMEM_resource_ioreq_server_frame_posted()), the slots in the
+ * IOREQ_POSTED_PAGES following ones, IOREQ_POSTED_SLOTS_PER_PAGE to a page.
+ *
+ * Indexes are free running.  The device model is sent a notification on
+ * the buffered ioreq event channel when prod advances past prod_event, so
+ * having consumed all slots it should set prod_event to cons + 1 and then
+ * check prod once more.
+ *
+ * A synchronous ioreq (port, memory or PCI config space) is not sent to
+ * the server while writes posted ahead of it are yet to be consumed, so
+ * the device model must only advance cons past a write once it has carried
+ * it out.  Instead, Xen sets cons_event to the prod value those writes end
+ * at, and blocks the vCPU.  Having advanced cons from old to new, the
+ * device model must send a notification on the buffered ioreq event
+ * channel if cons_event lies in (old, new].
+ */
+struct posted_ioreq {
+    uint64_t addr;   /* physical address (IOREQ_TYPE_COPY) or port */
+    uint64_t data;
+    uint8_t  type;   /* IOREQ_TYPE_COPY or IOREQ_TYPE_PIO */
+    uint8_t  size;   /* 1, 2, 4 or 8 */
+    uint8_t  pad[14];
+};
+typedef struct posted_ioreq posted_ioreq_t;
+
+#define IOREQ_POSTED_PAGES          4
+#define IOREQ_POSTED_SLOTS_PER_PAGE 128 /* 32 bytes each */
+#define IOREQ_POSTED_SLOT_NUM       (IOREQ_POSTED_PAGES * \
+                                     IOREQ_POSTED_SLOTS_PER_PAGE)
+
+struct posted_iopage {
+    uint32_t prod;       /* written by Xen */
+    uint32_t prod_event; /* written by the device model */
+    uint32_t cons;       /* written by the device model */
+    uint32_t cons_event; /* written by Xen */
+};
+typedef struct posted_iopage posted_iopage_t;
+
 /*
  * ACPI Control/Event register locations. Location is controlled by a 
  * version number in HVM_PARAM_ACPI_IOPORTS_LOCATION.
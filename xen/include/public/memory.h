@@ -650,6 +650,12 @@ struct xen_mem_acquire_resource {
 
 #define XENMEM_resource_ioreq_server_frame_bufioreq 0
 #define XENMEM_resource_ioreq_server_frame_ioreq(n) (1 + (n))
+/*
+ * Ring of posted writes: its indexes, then IOREQ_POSTED_PAGES of slots.
+ * Acquiring these fails with -ENOENT until the first posted range has been
+ * mapped (XEN_DMOP_io_range_posted).
+ */
+#define XENMEM_resource_ioreq_server_frame_posted(n) (0x100 + (n))
 
     /*
      * IN/OUT - If the tools domain is PV then, upon return, frame_list
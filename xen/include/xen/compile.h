@@ -0,0 +1,15 @@
+#define XEN_COMPILE_DATE	"Sat Oct 17 01:22:37 UTC 2026"
+#define XEN_COMPILE_TIME	"01:22:37"
+#define XEN_COMPILE_BY		""
+#define XEN_COMPILE_DOMAIN	""
+#define XEN_COMPILE_HOST	"vm"
+#define XEN_COMPILER		"gcc (Debian 12.2.0-14+deb12u1) 12.2.0"
+
+#define XEN_VERSION		4
+#define XEN_SUBVERSION		12
+#define XEN_EXTRAVERSION	"-unstable"
+
+#define XEN_CHANGESET		"Sat Oct 17 01:21:11 2026 +0000 git:e7ecb04-dirty"
+#define XEN_BANNER		\
+"\040\130\145\156\040\064\056\061\062\055\165\156\163\164\141\142\154\145" \
+"\012"
@@ -150,6 +150,12 @@ int evtchn_reset(struct domain *d);
 struct evtchn_port_ops {
     void (*init)(struct domain *d, struct evtchn *evtchn);
     void (*set_pending)(struct vcpu *v, struct evtchn *evtchn);
+    /*
+     * Optional: raise @nr events for vcpu @v at once.  The caller holds
+     * each event's channel lock.
+     */
+    void (*set_pending_batch)(struct vcpu *v, struct evtchn **evtchns,
+                              unsigned int nr);
     void (*clear_pending)(struct domain *d, struct evtchn *evtchn);
     void (*unmask)(struct domain *d, struct evtchn *evtchn);
     bool (*is_pending)(const struct domain *d, evtchn_port_t port);
@@ -177,6 +183,23 @@ static inline void evtchn_port_set_pending(struct domain *d,
     d->evtchn_port_ops->set_pending(d->vcpu[vcpu_id], evtchn);
 }
 
+static inline void evtchn_port_set_pending_batch(struct domain *d,
+                                                 unsigned int vcpu_id,
+                                                 struct evtchn **evtchns,
+                                                 unsigned int nr)
+{
+    unsigned int i;
+
+    if ( d->evtchn_port_ops->set_pending_batch )
+    {
+        d->evtchn_port_ops->set_pending_batch(d->vcpu[vcpu_id], evtchns, nr);
+        return;
+    }
+
+    for ( i = 0; i < nr; i++ )
+        d->evtchn_port_ops->set_pending(d->vcpu[vcpu_id], evtchns[i]);
+}
+
 static inline void evtchn_port_clear_pending(struct domain *d,
                                              struct evtchn *evtchn)
 {
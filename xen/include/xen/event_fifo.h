@@ -14,6 +14,11 @@ struct evtchn_fifo_queue {
     uint32_t tail;
     uint8_t priority;
     spinlock_t lock;
+
+    /* Statistics, updated under lock. */
+    unsigned long links;        /* events linked */
+    unsigned long batched;      /* ... of which by set_pending_batch */
+    unsigned long contended;    /* lock acquisitions that had to wait */
 };
 
 struct evtchn_fifo_vcpu {
@@ -33,6 +38,7 @@ struct evtchn_fifo_domain {
 int evtchn_fifo_init_control(struct evtchn_init_control *init_control);
 int evtchn_fifo_expand_array(const struct evtchn_expand_array *expand_array);
 void evtchn_fifo_destroy(struct domain *domain);
+void evtchn_fifo_dump_queues(const struct domain *d);
 
 #endif /* __XEN_EVENT_FIFO_H__ */
 
@@ -33,6 +33,7 @@ extern bool_t force_iommu, iommu_dom0_strict, iommu_verbose;
 extern bool_t iommu_workaround_bios_bug, iommu_igfx, iommu_passthrough;
 extern bool_t iommu_snoop, iommu_qinval, iommu_intremap, iommu_intpost;
 extern bool_t iommu_hap_pt_share;
+extern bool_t iommu_superpages;
 extern bool_t iommu_debug;
 extern bool_t amd_iommu_perdev_intremap;
 
@@ -64,6 +65,19 @@ int __must_check iommu_map_page(struct domain *d, unsigned long gfn,
                                 unsigned long mfn, unsigned int flags);
 int __must_check iommu_unmap_page(struct domain *d, unsigned long gfn);
 
+/*
+ * Map (unmap) 2^order contiguous pages in one go.  Backends supporting it
+ * use superpages where alignment allows, and the IOTLB is flushed once for
+ * the whole range (unless iommu_dont_flush_iotlb is set).  On failure,
+ * iommu_map_pages() unmaps again whatever it had mapped of the range, and
+ * leaves the rest of it as it was.
+ */
+int __must_check iommu_map_pages(struct domain *d, unsigned long gfn,
+                                 unsigned long mfn, unsigned int order,
+                                 unsigned int flags);
+int __must_check iommu_unmap_pages(struct domain *d, unsigned long gfn,
+                                   unsigned int order);
+
 enum iommu_feature
 {
     IOMMU_FEAT_COHERENT_WALK,
@@ -85,6 +99,11 @@ struct domain_iommu {
 
     /* Features supported by the IOMMU */
     DECLARE_BITMAP(features, IOMMU_FEAT_count);
+
+    /* Statistics, shown by the 'q' debug key. */
+    atomic_t map_ops;       /* iommu_map_page{,s}() calls                */
+    atomic_t unmap_ops;     /* iommu_unmap_page{,s}() calls              */
+    atomic_t iotlb_flushes; /* IOTLB flushes issued for this domain      */
 };
 
 #define dom_iommu(d)              (&(d)->iommu)
@@ -153,6 +172,15 @@ struct iommu_ops {
     int __must_check (*map_page)(struct domain *d, unsigned long gfn,
                                  unsigned long mfn, unsigned int flags);
     int __must_check (*unmap_page)(struct domain *d, unsigned long gfn);
+    /*
+     * Optional: map_page/unmap_page are used page by page if absent.  On
+     * failure, map_pages has to undo whatever it installed itself.
+     */
+    int __must_check (*map_pages)(struct domain *d, unsigned long gfn,
+                                  unsigned long mfn, unsigned int order,
+                                  unsigned int flags);
+    int __must_check (*unmap_pages)(struct domain *d, unsigned long gfn,
+                                    unsigned int order);
     void (*free_page_table)(struct page_info *);
 #ifdef CONFIG_X86
     void (*update_ire_from_apic)(unsigned int apic, unsigned int reg, unsigned int value);
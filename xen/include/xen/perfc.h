@@ -112,7 +112,7 @@ extern void perfc_reset(unsigned char key);
 #define perfc_decra(x,y)  ((void)0)
 #define perfc_add(x,y)    ((void)0)
 #define perfc_adda(x,y,z) ((void)0)
-#define perfc_incr_histo(x,y,z) ((void)0)
+#define perfc_incr_histo(x,y) ((void)0)
 
 #endif /* CONFIG_PERF_COUNTERS */
 
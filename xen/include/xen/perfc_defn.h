@@ -80,4 +80,24 @@ PERFCOUNTER(tickled_cpu_overridden, "csched2: tickled_cpu_overridden")
 
 PERFCOUNTER(need_flush_tlb_flush,   "PG_need_flush tlb flushes")
 
+/* Page allocator per-CPU caches */
+PERFCOUNTER(page_cache_hit,         "page cache: allocs from cache")
+PERFCOUNTER(page_cache_refill,      "page cache: refills from heap")
+PERFCOUNTER(page_cache_bypass,      "page cache: allocs bypassing cache")
+PERFCOUNTER(page_cache_free,        "page cache: frees to cache")
+PERFCOUNTER(page_cache_drain,       "page cache: drains to heap")
+PERFCOUNTER(page_cache_flush,       "page cache: flushes of all caches")
+
+/* Grant table maptrack magazines */
+PERFCOUNTER(maptrack_refill,        "maptrack: magazine refills")
+PERFCOUNTER(maptrack_drain,         "maptrack: magazine drains")
+PERFCOUNTER(maptrack_steal,         "maptrack: handles stolen")
+
+/* FIFO event channels */
+PERFCOUNTER(evtchn_fifo_link,       "evtchn fifo: events linked")
+PERFCOUNTER(evtchn_fifo_batch_link, "evtchn fifo: events linked in batches")
+PERFCOUNTER(evtchn_fifo_contended,  "evtchn fifo: contended queue locks")
+PERFCOUNTER(evtchn_send_batch,      "evtchn: send_batch calls")
+PERFCOUNTER(evtchn_moderated,       "evtchn: sends deferred by moderation")
+
 /*#endif*/ /* __XEN_PERFC_DEFN_H__ */
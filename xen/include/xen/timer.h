@@ -26,6 +26,8 @@ struct timer {
         struct timer *list_next;
         /* Linked list of inactive timers (TIMER_STATUS_inactive). */
         struct list_head inactive;
+        /* Timer-wheel bucket list (TIMER_STATUS_in_wheel). */
+        struct list_head wheel;
     };
 
     /* On expiry, '(*function)(data)' will be executed in softirq context. */
@@ -36,12 +38,16 @@ struct timer {
 #define TIMER_CPU_status_killed 0xffffu /* Timer is TIMER_STATUS_killed */
     uint16_t cpu;
 
+    /* Timer-wheel bucket (TIMER_STATUS_in_wheel). */
+    uint16_t wheel_bucket;
+
     /* Timer status. */
 #define TIMER_STATUS_invalid  0 /* Should never see this.           */
 #define TIMER_STATUS_inactive 1 /* Not in use; can be activated.    */
 #define TIMER_STATUS_killed   2 /* Not in use; cannot be activated. */
 #define TIMER_STATUS_in_heap  3 /* In use; on timer heap.           */
 #define TIMER_STATUS_in_list  4 /* In use; on overflow linked list. */
+#define TIMER_STATUS_in_wheel 5 /* In use; on timer wheel.          */
     uint8_t status;
 };
 
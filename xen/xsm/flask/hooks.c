@@ -1496,6 +1496,8 @@ static int flask_shadow_control(struct domain *d, uint32_t op)
     case XEN_DOMCTL_SHADOW_OP_ENABLE_LOGDIRTY:
     case XEN_DOMCTL_SHADOW_OP_PEEK:
     case XEN_DOMCTL_SHADOW_OP_CLEAN:
+    case XEN_DOMCTL_SHADOW_OP_PEEK_RANGES:
+    case XEN_DOMCTL_SHADOW_OP_CLEAN_RANGES:
         perm = SHADOW__LOGDIRTY;
         break;
     default: